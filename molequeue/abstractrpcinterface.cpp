@@ -32,7 +32,9 @@ namespace MoleQueue
 AbstractRpcInterface::AbstractRpcInterface(QObject *parentObject) :
   QObject(parentObject),
   m_jsonrpc(new JsonRpc (this)),
-  m_packetCounter(0)
+  m_packetCounter(0),
+  m_batchConnection(NULL),
+  m_batchDepth(0)
 {
   // Randomize the packet counter's starting value.
   qsrand(static_cast<uint>(QDateTime::currentMSecsSinceEpoch()));
@@ -68,6 +70,14 @@ AbstractRpcInterface::AbstractRpcInterface(QObject *parentObject) :
           this, SLOT(replyWithInternalError(MoleQueue::Connection*,
                                             MoleQueue::EndpointId,
                                             Json::Value,Json::Value)));
+  connect(m_jsonrpc, SIGNAL(batchStarted(MoleQueue::Connection*,
+                                         MoleQueue::EndpointId)),
+          this, SLOT(beginBatch(MoleQueue::Connection*,
+                                MoleQueue::EndpointId)));
+  connect(m_jsonrpc, SIGNAL(batchFinished(MoleQueue::Connection*,
+                                          MoleQueue::EndpointId)),
+          this, SLOT(endBatch(MoleQueue::Connection*,
+                              MoleQueue::EndpointId)));
 }
 
 AbstractRpcInterface::~AbstractRpcInterface()
@@ -91,11 +101,10 @@ void AbstractRpcInterface::replyToInvalidPacket(MoleQueue::Connection *connectio
                                                 const Json::Value &errorDataObject)
 {
   PacketType packet = m_jsonrpc->generateErrorResponse(
-        -32700, "Parse error", errorDataObject, packetId);
+        -32700, "Parse error", errorDataObject, packetId,
+        m_jsonrpc->packetFormat(connection));
 
-  Message msg(replyTo, packet);
-
-  connection->send(msg);
+  sendReply(connection, replyTo, packet);
 }
 
 void AbstractRpcInterface::replyToInvalidRequest(MoleQueue::Connection *connection,
@@ -104,11 +113,10 @@ void AbstractRpcInterface::replyToInvalidRequest(MoleQueue::Connection *connecti
                                                  const Json::Value &errorDataObject)
 {
   PacketType packet = m_jsonrpc->generateErrorResponse(
-        -32600, "Invalid request", errorDataObject, packetId);
-
-  Message msg(replyTo, packet);
+        -32600, "Invalid request", errorDataObject, packetId,
+        m_jsonrpc->packetFormat(connection));
 
-  connection->send(msg);
+  sendReply(connection, replyTo, packet);
 }
 
 void AbstractRpcInterface::replyToUnrecognizedRequest(MoleQueue::Connection *connection,
@@ -117,11 +125,10 @@ void AbstractRpcInterface::replyToUnrecognizedRequest(MoleQueue::Connection *con
                                                       const Json::Value &errorDataObject)
 {
   PacketType packet = m_jsonrpc->generateErrorResponse(
-        -32601, "Method not found", errorDataObject, packetId);
-
-  Message msg(replyTo, packet);
+        -32601, "Method not found", errorDataObject, packetId,
+        m_jsonrpc->packetFormat(connection));
 
-  connection->send(msg);
+  sendReply(connection, replyTo, packet);
 }
 
 void AbstractRpcInterface::replyToinvalidRequestParams(MoleQueue::Connection *connection,
@@ -130,11 +137,10 @@ void AbstractRpcInterface::replyToinvalidRequestParams(MoleQueue::Connection *co
                                                        const Json::Value &errorDataObject)
 {
   PacketType packet = m_jsonrpc->generateErrorResponse(
-        -32602, "Invalid params", errorDataObject, packetId);
+        -32602, "Invalid params", errorDataObject, packetId,
+        m_jsonrpc->packetFormat(connection));
 
-  Message msg(replyTo, packet);
-
-  connection->send(msg);
+  sendReply(connection, replyTo, packet);
 }
 
 void AbstractRpcInterface::replyWithInternalError(MoleQueue::Connection *connection,
@@ -143,11 +149,45 @@ void AbstractRpcInterface::replyWithInternalError(MoleQueue::Connection *connect
                                                   const Json::Value &errorDataObject)
 {
   PacketType packet = m_jsonrpc->generateErrorResponse(
-        -32603, "Internal error", errorDataObject, packetId);
+        -32603, "Internal error", errorDataObject, packetId,
+        m_jsonrpc->packetFormat(connection));
 
-  Message msg(replyTo, packet);
+  sendReply(connection, replyTo, packet);
+}
 
-  connection->send(msg);
+void AbstractRpcInterface::beginBatch(MoleQueue::Connection *connection,
+                                      const MoleQueue::EndpointId replyTo)
+{
+  if (m_batchDepth++ > 0)
+    return;
+
+  m_batchConnection = connection;
+  m_batchReplyTo = replyTo;
+}
+
+void AbstractRpcInterface::endBatch(MoleQueue::Connection *connection,
+                                    const MoleQueue::EndpointId replyTo)
+{
+  Q_UNUSED(connection);
+  Q_UNUSED(replyTo);
+
+  if (m_batchDepth == 0 || --m_batchDepth > 0)
+    return;
+
+  if (!m_batchReplies.isEmpty()) {
+    Message msg(m_batchReplyTo, m_jsonrpc->generateBatch(m_batchReplies));
+    m_batchConnection->send(msg);
+  }
+
+  foreach (const PacketType &packet, m_batchNotifications) {
+    Message msg(m_batchReplyTo, packet);
+    m_batchConnection->send(msg);
+  }
+
+  m_batchReplies.clear();
+  m_batchNotifications.clear();
+  m_batchConnection = NULL;
+  m_batchReplyTo.clear();
 }
 
 IdType AbstractRpcInterface::nextPacketId()
@@ -155,4 +195,38 @@ IdType AbstractRpcInterface::nextPacketId()
   return m_packetCounter++;
 }
 
+void AbstractRpcInterface::sendReply(MoleQueue::Connection *connection,
+                                     const MoleQueue::EndpointId &replyTo,
+                                     const PacketType &packet)
+{
+  if (isBatchPending(connection, replyTo)) {
+    m_batchReplies.append(packet);
+    return;
+  }
+
+  Message msg(replyTo, packet);
+  connection->send(msg);
+}
+
+void AbstractRpcInterface::sendNotification(MoleQueue::Connection *connection,
+                                            const MoleQueue::EndpointId &to,
+                                            const PacketType &packet)
+{
+  if (isBatchPending(connection, to)) {
+    m_batchNotifications.append(packet);
+    return;
+  }
+
+  Message msg(to, packet);
+  connection->send(msg);
+}
+
+bool AbstractRpcInterface::isBatchPending(
+    const MoleQueue::Connection *connection,
+    const MoleQueue::EndpointId &replyTo) const
+{
+  return m_batchDepth > 0 && connection == m_batchConnection &&
+      replyTo == m_batchReplyTo;
+}
+
 } // end namespace MoleQueue
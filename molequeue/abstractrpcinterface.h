@@ -17,6 +17,7 @@
 #ifndef ABSTRACTRPCINTERFACE_H
 #define ABSTRACTRPCINTERFACE_H
 
+#include <QtCore/QList>
 #include <QtCore/QObject>
 
 #include "molequeueglobal.h"
@@ -125,6 +126,20 @@ protected slots:
                               const Json::Value &packetId,
                               const Json::Value &errorDataObject);
 
+  /**
+   * Start collecting the replies to a batch transmission received from
+   * @a replyTo on @a connection.
+   */
+  void beginBatch(MoleQueue::Connection *connection,
+                  const MoleQueue::EndpointId replyTo);
+
+  /**
+   * Send the replies collected since beginBatch() as a single batch response,
+   * followed by any notifications that were held back.
+   */
+  void endBatch(MoleQueue::Connection *connection,
+                const MoleQueue::EndpointId replyTo);
+
 protected:
 
   /**
@@ -132,12 +147,46 @@ protected:
    */
   IdType nextPacketId();
 
+  /**
+   * Send a response @a packet to @a replyTo over @a connection. While a batch
+   * from the same client is being processed, the response is added to the
+   * batch response instead.
+   */
+  void sendReply(MoleQueue::Connection *connection,
+                 const MoleQueue::EndpointId &replyTo,
+                 const PacketType &packet);
+
+  /**
+   * Send a notification @a packet to @a to over @a connection. While a batch
+   * from the same client is being processed, the notification is held back
+   * until the batch response has been sent.
+   */
+  void sendNotification(MoleQueue::Connection *connection,
+                        const MoleQueue::EndpointId &to,
+                        const PacketType &packet);
+
   /// The internal JsonRpc object
   JsonRpc *m_jsonrpc;
 
 private:
+  /// @return True if a batch from @a replyTo on @a connection is being
+  /// processed.
+  bool isBatchPending(const MoleQueue::Connection *connection,
+                      const MoleQueue::EndpointId &replyTo) const;
+
   /// Counter for packet requests @todo client side only? But what about notifications?
   IdType m_packetCounter;
+
+  /// Connection of the batch being processed.
+  Connection *m_batchConnection;
+  /// Reply to endpoint of the batch being processed.
+  EndpointId m_batchReplyTo;
+  /// Nesting depth of batches being processed. Zero if there is no batch.
+  int m_batchDepth;
+  /// Responses collected for the batch being processed.
+  QList<PacketType> m_batchReplies;
+  /// Notifications held back until the batch response has been sent.
+  QList<PacketType> m_batchNotifications;
 };
 
 } // end namespace MoleQueue
@@ -43,6 +43,9 @@ Client::Client(QObject *parentObject) :
                                               MoleQueue::QueueListType)),
           this, SLOT(queueListReceived(MoleQueue::IdType,
                                        MoleQueue::QueueListType)));
+  connect(m_jsonrpc, SIGNAL(queueStatusReceived(MoleQueue::IdType,
+                                                QVariantHash)),
+          this, SLOT(queueStatusReceived(MoleQueue::IdType, QVariantHash)));
   connect(m_jsonrpc, SIGNAL(successfulSubmissionReceived(MoleQueue::IdType,
                                                          MoleQueue::IdType,
                                                          QDir)),
@@ -69,12 +72,26 @@ Client::Client(QObject *parentObject) :
                                                    MoleQueue::IdType)),
           this, SLOT(lookupJobErrorReceived(MoleQueue::IdType,
                                             MoleQueue::IdType)));
+  connect(m_jsonrpc, SIGNAL(queueUpdateResponseReceived(MoleQueue::IdType,
+                                                        QVariantHash)),
+          this, SLOT(queueUpdateResponseReceived(MoleQueue::IdType,
+                                                 QVariantHash)));
+  connect(m_jsonrpc, SIGNAL(queueUpdateErrorReceived(MoleQueue::IdType,
+                                                     QString)),
+          this, SLOT(queueUpdateErrorReceived(MoleQueue::IdType, QString)));
+  connect(m_jsonrpc, SIGNAL(packetFormatResponseReceived(
+                              MoleQueue::IdType, MoleQueue::PacketFormat)),
+          this, SLOT(packetFormatResponseReceived(MoleQueue::IdType,
+                                                  MoleQueue::PacketFormat)));
   connect(m_jsonrpc, SIGNAL(jobStateChangeReceived(MoleQueue::IdType,
                                                    MoleQueue::JobState,
                                                    MoleQueue::JobState)),
           this, SLOT(jobStateChangeReceived(MoleQueue::IdType,
                                             MoleQueue::JobState,
                                             MoleQueue::JobState)));
+  connect(m_jsonrpc, SIGNAL(jobOutputReceived(MoleQueue::IdType,
+                                              QStringList)),
+          this, SLOT(jobOutputReceived(MoleQueue::IdType, QStringList)));
 }
 
 Client::~Client()
@@ -91,6 +108,27 @@ QueueListType Client::queueList() const
   return m_queueList;
 }
 
+QVariantHash Client::queueStatus() const
+{
+  return m_queueStatus;
+}
+
+void Client::setPacketFormat(PacketFormat format)
+{
+  m_jsonrpc->setDefaultPacketFormat(format);
+
+  if (m_connection && m_connection->isOpen()) {
+    const PacketType packet = m_jsonrpc->generatePacketFormatRequest(
+          m_jsonrpc->defaultPacketFormat(), nextPacketId());
+    m_connection->send(packet);
+  }
+}
+
+PacketFormat Client::packetFormat() const
+{
+  return m_jsonrpc->defaultPacketFormat();
+}
+
 void Client::submitJobRequest(const JobRequest &req)
 {
   const IdType id = nextPacketId();
@@ -99,6 +137,26 @@ void Client::submitJobRequest(const JobRequest &req)
   m_connection->send(packet);
 }
 
+void Client::submitJobRequests(const QList<JobRequest> &reqs)
+{
+  if (reqs.isEmpty())
+    return;
+
+  if (reqs.size() == 1) {
+    submitJobRequest(reqs.first());
+    return;
+  }
+
+  QList<PacketType> packets;
+  packets.reserve(reqs.size());
+  foreach (const JobRequest &req, reqs) {
+    const IdType id = nextPacketId();
+    packets.append(m_jsonrpc->generateJobRequest(req, id));
+    m_submittedLUT->insert(id, req);
+  }
+  m_connection->send(m_jsonrpc->generateBatch(packets));
+}
+
 void Client::cancelJob(const JobRequest &req)
 {
   const IdType id = nextPacketId();
@@ -114,12 +172,26 @@ void Client::lookupJob(IdType moleQueueId)
   m_connection->send(packet);
 }
 
+void Client::updateQueue(const QString &queueName)
+{
+  const IdType id = nextPacketId();
+  const PacketType packet = m_jsonrpc->generateQueueUpdateRequest(queueName,
+                                                                  id);
+  m_connection->send(packet);
+}
+
 void Client::queueListReceived(IdType, const QueueListType &list)
 {
   m_queueList = list;
   emit queueListUpdated(m_queueList);
 }
 
+void Client::queueStatusReceived(IdType, const QVariantHash &status)
+{
+  m_queueStatus = status;
+  emit queueStatusUpdated(m_queueStatus);
+}
+
 void Client::successfulSubmissionReceived(IdType packetId,
                                           IdType moleQueueId,
                                           const QDir &workingDir)
@@ -226,6 +298,22 @@ void Client::lookupJobErrorReceived(IdType, IdType moleQueueId)
   emit lookupJobComplete(JobRequest(), moleQueueId);
 }
 
+void Client::queueUpdateResponseReceived(IdType,
+                                         const QVariantHash &statistics)
+{
+  emit updateQueueComplete(statistics.value("queue").toString(), statistics);
+}
+
+void Client::queueUpdateErrorReceived(IdType, const QString &queueName)
+{
+  emit updateQueueComplete(queueName, QVariantHash());
+}
+
+void Client::packetFormatResponseReceived(IdType, PacketFormat format)
+{
+  emit packetFormatAccepted(format);
+}
+
 void Client::jobStateChangeReceived(IdType moleQueueId,
                                     JobState oldState, JobState newState)
 {
@@ -242,12 +330,31 @@ void Client::jobStateChangeReceived(IdType moleQueueId,
   emit jobStateChanged(JobRequest(req), oldState, newState);
 }
 
+void Client::jobOutputReceived(IdType moleQueueId, const QStringList &files)
+{
+  Job req = m_jobManager->lookupJobByMoleQueueId(moleQueueId);
+  if (!req.isValid()) {
+    qWarning() << "Client received a job output notification for a job with "
+                  "an unrecognized MoleQueue id:" << moleQueueId;
+    return;
+  }
+
+  emit jobOutputAvailable(JobRequest(req), files);
+}
+
 void Client::requestQueueListUpdate()
 {
   PacketType packet = m_jsonrpc->generateQueueListRequest(nextPacketId());
   m_connection->send(packet);
 }
 
+void Client::requestQueueStatusUpdate()
+{
+  PacketType packet =
+      m_jsonrpc->generateQueueStatusListRequest(nextPacketId());
+  m_connection->send(packet);
+}
+
 JobRequest Client::newJobRequest()
 {
   return m_jobManager->newJob();
@@ -85,11 +85,30 @@ public:
    */
   QueueListType queueList() const;
 
+  /**
+   * Retreive the most recent status of the queues, see Queue::status().
+   *
+   * @return Hash of queue name to status. Only queues that report a status
+   * are listed.
+   */
+  QVariantHash queueStatus() const;
+
   /**
    * Sets the connection to be used by this client.
    */
   void setConnection(Connection *connecton);
 
+  /**
+   * Set the format used to serialize packets sent to the server. The default
+   * is StyledPacketFormat; CompactPacketFormat produces smaller packets. If
+   * the client is connected, the server is asked to use the same format for
+   * the packets it sends to this client, see packetFormatAccepted().
+   */
+  void setPacketFormat(PacketFormat format);
+
+  /// @return The format used to serialize packets sent to the server.
+  PacketFormat packetFormat() const;
+
   /// Used for internal lookup structures
   typedef QMap<IdType, JobRequest> PacketLookupTable;
 
@@ -107,6 +126,14 @@ signals:
    */
   void queueListUpdated(const MoleQueue::QueueListType &list) const;
 
+  /**
+   * Emitted when the status of the queues has been updated from the MoleQueue
+   * server, after queueListUpdated.
+   *
+   * @param status Hash of queue name to status, see Queue::status().
+   */
+  void queueStatusUpdated(const QVariantHash &status) const;
+
   /**
    * Emitted when a job submission reply is received.
    * @param req The job request.
@@ -136,6 +163,25 @@ signals:
   void lookupJobComplete(const MoleQueue::JobRequest &req,
                          MoleQueue::IdType moleQueueId) const;
 
+  /**
+   * Emitted when a queue update reply is received.
+   * @param queueName The name of the queue from the request.
+   * @param statistics The queue update statistics of the queue, see
+   * QueueRemote::queueUpdateStatistics(). Empty if the queue is unknown or
+   * not a remote queue.
+   * @see updateQueue
+   */
+  void updateQueueComplete(const QString &queueName,
+                           const QVariantHash &statistics) const;
+
+  /**
+   * Emitted when the server confirms the format of the packets it sends to
+   * this client.
+   * @param format The format used by the server.
+   * @see setPacketFormat
+   */
+  void packetFormatAccepted(MoleQueue::PacketFormat format) const;
+
   /**
    * Emitted when a job changes state. The JobState of @a req will already be
    * set to @a newState.
@@ -148,6 +194,16 @@ signals:
                        MoleQueue::JobState oldState,
                        MoleQueue::JobState newState);
 
+  /**
+   * Emitted when new output of a running job has been copied to its local
+   * working directory. Only sent for programs that stream output.
+   *
+   * @param req The job request.
+   * @param files The updated files, relative to the local working directory.
+   */
+  void jobOutputAvailable(const MoleQueue::JobRequest &req,
+                          const QStringList &files);
+
 public slots:
 
   /**
@@ -165,6 +221,15 @@ public slots:
    */
   void requestQueueListUpdate();
 
+  /**
+   * Request a list of Queues and Programs and the status of each queue, e.g.
+   * whether a remote host is reachable, from the server.
+   * @sa queueListUpdated()
+   * @sa queueStatusUpdated()
+   * @sa queueStatus()
+   */
+  void requestQueueStatusUpdate();
+
   /**
    * @return A new Job object to fill with data and submit.
    */
@@ -176,6 +241,14 @@ public slots:
    */
   void submitJobRequest(const JobRequest &req);
 
+  /**
+   * Submit several job requests to the connected server in a single JSON-RPC
+   * batch transmission. The server answers with a single batch response, and
+   * jobSubmitted() is emitted for each request.
+   * @param reqs The Jobs
+   */
+  void submitJobRequests(const QList<JobRequest> &reqs);
+
   /**
    * Cancel a previously submitted job.
    * @param req The Job
@@ -191,6 +264,14 @@ public slots:
    */
   void lookupJob(MoleQueue::IdType moleQueueId);
 
+  /**
+   * Ask the server to check the jobs of a remote queue now rather than at
+   * the next scheduled queue update.
+   * @param queueName Name of the queue.
+   * @see updateQueueComplete
+   */
+  void updateQueue(const QString &queueName);
+
 protected slots:
 
   /**
@@ -200,6 +281,13 @@ protected slots:
   void queueListReceived(MoleQueue::IdType,
                          const MoleQueue::QueueListType &list);
 
+  /**
+   * Called when the JsonRpc instance handles a listQueues response that
+   * includes the queue status.
+   * @param status Hash of queue name to status
+   */
+  void queueStatusReceived(MoleQueue::IdType, const QVariantHash &status);
+
   /**
    * Called when the JsonRpc instance handles a successful submitJob response.
    *
@@ -242,6 +330,28 @@ protected slots:
    */
   void lookupJobErrorReceived(MoleQueue::IdType, MoleQueue::IdType moleQueueId);
 
+  /**
+   * Called when the JsonRpc instance handles a successful updateQueue
+   * response.
+   * @param statistics The queue update statistics, including the queue name.
+   */
+  void queueUpdateResponseReceived(MoleQueue::IdType,
+                                   const QVariantHash &statistics);
+
+  /**
+   * Called when the JsonRpc instance handles an unsuccessful updateQueue
+   * reply.
+   * @param queueName Requested queue name.
+   */
+  void queueUpdateErrorReceived(MoleQueue::IdType, const QString &queueName);
+
+  /**
+   * Called when the JsonRpc instance handles a setPacketFormat response.
+   * @param format The format used by the server.
+   */
+  void packetFormatResponseReceived(MoleQueue::IdType,
+                                    MoleQueue::PacketFormat format);
+
   /**
    * Called when the JsonRpc instance handles a job state change notification.
    *
@@ -253,6 +363,15 @@ protected slots:
                               MoleQueue::JobState oldState,
                               MoleQueue::JobState newState);
 
+  /**
+   * Called when the JsonRpc instance handles a job output notification.
+   *
+   * @param moleQueueId Unique MoleQueue identifier for the job.
+   * @param files The updated files.
+   */
+  void jobOutputReceived(MoleQueue::IdType moleQueueId,
+                         const QStringList &files);
+
 protected:
 
   /// JobManager for this client.
@@ -267,6 +386,9 @@ protected:
   /// Cached list of queues/programs
   QueueListType m_queueList;
 
+  /// Cached status of the queues
+  QVariantHash m_queueStatus;
+
   Connection *m_connection;
 };
 
@@ -30,7 +30,7 @@
 namespace MoleQueue
 {
 
-class FileSpecificationPrivate
+class FileSpecificationPrivate : public QSharedData
 {
 public:
   Json::Value json;
@@ -99,22 +99,25 @@ FileSpecification::FileSpecification(QFile *file, FileSpecification::Format form
 }
 
 FileSpecification::FileSpecification(const FileSpecification &other)
-  : d_ptr(new FileSpecificationPrivate())
+  : d_ptr(other.d_ptr)
 {
-  Q_D(FileSpecification);
-  d->json = other.d_ptr->json;
+}
+
+FileSpecification FileSpecification::fromJson(Json::Value &json)
+{
+  FileSpecification result;
+  result.d_func()->json.swap(json);
+  return result;
 }
 
 FileSpecification &FileSpecification::operator=(const FileSpecification &other)
 {
-  Q_D(FileSpecification);
-  d->json = other.d_ptr->json;
+  d_ptr = other.d_ptr;
   return *this;
 }
 
 FileSpecification::~FileSpecification()
 {
-  delete d_ptr;
 }
 
 FileSpecification::Format FileSpecification::format() const
@@ -173,7 +176,17 @@ bool FileSpecification::writeFile(const QDir &dir, const QString &filename_) con
     QFile file(path);
     if (!file.open(QFile::WriteOnly | QFile::Truncate | QFile::Text))
       return false;
-    file.write(contents().toLocal8Bit());
+    // Write the stored contents directly rather than converting the entire
+    // file to a QString and back.
+    if (format() == ContentsFileSpecification) {
+      Q_D(const FileSpecification);
+      const Json::Value &fileContents = d->json["contents"];
+      if (fileContents.isString())
+        file.write(fileContents.asCString());
+    }
+    else {
+      file.write(contents().toLocal8Bit());
+    }
     file.close();
 
     return true;
@@ -17,11 +17,18 @@
 #ifndef MOLEQUEUE_FILESPEC_H
 #define MOLEQUEUE_FILESPEC_H
 
+#include <QtCore/QMetaType>
+#include <QtCore/QSharedData>
 #include <QtCore/QVariantHash>
 
 class QDir;
 class QFile;
 
+namespace Json
+{
+class Value;
+}
+
 namespace MoleQueue
 {
 class FileSpecificationPrivate;
@@ -34,6 +41,9 @@ class FileSpecificationPrivate;
  * The FileSpecification class converts between Qt and JsonCpp types to facilite
  * file manipulation during RPC communication. Files are stored as either a path
  * to the local file on disk, or a filename and content string.
+ *
+ * FileSpecification is implicitly shared, so copies are cheap even when the
+ * object holds the contents of a large file.
  */
 class FileSpecification
 {
@@ -67,6 +77,10 @@ public:
   /// Copy a FileSpecification
   FileSpecification(const FileSpecification &other);
 
+  /// Create a FileSpecification that takes over the JSON object @a json
+  /// without copying it. @a json is left null.
+  static FileSpecification fromJson(Json::Value &json);
+
   /// Copy a FileSpecification
   FileSpecification & operator=(const FileSpecification &other);
 
@@ -120,10 +134,14 @@ public:
   QString fileExtension() const;
 
 private:
-  FileSpecificationPrivate * const d_ptr;
+  // The private data is never modified after construction, so it can be
+  // shared between copies without detaching.
+  QExplicitlySharedDataPointer<FileSpecificationPrivate> d_ptr;
   Q_DECLARE_PRIVATE(FileSpecification)
 };
 
 } // namespace MoleQueue
 
+Q_DECLARE_METATYPE(MoleQueue::FileSpecification)
+
 #endif // MOLEQUEUE_FILESPEC_H
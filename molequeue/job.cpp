@@ -42,8 +42,10 @@ Job::~Job()
 
 void Job::setFromHash(const QVariantHash &state)
 {
-  if (warnIfInvalid())
+  if (warnIfInvalid()) {
     m_jobData->setFromHash(state);
+    m_jobData->jobManager()->updateJobStateIndex(m_jobData);
+  }
 }
 
 QVariantHash Job::hash() const
@@ -255,6 +257,32 @@ int Job::maxWallTime() const
   return -1;
 }
 
+void Job::setPriority(int priority)
+{
+  if (warnIfInvalid())
+    m_jobData->setPriority(priority);
+}
+
+int Job::priority() const
+{
+  if (warnIfInvalid())
+    return m_jobData->priority();
+  return 0;
+}
+
+void Job::setMaxMemory(int memory)
+{
+  if (warnIfInvalid())
+    m_jobData->setMaxMemory(memory);
+}
+
+int Job::maxMemory() const
+{
+  if (warnIfInvalid())
+    return m_jobData->maxMemory();
+  return 0;
+}
+
 void Job::setMoleQueueId(IdType id)
 {
   if (warnIfInvalid()) {
@@ -209,6 +209,22 @@ public:
   /// available for remote queues. Default is -1.
   int maxWallTime() const;
 
+  /// @param priority Scheduling priority of the job. Pending jobs with a
+  /// higher priority are started before those with a lower priority, e.g.
+  /// interactive jobs before batch jobs. Default: 0
+  void setPriority(int priority);
+
+  /// @return Scheduling priority of the job. Default: 0
+  int priority() const;
+
+  /// @param memory Memory required by the job in megabytes. Local queues
+  /// will not start the job until this much memory is free. Set to a value
+  /// <= 0 if unknown. Default: 0
+  void setMaxMemory(int memory);
+
+  /// @return Memory required by the job in megabytes, or <= 0 if unknown.
+  int maxMemory() const;
+
   /// @param id The new MoleQueue id for this job.
   /// @warning Do not call this function except in Server or Client as a
   ///   response to the JobManager::jobAboutToBeAdded signal.
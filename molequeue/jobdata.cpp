@@ -17,6 +17,17 @@
 #include "jobdata.h"
 #include "jobmanager.h"
 
+namespace {
+// Files may be stored either as a FileSpecification (e.g. from JsonRpc, to
+// avoid copying large file contents) or as a QVariantHash.
+MoleQueue::FileSpecification toFileSpecification(const QVariant &variant)
+{
+  if (variant.userType() == qMetaTypeId<MoleQueue::FileSpecification>())
+    return variant.value<MoleQueue::FileSpecification>();
+  return MoleQueue::FileSpecification(variant.toHash());
+}
+}
+
 namespace MoleQueue
 {
 
@@ -30,8 +41,12 @@ JobData::JobData(JobManager *parentManager)
     m_popupOnStateChange(false),
     m_numberOfCores(DEFAULT_NUM_CORES),
     m_maxWallTime(-1), // use default queue time
+    m_priority(0),
+    m_maxMemory(0),
     m_moleQueueId(InvalidId),
-    m_queueId(InvalidId)
+    m_queueId(InvalidId),
+    m_handleSlot(-1),
+    m_handleGeneration(0)
 {
 }
 
@@ -52,8 +67,13 @@ JobData::JobData(const MoleQueue::JobData &other)
     m_popupOnStateChange(other.m_popupOnStateChange),
     m_numberOfCores(other.m_numberOfCores),
     m_maxWallTime(other.m_maxWallTime),
+    m_priority(other.m_priority),
+    m_maxMemory(other.m_maxMemory),
     m_moleQueueId(other.m_moleQueueId),
-    m_queueId(other.m_queueId)
+    m_queueId(other.m_queueId),
+    m_keywords(other.m_keywords),
+    m_handleSlot(-1),
+    m_handleGeneration(0)
 {
 }
 
@@ -82,6 +102,10 @@ QVariantHash JobData::hash() const
   state.insert("popupOnStateChange", m_popupOnStateChange);
   state.insert("numberOfCores", m_numberOfCores);
   state.insert("maxWallTime", m_maxWallTime);
+  if (m_priority != 0)
+    state.insert("priority", m_priority);
+  if (m_maxMemory > 0)
+    state.insert("maxMemory", m_maxMemory);
   state.insert("moleQueueId", m_moleQueueId);
   state.insert("queueId", m_queueId);
   if (!m_keywords.isEmpty()) {
@@ -106,12 +130,12 @@ void JobData::setFromHash(const QVariantHash &state)
   if (state.contains("jobState"))
     m_jobState = static_cast<JobState>(state.value("jobState").toInt());
   if (state.contains("inputFile"))
-    m_inputFile = FileSpecification(state.value("inputFile").toHash());
+    m_inputFile = toFileSpecification(state.value("inputFile"));
   m_additionalInputFiles.clear();
   if (state.contains("additionalInputFiles")) {
     foreach(const QVariant &variantHash,
             state.value("additionalInputFiles").toList()) {
-      m_additionalInputFiles.append(FileSpecification(variantHash.toHash()));
+      m_additionalInputFiles.append(toFileSpecification(variantHash));
     }
   }
   if (state.contains("outputDirectory"))
@@ -134,6 +158,8 @@ void JobData::setFromHash(const QVariantHash &state)
     m_numberOfCores = state.value("numberOfCores").toInt();
   if (state.contains("maxWallTime"))
     m_maxWallTime = state.value("maxWallTime").toInt();
+  m_priority = state.value("priority", 0).toInt();
+  m_maxMemory = state.value("maxMemory", 0).toInt();
   if (state.contains("moleQueueId"))
     m_moleQueueId = static_cast<IdType>(state.value("moleQueueId").toUInt());
   if (state.contains("queueId"))
@@ -34,6 +34,7 @@ namespace MoleQueue
 {
 class Client;
 class JobManager;
+class JobReferenceBase;
 class Server;
 
 /**
@@ -191,6 +192,21 @@ public:
   /// available for remote queues. Default is -1.
   int maxWallTime() const { return m_maxWallTime; }
 
+  /// @param priority Scheduling priority of the job. Pending jobs with a
+  /// higher priority are started first. Default: 0
+  void setPriority(int priority) { m_priority = priority; }
+
+  /// @return Scheduling priority of the job. Default: 0
+  int priority() const { return m_priority; }
+
+  /// @param memory Memory required by the job in megabytes. Local queues
+  /// will not start the job until this much memory is free. Set to a value
+  /// <= 0 if unknown. Default: 0
+  void setMaxMemory(int memory) { m_maxMemory = memory; }
+
+  /// @return Memory required by the job in megabytes, or <= 0 if unknown.
+  int maxMemory() const { return m_maxMemory; }
+
   /// @param id Internal MoleQueue identifier
   void setMoleQueueId(IdType id) { m_moleQueueId = id; }
 
@@ -262,12 +278,26 @@ protected:
   /// to a value <= 0 will use the queue-specific default max walltime. Only
   /// available for remote queues. Default is -1.
   int m_maxWallTime;
+  /// Scheduling priority. Pending jobs with a higher priority start first.
+  int m_priority;
+  /// Memory required by the job in megabytes, or <= 0 if unknown.
+  int m_maxMemory;
   /// Internal MoleQueue identifier
   IdType m_moleQueueId;
   /// Queue Job ID
   IdType m_queueId;
   /// List of custom keyword replacements for the job's launch script
   QHash<QString, QString> m_keywords;
+
+  /// The handle fields are maintained by JobManager and copied into each
+  /// JobReferenceBase.
+  friend class JobManager;
+  friend class JobReferenceBase;
+  /// Index of this JobData in the JobManager's handle table, or -1 if it is
+  /// not owned by a JobManager (e.g. a copy).
+  int m_handleSlot;
+  /// Generation of m_handleSlot when this JobData was assigned to it.
+  quint32 m_handleGeneration;
 };
 
 } // end namespace MoleQueue
@@ -21,6 +21,11 @@
 
 #include <QtCore/QDebug>
 
+namespace {
+// Number of deferred jobs loaded by each call to fetchMore.
+const int fetchBatchSize = 256;
+}
+
 namespace MoleQueue {
 
 JobItemModel::JobItemModel(QObject *parentObject)
@@ -143,6 +148,18 @@ bool JobItemModel::insertRows(int row, int count, const QModelIndex &)
   return true;
 }
 
+bool JobItemModel::canFetchMore(const QModelIndex &parent) const
+{
+  return m_jobManager && !parent.isValid() &&
+      m_jobManager->deferredCount() > 0;
+}
+
+void JobItemModel::fetchMore(const QModelIndex &parent)
+{
+  if (m_jobManager && !parent.isValid())
+    m_jobManager->loadDeferredJobs(fetchBatchSize);
+}
+
 Qt::ItemFlags JobItemModel::flags(const QModelIndex &) const
 {
   return Qt::ItemIsSelectable | Qt::ItemIsEnabled;
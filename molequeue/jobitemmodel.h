@@ -73,6 +73,13 @@ public:
   /// @see JobManager::newJob()
   bool insertRows(int row, int count, const QModelIndex &);
 
+  /// @return True if the JobManager has deferred jobs that can be loaded.
+  /// @see JobManager::setLazyLoading()
+  bool canFetchMore(const QModelIndex &parent) const;
+
+  /// Load the next batch of deferred jobs from the JobManager.
+  void fetchMore(const QModelIndex &parent);
+
   Qt::ItemFlags flags(const QModelIndex & modelIndex) const;
 
   QModelIndex index(int row, int column,
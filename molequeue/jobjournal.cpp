@@ -0,0 +1,387 @@
+/******************************************************************************
+
+  This source file is part of the MoleQueue project.
+
+  Copyright 2012 Kitware, Inc.
+
+  This source code is released under the New BSD License, (the "License").
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+******************************************************************************/
+
+#include "jobjournal.h"
+
+#include "logger.h"
+
+#include <QtCore/QDataStream>
+#include <QtCore/QtEndian>
+
+namespace {
+// "MQJL"
+const quint32 journalMagic = 0x4d514a4c;
+const quint32 journalVersion = 1;
+const int headerSize = 8;
+// type (1) + moleQueueId (4) + jobState (1) + payload size (4)
+const int recordHeaderSize = 10;
+const int checksumSize = 2;
+// Don't bother compacting small journals.
+const int minObsoleteRecords = 1000;
+}
+
+namespace MoleQueue
+{
+
+JobJournal::JobJournal()
+  : m_maxMoleQueueId(0),
+    m_recordCount(0)
+{
+}
+
+JobJournal::~JobJournal()
+{
+  close();
+}
+
+bool JobJournal::open(const QString &fileName)
+{
+  close();
+
+  // Recover from an interrupted compaction:
+  const QString tmpFileName = fileName + ".tmp";
+  if (QFile::exists(tmpFileName)) {
+    if (QFile::exists(fileName))
+      QFile::remove(tmpFileName);
+    else
+      QFile::rename(tmpFileName, fileName);
+  }
+
+  m_file.setFileName(fileName);
+  if (!m_file.open(QIODevice::ReadWrite)) {
+    Logger::logError(QObject::tr("Cannot open job journal '%1': %2")
+                     .arg(fileName).arg(m_file.errorString()));
+    return false;
+  }
+
+  if (m_file.size() == 0) {
+    if (!writeHeader(&m_file)) {
+      m_file.close();
+      return false;
+    }
+    m_file.flush();
+    return true;
+  }
+
+  QByteArray header = m_file.read(headerSize);
+  if (header.size() != headerSize ||
+      qFromBigEndian<quint32>(
+        reinterpret_cast<const uchar*>(header.constData())) != journalMagic) {
+    Logger::logError(QObject::tr("File '%1' is not a MoleQueue job journal.")
+                     .arg(fileName));
+    m_file.close();
+    return false;
+  }
+
+  const quint32 version = qFromBigEndian<quint32>(
+        reinterpret_cast<const uchar*>(header.constData()) + 4);
+  if (version != journalVersion) {
+    Logger::logError(QObject::tr("Job journal '%1' has unsupported version %2.")
+                     .arg(fileName).arg(version));
+    m_file.close();
+    return false;
+  }
+
+  m_file.seek(m_file.size());
+  return true;
+}
+
+void JobJournal::close()
+{
+  if (m_file.isOpen())
+    m_file.close();
+  m_maxMoleQueueId = 0;
+  m_recordCount = 0;
+  m_liveIds.clear();
+}
+
+QMap<IdType, QVariantHash> JobJournal::replay()
+{
+  QMap<IdType, QVariantHash> states;
+  QMap<IdType, JobRecord> records = replayRecords();
+  for (QMap<IdType, JobRecord>::const_iterator it = records.constBegin(),
+       itEnd = records.constEnd(); it != itEnd; ++it) {
+    states.insert(it.key(), deserializeRecord(it.value()));
+  }
+  return states;
+}
+
+QMap<IdType, JobJournal::JobRecord> JobJournal::replayRecords()
+{
+  QMap<IdType, JobRecord> records;
+  if (!m_file.isOpen())
+    return records;
+
+  m_file.seek(0);
+  const QByteArray data = m_file.readAll();
+  const uchar *bytes = reinterpret_cast<const uchar*>(data.constData());
+
+  m_recordCount = 0;
+  int pos = headerSize;
+  while (pos < data.size()) {
+    if (data.size() - pos < recordHeaderSize + checksumSize)
+      break;
+
+    const RecordType type = static_cast<RecordType>(bytes[pos]);
+    const IdType moleQueueId = qFromBigEndian<quint32>(bytes + pos + 1);
+    const JobState jobState =
+        static_cast<JobState>(static_cast<qint8>(bytes[pos + 5]));
+    const quint32 payloadSize = qFromBigEndian<quint32>(bytes + pos + 6);
+    if (payloadSize > static_cast<quint32>(data.size() - pos -
+                                           recordHeaderSize - checksumSize)) {
+      break;
+    }
+
+    const int recordSize = recordHeaderSize + static_cast<int>(payloadSize);
+    const quint16 checksum = qFromBigEndian<quint16>(bytes + pos + recordSize);
+    if (checksum != qChecksum(data.constData() + pos,
+                              static_cast<uint>(recordSize))) {
+      break;
+    }
+
+    const QByteArray payload(data.constData() + pos + recordHeaderSize,
+                             static_cast<int>(payloadSize));
+    switch (type) {
+    case CreateRecord: {
+      JobRecord &record = records[moleQueueId];
+      record.jobState = jobState;
+      record.payload = payload;
+      record.updates.clear();
+      break;
+    }
+    case UpdateRecord: {
+      JobRecord &record = records[moleQueueId];
+      record.jobState = jobState;
+      record.updates.append(payload);
+      break;
+    }
+    case RemoveRecord:
+      records.remove(moleQueueId);
+      break;
+    case CounterRecord:
+      break;
+    default:
+      Logger::logWarning(QObject::tr("Skipping unknown record type %1 in job "
+                                     "journal '%2'.")
+                         .arg(static_cast<int>(type)).arg(m_file.fileName()));
+      break;
+    }
+
+    if (moleQueueId != InvalidId && moleQueueId > m_maxMoleQueueId)
+      m_maxMoleQueueId = moleQueueId;
+
+    ++m_recordCount;
+    pos += recordSize + checksumSize;
+  }
+
+  if (pos < data.size()) {
+    Logger::logWarning(QObject::tr("Discarding %n byte(s) of incomplete data "
+                                   "at the end of job journal '%1'.", "",
+                                   data.size() - pos)
+                       .arg(m_file.fileName()));
+    m_file.resize(pos);
+  }
+
+  m_liveIds = records.keys().toSet();
+  m_file.seek(m_file.size());
+  return records;
+}
+
+bool JobJournal::appendCreate(IdType moleQueueId, const QVariantHash &state)
+{
+  if (!appendRecord(CreateRecord, moleQueueId, stateOf(state),
+                    serializeState(state))) {
+    return false;
+  }
+  m_liveIds.insert(moleQueueId);
+  return true;
+}
+
+bool JobJournal::appendUpdate(IdType moleQueueId, JobState jobState,
+                              const QVariantHash &changes)
+{
+  return appendRecord(UpdateRecord, moleQueueId, jobState,
+                      serializeState(changes));
+}
+
+bool JobJournal::appendRemove(IdType moleQueueId)
+{
+  if (!appendRecord(RemoveRecord, moleQueueId))
+    return false;
+  m_liveIds.remove(moleQueueId);
+  return true;
+}
+
+bool JobJournal::compact(const QList<QVariantHash> &states,
+                         const QMap<IdType, JobRecord> &records)
+{
+  if (!m_file.isOpen())
+    return false;
+
+  QList<IdType> ids;
+  ids.reserve(states.size());
+  foreach (const QVariantHash &state, states) {
+    IdType moleQueueId = static_cast<IdType>(
+          state.value("moleQueueId", InvalidId).toUInt());
+    ids.append(moleQueueId);
+    if (moleQueueId != InvalidId && moleQueueId > m_maxMoleQueueId)
+      m_maxMoleQueueId = moleQueueId;
+  }
+  if (!records.isEmpty() && records.lastKey() != InvalidId &&
+      records.lastKey() > m_maxMoleQueueId) {
+    m_maxMoleQueueId = records.lastKey();
+  }
+
+  const QString fileName = m_file.fileName();
+  QFile tmpFile(fileName + ".tmp");
+  if (!tmpFile.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+    Logger::logError(QObject::tr("Cannot compact job journal '%1': %2")
+                     .arg(fileName).arg(tmpFile.errorString()));
+    return false;
+  }
+
+  bool ok = writeHeader(&tmpFile) &&
+      writeRecord(&tmpFile, CounterRecord, m_maxMoleQueueId, None,
+                  QByteArray());
+  for (int i = 0; ok && i < states.size(); ++i) {
+    ok = writeRecord(&tmpFile, CreateRecord, ids[i], stateOf(states[i]),
+                     serializeState(states[i]));
+  }
+  for (QMap<IdType, JobRecord>::const_iterator it = records.constBegin(),
+       itEnd = records.constEnd(); ok && it != itEnd; ++it) {
+    ok = writeRecord(&tmpFile, CreateRecord, it.key(), it->jobState,
+                     it->updates.isEmpty()
+                     ? it->payload : serializeState(deserializeRecord(*it)));
+  }
+  ok = ok && tmpFile.flush();
+  tmpFile.close();
+
+  if (!ok) {
+    Logger::logError(QObject::tr("Cannot compact job journal '%1': %2")
+                     .arg(fileName).arg(tmpFile.errorString()));
+    tmpFile.remove();
+    return false;
+  }
+
+  m_file.close();
+  QFile::remove(fileName);
+  if (!QFile::rename(tmpFile.fileName(), fileName) ||
+      !m_file.open(QIODevice::ReadWrite)) {
+    Logger::logError(QObject::tr("Cannot replace job journal '%1'.")
+                     .arg(fileName));
+    return false;
+  }
+  m_file.seek(m_file.size());
+
+  m_liveIds = ids.toSet();
+  m_liveIds.unite(records.keys().toSet());
+  m_recordCount = states.size() + records.size() + 1;
+  return true;
+}
+
+bool JobJournal::needsCompaction() const
+{
+  const int liveCount = m_liveIds.size();
+  const int obsoleteRecords = m_recordCount - liveCount;
+  return obsoleteRecords > qMax(minObsoleteRecords, 2 * liveCount);
+}
+
+bool JobJournal::writeRecord(QIODevice *device, RecordType type,
+                             IdType moleQueueId, JobState jobState,
+                             const QByteArray &payload)
+{
+  QByteArray record(recordHeaderSize, '\0');
+  record.reserve(recordHeaderSize + payload.size() + checksumSize);
+  uchar *bytes = reinterpret_cast<uchar*>(record.data());
+  bytes[0] = static_cast<uchar>(type);
+  qToBigEndian<quint32>(moleQueueId, bytes + 1);
+  bytes[5] = static_cast<uchar>(static_cast<qint8>(jobState));
+  qToBigEndian<quint32>(static_cast<quint32>(payload.size()), bytes + 6);
+  record.append(payload);
+
+  uchar checksum[checksumSize];
+  qToBigEndian<quint16>(qChecksum(record.constData(),
+                                  static_cast<uint>(record.size())), checksum);
+  record.append(reinterpret_cast<const char*>(checksum), checksumSize);
+
+  return device->write(record) == record.size();
+}
+
+bool JobJournal::appendRecord(RecordType type, IdType moleQueueId,
+                              JobState jobState, const QByteArray &payload)
+{
+  if (!m_file.isOpen())
+    return false;
+
+  if (!writeRecord(&m_file, type, moleQueueId, jobState, payload) ||
+      !m_file.flush()) {
+    Logger::logError(QObject::tr("Cannot write to job journal '%1': %2")
+                     .arg(m_file.fileName()).arg(m_file.errorString()));
+    return false;
+  }
+
+  if (moleQueueId != InvalidId && moleQueueId > m_maxMoleQueueId)
+    m_maxMoleQueueId = moleQueueId;
+  ++m_recordCount;
+  return true;
+}
+
+QByteArray JobJournal::serializeState(const QVariantHash &state)
+{
+  QByteArray payload;
+  QDataStream stream(&payload, QIODevice::WriteOnly);
+  stream.setVersion(QDataStream::Qt_4_8);
+  stream << state;
+  return payload;
+}
+
+QVariantHash JobJournal::deserializeState(const QByteArray &payload)
+{
+  QVariantHash state;
+  QDataStream stream(payload);
+  stream.setVersion(QDataStream::Qt_4_8);
+  stream >> state;
+  return state;
+}
+
+QVariantHash JobJournal::deserializeRecord(const JobRecord &record)
+{
+  QVariantHash state = deserializeState(record.payload);
+  foreach (const QByteArray &update, record.updates) {
+    const QVariantHash changes = deserializeState(update);
+    for (QVariantHash::const_iterator it = changes.constBegin(),
+         itEnd = changes.constEnd(); it != itEnd; ++it) {
+      state.insert(it.key(), it.value());
+    }
+  }
+  return state;
+}
+
+JobState JobJournal::stateOf(const QVariantHash &state)
+{
+  return static_cast<JobState>(state.value("jobState", None).toInt());
+}
+
+bool JobJournal::writeHeader(QIODevice *device)
+{
+  uchar header[headerSize];
+  qToBigEndian<quint32>(journalMagic, header);
+  qToBigEndian<quint32>(journalVersion, header + 4);
+  return device->write(reinterpret_cast<const char*>(header), headerSize) ==
+      headerSize;
+}
+
+} // namespace MoleQueue
@@ -0,0 +1,186 @@
+/******************************************************************************
+
+  This source file is part of the MoleQueue project.
+
+  Copyright 2012 Kitware, Inc.
+
+  This source code is released under the New BSD License, (the "License").
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+******************************************************************************/
+
+#ifndef MOLEQUEUE_JOBJOURNAL_H
+#define MOLEQUEUE_JOBJOURNAL_H
+
+#include "molequeueglobal.h"
+
+#include <QtCore/QFile>
+#include <QtCore/QMap>
+#include <QtCore/QSet>
+#include <QtCore/QVariantHash>
+
+class JobJournalTest;
+
+namespace MoleQueue
+{
+
+/**
+ * @class JobJournal jobjournal.h <molequeue/jobjournal.h>
+ * @brief Append-only binary log of job state changes.
+ *
+ * The JobJournal persists JobData state as a sequence of records keyed by
+ * MoleQueue id. Creating, updating or removing a job appends a single record,
+ * so the cost of persisting a change does not depend on the number of jobs
+ * that are stored. Updates only hold the fields that have changed, so they do
+ * not depend on the size of the job either.
+ *
+ * Each record is written with a single write and flushed immediately. replay()
+ * rebuilds the current job states from the log, and stops at (and truncates)
+ * the first incomplete or corrupt record, e.g. one left behind by a crash.
+ *
+ * Obsolete records accumulate over time. compact() atomically replaces the
+ * log with one record per live job; needsCompaction() indicates when this is
+ * worthwhile.
+ */
+class JobJournal
+{
+public:
+  /// Types of records stored in the journal.
+  enum RecordType {
+    /// A new job. The payload is the full JobData hash.
+    CreateRecord = 1,
+    /// An existing job has changed. The payload holds the changed entries of
+    /// the JobData hash.
+    UpdateRecord,
+    /// A job has been removed. There is no payload.
+    RemoveRecord,
+    /// Records the largest MoleQueue id ever issued. There is no payload.
+    CounterRecord
+  };
+
+  /// Serialized state of a single job, as stored in the journal.
+  struct JobRecord
+  {
+    JobRecord() : jobState(None) {}
+    /// The JobState of the job, available without deserializing the payload.
+    JobState jobState;
+    /// The serialized JobData hash. Use deserializeRecord() to read it.
+    QByteArray payload;
+    /// Serialized changes to apply to the payload, oldest first.
+    QList<QByteArray> updates;
+  };
+
+  JobJournal();
+  ~JobJournal();
+
+  /**
+   * Open (or create) the journal file @a fileName. If a previous compaction
+   * was interrupted, the compacted file is recovered first.
+   * @return True on success.
+   */
+  bool open(const QString &fileName);
+
+  /// Close the journal file.
+  void close();
+
+  /// @return True if the journal file is open for writing.
+  bool isOpen() const { return m_file.isOpen(); }
+
+  /// @return The name of the journal file.
+  QString fileName() const { return m_file.fileName(); }
+
+  /**
+   * Read all records from the journal.
+   * @return The current state of all jobs in the journal, keyed by MoleQueue
+   * id.
+   */
+  QMap<IdType, QVariantHash> replay();
+
+  /**
+   * Read all records from the journal without deserializing the job states.
+   * @return The current serialized state of all jobs in the journal, keyed by
+   * MoleQueue id.
+   * @sa deserializeRecord()
+   */
+  QMap<IdType, JobRecord> replayRecords();
+
+  /// Append a CreateRecord for the job @a moleQueueId with @a state.
+  bool appendCreate(IdType moleQueueId, const QVariantHash &state);
+
+  /**
+   * Append an UpdateRecord for the job @a moleQueueId, which is now in
+   * @a jobState. @a changes holds the entries of the JobData hash that have
+   * changed; replaying the journal merges them into the job's state.
+   */
+  bool appendUpdate(IdType moleQueueId, JobState jobState,
+                    const QVariantHash &changes);
+
+  /// Append a RemoveRecord for the job @a moleQueueId.
+  bool appendRemove(IdType moleQueueId);
+
+  /**
+   * Replace the journal with a CreateRecord for each hash in @a states and
+   * each entry of @a records. The new journal is written to a temporary file
+   * and then moved into place.
+   * @return True on success.
+   */
+  bool compact(const QList<QVariantHash> &states,
+               const QMap<IdType, JobRecord> &records =
+               QMap<IdType, JobRecord>());
+
+  /// @return True if the journal holds enough obsolete records that compact()
+  /// should be called.
+  bool needsCompaction() const;
+
+  /// @return The largest MoleQueue id that has been recorded in the journal,
+  /// including removed jobs, or 0 if none.
+  IdType maxMoleQueueId() const { return m_maxMoleQueueId; }
+
+  /// @return The number of records in the journal.
+  int recordCount() const { return m_recordCount; }
+
+  /// @return The number of jobs that are live in the journal.
+  int liveCount() const { return m_liveIds.size(); }
+
+  /// @return @a state serialized for a record payload.
+  static QByteArray serializeState(const QVariantHash &state);
+
+  /// @return The JobData hash serialized in @a payload.
+  static QVariantHash deserializeState(const QByteArray &payload);
+
+  /// @return The JobData hash of @a record, with its updates applied.
+  static QVariantHash deserializeRecord(const JobRecord &record);
+
+  friend class ::JobJournalTest;
+
+private:
+  /// Write a single record to @a device.
+  static bool writeRecord(QIODevice *device, RecordType type,
+                          IdType moleQueueId, JobState jobState,
+                          const QByteArray &payload);
+
+  /// Append a record to m_file and flush it.
+  bool appendRecord(RecordType type, IdType moleQueueId,
+                    JobState jobState = None,
+                    const QByteArray &payload = QByteArray());
+
+  /// @return The JobState stored in the JobData hash @a state.
+  static JobState stateOf(const QVariantHash &state);
+
+  /// Write the file header to @a device.
+  static bool writeHeader(QIODevice *device);
+
+  QFile m_file;
+  IdType m_maxMoleQueueId;
+  int m_recordCount;
+  QSet<IdType> m_liveIds;
+};
+
+} // namespace MoleQueue
+
+#endif // MOLEQUEUE_JOBJOURNAL_H
@@ -19,17 +19,34 @@
 #include "job.h"
 #include "jobdata.h"
 #include "jobitemmodel.h"
+#include "jobjournal.h"
 #include "logger.h"
 
 #include <QtCore/QSettings>
 
+#include <algorithm>
+
+namespace {
+/// @return True if @a state is a JobState that a job never leaves.
+inline bool isFinalJobState(MoleQueue::JobState state)
+{
+  return state == MoleQueue::Finished || state == MoleQueue::Killed ||
+      state == MoleQueue::Error;
+}
+}
+
 namespace MoleQueue
 {
 
 JobManager::JobManager(QObject *parentObject) :
   QObject(parentObject),
-  m_itemModel(new JobItemModel(this))
+  m_itemModel(new JobItemModel(this)),
+  m_journal(NULL),
+  m_lazyLoading(false)
 {
+  for (int i = 0; i <= Error - Unknown; ++i)
+    m_deferredStateCount[i] = 0;
+
   qRegisterMetaType<Job>("MoleQueue::Job");
 
   m_itemModel->setJobManager(this);
@@ -42,28 +59,80 @@ JobManager::JobManager(QObject *parentObject) :
 JobManager::~JobManager()
 {
   m_moleQueueMap.clear();
+  m_jobIndex.clear();
+  for (int i = 0; i <= Error - Unknown; ++i)
+    m_jobStateIndex[i].clear();
+  m_handleGenerations.clear();
+  m_freeHandleSlots.clear();
   qDeleteAll(m_jobs);
   m_jobs.clear();
+  delete m_journal;
+  m_journal = NULL;
 }
 
 void JobManager::readSettings(QSettings &settings)
 {
+  QList<QVariantHash> states;
   int numJobs = settings.beginReadArray("Jobs");
+  states.reserve(numJobs);
   for (int i = 0; i < numJobs; ++i) {
     settings.setArrayIndex(i);
-    QVariantHash hash = settings.value("hash").toHash();
+    states.append(settings.value("hash").toHash());
+  }
+  settings.endArray();
+
+  const bool migrateSettings = m_journal && !states.isEmpty();
+  if (m_journal) {
+    QMap<IdType, JobJournal::JobRecord> records = m_journal->replayRecords();
+    QMap<IdType, QVariantHash> journalStates;
+    for (QMap<IdType, JobJournal::JobRecord>::const_iterator
+         it = records.constBegin(), itEnd = records.constEnd(); it != itEnd;
+         ++it) {
+      if (m_lazyLoading && isFinalJobState(it->jobState)) {
+        m_deferredJobs.insert(it.key(), it.value());
+        ++m_deferredStateCount[jobStateBucket(it->jobState)];
+      }
+      else {
+        journalStates.insert(it.key(),
+                             JobJournal::deserializeRecord(it.value()));
+      }
+    }
+    // Jobs written to the settings by older versions; the journal wins.
+    foreach (const QVariantHash &state, states) {
+      IdType moleQueueId =
+          static_cast<IdType>(state.value("moleQueueId").toUInt());
+      if (!records.contains(moleQueueId))
+        journalStates.insert(moleQueueId, state);
+    }
+    states = journalStates.values();
+  }
+
+  m_jobs.reserve(m_jobs.size() + states.size());
+  m_jobIndex.reserve(m_jobs.size() + states.size());
+  m_handleGenerations.reserve(m_handleGenerations.size() + states.size());
+  m_moleQueueMap.reserve(m_jobs.size() + states.size());
+  foreach (const QVariantHash &state, states) {
     JobData *jobdata = new JobData(this);
-    jobdata->setFromHash(hash);
-    m_jobs.append(jobdata);
+    jobdata->setFromHash(state);
+    appendJobData(jobdata);
     insertJobData(jobdata);
   }
-  settings.endArray();
+
+  if (migrateSettings) {
+    compactJournal();
+    settings.remove("Jobs");
+  }
 
   m_itemModel->reset();
 }
 
 void JobManager::writeSettings(QSettings &settings) const
 {
+  if (m_journal) {
+    compactJournal();
+    return;
+  }
+
   settings.beginWriteArray("Jobs", m_jobs.size());
   for (int i = 0; i < m_jobs.size(); ++i) {
     settings.setArrayIndex(i);
@@ -72,14 +141,39 @@ void JobManager::writeSettings(QSettings &settings) const
   settings.endArray(); // Jobs
 }
 
+int JobManager::loadDeferredJobs(int maxJobs)
+{
+  int loaded = 0;
+  while (loaded < maxJobs && !m_deferredJobs.isEmpty()) {
+    loadDeferredJob(m_deferredJobs.constBegin().key());
+    ++loaded;
+  }
+  return loaded;
+}
+
+bool JobManager::openJournal(const QString &fileName)
+{
+  if (!m_journal)
+    m_journal = new JobJournal;
+
+  if (m_journal->open(fileName))
+    return true;
+
+  delete m_journal;
+  m_journal = NULL;
+  return false;
+}
+
 Job JobManager::newJob()
 {
   JobData *jobdata = new JobData(this);
 
-  m_jobs.append(jobdata);
+  appendJobData(jobdata);
   emit jobAboutToBeAdded(Job(jobdata));
 
   insertJobData(jobdata);
+  if (m_journal)
+    m_journal->appendCreate(jobdata->moleQueueId(), jobdata->hash());
   return Job(jobdata);
 }
 
@@ -89,30 +183,21 @@ Job JobManager::newJob(const QVariantHash &jobState)
   jobdata->setFromHash(jobState);
   jobdata->setMoleQueueId(InvalidId);
 
-  m_jobs.append(jobdata);
+  appendJobData(jobdata);
   emit jobAboutToBeAdded(Job(jobdata));
 
   insertJobData(jobdata);
+  if (m_journal)
+    m_journal->appendCreate(jobdata->moleQueueId(), jobdata->hash());
   return Job(jobdata);
 }
 
 void JobManager::removeJob(JobData *jobdata)
 {
-  if (!jobdata || !m_jobs.contains(jobdata))
+  if (!jobdata)
     return;
 
-  emit jobAboutToBeRemoved(Job(jobdata));
-
-  IdType moleQueueId = jobdata->moleQueueId();
-
-  int jobsIndex = m_jobs.indexOf(jobdata);
-  m_jobs.removeAt(jobsIndex);
-  m_itemModel->removeRow(jobsIndex);
-  m_moleQueueMap.remove(moleQueueId);
-
-  delete jobdata;
-
-  emit jobRemoved(moleQueueId);
+  removeJobData(QList<JobData*>() << jobdata);
 }
 
 void JobManager::removeJob(IdType moleQueueId)
@@ -131,14 +216,63 @@ void JobManager::removeJob(const Job &job)
 
 void JobManager::removeJobs(const QList<Job> &jobsToRemove)
 {
-  foreach (const Job &job, jobsToRemove)
-    removeJob(job);
+  QList<JobData*> jobdatas;
+  jobdatas.reserve(jobsToRemove.size());
+  foreach (const Job &job, jobsToRemove) {
+    if (job.isValid())
+      jobdatas.append(job.jobData());
+  }
+
+  removeJobData(jobdatas);
 }
 
 void JobManager::removeJobs(const QList<IdType> &moleQueueIds)
 {
-  foreach(IdType moleQueueId, moleQueueIds)
-    removeJob(moleQueueId);
+  QList<JobData*> jobdatas;
+  jobdatas.reserve(moleQueueIds.size());
+  foreach (IdType moleQueueId, moleQueueIds) {
+    if (JobData *jobdata = lookupJobDataByMoleQueueId(moleQueueId))
+      jobdatas.append(jobdata);
+  }
+
+  removeJobData(jobdatas);
+}
+
+void JobManager::removeJobsWithJobState(JobState state)
+{
+  const int bucketIndex = jobStateBucket(state);
+  removeJobData(m_jobStateIndex[bucketIndex].toList());
+
+  if (m_deferredStateCount[bucketIndex] == 0)
+    return;
+
+  QList<IdType> removedIds;
+  QMap<IdType, JobJournal::JobRecord>::iterator it = m_deferredJobs.begin();
+  while (it != m_deferredJobs.end()) {
+    if (jobStateBucket(it->jobState) == bucketIndex) {
+      removedIds.append(it.key());
+      it = m_deferredJobs.erase(it);
+    }
+    else {
+      ++it;
+    }
+  }
+  m_deferredStateCount[bucketIndex] = 0;
+
+  if (m_journal) {
+    foreach (IdType moleQueueId, removedIds)
+      m_journal->appendRemove(moleQueueId);
+    if (m_journal->needsCompaction())
+      compactJournal();
+  }
+
+  foreach (IdType moleQueueId, removedIds)
+    emit jobRemoved(moleQueueId);
+}
+
+Job JobManager::lookupJobByMoleQueueId(IdType moleQueueId)
+{
+  return Job(lookupJobDataByMoleQueueId(moleQueueId));
 }
 
 Job JobManager::lookupJobByMoleQueueId(IdType moleQueueId) const
@@ -146,14 +280,14 @@ Job JobManager::lookupJobByMoleQueueId(IdType moleQueueId) const
   return Job(lookupJobDataByMoleQueueId(moleQueueId));
 }
 
-QList<Job> JobManager::jobsWithJobState(JobState state)
+QList<Job> JobManager::jobsWithJobState(JobState state) const
 {
-  QList<Job> result;
+  const QSet<JobData*> &bucket = m_jobStateIndex[jobStateBucket(state)];
 
-  foreach (JobData *jobdata, m_jobs) {
-    if (jobdata->jobState() == state)
-      result << Job(jobdata);
-  }
+  QList<Job> result;
+  result.reserve(bucket.size());
+  foreach (JobData *jobdata, bucket)
+    result << Job(jobdata);
 
   return result;
 }
@@ -167,9 +301,10 @@ Job JobManager::jobAt(int i) const
 
 int JobManager::indexOf(const Job &job) const
 {
-  JobData *jobdata = job.jobData();
-  if (jobdata)
-    return m_jobs.indexOf(jobdata);
+  QHash<const JobData*, JobIndexEntry>::const_iterator it =
+      m_jobIndex.constFind(job.jobData());
+  if (it != m_jobIndex.constEnd())
+    return it->row;
 
   return -1;
 }
@@ -177,15 +312,22 @@ int JobManager::indexOf(const Job &job) const
 void JobManager::moleQueueIdChanged(const Job &job)
 {
   JobData *jobdata = job.jobData();
-  if (!m_jobs.contains(jobdata))
+  QHash<const JobData*, JobIndexEntry>::iterator it =
+      m_jobIndex.find(jobdata);
+  if (it == m_jobIndex.end())
     return;
 
-  if (lookupJobDataByMoleQueueId(jobdata->moleQueueId()) != jobdata) {
-    IdType oldMoleQueueId = m_moleQueueMap.key(jobdata, InvalidId);
-    if (oldMoleQueueId != InvalidId)
-      m_moleQueueMap.remove(oldMoleQueueId);
-    m_moleQueueMap.insert(jobdata->moleQueueId(), jobdata);
+  const IdType newMoleQueueId = jobdata->moleQueueId();
+  if (it->moleQueueId == newMoleQueueId)
+    return;
+
+  if (it->moleQueueId != InvalidId &&
+      m_moleQueueMap.value(it->moleQueueId) == jobdata) {
+    m_moleQueueMap.remove(it->moleQueueId);
   }
+  if (newMoleQueueId != InvalidId)
+    m_moleQueueMap.insert(newMoleQueueId, jobdata);
+  it->moleQueueId = newMoleQueueId;
 }
 
 void JobManager::setJobState(IdType moleQueueId, JobState newState)
@@ -200,6 +342,10 @@ void JobManager::setJobState(IdType moleQueueId, JobState newState)
     return;
 
   jobdata->setJobState(newState);
+  updateJobStateIndex(jobdata);
+  QVariantHash changes;
+  changes.insert("jobState", newState);
+  journalJobUpdate(jobdata, changes);
 
   Logger::logNotification(tr("Job '%1' has changed status from '%2' to '%3'.")
                           .arg(jobdata->description())
@@ -220,17 +366,173 @@ void JobManager::setJobQueueId(IdType moleQueueId, IdType queueId)
     return;
 
   jobdata->setQueueId(queueId);
+  QVariantHash changes;
+  changes.insert("queueId", queueId);
+  journalJobUpdate(jobdata, changes);
 
   emit jobUpdated(jobdata);
 }
 
+void JobManager::setJobOutputAvailable(IdType moleQueueId,
+                                       const QStringList &files)
+{
+  JobData *jobdata = lookupJobDataByMoleQueueId(moleQueueId);
+  if (!jobdata || files.isEmpty())
+    return;
+
+  emit jobOutputAvailable(jobdata, files);
+}
+
+void JobManager::appendJobData(JobData *jobdata)
+{
+  if (m_freeHandleSlots.isEmpty()) {
+    jobdata->m_handleSlot = m_handleGenerations.size();
+    m_handleGenerations.append(0);
+  }
+  else {
+    jobdata->m_handleSlot = m_freeHandleSlots.last();
+    m_freeHandleSlots.pop_back();
+  }
+  jobdata->m_handleGeneration = m_handleGenerations.at(jobdata->m_handleSlot);
+
+  JobIndexEntry entry = { m_jobs.size(), InvalidId, jobdata->jobState() };
+  m_jobs.append(jobdata);
+  m_jobIndex.insert(jobdata, entry);
+  m_jobStateIndex[jobStateBucket(entry.jobState)].insert(jobdata);
+}
+
 void JobManager::insertJobData(JobData *jobdata)
 {
-  if (jobdata->moleQueueId() != MoleQueue::InvalidId)
+  JobIndexEntry &entry = m_jobIndex[jobdata];
+  if (jobdata->moleQueueId() != MoleQueue::InvalidId &&
+      entry.moleQueueId != jobdata->moleQueueId()) {
+    if (entry.moleQueueId != InvalidId)
+      m_moleQueueMap.remove(entry.moleQueueId);
     m_moleQueueMap.insert(jobdata->moleQueueId(), jobdata);
+    entry.moleQueueId = jobdata->moleQueueId();
+  }
 
   m_itemModel->insertRow(m_jobs.size() - 1);
   emit jobAdded(Job(jobdata));
 }
 
+void JobManager::removeJobData(const QList<JobData*> &jobdatas)
+{
+  // Collect the rows to remove, sorted and without duplicates:
+  QVector<int> rows;
+  rows.reserve(jobdatas.size());
+  foreach (JobData *jobdata, jobdatas) {
+    QHash<const JobData*, JobIndexEntry>::const_iterator it =
+        m_jobIndex.constFind(jobdata);
+    if (it != m_jobIndex.constEnd())
+      rows.append(it->row);
+  }
+  if (rows.isEmpty())
+    return;
+  qSort(rows);
+  rows.erase(std::unique(rows.begin(), rows.end()), rows.end());
+
+  foreach (int row, rows)
+    emit jobAboutToBeRemoved(Job(m_jobs.at(row)));
+
+  // Remove contiguous blocks of rows, starting at the end so that the
+  // remaining row numbers stay valid.
+  QList<IdType> removedIds;
+  int blockEnd = rows.size() - 1;
+  while (blockEnd >= 0) {
+    int blockBegin = blockEnd;
+    while (blockBegin > 0 && rows.at(blockBegin - 1) == rows.at(blockBegin) - 1)
+      --blockBegin;
+
+    const int firstRow = rows.at(blockBegin);
+    const int lastRow = rows.at(blockEnd);
+
+    m_itemModel->beginRemoveRows(QModelIndex(), firstRow, lastRow);
+    for (int row = firstRow; row <= lastRow; ++row) {
+      JobData *jobdata = m_jobs.at(row);
+      const JobIndexEntry entry = m_jobIndex.value(jobdata);
+      const IdType moleQueueId = entry.moleQueueId;
+      m_jobStateIndex[jobStateBucket(entry.jobState)].remove(jobdata);
+      if (moleQueueId != InvalidId &&
+          m_moleQueueMap.value(moleQueueId) == jobdata) {
+        m_moleQueueMap.remove(moleQueueId);
+      }
+      m_jobIndex.remove(jobdata);
+      ++m_handleGenerations[jobdata->m_handleSlot];
+      m_freeHandleSlots.append(jobdata->m_handleSlot);
+      removedIds.append(jobdata->moleQueueId());
+      delete jobdata;
+    }
+    m_jobs.remove(firstRow, lastRow - firstRow + 1);
+    m_itemModel->endRemoveRows();
+
+    blockEnd = blockBegin - 1;
+  }
+
+  // Shift the cached rows of the remaining jobs, once:
+  for (int row = rows.first(); row < m_jobs.size(); ++row)
+    m_jobIndex[m_jobs.at(row)].row = row;
+
+  if (m_journal) {
+    foreach (IdType moleQueueId, removedIds)
+      m_journal->appendRemove(moleQueueId);
+    if (m_journal->needsCompaction())
+      compactJournal();
+  }
+
+  foreach (IdType moleQueueId, removedIds)
+    emit jobRemoved(moleQueueId);
+}
+
+void JobManager::journalJobUpdate(const JobData *jobdata,
+                                  const QVariantHash &changes)
+{
+  if (!m_journal)
+    return;
+
+  m_journal->appendUpdate(jobdata->moleQueueId(), jobdata->jobState(),
+                          changes);
+  if (m_journal->needsCompaction())
+    compactJournal();
+}
+
+void JobManager::compactJournal() const
+{
+  QList<QVariantHash> states;
+  states.reserve(m_jobs.size());
+  foreach (const JobData *jobdata, m_jobs)
+    states.append(jobdata->hash());
+
+  m_journal->compact(states, m_deferredJobs);
+}
+
+JobData *JobManager::loadDeferredJob(IdType moleQueueId)
+{
+  QMap<IdType, JobJournal::JobRecord>::iterator it =
+      m_deferredJobs.find(moleQueueId);
+  if (it == m_deferredJobs.end())
+    return NULL;
+
+  JobData *jobdata = new JobData(this);
+  jobdata->setFromHash(JobJournal::deserializeRecord(it.value()));
+  --m_deferredStateCount[jobStateBucket(it->jobState)];
+  m_deferredJobs.erase(it);
+
+  appendJobData(jobdata);
+  insertJobData(jobdata);
+  return jobdata;
+}
+
+void JobManager::updateJobStateIndex(JobData *jobdata)
+{
+  QHash<const JobData*, JobIndexEntry>::iterator it =
+      m_jobIndex.find(jobdata);
+  if (it == m_jobIndex.end() || it->jobState == jobdata->jobState())
+    return;
+
+  m_jobStateIndex[jobStateBucket(it->jobState)].remove(jobdata);
+  it->jobState = jobdata->jobState();
+  m_jobStateIndex[jobStateBucket(it->jobState)].insert(jobdata);
+}
+
 } // end namespace MoleQueue
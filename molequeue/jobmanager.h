@@ -21,9 +21,12 @@
 
 #include "molequeueglobal.h"
 #include "job.h"
+#include "jobjournal.h"
 
-#include <QtCore/QMap>
+#include <QtCore/QHash>
+#include <QtCore/QSet>
 #include <QtCore/QVariantHash>
+#include <QtCore/QVector>
 
 class QSettings;
 
@@ -53,11 +56,56 @@ public:
   explicit JobManager(QObject *parentObject = 0);
   virtual ~JobManager();
 
-  /// @param settings QSettings object to write state to.
+  /**
+   * Read the stored jobs. If a journal is open, the jobs are replayed from the
+   * journal, and any jobs stored in @a settings by older versions are migrated
+   * into it.
+   * @param settings QSettings object to read state from.
+   */
   void readSettings(QSettings &settings);
-  /// @param settings QSettings object to read state from.
+
+  /**
+   * Write the current jobs. If a journal is open, the journal is compacted
+   * instead of writing the jobs to @a settings.
+   * @param settings QSettings object to write state to.
+   */
   void writeSettings(QSettings &settings) const;
 
+  /**
+   * Persist jobs to the append-only journal in @a fileName. Once opened, every
+   * job creation, state/queue id change, and removal is appended to the
+   * journal as it happens. Call before readSettings().
+   * @return True if the journal was opened successfully.
+   * @sa JobJournal
+   */
+  bool openJournal(const QString &fileName);
+
+  /// @return The journal used to persist jobs, or NULL if none is open.
+  const JobJournal * journal() const { return m_journal; }
+
+  /**
+   * If enabled, readSettings() only loads jobs from the journal that have not
+   * reached a final JobState (Finished, Killed or Error). The remaining jobs
+   * are deferred and loaded on demand by lookupJobByMoleQueueId(),
+   * loadDeferredJobs() or the item model. jobCount() includes deferred jobs.
+   * Has no effect without a journal. Default: false
+   */
+  void setLazyLoading(bool lazy) { m_lazyLoading = lazy; }
+
+  /// @return Whether lazy loading is enabled. @sa setLazyLoading
+  bool lazyLoading() const { return m_lazyLoading; }
+
+  /// @return The number of jobs that have been deferred by lazy loading and
+  /// are not loaded yet.
+  int deferredCount() const { return m_deferredJobs.size(); }
+
+  /**
+   * Load up to @a maxJobs deferred jobs, in order of MoleQueue id.
+   * @return The number of jobs loaded.
+   * @sa setLazyLoading
+   */
+  int loadDeferredJobs(int maxJobs);
+
   /**
    * @name Job Management
    * Functions to add, remove, or locate jobs.
@@ -96,32 +144,62 @@ public:
   void removeJob(const Job &job);
 
   /**
-   * Remove the specified @a jobs from this manager and delete them.
+   * Remove the specified @a jobs from this manager and delete them. The jobs
+   * are removed in a single pass, and the item model is notified once per
+   * contiguous block of rows.
    */
   void removeJobs(const QList<Job> &jobsToRemove);
 
   /**
    * Remove the jobs with the specified @a moleQueueIds from this manager and
    * delete them.
+   * @sa removeJobs(const QList<Job>&)
    */
   void removeJobs(const QList<IdType> &moleQueueIds);
 
+  /**
+   * Remove all jobs with JobState @a state from this manager and delete them.
+   * Jobs deferred by lazy loading are removed without loading them.
+   */
+  void removeJobsWithJobState(MoleQueue::JobState state);
+
   /**
    * @param moleQueueId The MoleQueue Id of the requested Job.
    * @return The Job with the requested MoleQueue Id.
   * @note If no such Job exists, Job::isValid() will return false;
    */
+  Job lookupJobByMoleQueueId(IdType moleQueueId);
+
+  /**
+   * @overload
+   * Only jobs that are loaded are found; jobs deferred by lazy loading are
+   * not loaded by this const overload.
+   */
   Job lookupJobByMoleQueueId(IdType moleQueueId) const;
 
   /**
-   * Return a list of Job objects that have JobState @a state.
+   * Return a list of Job objects that have JobState @a state. The jobs are
+   * taken from a per-state index, so the cost is proportional to the number
+   * of matching jobs. The order of the list is unspecified. Jobs deferred by
+   * lazy loading are not included, see jobCount().
    * @param state JobState of interests
    * @return List of Job objects with JobState @a state
    */
-  QList<Job> jobsWithJobState(MoleQueue::JobState state);
+  QList<Job> jobsWithJobState(MoleQueue::JobState state) const;
+
+  /**
+   * @return The number of Job objects that have JobState @a state, including
+   * jobs that are deferred by lazy loading.
+   */
+  int jobCount(MoleQueue::JobState state) const
+  {
+    const int bucket = jobStateBucket(state);
+    return m_jobStateIndex[bucket].size() + m_deferredStateCount[bucket];
+  }
 
   /**
-   * @return Number of Job objects held by this manager.
+   * @return Number of Job objects held by this manager. Jobs deferred by lazy
+   * loading are not included until they are loaded.
    */
   int count() const { return m_jobs.size(); }
 
@@ -143,6 +221,7 @@ public:
    */
   JobItemModel * itemModel() const { return m_itemModel; }
 
+  friend class Job;
   friend class JobReferenceBase;
   friend class ConnectionTest;
 
@@ -177,6 +256,14 @@ public slots:
   void setJobQueueId(MoleQueue::IdType jobManagerIdId,
                      MoleQueue::IdType queueId);
 
+  /**
+   * Announce that new output of the running job with the specified MoleQueue
+   * id has been copied to its local working directory.
+   * @param files The updated files, relative to the local working directory.
+   */
+  void setJobOutputAvailable(MoleQueue::IdType moleQueueId,
+                             const QStringList &files);
+
   // End Job Modification group
   /**
    * @}
@@ -207,6 +294,13 @@ signals:
                        MoleQueue::JobState oldState,
                        MoleQueue::JobState newState);
 
+  /**
+   * Emitted when new output of a running Job is available locally.
+   * @param job Job object
+   * @param files The updated files, relative to the local working directory.
+   */
+  void jobOutputAvailable(const MoleQueue::Job &job, const QStringList &files);
+
   /**
    * Emitted when a Job's state changes.
    * @param job
@@ -226,29 +320,109 @@ signals:
   void jobRemoved(MoleQueue::IdType moleQueueId);
 
 protected:
-  /// @return The JobData with @a moleQueueId
+  /// @return The JobData with @a moleQueueId. Loads the job if it has been
+  /// deferred.
+  JobData *lookupJobDataByMoleQueueId(IdType moleQueueId)
+  {
+    JobData *jobdata = m_moleQueueMap.value(moleQueueId, NULL);
+    if (!jobdata && !m_deferredJobs.isEmpty())
+      jobdata = loadDeferredJob(moleQueueId);
+    return jobdata;
+  }
+
+  /// @return The loaded JobData with @a moleQueueId.
   JobData *lookupJobDataByMoleQueueId(IdType moleQueueId) const
   {
     return m_moleQueueMap.value(moleQueueId, NULL);
   }
 
-  /// @return Whether the address @a data is stored in m_jobs.
-  bool hasJobData(const JobData *data) const
+  /// Load the deferred job with @a moleQueueId.
+  /// @return The new JobData, or NULL if no such job is deferred.
+  JobData *loadDeferredJob(IdType moleQueueId);
+
+  /// @return Whether the handle table slot @a slot still holds the JobData
+  /// that was assigned to it at @a generation.
+  bool isValidHandle(int slot, quint32 generation) const
   {
-    return m_jobs.contains(const_cast<JobData*>(data));
+    return slot >= 0 && slot < m_handleGenerations.size() &&
+        m_handleGenerations.at(slot) == generation;
   }
 
+  /// Append @a jobdata to m_jobs and create its index entries. The item model
+  /// is not notified.
+  void appendJobData(JobData *jobdata);
+
   /// @param jobdata Job to insert into the internal lookup structures.
   void insertJobData(JobData *jobdata);
 
-  /// "Master" list of JobData
-  QList<JobData*> m_jobs;
+  /// Append an UpdateRecord with the @a changes of @a jobdata to the journal,
+  /// if one is open.
+  void journalJobUpdate(const JobData *jobdata, const QVariantHash &changes);
+
+  /// Rewrite the journal so that it only holds the current jobs.
+  void compactJournal() const;
+
+  /// Move @a jobdata to the correct bucket of m_jobStateIndex if its JobState
+  /// was modified without going through setJobState (e.g. Job::setFromHash).
+  void updateJobStateIndex(JobData *jobdata);
+
+  /// @return The index into m_jobStateIndex for @a state.
+  static int jobStateBucket(JobState state)
+  {
+    return (state >= Unknown && state <= Error) ? state - Unknown : 0;
+  }
+
+  /// Remove and delete all of the JobData objects in @a jobdatas. Unknown or
+  /// duplicate entries are ignored.
+  void removeJobData(const QList<JobData*> &jobdatas);
+
+  /// Bookkeeping for each JobData in m_jobs.
+  struct JobIndexEntry
+  {
+    /// Index of the JobData in m_jobs (and the row in m_itemModel).
+    int row;
+    /// MoleQueue id used as the key in m_moleQueueMap, or InvalidId if the
+    /// JobData is not yet registered there.
+    IdType moleQueueId;
+    /// JobState used to select the bucket in m_jobStateIndex.
+    JobState jobState;
+  };
+
+  /// "Master" list of JobData. Indices are dense and match the rows of
+  /// m_itemModel.
+  QVector<JobData*> m_jobs;
 
   /// Item model for interacting with jobs
   JobItemModel *m_itemModel;
 
   /// Lookup table for MoleQueue ids
-  QMap<IdType, JobData*> m_moleQueueMap;
+  QHash<IdType, JobData*> m_moleQueueMap;
+
+  /// Lookup table for JobData addresses
+  QHash<const JobData*, JobIndexEntry> m_jobIndex;
+
+  /// Handle table used to validate JobReferenceBase objects. Each JobData
+  /// occupies a slot; the slot's generation is incremented when the JobData is
+  /// removed, invalidating all references to it.
+  QVector<quint32> m_handleGenerations;
+
+  /// Slots in m_handleGenerations that are not in use.
+  QVector<int> m_freeHandleSlots;
+
+  /// JobData grouped by JobState, indexed by jobStateBucket().
+  QSet<JobData*> m_jobStateIndex[Error - Unknown + 1];
+
+  /// Persistent job log, or NULL if jobs are stored in QSettings.
+  JobJournal *m_journal;
+
+  /// Whether finished jobs are deferred in readSettings().
+  bool m_lazyLoading;
+
+  /// Serialized jobs that have not been loaded yet, by MoleQueue id.
+  QMap<IdType, JobJournal::JobRecord> m_deferredJobs;
+
+  /// Number of deferred jobs per JobState, indexed by jobStateBucket().
+  int m_deferredStateCount[Error - Unknown + 1];
 };
 
 }
@@ -25,15 +25,19 @@ JobReferenceBase::JobReferenceBase(JobData *jobdata)
   : m_jobData(jobdata),
     m_jobManager( Q_LIKELY(jobdata != NULL) ? jobdata->jobManager() : NULL),
     m_moleQueueId( Q_LIKELY(jobdata != NULL) ? jobdata->moleQueueId() :
-                                               MoleQueue::InvalidId )
-
+                                               MoleQueue::InvalidId ),
+    m_handleSlot( Q_LIKELY(jobdata != NULL) ? jobdata->m_handleSlot : -1),
+    m_handleGeneration( Q_LIKELY(jobdata != NULL) ? jobdata->m_handleGeneration
+                                                  : 0)
 {
 }
 
 JobReferenceBase::JobReferenceBase(JobManager *jobManager, IdType moleQueueId)
   : m_jobData(jobManager->lookupJobDataByMoleQueueId(moleQueueId)),
     m_jobManager(jobManager),
-    m_moleQueueId(moleQueueId)
+    m_moleQueueId(moleQueueId),
+    m_handleSlot(m_jobData ? m_jobData->m_handleSlot : -1),
+    m_handleGeneration(m_jobData ? m_jobData->m_handleGeneration : 0)
 {
 }
 
@@ -44,34 +48,21 @@ JobReferenceBase::~JobReferenceBase()
 bool JobReferenceBase::isValid() const
 {
   if (m_jobData) {
-    // If we have a molequeue id, validate the job data using the faster QMap
-    // lookup, O(log(n))
-    if (m_moleQueueId != InvalidId) {
-      JobData *ref = m_jobManager->lookupJobDataByMoleQueueId(m_moleQueueId);
-      if (ref) {
-        if (ref == m_jobData)
-          return true;
-
-        qWarning() << "Job with molequeue id" << m_moleQueueId << "maps to a "
-                      "different job than expected.\nExpected:\n"
-                   << m_jobData->hash() << "\nLookup returned:\n"
-                   << ref->hash();
-        return false;
-      }
-    }
-    // If the cached molequeue id is invalid, do the slow QList lookup, O(n):
-    if (m_jobManager->hasJobData(m_jobData)) {
-      // m_jobData is still valid. Try to update our cached molequeueid:
-      if (m_jobData->moleQueueId() != InvalidId)
-        m_moleQueueId = m_jobData->moleQueueId();
+    if (m_jobManager->isValidHandle(m_handleSlot, m_handleGeneration))
       return true;
-    }
+
     // m_jobData is gone...
     m_jobData = NULL;
-    return false;
   }
   // If m_jobData is NULL, the reference is invalid
   return false;
 }
 
+JobData JobReferenceBase::snapshot() const
+{
+  if (warnIfInvalid())
+    return JobData(*m_jobData);
+  return JobData(m_jobManager);
+}
+
 } // namespace MoleQueue
@@ -38,13 +38,16 @@ class JobManager;
  * of JobReferenceBase provide a convenient interface for obtaining and
  * modifying job properties.
  *
- * JobReferenceBase validates the pointer to the JobData object it represents by
- * querying the JobManager. The validity of the JobData pointer can be checked
- * with isValid(), which will return false if the JobData has been removed from
- * the JobManager. Subclasses of JobReferenceBase, Job on the Server and
- * JobRequest on the Client, will forward requests to the JobData. Certain
- * methods may cause signals to be emitted from JobManager; these cases will be
- * noted in the method documentation.
+ * JobReferenceBase validates the pointer to the JobData object it represents
+ * using a generation-counted handle: the JobManager assigns each JobData a slot
+ * in its handle table and bumps the slot's generation when the JobData is
+ * removed, so validation is a single comparison. The validity of the JobData
+ * pointer can be checked with isValid(), which will return false if the
+ * JobData has been removed from the JobManager. Subclasses of
+ * JobReferenceBase, Job on the Server and JobRequest on the Client, will
+ * forward requests to the JobData. Certain methods may cause signals to be
+ * emitted from JobManager; these cases will be noted in the method
+ * documentation.
  */
 class JobReferenceBase
 {
@@ -59,7 +62,8 @@ public:
   /// Construct a new JobReferenceBase with the same JobData as @a other.
   JobReferenceBase(const JobReferenceBase &other)
     : m_jobData(other.m_jobData),m_jobManager(other.m_jobManager),
-      m_moleQueueId(other.m_moleQueueId) {}
+      m_moleQueueId(other.m_moleQueueId), m_handleSlot(other.m_handleSlot),
+      m_handleGeneration(other.m_handleGeneration) {}
 
   virtual ~JobReferenceBase();
 
@@ -73,6 +77,14 @@ public:
   /// @return true if the guarded JobData pointer is valid, false otherwise.
   bool isValid() const;
 
+  /**
+   * @return A copy of all properties of the referenced job, taken in a single
+   * validated call. Use this instead of several accessors when many
+   * properties are needed at once. The copy is detached: modifying it does not
+   * affect the job. If the reference is invalid, a default JobData is returned.
+   */
+  JobData snapshot() const;
+
   friend class JobManager;
 
 protected:
@@ -95,8 +107,12 @@ protected:
   /// May be set to NULL during validation
   mutable JobData* m_jobData;
   JobManager *m_jobManager;
-  /// Used to speed up lookups and validation
+  /// MoleQueue id at the time the reference was created, for diagnostics.
   mutable IdType m_moleQueueId;
+  /// Slot of the JobData in the JobManager's handle table.
+  int m_handleSlot;
+  /// Generation of m_handleSlot when the reference was created.
+  quint32 m_handleGeneration;
 };
 
 } // namespace MoleQueue
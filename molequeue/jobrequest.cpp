@@ -237,6 +237,32 @@ int JobRequest::maxWallTime() const
   return -1;
 }
 
+void JobRequest::setPriority(int priority)
+{
+  if (warnIfInvalid())
+    m_jobData->setPriority(priority);
+}
+
+int JobRequest::priority() const
+{
+  if (warnIfInvalid())
+    return m_jobData->priority();
+  return 0;
+}
+
+void JobRequest::setMaxMemory(int memory)
+{
+  if (warnIfInvalid())
+    m_jobData->setMaxMemory(memory);
+}
+
+int JobRequest::maxMemory() const
+{
+  if (warnIfInvalid())
+    return m_jobData->maxMemory();
+  return 0;
+}
+
 IdType JobRequest::moleQueueId() const
 {
   if (warnIfInvalid())
@@ -92,21 +92,22 @@ void JobTableWidget::clearFinishedJobs()
   if (!m_jobManager)
     return;
 
-  QList<Job> finishedJobs =
-      m_jobManager->jobsWithJobState(MoleQueue::Finished);
-  finishedJobs.append(m_jobManager->jobsWithJobState(MoleQueue::Killed));
+  // Use the per-state counts so that deferred jobs are not loaded:
+  const int finishedJobs = m_jobManager->jobCount(MoleQueue::Finished) +
+      m_jobManager->jobCount(MoleQueue::Killed);
 
   QMessageBox::StandardButton confirm =
       QMessageBox::question(this, tr("Really remove jobs?"),
                             tr("Are you sure you would like to remove %n "
                                "finished job(s)? This will not delete any input"
-                               " or output files.", "", finishedJobs.size()),
+                               " or output files.", "", finishedJobs),
                             QMessageBox::Yes | QMessageBox::No, QMessageBox::No);
 
   if (confirm != QMessageBox::Yes)
     return;
 
-  m_jobManager->removeJobs(finishedJobs);
+  m_jobManager->removeJobsWithJobState(MoleQueue::Finished);
+  m_jobManager->removeJobsWithJobState(MoleQueue::Killed);
 }
 
 void JobTableWidget::showFilterBar(bool visible)
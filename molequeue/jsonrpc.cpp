@@ -16,10 +16,12 @@
 
 #include "jsonrpc.h"
 
+#include "filespecification.h"
 #include "job.h"
 #include "jobdata.h"
 #include "molequeueglobal.h"
 #include "qtjson.h"
+#include "transport/connection.h"
 
 #include <json/json.h>
 
@@ -34,7 +36,9 @@ namespace MoleQueue
 {
 
 JsonRpc::JsonRpc(QObject *parentObject)
-  : QObject(parentObject)
+  : QObject(parentObject),
+    m_defaultPacketFormat(StyledPacketFormat),
+    m_packetSizeHint(0)
 {
   qRegisterMetaType<QDir>("QDir");
   qRegisterMetaType<Json::Value>("Json::Value");
@@ -42,14 +46,67 @@ JsonRpc::JsonRpc(QObject *parentObject)
   qRegisterMetaType<JobState>("MoleQueue::JobState");
   qRegisterMetaType<QueueListType>("MoleQueue::QueueListType");
   qRegisterMetaType<JobSubmissionErrorCode>("MoleQueue::JobSubmissionErrorCode");
+  qRegisterMetaType<PacketFormat>("MoleQueue::PacketFormat");
 }
 
 JsonRpc::~JsonRpc()
 {
 }
 
+void JsonRpc::setDefaultPacketFormat(PacketFormat format)
+{
+  if (format != DefaultPacketFormat)
+    m_defaultPacketFormat = format;
+}
+
+void JsonRpc::setPacketFormat(Connection *connection, PacketFormat format)
+{
+  if (!connection)
+    return;
+
+  if (format == DefaultPacketFormat) {
+    if (m_packetFormats.remove(connection) > 0) {
+      disconnect(connection, SIGNAL(destroyed(QObject*)),
+                 this, SLOT(connectionDestroyed(QObject*)));
+    }
+    return;
+  }
+
+  if (!m_packetFormats.contains(connection)) {
+    connect(connection, SIGNAL(destroyed(QObject*)),
+            this, SLOT(connectionDestroyed(QObject*)));
+  }
+  m_packetFormats.insert(connection, format);
+}
+
+PacketFormat JsonRpc::packetFormat(const Connection *connection) const
+{
+  return m_packetFormats.value(connection, m_defaultPacketFormat);
+}
+
+void JsonRpc::serializePacket(const Json::Value &packet, PacketFormat format,
+                              PacketType &buffer) const
+{
+  if (format == DefaultPacketFormat)
+    format = m_defaultPacketFormat;
+
+  switch (format) {
+  case CompactPacketFormat:
+    appendCompactValue(packet, buffer);
+    break;
+  default:
+  case StyledPacketFormat: {
+    Json::StyledWriter writer;
+    std::string str = writer.write(packet);
+    buffer.append(str.data(), static_cast<int>(str.size()));
+    break;
+  }
+  }
+}
+
 PacketType JsonRpc::generateJobRequest(const Job &job,
-                                       IdType packetId)
+                                       IdType packetId,
+                                       PacketFormat format)
 {
   Json::Value packet = generateEmptyRequest(packetId);
 
@@ -59,9 +116,7 @@ PacketType JsonRpc::generateJobRequest(const Job &job,
 
   packet["params"] = paramsObject;
 
-  Json::StyledWriter writer;
-  std::string ret_stdstr = writer.write(packet);
-  PacketType ret (ret_stdstr.c_str());
+  PacketType ret = writePacket(packet, format);
 
   registerRequest(packetId, SUBMIT_JOB);
 
@@ -71,7 +126,8 @@ PacketType JsonRpc::generateJobRequest(const Job &job,
 PacketType
 JsonRpc::generateJobSubmissionConfirmation(IdType moleQueueId,
                                            const QString &workingDirectory,
-                                           IdType packetId)
+                                           IdType packetId,
+                                           PacketFormat format)
 {
   Json::Value packet = generateEmptyResponse(packetId);
 
@@ -81,25 +137,22 @@ JsonRpc::generateJobSubmissionConfirmation(IdType moleQueueId,
 
   packet["result"] = resultObject;
 
-  Json::StyledWriter writer;
-  std::string ret_stdstr = writer.write(packet);
-  PacketType ret (ret_stdstr.c_str());
+  PacketType ret = writePacket(packet, format);
 
   return ret;
 }
 
 PacketType JsonRpc::generateErrorResponse(int errorCode,
                                           const QString &message,
-                                          IdType packetId)
+                                          IdType packetId,
+                                          PacketFormat format)
 {
   Json::Value packet = generateEmptyError(packetId);
 
   packet["error"]["code"]    = errorCode;
   packet["error"]["message"] = message.toStdString();
 
-  Json::StyledWriter writer;
-  std::string ret_stdstr = writer.write(packet);
-  PacketType ret (ret_stdstr.c_str());
+  PacketType ret = writePacket(packet, format);
 
   return ret;
 }
@@ -107,7 +160,8 @@ PacketType JsonRpc::generateErrorResponse(int errorCode,
 PacketType JsonRpc::generateErrorResponse(int errorCode,
                                           const QString &message,
                                           const Json::Value &data,
-                                          IdType packetId)
+                                          IdType packetId,
+                                          PacketFormat format)
 {
   Json::Value packet = generateEmptyError(packetId);
 
@@ -115,25 +169,22 @@ PacketType JsonRpc::generateErrorResponse(int errorCode,
   packet["error"]["message"] = message.toStdString();
   packet["error"]["data"]    = data;
 
-  Json::StyledWriter writer;
-  std::string ret_stdstr = writer.write(packet);
-  PacketType ret (ret_stdstr.c_str());
+  PacketType ret = writePacket(packet, format);
 
   return ret;
 }
 
 PacketType JsonRpc::generateErrorResponse(int errorCode,
                                           const QString &message,
-                                          const Json::Value &packetId)
+                                          const Json::Value &packetId,
+                                          PacketFormat format)
 {
   Json::Value packet = generateEmptyError(packetId);
 
   packet["error"]["code"]    = errorCode;
   packet["error"]["message"] = message.toStdString();
 
-  Json::StyledWriter writer;
-  std::string ret_stdstr = writer.write(packet);
-  PacketType ret (ret_stdstr.c_str());
+  PacketType ret = writePacket(packet, format);
 
   return ret;
 }
@@ -141,7 +192,8 @@ PacketType JsonRpc::generateErrorResponse(int errorCode,
 PacketType JsonRpc::generateErrorResponse(int errorCode,
                                           const QString &message,
                                           const Json::Value &data,
-                                          const Json::Value &packetId)
+                                          const Json::Value &packetId,
+                                          PacketFormat format)
 {
   Json::Value packet = generateEmptyError(packetId);
 
@@ -149,15 +201,14 @@ PacketType JsonRpc::generateErrorResponse(int errorCode,
   packet["error"]["message"] = message.toStdString();
   packet["error"]["data"]    = data;
 
-  Json::StyledWriter writer;
-  std::string ret_stdstr = writer.write(packet);
-  PacketType ret (ret_stdstr.c_str());
+  PacketType ret = writePacket(packet, format);
 
   return ret;
 }
 
 PacketType JsonRpc::generateJobCancellation(const Job &job,
-                                            IdType packetId)
+                                            IdType packetId,
+                                            PacketFormat format)
 {
   Json::Value packet = generateEmptyRequest(packetId);
 
@@ -168,9 +219,7 @@ PacketType JsonRpc::generateJobCancellation(const Job &job,
 
   packet["params"] = paramsObject;
 
-  Json::StyledWriter writer;
-  std::string ret_stdstr = writer.write(packet);
-  PacketType ret (ret_stdstr.c_str());
+  PacketType ret = writePacket(packet, format);
 
   registerRequest(packetId, CANCEL_JOB);
 
@@ -178,21 +227,21 @@ PacketType JsonRpc::generateJobCancellation(const Job &job,
 }
 
 PacketType JsonRpc::generateJobCancellationConfirmation(IdType moleQueueId,
-                                                        IdType packetId)
+                                                        IdType packetId,
+                                                        PacketFormat format)
 {
   Json::Value packet = generateEmptyResponse(packetId);
 
   packet["result"] = moleQueueId;
 
-  Json::StyledWriter writer;
-  std::string ret_stdstr = writer.write(packet);
-  PacketType ret (ret_stdstr.c_str());
+  PacketType ret = writePacket(packet, format);
 
   return ret;
 }
 
 PacketType JsonRpc::generateLookupJobRequest(IdType moleQueueId,
-                                             IdType packetId)
+                                             IdType packetId,
+                                             PacketFormat format)
 {
   Json::Value packet = generateEmptyRequest(packetId);
 
@@ -203,9 +252,7 @@ PacketType JsonRpc::generateLookupJobRequest(IdType moleQueueId,
 
   packet["params"] = paramsObject;
 
-  Json::StyledWriter writer;
-  std::string ret_stdstr = writer.write(packet);
-  PacketType ret(ret_stdstr.c_str());
+  PacketType ret = writePacket(packet, format);
 
   registerRequest(packetId, LOOKUP_JOB);
 
@@ -214,7 +261,8 @@ PacketType JsonRpc::generateLookupJobRequest(IdType moleQueueId,
 
 PacketType JsonRpc::generateLookupJobResponse(const Job &req,
                                               IdType moleQueueId,
-                                              IdType packetId)
+                                              IdType packetId,
+                                              PacketFormat format)
 {
   Json::Value packet;
 
@@ -231,22 +279,117 @@ PacketType JsonRpc::generateLookupJobResponse(const Job &req,
     packet["result"] = QtJson::toJson(req.hash());
   }
 
-  Json::StyledWriter writer;
-  std::string ret_stdstr = writer.write(packet);
-  PacketType ret(ret_stdstr.c_str());
+  PacketType ret = writePacket(packet, format);
+
+  return ret;
+}
+
+PacketType JsonRpc::generateQueueUpdateRequest(const QString &queueName,
+                                               IdType packetId,
+                                               PacketFormat format)
+{
+  Json::Value packet = generateEmptyRequest(packetId);
+
+  packet["method"] = "updateQueue";
+
+  Json::Value paramsObject(Json::objectValue);
+  paramsObject["queue"] = queueName.toStdString();
+
+  packet["params"] = paramsObject;
+
+  PacketType ret = writePacket(packet, format);
+
+  registerRequest(packetId, UPDATE_QUEUE);
+
+  return ret;
+}
+
+PacketType JsonRpc::generateQueueUpdateResponse(const QString &queueName,
+                                                const QVariantHash &statistics,
+                                                IdType packetId,
+                                                PacketFormat format)
+{
+  Json::Value packet;
+
+  if (statistics.isEmpty()) {
+    packet = generateEmptyError(packetId);
+    Json::Value errorObject(Json::objectValue);
+    errorObject["message"] = "Unknown queue";
+    errorObject["code"] = 0;
+    errorObject["data"] = queueName.toStdString();
+    packet["error"] = errorObject;
+  }
+  else {
+    packet = generateEmptyResponse(packetId);
+    packet["result"] = QtJson::toJson(statistics);
+    packet["result"]["queue"] = queueName.toStdString();
+  }
+
+  PacketType ret = writePacket(packet, format);
+
+  return ret;
+}
+
+PacketType JsonRpc::generatePacketFormatRequest(PacketFormat requestedFormat,
+                                                IdType packetId,
+                                                PacketFormat format)
+{
+  Json::Value packet = generateEmptyRequest(packetId);
+
+  packet["method"] = "setPacketFormat";
+
+  Json::Value paramsObject(Json::objectValue);
+  paramsObject["format"] = packetFormatToString(requestedFormat);
+
+  packet["params"] = paramsObject;
+
+  PacketType ret = writePacket(packet, format);
+
+  registerRequest(packetId, SET_PACKET_FORMAT);
+
+  return ret;
+}
+
+PacketType JsonRpc::generatePacketFormatResponse(PacketFormat acceptedFormat,
+                                                 IdType packetId,
+                                                 PacketFormat format)
+{
+  Json::Value packet = generateEmptyResponse(packetId);
+
+  packet["result"] = packetFormatToString(acceptedFormat);
+
+  PacketType ret = writePacket(packet, format);
+
+  return ret;
+}
+
+PacketType JsonRpc::generateQueueListRequest(IdType packetId,
+                                             PacketFormat format)
+{
+  Json::Value packet = generateEmptyRequest(packetId);
+
+  packet["method"] = "listQueues";
+
+  PacketType ret = writePacket(packet, format);
+
+  registerRequest(packetId, LIST_QUEUES);
 
   return ret;
 }
 
-PacketType JsonRpc::generateQueueListRequest(IdType packetId)
+PacketType JsonRpc::generateQueueStatusListRequest(IdType packetId,
+                                                   PacketFormat format)
 {
   Json::Value packet = generateEmptyRequest(packetId);
 
   packet["method"] = "listQueues";
 
-  Json::StyledWriter writer;
-  std::string ret_stdstr = writer.write(packet);
-  PacketType ret (ret_stdstr.c_str());
+  Json::Value paramsObject(Json::objectValue);
+  paramsObject["status"] = true;
+
+  packet["params"] = paramsObject;
+
+  PacketType ret = writePacket(packet, format);
 
   registerRequest(packetId, LIST_QUEUES);
 
@@ -254,7 +397,8 @@ PacketType JsonRpc::generateQueueListRequest(IdType packetId)
 }
 
 PacketType JsonRpc::generateQueueList(const QueueListType &queueList,
-                                      IdType packetId)
+                                      IdType packetId,
+                                      PacketFormat format)
 {
   Json::Value packet = generateEmptyResponse(packetId);
 
@@ -271,9 +415,37 @@ PacketType JsonRpc::generateQueueList(const QueueListType &queueList,
 
   packet["result"] = resultObject;
 
-  Json::StyledWriter writer;
-  std::string ret_stdstr = writer.write(packet);
-  PacketType ret (ret_stdstr.c_str());
+  PacketType ret = writePacket(packet, format);
+
+  return ret;
+}
+
+PacketType JsonRpc::generateQueueList(const QueueListType &queueList,
+                                      const QVariantHash &queueStatus,
+                                      IdType packetId,
+                                      PacketFormat format)
+{
+  Json::Value packet = generateEmptyResponse(packetId);
+
+  Json::Value resultObject (Json::objectValue);
+  foreach (const QString queueName, queueList.keys()) {
+
+    Json::Value programArray (Json::arrayValue);
+    foreach (const QString prog, queueList[queueName]) {
+      const std::string progName = prog.toStdString();
+      programArray.append(progName);
+    }
+
+    Json::Value queueObject (Json::objectValue);
+    queueObject["programs"] = programArray;
+    if (queueStatus.contains(queueName))
+      queueObject["status"] = QtJson::toJson(queueStatus.value(queueName));
+    resultObject[queueName.toStdString()] = queueObject;
+  }
+
+  packet["result"] = resultObject;
+
+  PacketType ret = writePacket(packet, format);
 
   return ret;
 }
@@ -281,7 +453,8 @@ PacketType JsonRpc::generateQueueList(const QueueListType &queueList,
 PacketType
 JsonRpc::generateJobStateChangeNotification(IdType moleQueueId,
                                             JobState oldState,
-                                            JobState newState)
+                                            JobState newState,
+                                            PacketFormat format)
 {
   Json::Value packet = generateEmptyNotification();
 
@@ -294,13 +467,53 @@ JsonRpc::generateJobStateChangeNotification(IdType moleQueueId,
 
   packet["params"] = paramsObject;
 
-  Json::StyledWriter writer;
-  std::string ret_stdstr = writer.write(packet);
-  PacketType ret (ret_stdstr.c_str());
+  PacketType ret = writePacket(packet, format);
+
+  return ret;
+}
+
+PacketType JsonRpc::generateJobOutputNotification(IdType moleQueueId,
+                                                  const QStringList &files,
+                                                  PacketFormat format)
+{
+  Json::Value packet = generateEmptyNotification();
+
+  packet["method"] = "jobOutputAvailable";
+
+  Json::Value filesArray (Json::arrayValue);
+  foreach (const QString &file, files)
+    filesArray.append(file.toStdString());
+
+  Json::Value paramsObject (Json::objectValue);
+  paramsObject["moleQueueId"] = moleQueueId;
+  paramsObject["files"]       = filesArray;
+
+  packet["params"] = paramsObject;
+
+  PacketType ret = writePacket(packet, format);
 
   return ret;
 }
 
+PacketType JsonRpc::generateBatch(const QList<PacketType> &packets) const
+{
+  int size = 2 + packets.size();
+  foreach (const PacketType &packet, packets)
+    size += packet.size();
+
+  PacketType batch;
+  batch.reserve(size);
+  batch.append('[');
+  for (int i = 0; i < packets.size(); ++i) {
+    if (i > 0)
+      batch.append(',');
+    batch.append(packets[i]);
+  }
+  batch.append(']');
+
+  return batch;
+}
+
 void JsonRpc::interpretIncomingPacket(Connection* connection,
                                       const Message msg)
 {
@@ -315,20 +528,30 @@ void JsonRpc::interpretIncomingPacket(Connection* connection,
     return;
   }
 
-  // Submit the root node for processing
-  interpretIncomingJsonRpc(connection, msg.replyTo(), root);
+  // Submit the root node for processing. The handlers may take ownership of
+  // parts of root (e.g. file contents), so it must not be used afterwards.
+  dispatchJsonRpc(connection, msg.replyTo(), root);
 }
 
 void JsonRpc::interpretIncomingJsonRpc(Connection *connection,
                                        EndpointId replyTo,
                                        const Json::Value &data)
+{
+  Json::Value root(data);
+  dispatchJsonRpc(connection, replyTo, root);
+}
+
+void JsonRpc::dispatchJsonRpc(Connection *connection, EndpointId replyTo,
+                              Json::Value &data)
 {
   // Handle batch requests recursively:
   if (data.isArray()) {
-    for (Json::Value::const_iterator it = data.begin(), it_end = data.end();
+    emit batchStarted(connection, replyTo);
+    for (Json::Value::iterator it = data.begin(), it_end = data.end();
          it != it_end; ++it) {
-      interpretIncomingJsonRpc(connection, replyTo, *it);
+      dispatchJsonRpc(connection, replyTo, *it);
     }
+    emit batchFinished(connection, replyTo);
 
     return;
   }
@@ -338,8 +561,13 @@ void JsonRpc::interpretIncomingJsonRpc(Connection *connection,
     return;
   }
 
-  PacketForm   form   = guessPacketForm(data);
+  // Dispatch on the method before validating, so that replies to other
+  // clients are dropped without further processing.
   PacketMethod method = guessPacketMethod(data);
+  if (method == IGNORE_METHOD)
+    return;
+
+  PacketForm   form   = guessPacketForm(data);
 
   // Validate detected type
   switch (form) {
@@ -451,6 +679,46 @@ void JsonRpc::interpretIncomingJsonRpc(Connection *connection,
     }
     break;
   }
+  case UPDATE_QUEUE:
+  {
+    switch (form) {
+    default:
+    case INVALID_PACKET:
+    case NOTIFICATION_PACKET:
+      handleInvalidRequest(connection, replyTo, data);
+      break;
+    case REQUEST_PACKET:
+      handleUpdateQueueRequest(connection, replyTo, data);
+      break;
+    case RESULT_PACKET:
+      handleUpdateQueueResult(data);
+      break;
+    case ERROR_PACKET:
+      handleUpdateQueueError(data);
+      break;
+    }
+    break;
+  }
+  case SET_PACKET_FORMAT:
+  {
+    switch (form) {
+    default:
+    case INVALID_PACKET:
+    case NOTIFICATION_PACKET:
+      handleInvalidRequest(connection, replyTo, data);
+      break;
+    case REQUEST_PACKET:
+      handleSetPacketFormatRequest(connection, replyTo, data);
+      break;
+    case RESULT_PACKET:
+      handleSetPacketFormatResult(data);
+      break;
+    case ERROR_PACKET:
+      // Servers without setPacketFormat keep using their default format.
+      break;
+    }
+    break;
+  }
   case JOB_STATE_CHANGED:
   {
     switch (form) {
@@ -467,6 +735,22 @@ void JsonRpc::interpretIncomingJsonRpc(Connection *connection,
     }
     break;
   }
+  case JOB_OUTPUT_AVAILABLE:
+  {
+    switch (form) {
+    default:
+    case INVALID_PACKET:
+    case REQUEST_PACKET:
+    case RESULT_PACKET:
+    case ERROR_PACKET:
+      handleInvalidRequest(connection, replyTo, data);
+      break;
+    case NOTIFICATION_PACKET:
+      handleJobOutputAvailableNotification(data);
+      break;
+    }
+    break;
+  }
   }
 
   // Remove responses from pendingRequests lookup table
@@ -805,8 +1089,14 @@ JsonRpc::PacketMethod JsonRpc::guessPacketMethod(const Json::Value &root) const
       return CANCEL_JOB;
     else if (qstrcmp(methodCString, "lookupJob") == 0)
       return LOOKUP_JOB;
+    else if (qstrcmp(methodCString, "updateQueue") == 0)
+      return UPDATE_QUEUE;
+    else if (qstrcmp(methodCString, "setPacketFormat") == 0)
+      return SET_PACKET_FORMAT;
     else if (qstrcmp(methodCString, "jobStateChanged") == 0)
       return JOB_STATE_CHANGED;
+    else if (qstrcmp(methodCString, "jobOutputAvailable") == 0)
+      return JOB_OUTPUT_AVAILABLE;
 
     return UNRECOGNIZED_METHOD;
   }
@@ -874,6 +1164,16 @@ void JsonRpc::handleListQueuesRequest(Connection *connection,
                                       const Json::Value &root) const
 {
   const IdType id = static_cast<IdType>(root["id"].asLargestUInt());
+
+  // Clients that want the queue status ask for it explicitly, so that older
+  // clients keep receiving the plain queue list.
+  const Json::Value &paramsObject = root["params"];
+  if (paramsObject.isObject() && paramsObject["status"].isBool() &&
+      paramsObject["status"].asBool()) {
+    emit queueStatusListRequestReceived(connection, replyTo, id);
+    return;
+  }
+
   emit queueListRequestReceived(connection, replyTo, id);
 }
 
@@ -893,14 +1193,25 @@ void JsonRpc::handleListQueuesResult(const Json::Value &root) const
   // Populate queue list:
   QueueListType queueList;
   queueList.reserve(resultObject.size());
+  QVariantHash queueStatus;
+  bool hasStatus = false;
 
   // Iterate through queues
   for (Json::Value::const_iterator it = resultObject.begin(),
        it_end = resultObject.end(); it != it_end; ++it) {
     const QString queueName (it.memberName());
 
-    // Extract program data
-    const Json::Value &programArray = *it;
+    // Extract program data. Replies to requests for the queue status hold an
+    // object with the programs and status of each queue.
+    const Json::Value *programValue = &(*it);
+    if ((*it).isObject()) {
+      hasStatus = true;
+      const Json::Value &statusObject = (*it)["status"];
+      if (statusObject.isObject())
+        queueStatus.insert(queueName, QtJson::toVariant(statusObject));
+      programValue = &(*it)["programs"];
+    }
+    const Json::Value &programArray = *programValue;
 
     // No programs, just add an empty list
     if (programArray.isNull()) {
@@ -935,6 +1246,8 @@ void JsonRpc::handleListQueuesResult(const Json::Value &root) const
 
 
   emit queueListReceived(id, queueList);
+  if (hasStatus)
+    emit queueStatusReceived(id, queueStatus);
 }
 
 void JsonRpc::handleListQueuesError(Connection *connection,
@@ -949,11 +1262,11 @@ void JsonRpc::handleListQueuesError(Connection *connection,
 
 void JsonRpc::handleSubmitJobRequest(Connection *connection,
                                      EndpointId replyTo,
-                                     const Json::Value &root) const
+                                     Json::Value &root) const
 {
   const IdType id = static_cast<IdType>(root["id"].asLargestUInt());
 
-  const Json::Value &paramsObject = root["params"];
+  Json::Value &paramsObject = root["params"];
   if (!paramsObject.isObject()) {
     Json::StyledWriter writer;
     const std::string requestString = writer.write(root);
@@ -962,8 +1275,43 @@ void JsonRpc::handleSubmitJobRequest(Connection *connection,
     return;
   }
 
+  // Move the input files out of the request before converting the remaining
+  // (small) options, so that large file contents are not copied into QVariants.
+  QVariant inputFile;
+  if (paramsObject.isMember("inputFile")) {
+    Json::Value &inputFileObject = paramsObject["inputFile"];
+    if (inputFileObject.isObject()) {
+      inputFile = QVariant::fromValue(
+            FileSpecification::fromJson(inputFileObject));
+      paramsObject.removeMember("inputFile");
+    }
+  }
+
+  QVariantList additionalInputFiles;
+  bool hasAdditionalInputFiles = false;
+  if (paramsObject.isMember("additionalInputFiles")) {
+    Json::Value &filesArray = paramsObject["additionalInputFiles"];
+    if (filesArray.isArray()) {
+      hasAdditionalInputFiles = true;
+      additionalInputFiles.reserve(static_cast<int>(filesArray.size()));
+      for (Json::Value::iterator it = filesArray.begin(),
+           it_end = filesArray.end(); it != it_end; ++it) {
+        if ((*it).isObject())
+          additionalInputFiles.append(
+                QVariant::fromValue(FileSpecification::fromJson(*it)));
+        else
+          additionalInputFiles.append(QtJson::toVariant(*it));
+      }
+      paramsObject.removeMember("additionalInputFiles");
+    }
+  }
+
   // Populate options object:
   QVariantHash optionHash = QtJson::toVariant(paramsObject).toHash();
+  if (inputFile.isValid())
+    optionHash.insert("inputFile", inputFile);
+  if (hasAdditionalInputFiles)
+    optionHash.insert("additionalInputFiles", additionalInputFiles);
 
   emit jobSubmissionRequestReceived(connection, replyTo, id, optionHash);
 }
@@ -1127,6 +1475,106 @@ void JsonRpc::handleLookupJobError(const Json::Value &root) const
   emit lookupJobErrorReceived(id, moleQueueId);
 }
 
+void JsonRpc::handleUpdateQueueRequest(Connection *connection,
+                                       const EndpointId replyTo,
+                                       const Json::Value &root) const
+{
+  const IdType id = static_cast<IdType>(root["id"].asLargestUInt());
+
+  const Json::Value &paramsObject = root["params"];
+
+  if (!paramsObject.isObject() || !paramsObject["queue"].isString()) {
+    Json::StyledWriter writer;
+    const std::string responseString = writer.write(root);
+    qWarning() << "Queue update request is ill-formed:\n"
+               << responseString.c_str();
+    return;
+  }
+
+  const QString queueName(paramsObject["queue"].asCString());
+
+  emit queueUpdateRequestReceived(connection, replyTo, id, queueName);
+}
+
+void JsonRpc::handleUpdateQueueResult(const Json::Value &root) const
+{
+  const IdType id = static_cast<IdType>(root["id"].asLargestUInt());
+
+  const Json::Value &resultObject = root["result"];
+
+  if (!resultObject.isObject()) {
+    Json::StyledWriter writer;
+    const std::string responseString = writer.write(root);
+    qWarning() << "Queue update result is ill-formed:\n"
+               << responseString.c_str();
+    return;
+  }
+
+  QVariantHash statistics = QtJson::toVariant(resultObject).toHash();
+
+  emit queueUpdateResponseReceived(id, statistics);
+}
+
+void JsonRpc::handleUpdateQueueError(const Json::Value &root) const
+{
+  const IdType id = static_cast<IdType>(root["id"].asLargestUInt());
+
+  if (!root["error"]["code"].isIntegral() ||
+      !root["error"]["data"].isString() ||
+      !root["error"]["message"].isString()) {
+    Json::StyledWriter writer;
+    const std::string responseString = writer.write(root);
+    qWarning() << "Queue update failure response is ill-formed:\n"
+               << responseString.c_str();
+    return;
+  }
+
+  const QString queueName(root["error"]["data"].asCString());
+
+  emit queueUpdateErrorReceived(id, queueName);
+}
+
+void JsonRpc::handleSetPacketFormatRequest(Connection *connection,
+                                           const EndpointId replyTo,
+                                           const Json::Value &root) const
+{
+  const IdType id = static_cast<IdType>(root["id"].asLargestUInt());
+
+  const Json::Value &paramsObject = root["params"];
+
+  PacketFormat format = DefaultPacketFormat;
+  if (paramsObject.isObject() && paramsObject["format"].isString())
+    format = stringToPacketFormat(paramsObject["format"].asCString());
+
+  if (format == DefaultPacketFormat) {
+    Json::StyledWriter writer;
+    const std::string requestString = writer.write(root);
+    qWarning() << "Packet format request is ill-formed:\n"
+               << requestString.c_str();
+    return;
+  }
+
+  emit packetFormatRequestReceived(connection, replyTo, id, format);
+}
+
+void JsonRpc::handleSetPacketFormatResult(const Json::Value &root) const
+{
+  const IdType id = static_cast<IdType>(root["id"].asLargestUInt());
+
+  const Json::Value &resultValue = root["result"];
+
+  if (!resultValue.isString()) {
+    Json::StyledWriter writer;
+    const std::string responseString = writer.write(root);
+    qWarning() << "Packet format result is ill-formed:\n"
+               << responseString.c_str();
+    return;
+  }
+
+  emit packetFormatResponseReceived(
+        id, stringToPacketFormat(resultValue.asCString()));
+}
+
 void JsonRpc::handleJobStateChangedNotification(const Json::Value &root) const
 {
   const Json::Value &paramsObject = root["params"];
@@ -1154,6 +1602,35 @@ void JsonRpc::handleJobStateChangedNotification(const Json::Value &root) const
   emit jobStateChangeReceived(moleQueueId, oldState, newState);
 }
 
+void JsonRpc::handleJobOutputAvailableNotification(
+    const Json::Value &root) const
+{
+  const Json::Value &paramsObject = root["params"];
+
+  if (!paramsObject.isObject() ||
+      !paramsObject["moleQueueId"].isIntegral() ||
+      !paramsObject["files"].isArray()) {
+    Json::StyledWriter writer;
+    const std::string requestString = writer.write(root);
+    qWarning() << "Job output notification is ill-formed:\n"
+               << requestString.c_str();
+    return;
+  }
+
+  const IdType moleQueueId = static_cast<IdType>(
+        paramsObject["moleQueueId"].asLargestUInt());
+
+  QStringList files;
+  const Json::Value &filesArray = paramsObject["files"];
+  for (Json::Value::const_iterator it = filesArray.begin(),
+       itEnd = filesArray.end(); it != itEnd; ++it) {
+    if ((*it).isString())
+      files << (*it).asCString();
+  }
+
+  emit jobOutputReceived(moleQueueId, files);
+}
+
 void JsonRpc::registerRequest(IdType packetId,
                               JsonRpc::PacketMethod method)
 {
@@ -1165,4 +1642,120 @@ void JsonRpc::registerReply(IdType packetId)
   m_pendingRequests.remove(packetId);
 }
 
+void JsonRpc::connectionDestroyed(QObject *object)
+{
+  m_packetFormats.remove(object);
+}
+
+PacketType JsonRpc::writePacket(const Json::Value &packet,
+                                PacketFormat format)
+{
+  PacketType buffer;
+  buffer.reserve(m_packetSizeHint);
+  serializePacket(packet, format, buffer);
+
+  // Track the size of recent packets so that most packets are written without
+  // reallocating the buffer. Decay slowly to forget unusually large packets.
+  if (buffer.size() > m_packetSizeHint)
+    m_packetSizeHint = buffer.size();
+  else
+    m_packetSizeHint -= (m_packetSizeHint - buffer.size()) / 16;
+
+  return buffer;
+}
+
+void JsonRpc::appendCompactValue(const Json::Value &value, PacketType &buffer)
+{
+  switch (value.type()) {
+  case Json::nullValue:
+    buffer.append("null");
+    break;
+  case Json::intValue:
+    buffer.append(QByteArray::number(
+                    static_cast<qlonglong>(value.asLargestInt())));
+    break;
+  case Json::uintValue:
+    buffer.append(QByteArray::number(
+                    static_cast<qulonglong>(value.asLargestUInt())));
+    break;
+  case Json::realValue: {
+    // Use JsonCpp's formatting so that reals round-trip identically.
+    const std::string str = Json::valueToString(value.asDouble());
+    buffer.append(str.data(), static_cast<int>(str.size()));
+    break;
+  }
+  case Json::stringValue:
+    appendQuotedString(value.asCString(), buffer);
+    break;
+  case Json::booleanValue:
+    buffer.append(value.asBool() ? "true" : "false");
+    break;
+  case Json::arrayValue: {
+    buffer.append('[');
+    const Json::Value::ArrayIndex size = value.size();
+    for (Json::Value::ArrayIndex i = 0; i < size; ++i) {
+      if (i > 0)
+        buffer.append(',');
+      appendCompactValue(value[i], buffer);
+    }
+    buffer.append(']');
+    break;
+  }
+  case Json::objectValue: {
+    buffer.append('{');
+    bool first = true;
+    for (Json::Value::const_iterator it = value.begin(), itEnd = value.end();
+         it != itEnd; ++it) {
+      if (!first)
+        buffer.append(',');
+      first = false;
+      appendQuotedString(it.memberName(), buffer);
+      buffer.append(':');
+      appendCompactValue(*it, buffer);
+    }
+    buffer.append('}');
+    break;
+  }
+  }
+}
+
+void JsonRpc::appendQuotedString(const char *str, PacketType &buffer)
+{
+  static const char hexDigits[] = "0123456789ABCDEF";
+
+  buffer.append('"');
+  // Append runs of characters that need no escaping in one go.
+  const char *run = str;
+  for (const char *c = str; *c != '\0'; ++c) {
+    const char *escape = NULL;
+    switch (*c) {
+    case '"':  escape = "\\\""; break;
+    case '\\': escape = "\\\\"; break;
+    case '\b': escape = "\\b"; break;
+    case '\f': escape = "\\f"; break;
+    case '\n': escape = "\\n"; break;
+    case '\r': escape = "\\r"; break;
+    case '\t': escape = "\\t"; break;
+    default:
+      if (static_cast<unsigned char>(*c) >= 0x20)
+        continue;
+      break;
+    }
+
+    buffer.append(run, static_cast<int>(c - run));
+    run = c + 1;
+    if (escape) {
+      buffer.append(escape);
+    }
+    else {
+      const unsigned char ch = static_cast<unsigned char>(*c);
+      buffer.append("\\u00");
+      buffer.append(hexDigits[ch >> 4]);
+      buffer.append(hexDigits[ch & 0xf]);
+    }
+  }
+  buffer.append(run, static_cast<int>(qstrlen(run)));
+  buffer.append('"');
+}
+
 } // end namespace MoleQueue
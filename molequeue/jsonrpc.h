@@ -63,15 +63,48 @@ public:
     */
   virtual ~JsonRpc();
 
+  /**
+    * Set the format used for packets that are generated with
+    * DefaultPacketFormat and for connections without an explicit format. The
+    * default is StyledPacketFormat.
+    */
+  void setDefaultPacketFormat(PacketFormat format);
+
+  /// @return The format used when no other format is requested.
+  PacketFormat defaultPacketFormat() const { return m_defaultPacketFormat; }
+
+  /**
+    * Use @a format for packets sent over @a connection. Passing
+    * DefaultPacketFormat reverts to defaultPacketFormat(). The setting is
+    * forgotten when @a connection is destroyed.
+    */
+  void setPacketFormat(Connection *connection, PacketFormat format);
+
+  /// @return The format to use for packets sent over @a connection.
+  PacketFormat packetFormat(const Connection *connection) const;
+
+  /**
+    * Serialize @a packet and append it to @a buffer. This allows a caller to
+    * reuse a single buffer for many packets.
+    *
+    * @param packet The JSON-RPC packet.
+    * @param format The format to serialize with.
+    * @param buffer The buffer to append to.
+    */
+  void serializePacket(const Json::Value &packet, PacketFormat format,
+                       PacketType &buffer) const;
+
   /**
     * Generate a JSON-RPC packet for the job submission request described by
     * @a req.
     *
     * @param req The Job of interest.
     * @param packetId The JSON-RPC id for the request.
+    * @param format The format to serialize the packet with.
     * @return A PacketType, ready to send to a Connection.
     */
-  PacketType generateJobRequest(const Job &req, IdType packetId);
+  PacketType generateJobRequest(const Job &req, IdType packetId,
+                                PacketFormat format = DefaultPacketFormat);
 
   /**
     * Generate a JSON-RPC packet to confirm a successful job submission.
@@ -80,11 +113,14 @@ public:
     * @param workingDir Local working directory where files are stored during
     * job execution
     * @param packetId The JSON-RPC id for the request.
+    * @param format The format to serialize the packet with.
     * @return A PacketType, ready to send to a Connection.
     */
   PacketType generateJobSubmissionConfirmation(IdType moleQueueId,
                                                const QString &workingDir,
-                                               IdType packetId);
+                                               IdType packetId,
+                                               PacketFormat format =
+                                               DefaultPacketFormat);
 
   /**
     * Generate a JSON-RPC response packet to notify of an error.
@@ -92,11 +128,13 @@ public:
     * @param errorCode Error code
     * @param message Single sentence describing the error that occurred.
     * @param packetId The JSON-RPC id for the packet.
+    * @param format The format to serialize the packet with.
     * @return A PacketType, ready to send to a Connection.
     */
   PacketType generateErrorResponse(int errorCode,
                                    const QString &message,
-                                   IdType packetId);
+                                   IdType packetId,
+                                   PacketFormat format = DefaultPacketFormat);
 
   /**
     * Generate a JSON-RPC response packet to notify of an error.
@@ -105,13 +143,15 @@ public:
     * @param message Single sentence describing the error that occurred.
     * @param data a Json::Value to be used as the error object's data member
     * @param packetId The JSON-RPC id for the packet.
+    * @param format The format to serialize the packet with.
     * @return A PacketType, ready to send to a Connection.
     * @overload
     */
   PacketType generateErrorResponse(int errorCode,
                                    const QString &message,
                                    const Json::Value &data,
-                                   IdType packetId);
+                                   IdType packetId,
+                                   PacketFormat format = DefaultPacketFormat);
 
   /**
     * Generate a JSON-RPC response packet to notify of an error.
@@ -119,12 +159,14 @@ public:
     * @param errorCode Error code
     * @param message Single sentence describing the error that occurred.
     * @param packetId The JSON-RPC id for the packet.
+    * @param format The format to serialize the packet with.
     * @return A PacketType, ready to send to a Connection.
     * @overload
     */
   PacketType generateErrorResponse(int errorCode,
                                    const QString &message,
-                                   const Json::Value &packetId);
+                                   const Json::Value &packetId,
+                                   PacketFormat format = DefaultPacketFormat);
 
   /**
     * Generate a JSON-RPC response packet to notify of an error.
@@ -133,42 +175,52 @@ public:
     * @param message Single sentence describing the error that occurred.
     * @param data a Json::Value to be used as the error object's data member
     * @param packetId The JSON-RPC id for the packet.
+    * @param format The format to serialize the packet with.
     * @return A PacketType, ready to send to a Connection.
     * @overload
     */
   PacketType generateErrorResponse(int errorCode,
                                    const QString &message,
                                    const Json::Value &data,
-                                   const Json::Value &packetId);
+                                   const Json::Value &packetId,
+                                   PacketFormat format = DefaultPacketFormat);
 
   /**
     * Generate a JSON-RPC packet for requesting a job cancellation.
     *
     * @param req The Job to cancel.
     * @param packetId The JSON-RPC id for the request.
+    * @param format The format to serialize the packet with.
     * @return A PacketType, ready to send to a Connection.
     */
   PacketType generateJobCancellation(const Job &req,
-                                     IdType packetId);
+                                     IdType packetId,
+                                     PacketFormat format = DefaultPacketFormat);
 
   /**
     * Generate a JSON-RPC packet confirming a job cancellation.
     *
     * @param moleQueueId MoleQueue internal identifer for the canceled job.
     * @param packetId The JSON-RPC id for the request.
+    * @param format The format to serialize the packet with.
     * @return A PacketType, ready to send to a Connection.
     */
   PacketType generateJobCancellationConfirmation(IdType moleQueueId,
-                                                 IdType packetId);
+                                                 IdType packetId,
+                                                 PacketFormat format =
+                                                 DefaultPacketFormat);
 
   /**
     * Generate a JSON-RPC packet for requesting a job lookup.
     *
     * @param moleQueueId The MoleQueue id of the job.
     * @param packetId The JSON-RPC id for the request.
+    * @param format The format to serialize the packet with.
     * @return A PacketType, ready to send to a Connection.
     */
-  PacketType generateLookupJobRequest(IdType moleQueueId, IdType packetId);
+  PacketType generateLookupJobRequest(IdType moleQueueId, IdType packetId,
+                                      PacketFormat format =
+                                      DefaultPacketFormat);
 
   /**
     * Generate a JSON-RPC packet to respond to a lookupJob request. If the Job
@@ -177,19 +229,96 @@ public:
     * @param req The requested Job.
     * @param moleQueueId MoleQueue id of requested job.
     * @param packetId The JSON-RPC id for the request.
+    * @param format The format to serialize the packet with.
     * @return A PacketType, ready to send to a Connection.
     */
   PacketType generateLookupJobResponse(const Job &req, IdType moleQueueId,
-                                       IdType packetId);
+                                       IdType packetId,
+                                       PacketFormat format =
+                                       DefaultPacketFormat);
+
+  /**
+    * Generate a JSON-RPC packet for requesting an immediate update of a remote
+    * queue.
+    *
+    * @param queueName The name of the queue.
+    * @param packetId The JSON-RPC id for the request.
+    * @param format The format to serialize the packet with.
+    * @return A PacketType, ready to send to a Connection.
+    */
+  PacketType generateQueueUpdateRequest(const QString &queueName,
+                                        IdType packetId,
+                                        PacketFormat format =
+                                        DefaultPacketFormat);
+
+  /**
+    * Generate a JSON-RPC packet to respond to an updateQueue request. If
+    * @a statistics is empty, the queue is unknown and an error response will
+    * be generated.
+    *
+    * @param queueName The name of the requested queue.
+    * @param statistics The queue update statistics of the queue.
+    * @param packetId The JSON-RPC id for the request.
+    * @param format The format to serialize the packet with.
+    * @return A PacketType, ready to send to a Connection.
+    */
+  PacketType generateQueueUpdateResponse(const QString &queueName,
+                                         const QVariantHash &statistics,
+                                         IdType packetId,
+                                         PacketFormat format =
+                                         DefaultPacketFormat);
+
+  /**
+    * Generate a JSON-RPC packet asking the server to use @a requestedFormat
+    * for the packets it sends over this connection.
+    *
+    * @param requestedFormat The format that replies should use.
+    * @param packetId The JSON-RPC id for the request.
+    * @param format The format to serialize the packet with.
+    * @return A PacketType, ready to send to a Connection.
+    */
+  PacketType generatePacketFormatRequest(PacketFormat requestedFormat,
+                                         IdType packetId,
+                                         PacketFormat format =
+                                         DefaultPacketFormat);
+
+  /**
+    * Generate a JSON-RPC packet to respond to a setPacketFormat request.
+    *
+    * @param acceptedFormat The format that the connection now uses.
+    * @param packetId The JSON-RPC id for the request.
+    * @param format The format to serialize the packet with.
+    * @return A PacketType, ready to send to a Connection.
+    */
+  PacketType generatePacketFormatResponse(PacketFormat acceptedFormat,
+                                          IdType packetId,
+                                          PacketFormat format =
+                                          DefaultPacketFormat);
 
   /**
     * Generate a JSON-RPC packet for requesting a list of available Queues and
     * Programs.
     *
     * @param packetId The JSON-RPC id for the request.
+    * @param format The format to serialize the packet with.
+    * @return A PacketType, ready to send to a Connection.
+    */
+  PacketType generateQueueListRequest(IdType packetId,
+                                      PacketFormat format =
+                                      DefaultPacketFormat);
+
+  /**
+    * Generate a JSON-RPC packet for requesting a list of available Queues and
+    * Programs along with the runtime status of each queue, such as the state
+    * of its connection to a remote host.
+    *
+    * @param packetId The JSON-RPC id for the request.
+    * @param format The format to serialize the packet with.
     * @return A PacketType, ready to send to a Connection.
     */
-  PacketType generateQueueListRequest(IdType packetId);
+  PacketType generateQueueStatusListRequest(IdType packetId,
+                                            PacketFormat format =
+                                            DefaultPacketFormat);
 
   /**
     * Generate a JSON-RPC packet to request a listing of all available Queues
@@ -197,10 +326,28 @@ public:
     *
     * @param qmanager The QueueManager to send.
     * @param packetId The JSON-RPC id for the request.
+    * @param format The format to serialize the packet with.
     * @return A PacketType, ready to send to a Connection.
     */
   PacketType generateQueueList(const QueueListType &queueList,
-                               IdType packetId);
+                               IdType packetId,
+                               PacketFormat format = DefaultPacketFormat);
+
+  /**
+    * Generate a JSON-RPC packet to respond to a listQueues request that asked
+    * for the queue status. Each queue maps to an object holding its
+    * "programs" and, if the queue reports one, its "status".
+    *
+    * @param queueList The queues and their programs.
+    * @param queueStatus The status of each queue, keyed by queue name.
+    * @param packetId The JSON-RPC id for the request.
+    * @param format The format to serialize the packet with.
+    * @return A PacketType, ready to send to a Connection.
+    */
+  PacketType generateQueueList(const QueueListType &queueList,
+                               const QVariantHash &queueStatus,
+                               IdType packetId,
+                               PacketFormat format = DefaultPacketFormat);
 
   /**
     * Generate a JSON-RPC packet to notify listeners that a job has changed
@@ -209,11 +356,37 @@ public:
     * @param moleQueueId Internal MoleQueue job id of job.
     * @param oldState Old state of the job.
     * @param newState New state of the job.
+    * @param format The format to serialize the packet with.
     * @return A PacketType, ready to send to a Connection.
     */
   PacketType generateJobStateChangeNotification(IdType moleQueueId,
                                                 JobState oldState,
-                                                JobState newState);
+                                                JobState newState,
+                                                PacketFormat format =
+                                                DefaultPacketFormat);
+
+  /**
+    * Generate a JSON-RPC packet to notify listeners that new output of a
+    * running job has been copied to its local working directory.
+    *
+    * @param moleQueueId Internal MoleQueue job id of job.
+    * @param files The updated files, relative to the local working directory.
+    * @param format The format to serialize the packet with.
+    * @return A PacketType, ready to send to a Connection.
+    */
+  PacketType generateJobOutputNotification(IdType moleQueueId,
+                                           const QStringList &files,
+                                           PacketFormat format =
+                                           DefaultPacketFormat);
+
+  /**
+    * Combine several packets into a single JSON-RPC batch transmission.
+    *
+    * @param packets Packets generated by the generate* functions.
+    * @return A PacketType containing a JSON array of @a packets, ready to send
+    * to a Connection.
+    */
+  PacketType generateBatch(const QList<PacketType> &packets) const;
 
   /**
     * Read a newly received packet.
@@ -365,6 +538,26 @@ signals:
                              const Json::Value &packetId,
                              const Json::Value &errorDataObject) const;
 
+  /**
+    * Emitted before the elements of a batch transmission are processed. All
+    * signals emitted for the elements follow, and batchFinished() is emitted
+    * afterwards.
+    *
+    * @param connection The connection the batch was received on
+    * @param replyTo The reply to endpoint to identify the client.
+    */
+  void batchStarted(MoleQueue::Connection *connection,
+                    const MoleQueue::EndpointId replyTo) const;
+
+  /**
+    * Emitted after all elements of a batch transmission have been processed.
+    *
+    * @param connection The connection the batch was received on
+    * @param replyTo The reply to endpoint to identify the client.
+    */
+  void batchFinished(MoleQueue::Connection *connection,
+                     const MoleQueue::EndpointId replyTo) const;
+
   /**
     * Emitted when a request for a list of available Queues/Programs is
     * received.
@@ -386,6 +579,28 @@ signals:
   void queueListReceived(MoleQueue::IdType packetId,
                          const MoleQueue::QueueListType &list) const;
 
+  /**
+    * Emitted when a request for a list of available Queues/Programs and the
+    * status of each queue is received.
+    *
+    * @param connection The connection the request was received on
+    * @param replyTo The reply to endpoint to identify the client.
+    * @param packetId The JSON-RPC id for the packet
+    */
+  void queueStatusListRequestReceived(MoleQueue::Connection *connection,
+                                      const MoleQueue::EndpointId replyTo,
+                                      MoleQueue::IdType packetId) const;
+
+  /**
+    * Emitted when a list of Queues/Programs that includes the status of the
+    * queues is received, after queueListReceived.
+    *
+    * @param packetId The JSON-RPC id for the packet
+    * @param status The status of each queue, keyed by queue name.
+    */
+  void queueStatusReceived(MoleQueue::IdType packetId,
+                           const QVariantHash &status) const;
+
   /**
     * Emitted when a request to submit a new job is received.
     *
@@ -477,6 +692,60 @@ signals:
   void lookupJobErrorReceived(MoleQueue::IdType packetId,
                               MoleQueue::IdType moleQueueId) const;
 
+  /**
+    * Emitted when an updateQueue request is received.
+    *
+    * @param connection The connection the request was received on.
+    * @param replyTo The reply to endpoint to identify the client.
+    * @param packetId The JSON-RPC id for the packet.
+    * @param queueName The name of the queue to update.
+    */
+  void queueUpdateRequestReceived(MoleQueue::Connection *connection,
+                                  const MoleQueue::EndpointId replyTo,
+                                  MoleQueue::IdType packetId,
+                                  const QString &queueName) const;
+
+  /**
+    * Emitted when a successful updateQueue response is received.
+    *
+    * @param packetId The JSON-RPC id for the packet.
+    * @param statistics The queue update statistics of the queue, including
+    * its name as "queue".
+    */
+  void queueUpdateResponseReceived(MoleQueue::IdType packetId,
+                                   const QVariantHash &statistics) const;
+
+  /**
+    * Emitted when a failed updateQueue response is received.
+    *
+    * @param packetId The JSON-RPC id for the packet.
+    * @param queueName The requested queue name.
+    */
+  void queueUpdateErrorReceived(MoleQueue::IdType packetId,
+                                const QString &queueName) const;
+
+  /**
+    * Emitted when a setPacketFormat request is received.
+    *
+    * @param connection The connection the request was received on.
+    * @param replyTo The reply to endpoint to identify the client.
+    * @param packetId The JSON-RPC id for the packet.
+    * @param format The requested format.
+    */
+  void packetFormatRequestReceived(MoleQueue::Connection *connection,
+                                   const MoleQueue::EndpointId replyTo,
+                                   MoleQueue::IdType packetId,
+                                   MoleQueue::PacketFormat format) const;
+
+  /**
+    * Emitted when a setPacketFormat response is received.
+    *
+    * @param packetId The JSON-RPC id for the packet.
+    * @param format The format that the server uses for this connection.
+    */
+  void packetFormatResponseReceived(MoleQueue::IdType packetId,
+                                    MoleQueue::PacketFormat format) const;
+
   /**
     * Emitted when a notification that a job has changed state is received.
     *
@@ -488,6 +757,16 @@ signals:
                               MoleQueue::JobState oldState,
                               MoleQueue::JobState newState) const;
 
+  /**
+    * Emitted when a notification that new output of a running job is
+    * available is received.
+    *
+    * @param moleQueueId The internal MoleQueue identifier for the job.
+    * @param files The updated files, relative to the local working directory.
+    */
+  void jobOutputReceived(MoleQueue::IdType moleQueueId,
+                         const QStringList &files) const;
+
 protected:
   /// Create and return a new JsonCpp JSON-RPC request.
   /// @param id JSON-RPC id
@@ -524,9 +803,23 @@ protected:
     SUBMIT_JOB,
     CANCEL_JOB,
     LOOKUP_JOB,
-    JOB_STATE_CHANGED
+    UPDATE_QUEUE,
+    SET_PACKET_FORMAT,
+    JOB_STATE_CHANGED,
+    JOB_OUTPUT_AVAILABLE
   };
 
+  /**
+    * Process a JSON-RPC packet or batch. Unlike interpretIncomingJsonRpc, the
+    * handlers may move data out of @a data instead of copying it.
+    *
+    * @param connection The connection the RPC was received on
+    * @param replyTo The reply to endpoint to identify the client.
+    * @param data A single or batch JSON-RPC transmission.
+    */
+  void dispatchJsonRpc(MoleQueue::Connection *connection,
+                       EndpointId replyTo, Json::Value &data);
+
   /// @param root Input JSOC-RPC packet
   /// @return The PacketType of the packet
   PacketForm guessPacketForm(const Json::Value &root) const;
@@ -563,11 +856,12 @@ protected:
                              const EndpointId replyTo,
                              const Json::Value &root) const;
 
-  /// Extract data and emit signal for a submitJob request.
+  /// Extract data and emit signal for a submitJob request. Input files are
+  /// moved out of @a root into FileSpecification objects without copying.
   /// @param root Root of request
   void handleSubmitJobRequest(MoleQueue::Connection *connection,
                               const EndpointId replyTo,
-                              const Json::Value &root) const;
+                              Json::Value &root) const;
   /// Extract data and emit signal for a submitJob result.
   /// @param root Root of request
   void handleSubmitJobResult(const Json::Value &root) const;
@@ -599,10 +893,35 @@ protected:
   /// @param root Root of request
   void handleLookupJobError(const Json::Value &root) const;
 
+  /// Extract data and emit signal for an updateQueue request.
+  /// @param root Root of request
+  void handleUpdateQueueRequest(MoleQueue::Connection *connection,
+                                const EndpointId replyTo,
+                                const Json::Value &root) const;
+  /// Extract data and emit signal for an updateQueue result.
+  /// @param root Root of request
+  void handleUpdateQueueResult(const Json::Value &root) const;
+  /// Extract data and emit signal for an updateQueue error.
+  /// @param root Root of request
+  void handleUpdateQueueError(const Json::Value &root) const;
+
+  /// Extract data and emit signal for a setPacketFormat request.
+  /// @param root Root of request
+  void handleSetPacketFormatRequest(MoleQueue::Connection *connection,
+                                    const EndpointId replyTo,
+                                    const Json::Value &root) const;
+  /// Extract data and emit signal for a setPacketFormat result.
+  /// @param root Root of request
+  void handleSetPacketFormatResult(const Json::Value &root) const;
+
   /// Extract data and emit signal for a jobStateChanged notification.
   /// @param root Root of request
   void handleJobStateChangedNotification(const Json::Value &root) const;
 
+  /// Extract data and emit signal for a jobOutputAvailable notification.
+  /// @param root Root of request
+  void handleJobOutputAvailableNotification(const Json::Value &root) const;
+
   /**
     * Record that a new request has been sent. This is necessary to identify the
     * matching reply. Register the request prior to sending it. This is handled
@@ -621,8 +940,30 @@ protected:
     */
   void registerReply(IdType packetId);
 
+  /// Serialize @a packet with @a format into a new PacketType.
+  PacketType writePacket(const Json::Value &packet, PacketFormat format);
+
+  /// Append @a value to @a buffer without insignificant whitespace.
+  static void appendCompactValue(const Json::Value &value, PacketType &buffer);
+
+  /// Append @a str to @a buffer as a quoted, escaped JSON string.
+  static void appendQuotedString(const char *str, PacketType &buffer);
+
   /// Lookup hash for pending requests
   QHash<IdType, PacketMethod> m_pendingRequests;
+
+  /// Format used when none is requested.
+  PacketFormat m_defaultPacketFormat;
+
+  /// Formats selected for individual connections.
+  QHash<const QObject*, PacketFormat> m_packetFormats;
+
+  /// Expected size of the next packet, used to preallocate buffers.
+  int m_packetSizeHint;
+
+protected slots:
+  /// Forget the packet format of a destroyed connection.
+  void connectionDestroyed(QObject *object);
 };
 
 } // end namespace MoleQueue
@@ -32,6 +32,17 @@ LocalQueueWidget::LocalQueueWidget(QueueLocal *queue, QWidget *parent_) :
 
   connect(ui->coresSpinBox, SIGNAL(valueChanged(int)),
           this, SLOT(setDirty()));
+  connect(ui->backfillCheckBox, SIGNAL(toggled(bool)),
+          this, SLOT(setDirty()));
+  connect(ui->fairShareCheckBox, SIGNAL(toggled(bool)),
+          this, SLOT(setDirty()));
+  connect(ui->memorySpinBox, SIGNAL(valueChanged(int)),
+          this, SLOT(setDirty()));
+  connect(ui->pinCpusCheckBox, SIGNAL(toggled(bool)),
+          this, SLOT(setDirty()));
+#ifndef Q_OS_LINUX
+  ui->pinCpusCheckBox->setEnabled(false);
+#endif // Q_OS_LINUX
 
 }
 
@@ -43,12 +54,26 @@ LocalQueueWidget::~LocalQueueWidget()
 void LocalQueueWidget::save()
 {
   m_queue->setMaxNumberOfCores(ui->coresSpinBox->value());
+  m_queue->setSchedulingPolicy(ui->backfillCheckBox->isChecked()
+                               ? QueueLocal::BackfillScheduling
+                               : QueueLocal::FifoScheduling);
+  m_queue->setFairShare(ui->fairShareCheckBox->isChecked());
+  // The minimum value means "all host memory"
+  m_queue->setMaxMemory(ui->memorySpinBox->value() > 0
+                        ? ui->memorySpinBox->value() : -1);
+  m_queue->setPinJobsToCpus(ui->pinCpusCheckBox->isChecked());
   setDirty(false);
 }
 
 void LocalQueueWidget::reset()
 {
   ui->coresSpinBox->setValue(m_queue->maxNumberOfCores());
+  ui->backfillCheckBox->setChecked(m_queue->schedulingPolicy() ==
+                                   QueueLocal::BackfillScheduling);
+  ui->fairShareCheckBox->setChecked(m_queue->fairShare());
+  const qint64 maxMemory = m_queue->maxMemory();
+  ui->memorySpinBox->setValue(maxMemory > 0 ? static_cast<int>(maxMemory) : 0);
+  ui->pinCpusCheckBox->setChecked(m_queue->pinJobsToCpus());
   setDirty(false);
 }
 
@@ -150,9 +150,60 @@ enum JobSubmissionErrorCode {
   InvalidProgram
 };
 
+/**
+  * Enumeration defining the formats used to serialize JSON-RPC packets.
+  */
+enum PacketFormat {
+  /// Use the default format of the serializer.
+  DefaultPacketFormat = -1,
+  /// Indented, human-readable JSON.
+  StyledPacketFormat = 0,
+  /// JSON without insignificant whitespace, for high-rate traffic.
+  CompactPacketFormat
+};
+
+/**
+ * Convert a PacketFormat value to a string.
+ *
+ * @param format PacketFormat
+ * @return C string
+ */
+inline const char * packetFormatToString(PacketFormat format)
+{
+  switch (format)
+  {
+  case StyledPacketFormat:
+    return "styled";
+  case CompactPacketFormat:
+    return "compact";
+  default:
+  case DefaultPacketFormat:
+    return "default";
+  }
+}
+
+/**
+ * Convert a string to a PacketFormat value.
+ *
+ * @param str PacketFormat string
+ * @return PacketFormat
+ */
+inline PacketFormat stringToPacketFormat(const char *str)
+{
+  if (qstrcmp(str, "styled") == 0)
+    return StyledPacketFormat;
+  else if (qstrcmp(str, "compact") == 0)
+    return CompactPacketFormat;
+  else
+    return DefaultPacketFormat;
+}
+
 /// Default time in between remote queue updates in minutes.
 const int DEFAULT_REMOTE_QUEUE_UPDATE_INTERVAL = 3;
 
+/// Default number of submissions that a remote queue runs at once.
+const int DEFAULT_MAX_CONCURRENT_SUBMISSIONS = 4;
+
 /// Default number of processor cores for a job
 const int DEFAULT_NUM_CORES = 1;
 
@@ -167,5 +218,6 @@ Q_DECLARE_METATYPE(MoleQueue::PacketType)
 Q_DECLARE_METATYPE(MoleQueue::QueueListType)
 Q_DECLARE_METATYPE(MoleQueue::JobState)
 Q_DECLARE_METATYPE(MoleQueue::JobSubmissionErrorCode)
+Q_DECLARE_METATYPE(MoleQueue::PacketFormat)
 
 #endif // MOLEQUEUEGLOBAL_H
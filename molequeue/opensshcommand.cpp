@@ -40,6 +40,7 @@ QStringList OpenSshCommand::sshArgs()
     args << "-i" << m_identityFile;
   if (m_portNumber >= 0 && m_portNumber != 22)
     args << "-p" << QString::number(m_portNumber);
+  args << connectionSharingArgs();
 
   return args;
 }
@@ -55,6 +56,21 @@ QStringList OpenSshCommand::scpArgs()
     args << "-i" << m_identityFile;
   if (m_portNumber >= 0 && m_portNumber != 22)
     args << "-P" << QString::number(m_portNumber);
+  // scp passes these on to ssh.
+  args << connectionSharingArgs();
+  return args;
+}
+
+QStringList OpenSshCommand::connectionSharingArgs() const
+{
+  QStringList args;
+  if (m_persistent && !m_controlPath.isEmpty()) {
+    // The first command starts a master connection in the background, which
+    // later commands reuse instead of authenticating again.
+    args << "-o" << "ControlMaster=auto"
+         << "-o" << "ControlPath=" + m_controlPath
+         << "-o" << QString("ControlPersist=%1").arg(controlPersistSeconds);
+  }
   return args;
 }
 
@@ -43,6 +43,9 @@ public:
   OpenSshCommand(QObject *parentObject = 0);
   ~OpenSshCommand();
 
+  /// Seconds that a shared connection stays open after its last command.
+  static const int controlPersistSeconds = 600;
+
 protected:
 
   /// @return the arguments to be passed to the SSH command.
@@ -50,6 +53,11 @@ protected:
 
   /// @return the arguments to be passed to the SCP command.
   QStringList scpArgs();
+
+  /// @return the ssh options that share a master connection between commands
+  /// through controlPath(), or an empty list if the connection is not
+  /// persistent.
+  QStringList connectionSharingArgs() const;
 };
 
 } // End namespace
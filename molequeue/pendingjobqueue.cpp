@@ -0,0 +1,221 @@
+/******************************************************************************
+
+  This source file is part of the MoleQueue project.
+
+  Copyright 2012 Kitware, Inc.
+
+  This source code is released under the New BSD License, (the "License").
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+******************************************************************************/
+
+#include "pendingjobqueue.h"
+
+#include <QtCore/QtAlgorithms>
+
+namespace MoleQueue
+{
+
+PendingJobQueue::PendingJobQueue()
+  : m_virtualTime(0),
+    m_sequence(0),
+    m_fairShare(false)
+{
+}
+
+void PendingJobQueue::enqueue(IdType moleQueueId, int priority,
+                              const QString &owner)
+{
+  if (m_positions.contains(moleQueueId))
+    return;
+
+  Entry entry;
+  entry.moleQueueId = moleQueueId;
+  entry.priority = priority;
+  entry.sequence = m_sequence++;
+  entry.tag = 0;
+  entry.fairShare = m_fairShare;
+
+  // Start-time fair queuing: each owner's jobs are stamped with consecutive
+  // virtual times, starting no earlier than the job currently being served.
+  // Owners that were idle thus rejoin at the current position rather than
+  // being credited for the time they did not use.
+  if (m_fairShare) {
+    QHash<QString, OwnerShare>::iterator it = m_owners.find(owner);
+    if (it == m_owners.end()) {
+      OwnerShare share = { 0, 0 };
+      it = m_owners.insert(owner, share);
+    }
+    entry.tag = qMax(it->finish, m_virtualTime);
+    entry.owner = owner;
+    it->finish = entry.tag + 1;
+    ++it->queued;
+  }
+
+  m_heap.append(entry);
+  m_positions.insert(moleQueueId, m_heap.size() - 1);
+  siftUp(m_heap.size() - 1);
+}
+
+IdType PendingJobQueue::first() const
+{
+  return m_heap.isEmpty() ? InvalidId : m_heap.first().moleQueueId;
+}
+
+IdType PendingJobQueue::takeFirst()
+{
+  if (m_heap.isEmpty())
+    return InvalidId;
+
+  const Entry head = m_heap.first();
+  if (head.tag > m_virtualTime)
+    m_virtualTime = head.tag;
+  removeAt(0);
+  releaseShare(head, false);
+  return head.moleQueueId;
+}
+
+bool PendingJobQueue::take(IdType moleQueueId)
+{
+  QHash<IdType, int>::iterator it = m_positions.find(moleQueueId);
+  if (it == m_positions.end())
+    return false;
+
+  const Entry entry = m_heap.at(it.value());
+  if (entry.tag > m_virtualTime)
+    m_virtualTime = entry.tag;
+  removeAt(it.value());
+  releaseShare(entry, false);
+  return true;
+}
+
+bool PendingJobQueue::remove(IdType moleQueueId)
+{
+  QHash<IdType, int>::iterator it = m_positions.find(moleQueueId);
+  if (it == m_positions.end())
+    return false;
+
+  const Entry entry = m_heap.at(it.value());
+  removeAt(it.value());
+  releaseShare(entry, true);
+  return true;
+}
+
+int PendingJobQueue::priority(IdType moleQueueId) const
+{
+  QHash<IdType, int>::const_iterator it = m_positions.constFind(moleQueueId);
+  return it == m_positions.constEnd() ? 0 : m_heap.at(it.value()).priority;
+}
+
+void PendingJobQueue::clear()
+{
+  m_heap.clear();
+  m_positions.clear();
+  m_owners.clear();
+  m_virtualTime = 0;
+}
+
+QList<IdType> PendingJobQueue::ids() const
+{
+  QVector<Entry> entries = m_heap;
+  qSort(entries.begin(), entries.end(), lessThan);
+
+  QList<IdType> result;
+  result.reserve(entries.size());
+  foreach (const Entry &entry, entries)
+    result.append(entry.moleQueueId);
+  return result;
+}
+
+bool PendingJobQueue::lessThan(const Entry &a, const Entry &b)
+{
+  if (a.priority != b.priority)
+    return a.priority > b.priority;
+  if (a.tag != b.tag)
+    return a.tag < b.tag;
+  return a.sequence < b.sequence;
+}
+
+void PendingJobQueue::siftUp(int index)
+{
+  const Entry entry = m_heap.at(index);
+  while (index > 0) {
+    const int parent = (index - 1) / 2;
+    if (!lessThan(entry, m_heap.at(parent)))
+      break;
+    place(index, m_heap.at(parent));
+    index = parent;
+  }
+  place(index, entry);
+}
+
+void PendingJobQueue::siftDown(int index)
+{
+  const int count = m_heap.size();
+  const Entry entry = m_heap.at(index);
+  for (;;) {
+    int child = 2 * index + 1;
+    if (child >= count)
+      break;
+    if (child + 1 < count && lessThan(m_heap.at(child + 1), m_heap.at(child)))
+      ++child;
+    if (!lessThan(m_heap.at(child), entry))
+      break;
+    place(index, m_heap.at(child));
+    index = child;
+  }
+  place(index, entry);
+}
+
+void PendingJobQueue::place(int index, const Entry &entry)
+{
+  m_heap[index] = entry;
+  m_positions[entry.moleQueueId] = index;
+}
+
+void PendingJobQueue::removeAt(int index)
+{
+  m_positions.remove(m_heap.at(index).moleQueueId);
+
+  const int last = m_heap.size() - 1;
+  if (index == last) {
+    m_heap.resize(last);
+    return;
+  }
+
+  const Entry moved = m_heap.at(last);
+  m_heap.resize(last);
+  place(index, moved);
+  if (index > 0 && lessThan(moved, m_heap.at((index - 1) / 2)))
+    siftUp(index);
+  else
+    siftDown(index);
+}
+
+void PendingJobQueue::releaseShare(const Entry &entry, bool cancelled)
+{
+  if (!entry.fairShare)
+    return;
+
+  QHash<QString, OwnerShare>::iterator it = m_owners.find(entry.owner);
+  if (it == m_owners.end())
+    return;
+
+  if (--it->queued <= 0) {
+    m_owners.erase(it);
+    return;
+  }
+
+  // A cancelled job gives its slot back, so that it no longer counts against
+  // the owner's share. The owner's next job may then tie with its last queued
+  // one, which is broken by submission order.
+  if (cancelled && it->finish > m_virtualTime)
+    --it->finish;
+}
+
+} // namespace MoleQueue
@@ -0,0 +1,163 @@
+/******************************************************************************
+
+  This source file is part of the MoleQueue project.
+
+  Copyright 2012 Kitware, Inc.
+
+  This source code is released under the New BSD License, (the "License").
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+******************************************************************************/
+
+#ifndef MOLEQUEUE_PENDINGJOBQUEUE_H
+#define MOLEQUEUE_PENDINGJOBQUEUE_H
+
+#include "molequeueglobal.h"
+
+#include <QtCore/QHash>
+#include <QtCore/QList>
+#include <QtCore/QString>
+#include <QtCore/QVector>
+
+class PendingJobQueueTest;
+
+namespace MoleQueue
+{
+
+/**
+ * @class PendingJobQueue pendingjobqueue.h <molequeue/pendingjobqueue.h>
+ * @brief Priority queue of MoleQueue ids awaiting submission.
+ *
+ * Jobs with a higher priority are dequeued first. Jobs of equal priority are
+ * dequeued in submission order, unless fair share is enabled: then the jobs of
+ * each owner (e.g. client) are interleaved, so that a client submitting many
+ * jobs at once cannot starve the others.
+ *
+ * The queue is an indexed binary heap. enqueue(), takeFirst(), take() and
+ * remove() are O(log n), contains() and first() are O(1).
+ */
+class PendingJobQueue
+{
+public:
+  PendingJobQueue();
+
+  /// @param enable If true, interleave the jobs of different owners that have
+  /// the same priority. Only affects jobs enqueued afterwards. Default: false
+  void setFairShare(bool enable) { m_fairShare = enable; }
+
+  /// @return True if the jobs of different owners are interleaved.
+  bool fairShare() const { return m_fairShare; }
+
+  /**
+   * Add the job @a moleQueueId to the queue. Nothing is done if the job is
+   * already queued.
+   * @param priority Jobs with a higher priority are dequeued first.
+   * @param owner Identifies the client that submitted the job. Only used with
+   * fair share.
+   */
+  void enqueue(IdType moleQueueId, int priority = 0,
+               const QString &owner = QString());
+
+  /// @return The MoleQueue id of the next job, or InvalidId if empty.
+  IdType first() const;
+
+  /// Remove the next job from the queue.
+  /// @return The MoleQueue id of the removed job, or InvalidId if empty.
+  IdType takeFirst();
+
+  /// Remove the job @a moleQueueId from the queue because it is started out
+  /// of order, e.g. by backfilling. Unlike remove(), the job is charged to its
+  /// owner's share as if dequeued with takeFirst().
+  /// @return True if the job was queued.
+  bool take(IdType moleQueueId);
+
+  /// Remove the job @a moleQueueId from the queue, e.g. because it was
+  /// cancelled. The job no longer counts against its owner's share.
+  /// @return True if the job was queued.
+  bool remove(IdType moleQueueId);
+
+  /// @return True if the job @a moleQueueId is queued.
+  bool contains(IdType moleQueueId) const
+  {
+    return m_positions.contains(moleQueueId);
+  }
+
+  /// @return The priority of the queued job @a moleQueueId, or 0.
+  int priority(IdType moleQueueId) const;
+
+  /// @return The number of queued jobs.
+  int size() const { return m_heap.size(); }
+
+  /// @return True if no jobs are queued.
+  bool isEmpty() const { return m_heap.isEmpty(); }
+
+  /// Remove all jobs from the queue.
+  void clear();
+
+  /// @return The MoleQueue ids of all queued jobs in the order that they would
+  /// be dequeued. This is O(n log n).
+  QList<IdType> ids() const;
+
+  friend class ::PendingJobQueueTest;
+
+private:
+  struct Entry
+  {
+    IdType moleQueueId;
+    int priority;
+    /// Fair share virtual start time.
+    quint64 tag;
+    /// Submission order.
+    quint64 sequence;
+    /// The owner, if the job was enqueued with fair share.
+    QString owner;
+    /// True if the job is counted in m_owners.
+    bool fairShare;
+  };
+
+  /// Fair share bookkeeping of an owner with queued jobs.
+  struct OwnerShare
+  {
+    /// Next virtual start time for the owner's jobs.
+    quint64 finish;
+    /// Number of the owner's jobs in the queue.
+    int queued;
+  };
+
+  /// @return True if @a a should be dequeued before @a b.
+  static bool lessThan(const Entry &a, const Entry &b);
+
+  /// Move the entry at @a index towards the root / leaves until the heap
+  /// property is restored.
+  void siftUp(int index);
+  void siftDown(int index);
+
+  /// Store @a entry at @a index and update m_positions.
+  void place(int index, const Entry &entry);
+
+  /// Remove the entry at @a index.
+  void removeAt(int index);
+
+  /// Release the owner's share of @a entry, which is leaving the queue.
+  /// @param cancelled True if the job was removed rather than dequeued.
+  void releaseShare(const Entry &entry, bool cancelled);
+
+  QVector<Entry> m_heap;
+  /// MoleQueue id --> index in m_heap.
+  QHash<IdType, int> m_positions;
+  /// Owner --> fair share state. Owners without queued jobs are dropped.
+  QHash<QString, OwnerShare> m_owners;
+  /// Virtual time of the most recently dequeued job.
+  quint64 m_virtualTime;
+  quint64 m_sequence;
+  bool m_fairShare;
+};
+
+} // namespace MoleQueue
+
+#endif // MOLEQUEUE_PENDINGJOBQUEUE_H
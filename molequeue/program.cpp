@@ -23,8 +23,24 @@
 
 #include <QtCore/QDebug>
 #include <QtCore/QFileInfo>
+#include <QtCore/QRegExp>
 #include <QtCore/QSettings>
 
+namespace {
+// Match relativePath against the glob patterns. Patterns without a '/' only
+// need to match the file name.
+bool matchesAny(const QStringList &patterns, const QString &relativePath)
+{
+  const QString fileName = relativePath.mid(relativePath.lastIndexOf('/') + 1);
+  foreach (const QString &pattern, patterns) {
+    QRegExp glob(pattern, Qt::CaseSensitive, QRegExp::Wildcard);
+    if (glob.exactMatch(pattern.contains('/') ? relativePath : fileName))
+      return true;
+  }
+  return false;
+}
+}
+
 namespace MoleQueue {
 
 Program::Program(Queue *parentQueue) :
@@ -40,7 +56,8 @@ Program::Program(Queue *parentQueue) :
   m_inputFilename("job.inp"),
   m_outputFilename("job.out"),
   m_launchSyntax(REDIRECT),
-  m_customLaunchTemplate("")
+  m_customLaunchTemplate(""),
+  m_skipUnchangedOutput(false)
 {
 }
 
@@ -55,7 +72,11 @@ Program::Program(const Program &other)
     m_inputFilename(other.m_inputFilename),
     m_outputFilename(other.m_outputFilename),
     m_launchSyntax(other.m_launchSyntax),
-    m_customLaunchTemplate(other.m_customLaunchTemplate)
+    m_customLaunchTemplate(other.m_customLaunchTemplate),
+    m_outputIncludePatterns(other.m_outputIncludePatterns),
+    m_outputExcludePatterns(other.m_outputExcludePatterns),
+    m_skipUnchangedOutput(other.m_skipUnchangedOutput),
+    m_streamedOutputFiles(other.m_streamedOutputFiles)
 {
 }
 
@@ -75,9 +96,22 @@ Program &Program::operator=(const Program &other)
   m_outputFilename = other.m_outputFilename;
   m_launchSyntax = other.m_launchSyntax;
   m_customLaunchTemplate = other.m_customLaunchTemplate;
+  m_outputIncludePatterns = other.m_outputIncludePatterns;
+  m_outputExcludePatterns = other.m_outputExcludePatterns;
+  m_skipUnchangedOutput = other.m_skipUnchangedOutput;
+  m_streamedOutputFiles = other.m_streamedOutputFiles;
   return *this;
 }
 
+bool Program::isOutputFileIncluded(const QString &relativePath) const
+{
+  if (!m_outputIncludePatterns.isEmpty() &&
+      !matchesAny(m_outputIncludePatterns, relativePath)) {
+    return false;
+  }
+  return !matchesAny(m_outputExcludePatterns, relativePath);
+}
+
 QString Program::queueName() const
 {
   if (m_queue)
@@ -98,6 +132,12 @@ void Program::readSettings(QSettings &settings)
   m_customLaunchTemplate = settings.value("customLaunchTemplate").toString();
   m_launchSyntax         = static_cast<LaunchSyntax>(
         settings.value("launchSyntax").toInt());
+  m_outputIncludePatterns =
+      settings.value("outputIncludePatterns").toStringList();
+  m_outputExcludePatterns =
+      settings.value("outputExcludePatterns").toStringList();
+  m_skipUnchangedOutput  = settings.value("skipUnchangedOutput").toBool();
+  m_streamedOutputFiles  = settings.value("streamedOutputFiles").toStringList();
 }
 
 void Program::writeSettings(QSettings &settings) const
@@ -111,6 +151,10 @@ void Program::writeSettings(QSettings &settings) const
   settings.setValue("outputFilename", m_outputFilename);
   settings.setValue("customLaunchTemplate", m_customLaunchTemplate);
   settings.setValue("launchSyntax", static_cast<int>(m_launchSyntax));
+  settings.setValue("outputIncludePatterns", m_outputIncludePatterns);
+  settings.setValue("outputExcludePatterns", m_outputExcludePatterns);
+  settings.setValue("skipUnchangedOutput", m_skipUnchangedOutput);
+  settings.setValue("streamedOutputFiles", m_streamedOutputFiles);
 }
 
 void Program::importConfiguration(QSettings &importer)
@@ -124,6 +168,12 @@ void Program::importConfiguration(QSettings &importer)
   m_customLaunchTemplate = importer.value("customLaunchTemplate").toString();
   m_launchSyntax         = static_cast<LaunchSyntax>(
         importer.value("launchSyntax").toInt());
+  m_outputIncludePatterns =
+      importer.value("outputIncludePatterns").toStringList();
+  m_outputExcludePatterns =
+      importer.value("outputExcludePatterns").toStringList();
+  m_skipUnchangedOutput  = importer.value("skipUnchangedOutput").toBool();
+  m_streamedOutputFiles  = importer.value("streamedOutputFiles").toStringList();
 }
 
 void Program::exportConfiguration(QSettings &exporter) const
@@ -136,6 +186,10 @@ void Program::exportConfiguration(QSettings &exporter) const
   exporter.setValue("outputFilename", m_outputFilename);
   exporter.setValue("customLaunchTemplate", m_customLaunchTemplate);
   exporter.setValue("launchSyntax", static_cast<int>(m_launchSyntax));
+  exporter.setValue("outputIncludePatterns", m_outputIncludePatterns);
+  exporter.setValue("outputExcludePatterns", m_outputExcludePatterns);
+  exporter.setValue("skipUnchangedOutput", m_skipUnchangedOutput);
+  exporter.setValue("streamedOutputFiles", m_streamedOutputFiles);
 }
 
 QString Program::launchTemplate() const
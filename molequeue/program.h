@@ -22,6 +22,7 @@
 #include <QtCore/QMap>
 #include <QtCore/QMetaType>
 #include <QtCore/QString>
+#include <QtCore/QStringList>
 
 class QSettings;
 
@@ -141,6 +142,58 @@ public:
     return chopExtension(m_outputFilename);
   }
 
+  /**
+   * Set the glob patterns, e.g. "*.out" or "results/*", of the files that are
+   * copied back from the working directory of a remote job. Patterns that
+   * contain a '/' are matched against the path relative to the job directory,
+   * all others against the file name. If empty, all files are copied back
+   * unless excluded. Default: empty
+   */
+  void setOutputIncludePatterns(const QStringList &patterns)
+  {
+    m_outputIncludePatterns = patterns;
+  }
+  QStringList outputIncludePatterns() const {return m_outputIncludePatterns;}
+
+  /// Set the glob patterns, e.g. "*.tmp", of the files in the working
+  /// directory of a remote job that are never copied back. Matched like
+  /// outputIncludePatterns(). Default: empty
+  void setOutputExcludePatterns(const QStringList &patterns)
+  {
+    m_outputExcludePatterns = patterns;
+  }
+  QStringList outputExcludePatterns() const {return m_outputExcludePatterns;}
+
+  /// If true, files of a remote job that are identical to the local copy,
+  /// such as the input files, are not copied back. Default: false
+  void setSkipUnchangedOutput(bool b) {m_skipUnchangedOutput = b;}
+  bool skipUnchangedOutput() const {return m_skipUnchangedOutput;}
+
+  /**
+   * Set the files, relative to the job directory, that are copied back
+   * incrementally while a job runs on a remote queue, e.g. a log file used to
+   * monitor convergence. Clients are notified whenever new output arrives.
+   * If empty, output is only copied back once the job has finished.
+   * Default: empty
+   */
+  void setStreamedOutputFiles(const QStringList &files)
+  {
+    m_streamedOutputFiles = files;
+  }
+  QStringList streamedOutputFiles() const {return m_streamedOutputFiles;}
+
+  /// @return True if only some of the files in the working directory of a
+  /// remote job are copied back.
+  bool hasOutputFilter() const
+  {
+    return m_skipUnchangedOutput || !m_outputIncludePatterns.isEmpty() ||
+        !m_outputExcludePatterns.isEmpty();
+  }
+
+  /// @return True if the file at @a relativePath in the working directory of
+  /// a job matches the include and exclude patterns.
+  bool isOutputFileIncluded(const QString &relativePath) const;
+
   void setLaunchSyntax(LaunchSyntax s)
   {
     if (s >= SYNTAX_COUNT)
@@ -201,6 +254,14 @@ protected:
   LaunchSyntax m_launchSyntax;
   /// Bash/Shell/Queue script template used to launch program
   QString m_customLaunchTemplate;
+  /// Glob patterns of the output files to copy back from remote queues
+  QStringList m_outputIncludePatterns;
+  /// Glob patterns of the output files to leave on remote queues
+  QStringList m_outputExcludePatterns;
+  /// Toggle skipping of unchanged files when copying back from remote queues
+  bool m_skipUnchangedOutput;
+  /// Files copied back from remote queues while the job runs
+  QStringList m_streamedOutputFiles;
 
 };
 
@@ -79,6 +79,14 @@ ProgramConfigureDialog::ProgramConfigureDialog(Program *program,
           this, SLOT(setDirty()));
   connect(ui->edit_outputFilename, SIGNAL(textChanged(QString)),
           this, SLOT(setDirty()));
+  connect(ui->edit_outputInclude, SIGNAL(textChanged(QString)),
+          this, SLOT(setDirty()));
+  connect(ui->edit_outputExclude, SIGNAL(textChanged(QString)),
+          this, SLOT(setDirty()));
+  connect(ui->cb_skipUnchangedOutput, SIGNAL(toggled(bool)),
+          this, SLOT(setDirty()));
+  connect(ui->edit_streamedOutput, SIGNAL(textChanged(QString)),
+          this, SLOT(setDirty()));
   connect(ui->gb_executablePath, SIGNAL(toggled(bool)),
           this, SLOT(setDirty()));
   connect(ui->combo_syntax, SIGNAL(currentIndexChanged(int)),
@@ -158,6 +166,12 @@ void ProgramConfigureDialog::updateGuiFromProgram()
   ui->edit_arguments->setText(m_program->arguments());
   ui->edit_inputFilename->setText(m_program->inputFilename());
   ui->edit_outputFilename->setText(m_program->outputFilename());
+  ui->edit_outputInclude->setText(
+        m_program->outputIncludePatterns().join(" "));
+  ui->edit_outputExclude->setText(
+        m_program->outputExcludePatterns().join(" "));
+  ui->cb_skipUnchangedOutput->setChecked(m_program->skipUnchangedOutput());
+  ui->edit_streamedOutput->setText(m_program->streamedOutputFiles().join(" "));
 
 
   Program::LaunchSyntax syntax = m_program->launchSyntax();
@@ -179,6 +193,13 @@ void ProgramConfigureDialog::updateProgramFromGui()
   m_program->setArguments(ui->edit_arguments->text());
   m_program->setInputFilename(ui->edit_inputFilename->text());
   m_program->setOutputFilename(ui->edit_outputFilename->text());
+  m_program->setOutputIncludePatterns(
+        ui->edit_outputInclude->text().split(' ', QString::SkipEmptyParts));
+  m_program->setOutputExcludePatterns(
+        ui->edit_outputExclude->text().split(' ', QString::SkipEmptyParts));
+  m_program->setSkipUnchangedOutput(ui->cb_skipUnchangedOutput->isChecked());
+  m_program->setStreamedOutputFiles(
+        ui->edit_streamedOutput->text().split(' ', QString::SkipEmptyParts));
 
   Program::LaunchSyntax syntax = static_cast<Program::LaunchSyntax>(
         ui->combo_syntax->currentIndex());
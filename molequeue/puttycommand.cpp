@@ -30,6 +30,9 @@ PuttyCommand::~PuttyCommand()
 QStringList PuttyCommand::sshArgs()
 {
   QStringList args;
+  // Share a single connection between plink sessions (PuTTY 0.64+).
+  if (m_persistent)
+    args << "-share";
   if (!m_identityFile.isEmpty())
     args << "-i" << m_identityFile;
   if (m_portNumber >= 0 && m_portNumber != 22)
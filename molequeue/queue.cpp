@@ -36,7 +36,8 @@ namespace MoleQueue {
 Queue::Queue(const QString &queueName, QueueManager *parentManager) :
   QObject(parentManager), m_queueManager(parentManager),
   m_server((m_queueManager) ? m_queueManager->server() : NULL),
-  m_name(queueName)
+  m_name(queueName),
+  m_fairShare(false)
 {
   qRegisterMetaType<Program*>("MoleQueue::Program*");
   qRegisterMetaType<const Program*>("const MoleQueue::Program*");
@@ -61,6 +62,7 @@ void Queue::readSettings(QSettings &settings)
 {
   m_launchTemplate = settings.value("launchTemplate").toString();
   m_launchScriptName = settings.value("launchScriptName").toString();
+  setFairShare(settings.value("fairShare", false).toBool());
 
   int jobIdMapSize = settings.beginReadArray("JobIdMap");
   for (int i = 0; i < jobIdMapSize; ++i) {
@@ -97,6 +99,7 @@ void Queue::writeSettings(QSettings &settings) const
 {
   settings.setValue("launchTemplate", m_launchTemplate);
   settings.setValue("launchScriptName", m_launchScriptName);
+  settings.setValue("fairShare", m_fairShare);
 
   QList<IdType> keys = m_jobs.keys();
   settings.beginWriteArray("JobIdMap", keys.size());
@@ -122,6 +125,7 @@ void Queue::exportConfiguration(QSettings &exporter, bool includePrograms) const
   exporter.setValue("type", typeName());
   exporter.setValue("launchTemplate", m_launchTemplate);
   exporter.setValue("launchScriptName", m_launchScriptName);
+  exporter.setValue("fairShare", m_fairShare);
 
   if (includePrograms) {
     exporter.setValue("programs", programNames());
@@ -139,6 +143,8 @@ void Queue::importConfiguration(QSettings &importer, bool includePrograms)
 {
   m_launchTemplate = importer.value("launchTemplate").toString();
   m_launchScriptName = importer.value("launchScriptName").toString();
+  if (importer.contains("fairShare"))
+    setFairShare(importer.value("fairShare").toBool());
 
   if (includePrograms) {
     QStringList progNames = importer.value("programs").toStringList();
@@ -165,6 +171,13 @@ void Queue::importConfiguration(QSettings &importer, bool includePrograms)
   }
 }
 
+QString Queue::jobOwner(const Job &job) const
+{
+  if (!m_fairShare || !m_server)
+    return QString();
+  return m_server->clientIdentifier(job.moleQueueId());
+}
+
 AbstractQueueSettingsWidget* Queue::settingsWidget()
 {
   return NULL;
@@ -200,6 +200,15 @@ public:
    */
   QString launchScriptName() const { return m_launchScriptName; }
 
+  /**
+   * @param enable If true, pending jobs of the same priority are taken from
+   * each client in turn, rather than in submission order. Default: false
+   */
+  virtual void setFairShare(bool enable) { m_fairShare = enable; }
+
+  /// @return True if pending jobs are shared fairly between clients.
+  bool fairShare() const { return m_fairShare; }
+
   /**
    * @param moleQueueId MoleQueue id of Job of interest.
    * @return The number of time the job has failed if it has encountered an
@@ -211,6 +220,12 @@ public:
     return m_failureTracker.value(moleQueueId, 0);
   }
 
+  /**
+   * @return The runtime state of the queue for monitoring, e.g. through the
+   * listQueues JSON-RPC request. Empty if the queue has nothing to report.
+   */
+  virtual QVariantHash status() const { return QVariantHash(); }
+
   /**
    * @brief replaceLaunchScriptKeywords Replace $$keywords$$ in @a launchScript
    * with queue/job specific values.
@@ -327,6 +342,10 @@ protected:
     m_failureTracker.remove(moleQueueId);
   }
 
+  /// @return The owner of @a job for fair sharing pending jobs, or an empty
+  /// string if fair share is disabled.
+  QString jobOwner(const Job &job) const;
+
   QueueManager *m_queueManager;
   Server *m_server;
 
@@ -334,6 +353,7 @@ protected:
   QString m_launchTemplate;
   QString m_launchScriptName;
   QMap<QString, Program *> m_programs;
+  bool m_fairShare;
   /// Lookup table for jobs that are using this Queue. Maps JobId to MoleQueueId.
   QMap<IdType, IdType> m_jobs;
   /// Keeps track of the number of times a job has failed (MoleQueueId to
@@ -150,6 +150,24 @@ QueueListType QueueManager::toQueueList() const
   return queueList;
 }
 
+QVariantHash QueueManager::toQueueStatus() const
+{
+  QVariantHash queueStatus;
+  foreach(const Queue *queue, m_queues) {
+    const QVariantHash status = queue->status();
+    if (!status.isEmpty())
+      queueStatus.insert(queue->name(), status);
+  }
+
+  return queueStatus;
+}
+
+CircuitBreaker &QueueManager::hostCircuitBreaker(const QString &hostName,
+                                                 int port)
+{
+  return m_hostCircuitBreakers[QString("%1:%2").arg(hostName).arg(port)];
+}
+
 void QueueManager::updateRemoteQueues() const
 {
   foreach (Queue *queue, m_queues) {
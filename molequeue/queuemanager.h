@@ -20,8 +20,11 @@
 #include <QtCore/QObject>
 
 #include "molequeueglobal.h"
+#include "queues/circuitbreaker.h"
 
+#include <QtCore/QHash>
 #include <QtCore/QMap>
+#include <QtCore/QVariantHash>
 
 class QSettings;
 
@@ -131,6 +134,19 @@ public:
    */
   QueueListType toQueueList() const;
 
+  /**
+   * @return The Queue::status() of each queue that reports one, keyed by
+   * queue name.
+   */
+  QVariantHash toQueueStatus() const;
+
+  /**
+   * @return The circuit breaker guarding connections to @a hostName on
+   * @a port. The queues of this manager that use the same host share it, so
+   * that they back off together. A new breaker is created on first use.
+   */
+  CircuitBreaker &hostCircuitBreaker(const QString &hostName, int port);
+
 public slots:
   /**
    * @brief updateRemoteQueues Request that all remote queues update the status
@@ -155,6 +171,7 @@ signals:
 
 protected:
   QMap<QString, Queue*> m_queues;
+  QHash<QString, CircuitBreaker> m_hostCircuitBreakers;
   Server *m_server;
 };
 
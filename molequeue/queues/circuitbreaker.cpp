@@ -0,0 +1,103 @@
+/******************************************************************************
+
+  This source file is part of the MoleQueue project.
+
+  Copyright 2012 Kitware, Inc.
+
+  This source code is released under the New BSD License, (the "License").
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+******************************************************************************/
+
+#include "circuitbreaker.h"
+
+#include <QtCore/QTime>
+
+namespace MoleQueue
+{
+
+CircuitBreaker::CircuitBreaker(int failureThreshold, int baseDelay,
+                               int maxDelay)
+  : m_state(Closed),
+    m_consecutiveFailures(0),
+    m_failureThreshold(failureThreshold),
+    m_baseDelay(baseDelay),
+    m_maxDelay(maxDelay)
+{
+  m_randomState = static_cast<quint32>(QDateTime::currentDateTime().toTime_t())
+      ^ static_cast<quint32>(QTime::currentTime().msec() << 16)
+      ^ static_cast<quint32>(reinterpret_cast<quintptr>(this));
+  if (m_randomState == 0)
+    m_randomState = 1;
+}
+
+bool CircuitBreaker::allowsRequests(const QDateTime &now) const
+{
+  return m_state == Closed && (!m_retryTime.isValid() || now >= m_retryTime);
+}
+
+bool CircuitBreaker::allowsProbe(const QDateTime &now) const
+{
+  return m_state == Open && (!m_retryTime.isValid() || now >= m_retryTime);
+}
+
+void CircuitBreaker::recordSuccess()
+{
+  m_state = Closed;
+  m_consecutiveFailures = 0;
+  m_retryTime = QDateTime();
+}
+
+void CircuitBreaker::recordFailure(const QDateTime &now)
+{
+  ++m_consecutiveFailures;
+  if (m_state == HalfOpen || m_consecutiveFailures >= m_failureThreshold)
+    m_state = Open;
+
+  m_retryTime = now.addSecs(backoffDelay(m_consecutiveFailures));
+}
+
+QVariantHash CircuitBreaker::toHash() const
+{
+  QVariantHash hash;
+  hash.insert("state", stateToString(m_state));
+  hash.insert("consecutiveFailures", m_consecutiveFailures);
+  hash.insert("retryTime", m_retryTime.isValid()
+              ? m_retryTime.toString(Qt::ISODate) : QString());
+  return hash;
+}
+
+QString CircuitBreaker::stateToString(State state)
+{
+  switch (state) {
+  case Closed:
+    return "closed";
+  case Open:
+    return "open";
+  case HalfOpen:
+    return "half-open";
+  }
+  return QString();
+}
+
+int CircuitBreaker::backoffDelay(int failures)
+{
+  int delay = m_maxDelay;
+  if (failures < 16)
+    delay = qMin(m_maxDelay, m_baseDelay << qMax(0, failures - 1));
+
+  // xorshift32
+  m_randomState ^= m_randomState << 13;
+  m_randomState ^= m_randomState >> 17;
+  m_randomState ^= m_randomState << 5;
+
+  const int half = delay / 2;
+  return delay - half + static_cast<int>(m_randomState % (half + 1));
+}
+
+} // End namespace
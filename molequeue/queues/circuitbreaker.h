@@ -0,0 +1,130 @@
+/******************************************************************************
+
+  This source file is part of the MoleQueue project.
+
+  Copyright 2012 Kitware, Inc.
+
+  This source code is released under the New BSD License, (the "License").
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+******************************************************************************/
+
+#ifndef CIRCUITBREAKER_H
+#define CIRCUITBREAKER_H
+
+#include <QtCore/QDateTime>
+#include <QtCore/QString>
+#include <QtCore/QVariantHash>
+
+class CircuitBreakerTest;
+
+namespace MoleQueue
+{
+
+/**
+ * @class CircuitBreaker circuitbreaker.h
+ * <molequeue/queues/circuitbreaker.h>
+ * @brief Tracks connection failures to a remote host and decides when the host
+ * may be contacted again.
+ *
+ * After each connection failure, requests are held back for a backoff delay
+ * that doubles with every consecutive failure, up to maxDelay(). The delay is
+ * jittered so that clients of the same host do not retry in lockstep.
+ *
+ * After failureThreshold() consecutive failures the breaker opens: no requests
+ * are sent until the backoff delay has passed and a single probe has reached
+ * the host. A successful probe closes the breaker again; a failed one keeps it
+ * open for a longer delay.
+ */
+class CircuitBreaker
+{
+public:
+  enum State {
+    /// Requests may be sent, possibly after a backoff delay.
+    Closed = 0,
+    /// The host is considered down. Only probes are sent.
+    Open,
+    /// A probe is in progress.
+    HalfOpen
+  };
+
+  /**
+   * @param failureThreshold Number of consecutive failures that open the
+   * breaker.
+   * @param baseDelay Backoff delay after the first failure in seconds.
+   * @param maxDelay Longest backoff delay in seconds.
+   */
+  CircuitBreaker(int failureThreshold = 5, int baseDelay = 5,
+                 int maxDelay = 600);
+
+  void setFailureThreshold(int threshold) { m_failureThreshold = threshold; }
+  int failureThreshold() const { return m_failureThreshold; }
+
+  void setBaseDelay(int seconds) { m_baseDelay = seconds; }
+  int baseDelay() const { return m_baseDelay; }
+
+  void setMaxDelay(int seconds) { m_maxDelay = seconds; }
+  int maxDelay() const { return m_maxDelay; }
+
+  State state() const { return m_state; }
+
+  /// @return The number of connection failures since the last success.
+  int consecutiveFailures() const { return m_consecutiveFailures; }
+
+  /// @return The earliest time of the next request or probe. Invalid if there
+  /// is no backoff delay.
+  QDateTime retryTime() const { return m_retryTime; }
+
+  /// @return True if requests may be sent at @a now.
+  bool allowsRequests(const QDateTime &now) const;
+
+  /// @return True if the breaker is open and a probe may be sent at @a now.
+  bool allowsProbe(const QDateTime &now) const;
+
+  /// Call when a probe is sent.
+  void probeStarted() { m_state = HalfOpen; }
+
+  /// Call when a request or probe reached the host.
+  void recordSuccess();
+
+  /// Call when a request or probe could not reach the host at @a now.
+  void recordFailure(const QDateTime &now);
+
+  /**
+   * @return The state for monitoring: "state" ("closed", "open" or
+   * "half-open"), "consecutiveFailures" and "retryTime" (ISO 8601, or an
+   * empty string if there is no backoff delay).
+   */
+  QVariantHash toHash() const;
+
+  /// @return @a state as a string, e.g. "half-open".
+  static QString stateToString(State state);
+
+private:
+  /// @return A jittered backoff delay in seconds for @a failures consecutive
+  /// failures, between half and all of the exponential delay.
+  int backoffDelay(int failures);
+
+  State m_state;
+  int m_consecutiveFailures;
+  QDateTime m_retryTime;
+
+  int m_failureThreshold;
+  int m_baseDelay;
+  int m_maxDelay;
+
+  /// State of the random number generator for the jitter, seeded per
+  /// breaker so that separate servers do not share a sequence.
+  quint32 m_randomState;
+
+  friend class ::CircuitBreakerTest;
+};
+
+} // End namespace
+
+#endif // CIRCUITBREAKER_H
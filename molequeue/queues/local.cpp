@@ -17,6 +17,7 @@
 #include "local.h"
 
 #include "../job.h"
+#include "../jobdata.h"
 #include "../jobmanager.h"
 #include "../localqueuewidget.h"
 #include "../logentry.h"
@@ -31,6 +32,7 @@
 
 #include <QtCore/QDir>
 #include <QtCore/QFile>
+#include <QtCore/QPair>
 #include <QtCore/QProcess>
 #include <QtCore/QSettings>
 #include <QtCore/QTimerEvent>
@@ -45,11 +47,51 @@
 #include <Windows.h> // For _PROCESS_INFORMATION (PID parsing)
 #endif
 
+namespace {
+// Milliseconds between checks for free memory while jobs are waiting for it.
+const int memoryRetryInterval = 5000;
+
+// Resources released when a job finishes, for backfill reservations.
+struct JobEnd
+{
+  JobEnd(qint64 time_, int cores_, qint64 memory_)
+    : time(time_), cores(cores_), memory(memory_) {}
+  bool operator<(const JobEnd &other) const
+  {
+    if (time != other.time)
+      return time < other.time;
+    if (cores != other.cores)
+      return cores < other.cores;
+    return memory < other.memory;
+  }
+  qint64 time;
+  int cores;
+  qint64 memory;
+};
+
+QByteArray readMemInfo()
+{
+  QFile memInfo("/proc/meminfo");
+  if (!memInfo.open(QIODevice::ReadOnly))
+    return QByteArray();
+  return memInfo.readAll();
+}
+}
+
 namespace MoleQueue {
 
 QueueLocal::QueueLocal(QueueManager *parentManager) :
   Queue("Local", parentManager),
   m_checkJobLimitTimerId(-1),
+  m_memoryRetryTimerId(-1),
+  m_coresInUse(0),
+  m_memoryInUse(0),
+  m_maxMemory(-1),
+  m_pinJobsToCpus(false),
+  m_schedulingPolicy(FifoScheduling),
+  m_lastQueueLatency(-1),
+  m_totalQueueLatency(0),
+  m_dispatchedJobCount(0),
   m_cores(-1)
 {
 #ifdef WIN32
@@ -60,8 +102,7 @@ QueueLocal::QueueLocal(QueueManager *parentManager) :
   m_launchScriptName = "MoleQueueLauncher.sh";
 #endif // WIN32
 
-  // Check if new jobs need starting every 10 seconds
-  m_checkJobLimitTimerId = startTimer(10000);
+  m_queueClock.start();
 }
 
 QueueLocal::~QueueLocal()
@@ -77,31 +118,47 @@ void QueueLocal::readSettings(QSettings &settings)
   if(m_cores == -1){
     m_cores = QThread::idealThreadCount();
   }
+  m_schedulingPolicy = static_cast<SchedulingPolicy>(
+        settings.value("schedulingPolicy", FifoScheduling).toInt());
+  m_maxMemory = settings.value("maxMemory", -1).toLongLong();
+  m_pinJobsToCpus = settings.value("pinJobsToCpus", false).toBool();
 
+  // The clients that submitted the jobs are gone, so they are all requeued
+  // with the same owner.
   int numPendingJobs = settings.beginReadArray("PendingJobs");
-  m_pendingJobQueue.reserve(numPendingJobs);
   for (int i = 0; i < numPendingJobs; ++i) {
     settings.setArrayIndex(i);
     IdType mqId = settings.value("moleQueueId", 0).value<IdType>();
     if (mqId == 0)
       continue;
-    m_pendingJobQueue.append(mqId);
+    m_pendingJobQueue.enqueue(mqId, settings.value("priority", 0).toInt());
   }
   settings.endArray(); // "PendingJobs"
+
+  // The jobs are loaded after the queues, so wait for the event loop.
+  if (!m_pendingJobQueue.isEmpty())
+    scheduleJobQueueCheck();
 }
 
 void QueueLocal::writeSettings(QSettings &settings) const
 {
   Queue::writeSettings(settings);
   settings.setValue("cores", m_cores);
+  settings.setValue("schedulingPolicy", static_cast<int>(m_schedulingPolicy));
+  settings.setValue("maxMemory", m_maxMemory);
+  settings.setValue("pinJobsToCpus", m_pinJobsToCpus);
 
+  // Interrupted jobs are resumed first.
   QList<IdType> jobsToResume;
   jobsToResume.append(m_runningJobs.keys());
-  jobsToResume.append(m_pendingJobQueue);
+  jobsToResume.append(m_pendingJobQueue.ids());
   settings.beginWriteArray("PendingJobs", jobsToResume.size());
   for (int i = 0; i < jobsToResume.size(); ++i) {
     settings.setArrayIndex(i);
     settings.setValue("moleQueueId", jobsToResume.at(i));
+    const int priority = m_pendingJobQueue.priority(jobsToResume.at(i));
+    if (priority != 0)
+      settings.setValue("priority", priority);
   }
   settings.endArray(); // "PendingJobs"
 }
@@ -111,13 +168,24 @@ void QueueLocal::exportConfiguration(QSettings &exporter,
 {
   Queue::exportConfiguration(exporter, includePrograms);
   exporter.setValue("cores", m_cores);
+  exporter.setValue("schedulingPolicy", static_cast<int>(m_schedulingPolicy));
+  exporter.setValue("maxMemory", m_maxMemory);
+  exporter.setValue("pinJobsToCpus", m_pinJobsToCpus);
 }
 
 void QueueLocal::importConfiguration(QSettings &importer, bool includePrograms)
 {
   Queue::importConfiguration(importer, includePrograms);
   if (importer.contains("cores"))
-    m_cores = importer.value("cores").toInt();
+    setMaxNumberOfCores(importer.value("cores").toInt());
+  if (importer.contains("schedulingPolicy")) {
+    setSchedulingPolicy(static_cast<SchedulingPolicy>(
+                          importer.value("schedulingPolicy").toInt()));
+  }
+  if (importer.contains("maxMemory"))
+    setMaxMemory(importer.value("maxMemory").toLongLong());
+  if (importer.contains("pinJobsToCpus"))
+    setPinJobsToCpus(importer.value("pinJobsToCpus").toBool());
 }
 
 AbstractQueueSettingsWidget *QueueLocal::settingsWidget()
@@ -140,14 +208,13 @@ void QueueLocal::killJob(Job job)
   if (!job.isValid())
     return;
 
-  int pendingIndex = m_pendingJobQueue.indexOf(job.moleQueueId());
-  if (pendingIndex >= 0) {
-    m_pendingJobQueue.removeAt(pendingIndex);
+  if (m_pendingJobQueue.remove(job.moleQueueId())) {
+    m_pendingSince.remove(job.moleQueueId());
     job.setJobState(MoleQueue::Killed);
     return;
   }
 
-  QProcess *process = m_runningJobs.take(job.moleQueueId());
+  QProcess *process = takeRunningJob(job.moleQueueId());
   if (process != NULL) {
     m_jobs.remove(job.queueId());
     process->disconnect(this);
@@ -220,7 +287,7 @@ void QueueLocal::processFinished(int exitCode, QProcess::ExitStatus exitStatus)
     return;
 
   // Remove and delete QProcess from queue
-  m_runningJobs.take(moleQueueId)->deleteLater();
+  takeRunningJob(moleQueueId)->deleteLater();
 
   // Get pointer to jobmanager to lookup job
   if (!m_server) {
@@ -259,13 +326,267 @@ int QueueLocal::maxNumberOfCores() const
     return QThread::idealThreadCount();
 }
 
+void QueueLocal::setMaxNumberOfCores(int cores)
+{
+  m_cores = cores;
+  // More cores may be available now.
+  scheduleJobQueueCheck();
+}
+
+void QueueLocal::setSchedulingPolicy(SchedulingPolicy policy)
+{
+  m_schedulingPolicy = policy;
+  scheduleJobQueueCheck();
+}
+
+void QueueLocal::setMaxMemory(qint64 memory)
+{
+  m_maxMemory = memory;
+  scheduleJobQueueCheck();
+}
+
+void QueueLocal::setFairShare(bool enable)
+{
+  Queue::setFairShare(enable);
+  m_pendingJobQueue.setFairShare(enable);
+}
+
+QList<int> QueueLocal::selectJobsToStart(const QList<PendingJobInfo> &pending,
+                                         const QList<RunningJobInfo> &running,
+                                         int totalCores, qint64 now,
+                                         SchedulingPolicy policy,
+                                         qint64 totalMemory,
+                                         bool *waitingForMemory)
+{
+  if (waitingForMemory)
+    *waitingForMemory = false;
+
+  // Without a memory limit, pretend that there is always enough.
+  const bool limitMemory = totalMemory >= 0;
+  QList<int> selected;
+  int freeCores = totalCores;
+  qint64 freeMemory = totalMemory;
+  foreach (const RunningJobInfo &job, running) {
+    freeCores -= job.cores;
+    freeMemory -= job.memory;
+  }
+
+  // Start jobs in order until we hit one we can't afford to start.
+  int head = 0;
+  for (; head < pending.size(); ++head) {
+    const PendingJobInfo &job = pending.at(head);
+    if (job.cores > freeCores || (limitMemory && job.memory > freeMemory)) {
+      if (waitingForMemory && job.cores <= freeCores)
+        *waitingForMemory = true;
+      break;
+    }
+    freeCores -= job.cores;
+    freeMemory -= job.memory;
+    selected.append(head);
+  }
+
+  if (policy != BackfillScheduling || head >= pending.size() || freeCores <= 0)
+    return selected;
+
+  // Reserve resources for the head job at the earliest time that enough are
+  // known to be free, assuming that jobs run for their full wall time. If that
+  // time is unknown, backfilling might delay the head job indefinitely.
+  QList<JobEnd> jobEnds;
+  foreach (const RunningJobInfo &job, running) {
+    if (job.expectedEnd >= 0)
+      jobEnds.append(JobEnd(qMax(job.expectedEnd, now), job.cores, job.memory));
+  }
+  foreach (int index, selected) {
+    const PendingJobInfo &job = pending.at(index);
+    if (job.wallTime > 0)
+      jobEnds.append(JobEnd(now + job.wallTime, job.cores, job.memory));
+  }
+  qSort(jobEnds);
+
+  const PendingJobInfo &headJob = pending.at(head);
+  qint64 reservationTime = -1;
+  // Resources that are free at reservationTime but not needed by the head job.
+  int extraCores = 0;
+  qint64 extraMemory = 0;
+  int coresAtTime = freeCores;
+  qint64 memoryAtTime = freeMemory;
+  for (int i = 0; i < jobEnds.size(); ++i) {
+    coresAtTime += jobEnds.at(i).cores;
+    memoryAtTime += jobEnds.at(i).memory;
+    if (coresAtTime >= headJob.cores &&
+        (!limitMemory || memoryAtTime >= headJob.memory)) {
+      reservationTime = jobEnds.at(i).time;
+      extraCores = coresAtTime - headJob.cores;
+      extraMemory = memoryAtTime - headJob.memory;
+      break;
+    }
+  }
+  if (reservationTime < 0)
+    return selected;
+
+  // Start later jobs that either finish before the reservation, or only use
+  // resources that the head job does not need.
+  for (int i = head + 1; i < pending.size() && freeCores > 0; ++i) {
+    const PendingJobInfo &job = pending.at(i);
+    if (job.cores > freeCores || (limitMemory && job.memory > freeMemory)) {
+      if (waitingForMemory && job.cores <= freeCores)
+        *waitingForMemory = true;
+      continue;
+    }
+
+    const bool endsBeforeReservation =
+        job.wallTime > 0 && now + job.wallTime <= reservationTime;
+    if (!endsBeforeReservation) {
+      if (job.cores > extraCores || (limitMemory && job.memory > extraMemory))
+        continue;
+      extraCores -= job.cores;
+      extraMemory -= job.memory;
+    }
+
+    freeCores -= job.cores;
+    freeMemory -= job.memory;
+    selected.append(i);
+  }
+
+  return selected;
+}
+
+qint64 QueueLocal::parseMemInfo(const QByteArray &memInfo, const char *field)
+{
+  // Lines look like "MemAvailable:   12345678 kB"
+  const QByteArray key = QByteArray(field) + ':';
+  int pos = 0;
+  while (pos < memInfo.size()) {
+    int lineEnd = memInfo.indexOf('\n', pos);
+    if (lineEnd < 0)
+      lineEnd = memInfo.size();
+    if (memInfo.mid(pos, key.size()) == key) {
+      QList<QByteArray> tokens =
+          memInfo.mid(pos + key.size(), lineEnd - pos - key.size())
+          .simplified().split(' ');
+      bool ok = false;
+      qint64 value = tokens.value(0).toLongLong(&ok);
+      if (!ok)
+        return -1;
+      if (tokens.value(1) == "kB")
+        value /= 1024;
+      return value;
+    }
+    pos = lineEnd + 1;
+  }
+  return -1;
+}
+
+qint64 QueueLocal::systemMemory(const char *field)
+{
+  return parseMemInfo(readMemInfo(), field);
+}
+
+QList<int> QueueLocal::parseCpuList(const QString &cpuList)
+{
+  QList<int> cpus;
+  foreach (const QString &range,
+           cpuList.trimmed().split(',', QString::SkipEmptyParts)) {
+    const int dash = range.indexOf('-');
+    bool firstOk = false;
+    bool lastOk = false;
+    const int first = range.left(dash < 0 ? range.size() : dash)
+        .toInt(&firstOk);
+    const int last = dash < 0 ? first : range.mid(dash + 1).toInt(&lastOk);
+    if (!firstOk || (dash >= 0 && !lastOk))
+      continue;
+    for (int cpu = first; cpu <= last; ++cpu)
+      cpus.append(cpu);
+  }
+  return cpus;
+}
+
+QList<QList<int> > QueueLocal::cpuTopology()
+{
+  QList<QList<int> > nodes;
+#ifdef Q_OS_LINUX
+  QDir nodeDir("/sys/devices/system/node");
+  foreach (const QString &node,
+           nodeDir.entryList(QStringList() << "node*", QDir::Dirs)) {
+    QFile cpuListFile(nodeDir.absoluteFilePath(node + "/cpulist"));
+    if (!cpuListFile.open(QIODevice::ReadOnly))
+      continue;
+    const QList<int> cpus = parseCpuList(QString(cpuListFile.readAll()));
+    if (!cpus.isEmpty())
+      nodes.append(cpus);
+  }
+#endif // Q_OS_LINUX
+
+  if (nodes.isEmpty()) {
+    QList<int> cpus;
+    for (int cpu = 0; cpu < QThread::idealThreadCount(); ++cpu)
+      cpus.append(cpu);
+    nodes.append(cpus);
+  }
+  return nodes;
+}
+
+QList<int> QueueLocal::allocateCpus(const QList<QList<int> > &nodes,
+                                    const QSet<int> &inUse, int count)
+{
+  QList<QList<int> > freeCpus;
+  int totalFree = 0;
+  foreach (const QList<int> &node, nodes) {
+    QList<int> cpus;
+    foreach (int cpu, node) {
+      if (!inUse.contains(cpu))
+        cpus.append(cpu);
+    }
+    totalFree += cpus.size();
+    freeCpus.append(cpus);
+  }
+  if (count <= 0 || count > totalFree)
+    return QList<int>();
+
+  // Best fit within a single node.
+  int bestNode = -1;
+  for (int i = 0; i < freeCpus.size(); ++i) {
+    const int size = freeCpus.at(i).size();
+    if (size >= count && (bestNode < 0 || size < freeCpus.at(bestNode).size()))
+      bestNode = i;
+  }
+  if (bestNode >= 0)
+    return freeCpus.at(bestNode).mid(0, count);
+
+  // Otherwise span as few nodes as possible.
+  QList<QPair<int, int> > nodesBySize;
+  for (int i = 0; i < freeCpus.size(); ++i)
+    nodesBySize.append(qMakePair(-freeCpus.at(i).size(), i));
+  qSort(nodesBySize);
+
+  QList<int> cpus;
+  for (int i = 0; i < nodesBySize.size() && cpus.size() < count; ++i) {
+    cpus.append(freeCpus.at(nodesBySize.at(i).second)
+                .mid(0, count - cpus.size()));
+  }
+  return cpus;
+}
+
 
 bool QueueLocal::addJobToQueue(const Job &job)
 {
-  m_pendingJobQueue.append(job.moleQueueId());
+  const qint64 memoryLimit = m_maxMemory >= 0 ? m_maxMemory
+                                              : systemMemory("MemTotal");
+  if (memoryLimit >= 0 && job.maxMemory() > memoryLimit) {
+    Logger::logError(tr("Job requires %1 MB of memory, but queue '%2' only "
+                        "has %3 MB.").arg(job.maxMemory()).arg(m_name)
+                     .arg(memoryLimit), job.moleQueueId());
+    Job(job).setJobState(MoleQueue::Error);
+    return false;
+  }
+
+  m_pendingJobQueue.enqueue(job.moleQueueId(), job.priority(), jobOwner(job));
+  m_pendingSince.insert(job.moleQueueId(), m_queueClock.elapsed());
 
   Job(job).setJobState(MoleQueue::LocalQueued);
 
+  scheduleJobQueueCheck();
+
   return true;
 }
 
@@ -281,34 +602,122 @@ void QueueLocal::connectProcess(QProcess *proc)
 
 void QueueLocal::checkJobQueue()
 {
-  int coresInUse = 0;
-  foreach(IdType moleQueueId, m_runningJobs.keys()) {
-    const Job job = m_server->jobManager()->lookupJobByMoleQueueId(moleQueueId);
-    if (job.isValid())
-      coresInUse += job.numberOfCores();
+  if (!m_server)
+    return;
+
+  const int freeCores = maxNumberOfCores() - m_coresInUse;
+  if (freeCores <= 0 || m_pendingJobQueue.isEmpty())
+    return;
+
+  // The memory that jobs may reserve is limited both by the queue and by what
+  // the system has available, as other processes use memory too.
+  const QByteArray memInfo = readMemInfo();
+  qint64 totalMemory = m_maxMemory >= 0
+      ? m_maxMemory : parseMemInfo(memInfo, "MemTotal");
+  qint64 systemFree = parseMemInfo(memInfo, "MemAvailable");
+  if (systemFree < 0)
+    systemFree = parseMemInfo(memInfo, "MemFree");
+  if (systemFree >= 0) {
+    totalMemory = totalMemory >= 0
+        ? qMin(totalMemory, m_memoryInUse + systemFree)
+        : m_memoryInUse + systemFree;
   }
 
-  int totalCores = maxNumberOfCores();
-  int coresAvailable = totalCores - coresInUse;
+  JobManager *jobManager = m_server->jobManager();
+  QList<IdType> startIds;
+  bool waitingForMemory = false;
+
+  if (m_schedulingPolicy == FifoScheduling) {
+    // Start jobs from the head of the queue until one does not fit.
+    int coresLeft = freeCores;
+    qint64 memoryLeft = totalMemory - m_memoryInUse;
+    while (!m_pendingJobQueue.isEmpty()) {
+      const IdType moleQueueId = m_pendingJobQueue.first();
+      const Job job = jobManager->lookupJobByMoleQueueId(moleQueueId);
+      if (job.isValid()) {
+        const qint64 memory = qMax(job.maxMemory(), 0);
+        if (job.numberOfCores() > coresLeft ||
+            (totalMemory >= 0 && memory > memoryLeft)) {
+          waitingForMemory = job.numberOfCores() <= coresLeft;
+          break;
+        }
+        coresLeft -= job.numberOfCores();
+        memoryLeft -= memory;
+        startIds.append(moleQueueId);
+      }
+      else {
+        m_pendingSince.remove(moleQueueId);
+      }
+      m_pendingJobQueue.takeFirst();
+    }
+  }
+  else {
+    // Collect the resources of all pending jobs in scheduling order.
+    QList<IdType> queuedIds;
+    QList<PendingJobInfo> pending;
+    foreach (IdType moleQueueId, m_pendingJobQueue.ids()) {
+      const Job job = jobManager->lookupJobByMoleQueueId(moleQueueId);
+      if (!job.isValid()) {
+        m_pendingJobQueue.remove(moleQueueId);
+        m_pendingSince.remove(moleQueueId);
+        continue;
+      }
+
+      PendingJobInfo info;
+      info.cores = job.numberOfCores();
+      info.wallTime = job.maxWallTime() > 0
+          ? static_cast<qint64>(job.maxWallTime()) * 60 * 1000 : 0;
+      info.memory = qMax(job.maxMemory(), 0);
+      queuedIds.append(moleQueueId);
+      pending.append(info);
+    }
 
-  // Keep submitting jobs (FIFO) until we hit one we can't afford to start.
-  while (!m_pendingJobQueue.isEmpty() && coresAvailable > 0) {
-    IdType nextMQId = m_pendingJobQueue.first();
-    Job nextJob = m_server->jobManager()->lookupJobByMoleQueueId(nextMQId);
-    if (!nextJob.isValid()) {
-      m_pendingJobQueue.removeFirst();
-      continue;
+    const qint64 now = m_queueClock.elapsed();
+    QList<int> toStart = selectJobsToStart(pending,
+                                           m_runningJobResources.values(),
+                                           maxNumberOfCores(), now,
+                                           m_schedulingPolicy, totalMemory,
+                                           &waitingForMemory);
+    foreach (int index, toStart) {
+      startIds.append(queuedIds.at(index));
+      m_pendingJobQueue.take(queuedIds.at(index));
     }
-    else if (nextJob.numberOfCores() <= coresAvailable) {
-      m_pendingJobQueue.removeFirst();
-      if (startJob(nextJob.moleQueueId()))
-        coresAvailable -= nextJob.numberOfCores();
-      continue;
+  }
+
+  foreach (IdType moleQueueId, startIds) {
+    const bool timed = m_pendingSince.contains(moleQueueId);
+    const qint64 queuedSince = m_pendingSince.take(moleQueueId);
+    if (startJob(moleQueueId) && timed) {
+      m_lastQueueLatency = m_queueClock.elapsed() - queuedSince;
+      m_totalQueueLatency += m_lastQueueLatency;
+      ++m_dispatchedJobCount;
     }
+  }
 
-    // Cannot start next job yet!
-    break;
+  // Nothing signals when other processes release memory, so check again later
+  // if a job was held back for lack of memory.
+  if (waitingForMemory && m_memoryRetryTimerId == -1)
+    m_memoryRetryTimerId = startTimer(memoryRetryInterval);
+}
+
+void QueueLocal::scheduleJobQueueCheck()
+{
+  if (m_checkJobLimitTimerId == -1)
+    m_checkJobLimitTimerId = startTimer(0);
+}
+
+QProcess *QueueLocal::takeRunningJob(IdType moleQueueId)
+{
+  QProcess *process = m_runningJobs.take(moleQueueId);
+  if (process) {
+    const RunningJobInfo info = m_runningJobResources.take(moleQueueId);
+    m_coresInUse -= info.cores;
+    m_memoryInUse -= info.memory;
+    foreach (int cpu, m_jobCpus.take(moleQueueId))
+      m_cpusInUse.remove(cpu);
+    scheduleJobQueueCheck();
   }
+  return process;
 }
 
 bool QueueLocal::startJob(IdType moleQueueId)
@@ -325,16 +734,19 @@ bool QueueLocal::startJob(IdType moleQueueId)
                      .arg(m_name).arg(moleQueueId), moleQueueId);
     return false;
   }
-  const Program *program = lookupProgram(job.program());
+  // Read the job's properties at once, rather than validating the reference
+  // in each accessor.
+  const JobData jobData = job.snapshot();
+  const Program *program = lookupProgram(jobData.program());
   if (!program) {
     Logger::logError(tr("Queue '%1' cannot locate Program '%2'.")
-                     .arg(m_name).arg(job.program()), moleQueueId);
+                     .arg(m_name).arg(jobData.program()), moleQueueId);
     return false;
   }
 
   // Create and setup process
   QProcess *proc = new QProcess (this);
-  QDir dir (job.localWorkingDirectory());
+  QDir dir (jobData.localWorkingDirectory());
   proc->setWorkingDirectory(dir.absolutePath());
 
   QStringList arguments;
@@ -376,7 +788,7 @@ bool QueueLocal::startJob(IdType moleQueueId)
   case Program::SYNTAX_COUNT:
   default:
     Logger::logError(tr("Unknown launcher syntax for program %1: %2.")
-                     .arg(job.program()).arg(program->launchSyntax()),
+                     .arg(jobData.program()).arg(program->launchSyntax()),
                      moleQueueId);
     return false;
   }
@@ -387,19 +799,64 @@ bool QueueLocal::startJob(IdType moleQueueId)
   QString args = arguments.join(" ");
   replaceLaunchScriptKeywords(args, job, false);
 
+#ifdef Q_OS_LINUX
+  // Bind the job to its own CPUs. The affinity is inherited by any processes
+  // that the job starts.
+  if (m_pinJobsToCpus) {
+    if (m_cpuTopology.isEmpty())
+      m_cpuTopology = cpuTopology();
+    const QList<int> cpus = allocateCpus(m_cpuTopology, m_cpusInUse,
+                                         jobData.numberOfCores());
+    if (!cpus.isEmpty()) {
+      QStringList cpuList;
+      foreach (int cpu, cpus) {
+        cpuList << QString::number(cpu);
+        m_cpusInUse.insert(cpu);
+      }
+      m_jobCpus.insert(moleQueueId, cpus);
+      command = QString("taskset -c %1 %2").arg(cpuList.join(",")).arg(command);
+    }
+    else {
+      Logger::logWarning(tr("Not enough free CPUs to bind job to %n core(s). "
+                            "Starting it without CPU binding.", "",
+                            jobData.numberOfCores()), moleQueueId);
+    }
+  }
+#endif // Q_OS_LINUX
+
   proc->start(command + " " + args);
   Logger::logNotification(tr("Executing '%1 %2' in %3", "command, args, dir")
                           .arg(command).arg(args)
                           .arg(proc->workingDirectory()),
-                          job.moleQueueId());
-  m_runningJobs.insert(job.moleQueueId(), proc);
+                          moleQueueId);
+  m_runningJobs.insert(moleQueueId, proc);
+  RunningJobInfo info;
+  info.cores = jobData.numberOfCores();
+  info.memory = qMax(jobData.maxMemory(), 0);
+  info.expectedEnd = jobData.maxWallTime() > 0
+      ? m_queueClock.elapsed() +
+        static_cast<qint64>(jobData.maxWallTime()) * 60 * 1000
+      : -1;
+  m_runningJobResources.insert(moleQueueId, info);
+  m_coresInUse += info.cores;
+  m_memoryInUse += info.memory;
 
   return true;
 }
 
 void QueueLocal::timerEvent(QTimerEvent *theEvent)
 {
+  if (theEvent->timerId() == m_memoryRetryTimerId) {
+    killTimer(m_memoryRetryTimerId);
+    m_memoryRetryTimerId = -1;
+    checkJobQueue();
+    theEvent->accept();
+    return;
+  }
+
   if (theEvent->timerId() == m_checkJobLimitTimerId) {
+    killTimer(m_checkJobLimitTimerId);
+    m_checkJobLimitTimerId = -1;
     checkJobQueue();
     theEvent->accept();
     return;
@@ -419,7 +876,7 @@ void QueueLocal::processError(QProcess::ProcessError error)
     return;
 
   // Remove and delete QProcess from queue
-  m_runningJobs.take(moleQueueId)->deleteLater();
+  takeRunningJob(moleQueueId)->deleteLater();
 
   if (!m_server) {
     Logger::logError(tr("Queue '%1' cannot locate Server instance!")
@@ -18,10 +18,15 @@
 #define QUEUELOCAL_H
 
 #include "../queue.h"
+#include "../pendingjobqueue.h"
 
+#include <QtCore/QElapsedTimer>
+#include <QtCore/QHash>
+#include <QtCore/QSet>
 #include <QtCore/QProcess>
 
 class QThread;
+class QueueLocalTest;
 
 namespace MoleQueue
 {
@@ -36,6 +41,44 @@ public:
   explicit QueueLocal(QueueManager *parentManager = 0);
   ~QueueLocal();
 
+  /// Policies for choosing which pending jobs to start.
+  enum SchedulingPolicy {
+    /// Start jobs in submission order. A job that does not fit in the free
+    /// cores blocks all jobs behind it.
+    FifoScheduling = 0,
+    /// Start jobs in submission order, but let later jobs start early if they
+    /// fit in the free cores and will not delay the first waiting job, based
+    /// on the jobs' maxWallTime. Jobs without a maxWallTime may only use cores
+    /// that the first waiting job does not need.
+    BackfillScheduling
+  };
+
+  /// Resources requested by a pending job. @sa selectJobsToStart()
+  struct PendingJobInfo
+  {
+    PendingJobInfo() : cores(1), wallTime(0), memory(0) {}
+    /// Number of cores.
+    int cores;
+    /// Maximum wall time in milliseconds, or <= 0 if unknown.
+    qint64 wallTime;
+    /// Memory in megabytes, or <= 0 if unknown.
+    qint64 memory;
+  };
+
+  /// Resources held by a running job. @sa selectJobsToStart()
+  struct RunningJobInfo
+  {
+    RunningJobInfo() : cores(1), expectedEnd(-1), memory(0) {}
+    /// Number of cores.
+    int cores;
+    /// Time by which the job is expected to finish, in milliseconds on the
+    /// same clock as the @a now argument of selectJobsToStart(), or -1 if
+    /// unknown.
+    qint64 expectedEnd;
+    /// Memory in megabytes reserved for the job.
+    qint64 memory;
+  };
+
   QString typeName() const { return "Local"; }
 
   /**
@@ -77,7 +120,102 @@ public:
   int maxNumberOfCores() const;
 
   /// The number of cores available.
-  void setMaxNumberOfCores(int cores) { m_cores = cores; }
+  void setMaxNumberOfCores(int cores);
+
+  /// Set the policy for choosing which pending jobs to start.
+  /// Default: FifoScheduling
+  void setSchedulingPolicy(SchedulingPolicy policy);
+
+  /// @return The policy for choosing which pending jobs to start.
+  SchedulingPolicy schedulingPolicy() const { return m_schedulingPolicy; }
+
+  /// Set the memory in megabytes that jobs may reserve, or -1 for the
+  /// physical memory of the host. Default: -1
+  void setMaxMemory(qint64 memory);
+
+  /// @return The memory in megabytes that jobs may reserve, or -1 for the
+  /// physical memory of the host.
+  qint64 maxMemory() const { return m_maxMemory; }
+
+  /// @return The memory in megabytes reserved by running jobs.
+  qint64 memoryInUse() const { return m_memoryInUse; }
+
+  /// If @a enable is true, each job is bound to its own set of CPUs, taken
+  /// from a single NUMA node where possible. Only supported on Linux, where
+  /// the jobs are started with taskset. Default: false
+  void setPinJobsToCpus(bool enable) { m_pinJobsToCpus = enable; }
+
+  /// @return True if jobs are bound to their own set of CPUs.
+  bool pinJobsToCpus() const { return m_pinJobsToCpus; }
+
+  /// Reimplemented from Queue::setFairShare
+  void setFairShare(bool enable);
+
+  /**
+   * Decide which pending jobs can be started.
+   * @param pending The pending jobs, in scheduling order.
+   * @param running The running jobs.
+   * @param totalCores The number of cores available to the queue.
+   * @param now The current time in milliseconds.
+   * @param policy The scheduling policy to apply.
+   * @param totalMemory The memory in megabytes available to the queue, or -1
+   * if unlimited.
+   * @param waitingForMemory If not NULL, set to true if a job that would fit
+   * the free cores was not started for lack of memory, false otherwise.
+   * @return Indices into @a pending of the jobs to start, in ascending order.
+   */
+  static QList<int> selectJobsToStart(const QList<PendingJobInfo> &pending,
+                                      const QList<RunningJobInfo> &running,
+                                      int totalCores, qint64 now,
+                                      SchedulingPolicy policy,
+                                      qint64 totalMemory = -1,
+                                      bool *waitingForMemory = NULL);
+
+  /**
+   * @return The value of @a field (e.g. "MemAvailable") in megabytes, parsed
+   * from the contents of /proc/meminfo in @a memInfo, or -1 if not present.
+   */
+  static qint64 parseMemInfo(const QByteArray &memInfo, const char *field);
+
+  /// @return The value of @a field in /proc/meminfo in megabytes, or -1 if
+  /// the field or file is not available.
+  static qint64 systemMemory(const char *field);
+
+  /// @return The CPU indices in the Linux cpulist format @a cpuList, e.g.
+  /// "0-3,8,10-11".
+  static QList<int> parseCpuList(const QString &cpuList);
+
+  /// @return The CPU indices of each NUMA node of the host. If the topology is
+  /// unknown, all CPUs are reported as a single node.
+  static QList<QList<int> > cpuTopology();
+
+  /**
+   * Choose @a count CPUs from @a nodes that are not in @a inUse. The CPUs are
+   * taken from the node with the fewest free CPUs that can hold them all, so
+   * that large blocks remain available for later jobs. If no single node
+   * can, they are taken from the nodes with the most free CPUs first.
+   * @return The chosen CPUs, or an empty list if there are not enough free.
+   */
+  static QList<int> allocateCpus(const QList<QList<int> > &nodes,
+                                 const QSet<int> &inUse, int count);
+
+  /// @return The number of cores used by running jobs.
+  int coresInUse() const { return m_coresInUse; }
+
+  /// @return The time in milliseconds that the most recently started job
+  /// spent waiting in the queue, or -1 if no job has been started.
+  qint64 lastQueueLatency() const { return m_lastQueueLatency; }
+
+  /// @return The mean time in milliseconds that started jobs spent waiting in
+  /// the queue, or -1 if no job has been started.
+  double averageQueueLatency() const
+  {
+    return m_dispatchedJobCount > 0
+        ? static_cast<double>(m_totalQueueLatency) / m_dispatchedJobCount
+        : -1.0;
+  }
+
+  friend class ::QueueLocalTest;
 
 public slots:
   bool submitJob(MoleQueue::Job job);
@@ -119,21 +257,72 @@ protected:
   /// Submit any queued jobs that can be started
   void checkJobQueue();
 
+  /// Call checkJobQueue() once control returns to the event loop. Multiple
+  /// requests are coalesced.
+  void scheduleJobQueueCheck();
+
+  /// Remove the running job @a moleQueueId, release its cores and schedule a
+  /// queue check.
+  /// @return The job's process, or NULL if the job is not running.
+  QProcess *takeRunningJob(IdType moleQueueId);
+
   /// Submit the job with MoleQueue id @a moleQueueId.
   bool startJob(IdType moleQueueId);
 
   /// Reimplemented to monitor queue events.
   void timerEvent(QTimerEvent *theEvent);
 
-  /// Internal timer id.
+  /// Id of the timer for a pending checkJobQueue() call, or -1.
   int m_checkJobLimitTimerId;
 
-  /// FIFO queue of MoleQueue ids.
-  QList<IdType> m_pendingJobQueue;
+  /// Id of the timer for rechecking the queue while jobs wait for memory, or
+  /// -1.
+  int m_memoryRetryTimerId;
+
+  /// MoleQueue ids of jobs waiting for free cores, by priority.
+  PendingJobQueue m_pendingJobQueue;
+
+  /// Time (from m_queueClock) at which each pending job was queued.
+  QHash<IdType, qint64> m_pendingSince;
 
   /// List of running processes. MoleQueue Id to QProcess*
   QMap<IdType, QProcess*> m_runningJobs;
 
+  /// Resources held by each running job.
+  QHash<IdType, RunningJobInfo> m_runningJobResources;
+
+  /// Sum of the cores in m_runningJobResources.
+  int m_coresInUse;
+
+  /// Sum of the memory in m_runningJobResources.
+  qint64 m_memoryInUse;
+
+  /// Memory that jobs may reserve in megabytes, or -1 for physical memory.
+  qint64 m_maxMemory;
+
+  /// Whether to bind each job to its own set of CPUs.
+  bool m_pinJobsToCpus;
+
+  /// CPUs of each NUMA node, read when first needed.
+  QList<QList<int> > m_cpuTopology;
+
+  /// CPUs bound to each running job.
+  QHash<IdType, QList<int> > m_jobCpus;
+
+  /// Union of the CPUs in m_jobCpus.
+  QSet<int> m_cpusInUse;
+
+  /// The policy for choosing which pending jobs to start.
+  SchedulingPolicy m_schedulingPolicy;
+
+  /// Clock for measuring queue latency.
+  QElapsedTimer m_queueClock;
+
+  /// Queue latency statistics in milliseconds.
+  qint64 m_lastQueueLatency;
+  qint64 m_totalQueueLatency;
+  int m_dispatchedJobCount;
+
   /// The number of cores available.
   int m_cores;
 
@@ -19,12 +19,44 @@
 #include "logger.h"
 
 #include <QtCore/QDebug>
+#include <QtCore/QXmlStreamReader>
+
+namespace {
+// Convert a PBS duration, e.g. "12:56:34", to seconds. Returns -1 if the
+// duration cannot be parsed.
+int parseDuration(const QString &duration)
+{
+  int seconds = 0;
+  foreach (const QString &field, duration.split(':')) {
+    bool ok;
+    const int value = field.toInt(&ok);
+    if (!ok || value < 0)
+      return -1;
+    seconds = seconds * 60 + value;
+  }
+  return seconds;
+}
+
+// Extract the hosts from a PBS exec_host list, e.g. "node01/0+node01/1" or
+// "node01/0*2+node02/0*2".
+QStringList parseExecHost(const QString &execHost)
+{
+  QStringList nodes;
+  foreach (const QString &slot, execHost.split('+', QString::SkipEmptyParts)) {
+    const QString node = slot.section('/', 0, 0).trimmed();
+    if (!node.isEmpty() && !nodes.contains(node))
+      nodes.append(node);
+  }
+  return nodes;
+}
+}
 
 namespace MoleQueue
 {
 
 QueuePbs::QueuePbs(QueueManager *parentManager) :
-  QueueRemoteSsh("Remote (PBS)", parentManager)
+  QueueRemoteSsh("Remote (PBS)", parentManager),
+  m_statusParser(0, 4)
 {
   m_submissionCommand = "qsub";
   m_killCommand = "qdel";
@@ -47,12 +79,28 @@ QueuePbs::QueuePbs(QueueManager *parentManager) :
   m_allowedQueueRequestExitCodes.append(153);
   // unless it's an ezHPC fork. Then it will return 35.
   m_allowedQueueRequestExitCodes.append(35);
+
+  // Job ids are followed by the server name, e.g. "4807.headnode".
+  m_statusParser.setAllowJobIdSuffix(true);
+  m_statusParser.addState("r", MoleQueue::RunningRemote);
+  m_statusParser.addState("e", MoleQueue::RunningRemote);
+  m_statusParser.addState("c", MoleQueue::RunningRemote);
+  m_statusParser.addState("q", MoleQueue::RemoteQueued);
+  m_statusParser.addState("h", MoleQueue::RemoteQueued);
+  m_statusParser.addState("t", MoleQueue::RemoteQueued);
+  m_statusParser.addState("w", MoleQueue::RemoteQueued);
+  m_statusParser.addState("s", MoleQueue::RemoteQueued);
 }
 
 QueuePbs::~QueuePbs()
 {
 }
 
+QString QueuePbs::structuredQueueRequestArguments() const
+{
+  return "-x";
+}
+
 bool QueuePbs::parseQueueId(const QString &submissionOutput, IdType *queueId)
 {
   // Assuming submissionOutput is:
@@ -75,44 +123,122 @@ bool QueuePbs::parseQueueLine(const QString &queueListOutput,
   // Job id           Name             User             Time Use S Queue
   // ---------------- ---------------- ---------------- -------- - -----
   //  4807             scatter          user01           12:56:34 R batch
-  QRegExp parser ("^\\s*(\\d+)\\S*" // job-ID
-                  "\\s+\\S+"    // name
-                  "\\s+\\S+"    // user
-                  "\\s+\\S+"    // time
-                  "\\s+(\\w+)"); // state
-
-  QString stateStr;
-  int ind = parser.indexIn(queueListOutput);
-  if (ind >= 0) {
-    bool ok;
-    *queueId = static_cast<IdType>(parser.cap(1).toInt(&ok));
-    if (!ok)
-      return false;
-    stateStr = parser.cap(2).toLower();
-
-    if (stateStr == "r" ||
-        stateStr == "e" ||
-        stateStr == "c") {
-      *state = MoleQueue::RunningRemote;
-      return true;
-    }
-    else if (stateStr == "q" ||
-             stateStr == "h" ||
-             stateStr == "t" ||
-             stateStr == "w" ||
-             stateStr == "s") {
-      *state = MoleQueue::RemoteQueued;
-      return true;
+  QStringRef stateStr;
+  switch (m_statusParser.parseLine(queueListOutput, queueId, state,
+                                   &stateStr)) {
+  case QueueStatusParser::KnownState:
+    return true;
+  case QueueStatusParser::UnknownState:
+    Logger::logWarning(tr("Unrecognized queue state '%1' in %2 queue '%3'. "
+                          "Queue line:\n%4")
+                       .arg(stateStr.toString().toLower()).arg(typeName())
+                       .arg(name()).arg(queueListOutput));
+    return false;
+  case QueueStatusParser::NoJob:
+    break;
+  }
+  return false;
+}
+
+void QueuePbs::parseQueueOutput(const QString &queueListOutput,
+                                QHash<IdType, JobState> *states)
+{
+  QStringList unknownLines;
+  m_statusParser.parse(queueListOutput, states, &unknownLines);
+
+  // Warn about the unrecognized states.
+  IdType queueId;
+  JobState state;
+  foreach (const QString &line, unknownLines)
+    parseQueueLine(line, &queueId, &state);
+}
+
+bool QueuePbs::parseStructuredQueueOutput(
+    const QString &queueListOutput, QHash<IdType, QueueJobStatus> *statuses)
+{
+  // Expecting the XML from qstat -x, all on one line:
+  // <Data><Job><Job_Id>4807.headnode</Job_Id>...<resources_used>...
+  // <walltime>12:56:34</walltime></resources_used><job_state>R</job_state>
+  // ...<exec_host>node01/0+node01/1</exec_host>...</Job>...</Data>
+  // qstat prints nothing if none of the requested jobs is known.
+  const int start = queueListOutput.indexOf('<');
+  if (start < 0)
+    return queueListOutput.trimmed().isEmpty();
+
+  QXmlStreamReader xml(queueListOutput.mid(start));
+  IdType queueId = InvalidId;
+  QueueJobStatus status;
+  QString stateCode;
+  bool inResourcesUsed = false;
+  int depth = 0;
+  while (!xml.atEnd()) {
+    xml.readNext();
+    if (xml.isStartElement()) {
+      ++depth;
+      const QStringRef element = xml.name();
+      if (element == QLatin1String("Job")) {
+        queueId = InvalidId;
+        status = QueueJobStatus();
+        stateCode.clear();
+        continue;
+      }
+      if (element == QLatin1String("resources_used")) {
+        inResourcesUsed = true;
+        continue;
+      }
+
+      // The remaining elements of interest contain only text. Reading it
+      // consumes the end element.
+      if (element == QLatin1String("Job_Id")) {
+        bool ok;
+        const IdType id = static_cast<IdType>(
+              xml.readElementText().section('.', 0, 0).toUInt(&ok));
+        if (ok)
+          queueId = id;
+      }
+      else if (element == QLatin1String("job_state")) {
+        stateCode = xml.readElementText().trimmed();
+      }
+      else if (inResourcesUsed && element == QLatin1String("walltime")) {
+        status.wallTimeUsed = parseDuration(xml.readElementText().trimmed());
+      }
+      else if (element == QLatin1String("exec_host")) {
+        status.nodes = parseExecHost(xml.readElementText());
+      }
+      else if (element == QLatin1String("exit_status")) {
+        bool ok;
+        status.exitStatus = xml.readElementText().trimmed().toInt(&ok);
+        status.hasExitStatus = ok;
+      }
+      else {
+        continue;
+      }
+      --depth;
     }
-    else {
-      Logger::logWarning(tr("Unrecognized queue state '%1' in %2 queue '%3'. "
-                            "Queue line:\n%4")
-                         .arg(stateStr).arg(typeName()).arg(name())
-                         .arg(queueListOutput));
-      return false;
+    else if (xml.isEndElement()) {
+      const QStringRef element = xml.name();
+      if (element == QLatin1String("resources_used")) {
+        inResourcesUsed = false;
+      }
+      else if (element == QLatin1String("Job") && queueId != InvalidId) {
+        if (m_statusParser.lookupState(QStringRef(&stateCode),
+                                       &status.state)) {
+          statuses->insert(queueId, status);
+        }
+        else {
+          Logger::logWarning(tr("Unrecognized queue state '%1' of job %2 in "
+                                "%3 queue '%4'.")
+                             .arg(stateCode.toLower()).arg(queueId)
+                             .arg(typeName()).arg(name()));
+        }
+      }
+      // Ignore anything after the document, such as error messages.
+      if (--depth == 0)
+        break;
     }
   }
-  return false;
+
+  return !xml.hasError();
 }
 
 } // End namespace
@@ -18,6 +18,7 @@
 #define QUEUEPBS_H
 
 #include "remotessh.h"
+#include "queuestatusparser.h"
 
 class QueuePbsTest;
 
@@ -40,6 +41,15 @@ protected:
   virtual bool parseQueueId(const QString &submissionOutput, IdType *queueId);
   virtual bool parseQueueLine(const QString &queueListOutput, IdType *queueId,
                               JobState *state);
+  virtual void parseQueueOutput(const QString &queueListOutput,
+                                QHash<IdType, JobState> *states);
+  virtual QString structuredQueueRequestArguments() const;
+  virtual bool parseStructuredQueueOutput(
+      const QString &queueListOutput,
+      QHash<IdType, QueueJobStatus> *statuses);
+
+  /// Parser for the qstat output, set up in the constructor.
+  QueueStatusParser m_statusParser;
 
 };
 
@@ -0,0 +1,144 @@
+/******************************************************************************
+
+  This source file is part of the MoleQueue project.
+
+  Copyright 2012 Kitware, Inc.
+
+  This source code is released under the New BSD License, (the "License").
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+******************************************************************************/
+
+#include "queuestatusparser.h"
+
+namespace MoleQueue
+{
+
+QueueStatusParser::QueueStatusParser(int jobIdColumn, int stateColumn)
+  : m_jobIdColumn(jobIdColumn),
+    m_stateColumn(stateColumn),
+    m_allowJobIdSuffix(false)
+{
+}
+
+void QueueStatusParser::addState(const QString &code, JobState state)
+{
+  StateEntry entry;
+  entry.code = code;
+  entry.state = state;
+  m_states.append(entry);
+}
+
+bool QueueStatusParser::lookupState(const QStringRef &code,
+                                    JobState *state) const
+{
+  foreach (const StateEntry &entry, m_states) {
+    if (code.compare(entry.code, Qt::CaseInsensitive) == 0) {
+      *state = entry.state;
+      return true;
+    }
+  }
+  return false;
+}
+
+QueueStatusParser::LineStatus
+QueueStatusParser::parseLine(const QString &text, int begin, int end,
+                             IdType *queueId, JobState *state,
+                             QStringRef *stateCode) const
+{
+  const QChar *data = text.constData();
+  const int lastColumn = qMax(m_jobIdColumn, m_stateColumn);
+
+  // Find the job id and state columns.
+  int idBegin = 0;
+  int idEnd = 0;
+  int stateBegin = 0;
+  int stateEnd = 0;
+  int pos = begin;
+  for (int column = 0; column <= lastColumn; ++column) {
+    while (pos < end && data[pos].isSpace())
+      ++pos;
+    if (pos == end)
+      return NoJob;
+
+    const int columnBegin = pos;
+    while (pos < end && !data[pos].isSpace())
+      ++pos;
+
+    if (column == m_jobIdColumn) {
+      idBegin = columnBegin;
+      idEnd = pos;
+    }
+    if (column == m_stateColumn) {
+      stateBegin = columnBegin;
+      stateEnd = pos;
+    }
+  }
+
+  // The job id is the leading number of its column.
+  IdType id = 0;
+  int idPos = idBegin;
+  for (; idPos < idEnd; ++idPos) {
+    const ushort c = data[idPos].unicode();
+    if (c < '0' || c > '9')
+      break;
+    const IdType digit = static_cast<IdType>(c - '0');
+    if (id > (InvalidId - 1 - digit) / 10)
+      return NoJob;
+    id = id * 10 + digit;
+  }
+  if (idPos == idBegin || (idPos != idEnd && !m_allowJobIdSuffix))
+    return NoJob;
+
+  // The state code is the leading word of its column.
+  int statePos = stateBegin;
+  while (statePos < stateEnd && (data[statePos].isLetterOrNumber() ||
+                                 data[statePos] == QLatin1Char('_'))) {
+    ++statePos;
+  }
+  if (statePos == stateBegin)
+    return NoJob;
+
+  const QStringRef code(&text, stateBegin, statePos - stateBegin);
+  *queueId = id;
+  if (stateCode)
+    *stateCode = code;
+
+  return lookupState(code, state) ? KnownState : UnknownState;
+}
+
+void QueueStatusParser::parse(const QString &output,
+                              QHash<IdType, JobState> *states,
+                              QStringList *unknownLines) const
+{
+  const int size = output.size();
+  int begin = 0;
+  while (begin < size) {
+    int end = output.indexOf(QLatin1Char('\n'), begin);
+    if (end < 0)
+      end = size;
+
+    IdType queueId;
+    JobState state;
+    switch (parseLine(output, begin, end, &queueId, &state)) {
+    case KnownState:
+      states->insert(queueId, state);
+      break;
+    case UnknownState:
+      if (unknownLines)
+        unknownLines->append(output.mid(begin, end - begin));
+      break;
+    case NoJob:
+      break;
+    }
+
+    begin = end + 1;
+  }
+}
+
+} // End namespace
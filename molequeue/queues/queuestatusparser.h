@@ -0,0 +1,139 @@
+/******************************************************************************
+
+  This source file is part of the MoleQueue project.
+
+  Copyright 2012 Kitware, Inc.
+
+  This source code is released under the New BSD License, (the "License").
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+******************************************************************************/
+
+#ifndef QUEUESTATUSPARSER_H
+#define QUEUESTATUSPARSER_H
+
+#include "../molequeueglobal.h"
+
+#include <QtCore/QHash>
+#include <QtCore/QString>
+#include <QtCore/QStringList>
+#include <QtCore/QVector>
+
+namespace MoleQueue
+{
+
+/// Status of a job as reported by the machine-readable output of a queuing
+/// system.
+struct QueueJobStatus
+{
+  QueueJobStatus()
+    : state(Unknown), hasExitStatus(false), exitStatus(0), wallTimeUsed(-1) {}
+
+  JobState state;
+  /// True if the queuing system reported the exit status of the job.
+  bool hasExitStatus;
+  int exitStatus;
+  /// Walltime used by the job in seconds, or -1 if it is not known.
+  int wallTimeUsed;
+  /// Hosts the job runs on, without duplicates.
+  QStringList nodes;
+};
+
+/**
+ * @class QueueStatusParser queuestatusparser.h
+ * <molequeue/queues/queuestatusparser.h>
+ * @brief Table driven parser for the tabular job listings of queuing systems,
+ * e.g. the output of qstat.
+ *
+ * Each line is split into whitespace separated columns. A line describes a
+ * job if the job id column starts with a number and the state column starts
+ * with a state code that has been registered with addState(). All other lines,
+ * such as headers and continuation lines, are ignored.
+ *
+ * The parser works directly on the output buffer and does not allocate memory
+ * per line, so that listings with many thousands of jobs are cheap to parse.
+ */
+class QueueStatusParser
+{
+public:
+  /// Result of parsing a single line.
+  enum LineStatus {
+    /// The line does not describe a job.
+    NoJob = 0,
+    /// The line describes a job in a known state.
+    KnownState,
+    /// The line describes a job, but the state code was not registered.
+    UnknownState
+  };
+
+  /**
+   * @param jobIdColumn Index of the column with the job id, starting at 0.
+   * @param stateColumn Index of the column with the state code.
+   */
+  QueueStatusParser(int jobIdColumn = 0, int stateColumn = 1);
+
+  /**
+   * If @a allow is true, job ids may be followed by other characters, e.g.
+   * "4807.headnode", and only the leading number is used. Otherwise the job
+   * id column must be a plain number. Default: false
+   */
+  void setAllowJobIdSuffix(bool allow) { m_allowJobIdSuffix = allow; }
+  bool allowJobIdSuffix() const { return m_allowJobIdSuffix; }
+
+  /// Map the state code @a code, which is case insensitive, to @a state.
+  void addState(const QString &code, JobState state);
+
+  /// Set @a state to the state registered for @a code.
+  /// @return False if @a code is not registered.
+  bool lookupState(const QStringRef &code, JobState *state) const;
+
+  /**
+   * Parse the line @a text[@a begin, @a end).
+   * @param queueId Set to the job id if the line describes a job.
+   * @param state Set to the job state if the state is known.
+   * @param stateCode If not NULL, set to the state code if the line describes
+   * a job.
+   */
+  LineStatus parseLine(const QString &text, int begin, int end,
+                       IdType *queueId, JobState *state,
+                       QStringRef *stateCode = NULL) const;
+
+  /// Parse the single line @a line.
+  LineStatus parseLine(const QString &line, IdType *queueId, JobState *state,
+                       QStringRef *stateCode = NULL) const
+  {
+    return parseLine(line, 0, line.size(), queueId, state, stateCode);
+  }
+
+  /**
+   * Parse all lines of @a output in a single pass.
+   * @param states Receives the state of each listed job, keyed by job id. If a
+   * job is listed more than once, the last line wins.
+   * @param unknownLines If not NULL, receives the lines that describe jobs in
+   * unknown states.
+   */
+  void parse(const QString &output, QHash<IdType, JobState> *states,
+             QStringList *unknownLines = NULL) const;
+
+private:
+  struct StateEntry
+  {
+    QString code;
+    JobState state;
+  };
+
+  int m_jobIdColumn;
+  int m_stateColumn;
+  bool m_allowJobIdSuffix;
+  /// State codes are few and short, so a linear scan beats hashing.
+  QVector<StateEntry> m_states;
+};
+
+} // End namespace
+
+#endif // QUEUESTATUSPARSER_H
@@ -29,16 +29,33 @@
 
 #include <QtGui>
 
+namespace {
+/// Shortest time between queue updates in seconds.
+const int minQueueUpdateDelay = 15;
+/// Time in seconds after the walltime limit of a job at which the queue is
+/// updated, to give the queuing system time to remove the job.
+const int wallTimeDeadlineMargin = 30;
+}
+
 namespace MoleQueue {
 
 QueueRemote::QueueRemote(const QString &queueName, QueueManager *parentObject)
   : Queue(queueName, parentObject),
+    m_checkQueueTimerId(-1),
+    m_queueUpdateDelay(0),
+    m_queueUpdateInProgress(false),
+    m_stableQueueUpdates(0),
+    m_queueUpdateCount(0),
+    m_immediateQueueUpdateCount(0),
+    m_failedQueueUpdateCount(0),
     m_checkForPendingJobsTimerId(-1),
     m_queueUpdateInterval(DEFAULT_REMOTE_QUEUE_UPDATE_INTERVAL),
-    m_defaultMaxWallTime(DEFAULT_MAX_WALLTIME)
+    m_defaultMaxWallTime(DEFAULT_MAX_WALLTIME),
+    m_maxConcurrentSubmissions(DEFAULT_MAX_CONCURRENT_SUBMISSIONS),
+    m_submissionsInProgress(0)
 {
   // Set remote queue check timer.
-  m_checkQueueTimerId = startTimer(m_queueUpdateInterval * 60000);
+  scheduleQueueUpdate();
 
   // Check for jobs to submit every 5 seconds
   m_checkForPendingJobsTimerId = startTimer(5000);
@@ -58,6 +75,12 @@ void QueueRemote::readSettings(QSettings &settings)
                      DEFAULT_REMOTE_QUEUE_UPDATE_INTERVAL).toInt();
   m_defaultMaxWallTime = settings.value("defaultMaxWallTime",
                                         DEFAULT_MAX_WALLTIME).toInt();
+  m_maxConcurrentSubmissions =
+      settings.value("maxConcurrentSubmissions",
+                     DEFAULT_MAX_CONCURRENT_SUBMISSIONS).toInt();
+
+  // Check the jobs that were restored soon.
+  resetQueueUpdateBackoff();
 }
 
 void QueueRemote::writeSettings(QSettings &settings) const
@@ -67,6 +90,7 @@ void QueueRemote::writeSettings(QSettings &settings) const
   settings.setValue("workingDirectoryBase", m_workingDirectoryBase);
   settings.setValue("queueUpdateInterval", m_queueUpdateInterval);
   settings.setValue("defaultMaxWallTime", m_defaultMaxWallTime);
+  settings.setValue("maxConcurrentSubmissions", m_maxConcurrentSubmissions);
 }
 
 void QueueRemote::exportConfiguration(QSettings &exporter,
@@ -76,6 +100,7 @@ void QueueRemote::exportConfiguration(QSettings &exporter,
 
   exporter.setValue("queueUpdateInterval", m_queueUpdateInterval);
   exporter.setValue("defaultMaxWallTime", m_defaultMaxWallTime);
+  exporter.setValue("maxConcurrentSubmissions", m_maxConcurrentSubmissions);
 }
 
 void QueueRemote::importConfiguration(QSettings &importer,
@@ -88,6 +113,9 @@ void QueueRemote::importConfiguration(QSettings &importer,
                      DEFAULT_REMOTE_QUEUE_UPDATE_INTERVAL).toInt();
   m_defaultMaxWallTime = importer.value("defaultMaxWallTime",
                                         DEFAULT_MAX_WALLTIME).toInt();
+  m_maxConcurrentSubmissions =
+      importer.value("maxConcurrentSubmissions",
+                     DEFAULT_MAX_CONCURRENT_SUBMISSIONS).toInt();
 }
 
 void QueueRemote::setQueueUpdateInterval(int interval)
@@ -97,8 +125,54 @@ void QueueRemote::setQueueUpdateInterval(int interval)
 
   m_queueUpdateInterval = interval;
 
-  killTimer(m_checkQueueTimerId);
-  m_checkQueueTimerId = startTimer(m_queueUpdateInterval * 60000);
+  requestQueueUpdate();
+  if (!m_queueUpdateInProgress)
+    scheduleQueueUpdate();
+}
+
+QVariantHash QueueRemote::queueUpdateStatistics() const
+{
+  QVariantHash statistics;
+  statistics.insert("updates", m_queueUpdateCount);
+  statistics.insert("immediateUpdates", m_immediateQueueUpdateCount);
+  statistics.insert("failedUpdates", m_failedQueueUpdateCount);
+  statistics.insert("updateInterval", m_queueUpdateDelay);
+  statistics.insert("lastUpdate", m_lastQueueUpdate.isValid()
+                    ? m_lastQueueUpdate.toString(Qt::ISODate) : QString());
+  statistics.insert("jobs", m_jobs.size());
+  return statistics;
+}
+
+QVariantHash QueueRemote::status() const
+{
+  QVariantHash hash = Queue::status();
+  hash.insert("queueUpdates", queueUpdateStatistics());
+  return hash;
+}
+
+void QueueRemote::requestImmediateQueueUpdate()
+{
+  ++m_immediateQueueUpdateCount;
+  m_stableQueueUpdates = 0;
+
+  // The update in progress may have missed the change the client is asking
+  // about. The next one follows after the shortest interval.
+  if (m_queueUpdateInProgress)
+    return;
+
+  // Merge requests that arrive in quick succession into one pending update
+  // so that clients cannot flood the remote host with queue requests.
+  const QDateTime now = QDateTime::currentDateTime();
+  if (m_lastQueueUpdateStart.isValid()) {
+    const int wait = minQueueUpdateDelay - m_lastQueueUpdateStart.secsTo(now);
+    if (wait > 0) {
+      if (m_checkQueueTimerId == -1 || now.secsTo(m_nextQueueUpdate) > wait)
+        scheduleQueueUpdate(wait);
+      return;
+    }
+  }
+
+  removeStaleJobs();
   requestQueueUpdate();
 }
 
@@ -136,10 +210,17 @@ void QueueRemote::replaceLaunchScriptKeywords(QString &launchScript,
   Queue::replaceLaunchScriptKeywords(launchScript, job, addNewline);
 }
 
+void QueueRemote::setFairShare(bool enable)
+{
+  Queue::setFairShare(enable);
+  m_pendingSubmission.setFairShare(enable);
+}
+
 bool QueueRemote::submitJob(Job job)
 {
   if (job.isValid()) {
-    m_pendingSubmission.append(job.moleQueueId());
+    m_pendingSubmission.enqueue(job.moleQueueId(), job.priority(),
+                                jobOwner(job));
     job.setJobState(MoleQueue::Accepted);
     return true;
   }
@@ -151,9 +232,7 @@ void QueueRemote::killJob(Job job)
   if (!job.isValid())
     return;
 
-  int pendingIndex = m_pendingSubmission.indexOf(job.moleQueueId());
-  if (pendingIndex >= 0) {
-    m_pendingSubmission.removeAt(pendingIndex);
+  if (m_pendingSubmission.remove(job.moleQueueId())) {
     job.setJobState(MoleQueue::Killed);
     return;
   }
@@ -190,13 +269,15 @@ void QueueRemote::submitPendingJobs()
     return;
   }
 
-  foreach (const IdType moleQueueId, m_pendingSubmission) {
-    Job job = jobManager->lookupJobByMoleQueueId(moleQueueId);
+  // Only submit the jobs that are pending now. Failed submissions are requeued
+  // for the next pass.
+  for (int i = m_pendingSubmission.size(); i > 0 && canStartSubmission(); --i) {
+    Job job = jobManager->lookupJobByMoleQueueId(
+          m_pendingSubmission.takeFirst());
     // Kick off the submission process...
+    submissionStarted();
     beginJobSubmission(job);
   }
-
-  m_pendingSubmission.clear();
 }
 
 void QueueRemote::beginJobSubmission(Job job)
@@ -204,6 +285,7 @@ void QueueRemote::beginJobSubmission(Job job)
   if (!writeInputFiles(job)) {
     Logger::logError(tr("Error while writing input files."), job.moleQueueId());
     job.setJobState(Error);
+    submissionFinished();
     return;
   }
   // Attempt to copy the files via scp first. Only call mkdir on the remote
@@ -262,7 +344,7 @@ void QueueRemote::finalizeJobCleanup(Job job)
 
 void QueueRemote::jobAboutToBeRemoved(const Job &job)
 {
-  m_pendingSubmission.removeOne(job.moleQueueId());
+  m_pendingSubmission.remove(job.moleQueueId());
   Queue::jobAboutToBeRemoved(job);
 }
 
@@ -288,13 +370,135 @@ void QueueRemote::removeStaleJobs()
   }
 }
 
+bool QueueRemote::canStartSubmission() const
+{
+  return m_maxConcurrentSubmissions <= 0 ||
+      m_submissionsInProgress < m_maxConcurrentSubmissions;
+}
+
+void QueueRemote::submissionFinished()
+{
+  if (m_submissionsInProgress > 0)
+    --m_submissionsInProgress;
+}
+
+void QueueRemote::queueUpdateStarted()
+{
+  ++m_queueUpdateCount;
+  m_queueUpdateInProgress = true;
+  m_lastQueueUpdateStart = QDateTime::currentDateTime();
+
+  // The next update is scheduled when this one finishes.
+  if (m_checkQueueTimerId != -1) {
+    killTimer(m_checkQueueTimerId);
+    m_checkQueueTimerId = -1;
+  }
+}
+
+void QueueRemote::queueUpdateFinished(bool success, bool changed)
+{
+  m_queueUpdateInProgress = false;
+
+  if (success)
+    m_lastQueueUpdate = QDateTime::currentDateTime();
+  else
+    ++m_failedQueueUpdateCount;
+
+  // Back off while nothing happens, including while the host is unreachable.
+  if (changed)
+    m_stableQueueUpdates = 0;
+  else
+    ++m_stableQueueUpdates;
+
+  // Forget the deadlines of the jobs that have left the queue.
+  QHash<IdType, QDateTime>::iterator it = m_wallTimeDeadlines.begin();
+  while (it != m_wallTimeDeadlines.end()) {
+    if (m_jobs.contains(it.key()))
+      ++it;
+    else
+      it = m_wallTimeDeadlines.erase(it);
+  }
+
+  scheduleQueueUpdate();
+}
+
+void QueueRemote::resetQueueUpdateBackoff()
+{
+  m_stableQueueUpdates = 0;
+
+  // Bring the next update forward if it is further away than the shortest
+  // interval. Otherwise a stream of submissions would keep postponing it.
+  if (!m_queueUpdateInProgress &&
+      (m_checkQueueTimerId == -1 ||
+       QDateTime::currentDateTime().secsTo(m_nextQueueUpdate) >
+       minQueueUpdateDelay)) {
+    scheduleQueueUpdate();
+  }
+}
+
+void QueueRemote::scheduleQueueUpdate()
+{
+  scheduleQueueUpdate(nextQueueUpdateDelay());
+}
+
+void QueueRemote::scheduleQueueUpdate(int delay)
+{
+  if (m_checkQueueTimerId != -1)
+    killTimer(m_checkQueueTimerId);
+
+  m_queueUpdateDelay = delay;
+  m_nextQueueUpdate = QDateTime::currentDateTime().addSecs(m_queueUpdateDelay);
+  m_checkQueueTimerId = startTimer(m_queueUpdateDelay * 1000);
+}
+
+int QueueRemote::nextQueueUpdateDelay() const
+{
+  const int maxDelay = qMax(1, m_queueUpdateInterval) * 60;
+  if (m_jobs.isEmpty())
+    return maxDelay;
+
+  // Double the delay for each update that did not change anything.
+  int delay = maxDelay;
+  if (m_stableQueueUpdates < 16)
+    delay = qMin(maxDelay, minQueueUpdateDelay << m_stableQueueUpdates);
+
+  // Notice soon when a job has been stopped at its walltime limit.
+  const QDateTime now = QDateTime::currentDateTime();
+  foreach (const QDateTime &deadline, m_wallTimeDeadlines) {
+    const int untilDeadline = now.secsTo(deadline) + wallTimeDeadlineMargin;
+    if (untilDeadline > 0 && untilDeadline < delay)
+      delay = qMax(minQueueUpdateDelay, untilDeadline);
+  }
+
+  return delay;
+}
+
+void QueueRemote::setRemoteJobState(Job job, JobState state, int wallTimeUsed)
+{
+  if (state == MoleQueue::RunningRemote &&
+      (wallTimeUsed >= 0 || !m_wallTimeDeadlines.contains(job.queueId()))) {
+    int wallTime = job.maxWallTime();
+    if (wallTime <= 0)
+      wallTime = m_defaultMaxWallTime;
+    m_wallTimeDeadlines.insert(job.queueId(), QDateTime::currentDateTime()
+                               .addSecs(wallTime * 60 - qMax(0, wallTimeUsed)));
+  }
+
+  job.setJobState(state);
+}
+
 void QueueRemote::timerEvent(QTimerEvent *theEvent)
 {
   if (theEvent->timerId() == m_checkQueueTimerId) {
     theEvent->accept();
+    killTimer(m_checkQueueTimerId);
+    m_checkQueueTimerId = -1;
     removeStaleJobs();
     if (!m_jobs.isEmpty())
       requestQueueUpdate();
+    // A running update schedules the next one when it finishes.
+    if (!m_queueUpdateInProgress && m_checkQueueTimerId == -1)
+      scheduleQueueUpdate();
     return;
   }
   else if (theEvent->timerId() == m_checkForPendingJobsTimerId) {
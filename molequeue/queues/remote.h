@@ -18,6 +18,10 @@
 #define QUEUEREMOTE_H
 
 #include "../queue.h"
+#include "../pendingjobqueue.h"
+
+#include <QtCore/QDateTime>
+#include <QtCore/QVariantHash>
 
 class QTimer;
 
@@ -75,12 +79,33 @@ public:
     return m_workingDirectoryBase;
   }
 
-  /** Time between remote queue updates in minutes. */
+  /**
+   * Longest time between remote queue updates in minutes. The queue is
+   * updated more often right after a submission and when a job is about to
+   * reach its walltime limit; while the jobs do not change, the time between
+   * updates doubles until it reaches this interval.
+   */
   void setQueueUpdateInterval(int i);
 
-  /** Time between remote queue updates in minutes. */
+  /** Longest time between remote queue updates in minutes. */
   int queueUpdateInterval() const { return m_queueUpdateInterval; }
 
+  /**
+   * @return Counters of the queue updates for monitoring:
+   * - "updates": Number of queue updates started.
+   * - "immediateUpdates": Number of requestImmediateQueueUpdate() calls.
+   * - "failedUpdates": Number of queue updates that failed.
+   * - "updateInterval": Seconds between the last and the next update.
+   * - "lastUpdate": Time of the last successful update (ISO 8601), or an
+   *   empty string.
+   * - "jobs": Number of jobs in the remote queue.
+   */
+  QVariantHash queueUpdateStatistics() const;
+
+  /// Reimplemented from Queue::status. The queue update statistics are stored
+  /// as "queueUpdates".
+  QVariantHash status() const;
+
   /**
    * @brief setDefaultMaxWallTime Set the default walltime limit (in minutes)
    * for jobs on this queue. This value will be used if the job's
@@ -99,10 +124,30 @@ public:
    */
   int defaultMaxWallTime() const { return m_defaultMaxWallTime; }
 
+  /**
+   * Limit the number of submissions that are in progress at once. A
+   * submission is either a single job or a batch of jobs; pending jobs wait
+   * until a submission finishes. 0 means no limit.
+   * Default: DEFAULT_MAX_CONCURRENT_SUBMISSIONS
+   */
+  void setMaxConcurrentSubmissions(int max)
+  {
+    m_maxConcurrentSubmissions = max;
+  }
+
+  /// @return The maximum number of submissions in progress at once.
+  int maxConcurrentSubmissions() const { return m_maxConcurrentSubmissions; }
+
+  /// @return The number of submissions currently in progress.
+  int submissionsInProgress() const { return m_submissionsInProgress; }
+
   /// Reimplemented from Queue::replaceLaunchScriptKeywords
   void replaceLaunchScriptKeywords(QString &launchScript, const Job &job,
                                    bool addNewline = true);
 
+  /// Reimplemented from Queue::setFairShare
+  void setFairShare(bool enable);
+
 public slots:
 
   bool submitJob(MoleQueue::Job job);
@@ -110,6 +155,15 @@ public slots:
 
   virtual void requestQueueUpdate() = 0;
 
+  /**
+   * Update the queue now rather than at the next scheduled time, e.g. when a
+   * client asks for it. The time between updates starts over at the
+   * shortest interval. Requests made while an update is in progress, or
+   * sooner than the shortest interval after the last one started, are merged
+   * into a single update at the earliest allowed time.
+   */
+  void requestImmediateQueueUpdate();
+
 protected slots:
   virtual void submitPendingJobs();
 
@@ -152,13 +206,61 @@ protected:
    */
   virtual void removeStaleJobs();
 
+  /// @return True if another submission may be started without exceeding
+  /// maxConcurrentSubmissions().
+  bool canStartSubmission() const;
+
+  /// Call when a submission (single job or batch) starts / finishes, whether
+  /// successfully or not.
+  void submissionStarted() { ++m_submissionsInProgress; }
+  void submissionFinished();
+
+  /// Call when a queue update starts and finishes. @a changed is true if a
+  /// job changed its state or left the queue.
+  void queueUpdateStarted();
+  void queueUpdateFinished(bool success, bool changed = false);
+
+  /// Poll the queue again soon, e.g. after a job was submitted.
+  void resetQueueUpdateBackoff();
+
+  /// Start the timer for the next queue update.
+  void scheduleQueueUpdate();
+  /// Start the timer for a queue update in @a delay seconds.
+  void scheduleQueueUpdate(int delay);
+
+  /// @return Seconds until the next queue update should be started.
+  int nextQueueUpdateDelay() const;
+
+  /**
+   * Set the state of @a job as reported by the remote queue. Running jobs are
+   * polled again shortly after their walltime limit.
+   * @param wallTimeUsed Walltime used by the job in seconds, if known.
+   */
+  void setRemoteJobState(Job job, JobState state, int wallTimeUsed = -1);
+
   /// Reimplemented to monitor queue events.
   virtual void timerEvent(QTimerEvent *theEvent);
 
+  /// Single shot timer for the next queue update, or -1.
   int m_checkQueueTimerId;
-
-  /// MoleQueue ids of jobs that have been accepted but not submitted.
-  QList<IdType> m_pendingSubmission;
+  QDateTime m_nextQueueUpdate;
+  /// Seconds between the last and the next queue update.
+  int m_queueUpdateDelay;
+  bool m_queueUpdateInProgress;
+  /// Number of queue updates in a row that did not change any job.
+  int m_stableQueueUpdates;
+  /// Expected end of the running jobs, keyed by queue id.
+  QHash<IdType, QDateTime> m_wallTimeDeadlines;
+
+  int m_queueUpdateCount;
+  int m_immediateQueueUpdateCount;
+  int m_failedQueueUpdateCount;
+  QDateTime m_lastQueueUpdate;
+  QDateTime m_lastQueueUpdateStart;
+
+  /// MoleQueue ids of jobs that have been accepted but not submitted, by
+  /// priority.
+  PendingJobQueue m_pendingSubmission;
   int m_checkForPendingJobsTimerId;
 
   /// Time between remote queue updates in minutes.
@@ -167,6 +269,9 @@ protected:
   /// Default maximum walltime limit for jobs on this queue in minutes.
   int m_defaultMaxWallTime;
 
+  int m_maxConcurrentSubmissions;
+  int m_submissionsInProgress;
+
   QString m_workingDirectoryBase;
 };
 
@@ -21,23 +21,88 @@
 #include "../logentry.h"
 #include "../logger.h"
 #include "../program.h"
+#include "../queuemanager.h"
 #include "../remotequeuewidget.h"
 #include "../server.h"
 #include "../sshcommandfactory.h"
 
+#include <QtCore/QCryptographicHash>
+#include <QtCore/QDir>
+#include <QtCore/QDirIterator>
+#include <QtCore/QFile>
+#include <QtCore/QFileInfo>
+#include <QtCore/QProcess>
+#include <QtCore/QRegExp>
 #include <QtCore/QTimer>
 #include <QtCore/QDebug>
 
 #include <QtGui>
 
+namespace {
+// Upper limit on the number of jobs submitted in one batch. Keeps the remote
+// command line and the cost of a failed batch bounded.
+const int maxSubmissionBatchSize = 100;
+
+// Default upper limit on the length of the job id list in a single queue
+// request. Remote shells and Windows command lines stop somewhere above 32k
+// characters.
+const int defaultMaxQueueRequestLength = 16384;
+
+// Connection failures reported by ssh and scp. ssh exits with code 255 on its
+// own errors, but so may the remote command, and scp reports a lost
+// connection with exit code 1, so the exit code alone is not enough. Only
+// checked for commands that failed, as the output of a successful one may
+// contain anything.
+const char *const connectionFailureMessages[] = {
+  "Connection refused",
+  "Connection timed out",
+  "Connection closed by",
+  "No route to host",
+  "Network is unreachable",
+  "Could not resolve hostname",
+  "lost connection"
+};
+
+// Lookup table for the CRC used by POSIX cksum (polynomial 0x04C11DB7, most
+// significant bit first).
+const quint32 *cksumTable()
+{
+  static quint32 table[256];
+  static bool initialized = false;
+  if (!initialized) {
+    for (quint32 i = 0; i < 256; ++i) {
+      quint32 crc = i << 24;
+      for (int bit = 0; bit < 8; ++bit)
+        crc = (crc & 0x80000000) ? (crc << 1) ^ 0x04C11DB7 : crc << 1;
+      table[i] = crc;
+    }
+    initialized = true;
+  }
+  return table;
+}
+}
+
 namespace MoleQueue {
 
+const char QueueRemoteSsh::batchStatusMarker[] = "MoleQueue-batch-status";
+const char QueueRemoteSsh::outputFilesMarker[] = "MoleQueue-output-files";
+const char QueueRemoteSsh::outputChecksumsMarker[] =
+    "MoleQueue-output-checksums";
+const char QueueRemoteSsh::outputStreamMarker[] = "MoleQueue-output-stream";
+
 QueueRemoteSsh::QueueRemoteSsh(const QString &queueName, QueueManager *parentObject)
   : QueueRemote(queueName, parentObject),
     m_sshExecutable(SshCommandFactory::defaultSshCommand()),
     m_scpExecutable(SshCommandFactory::defaultScpCommand()),
     m_sshPort(22),
-    m_isCheckingQueue(false)
+    m_shareConnections(false),
+    m_controlDirectoryUsable(false),
+    m_directoryTransferMode(SshCommand::ScpTransfer),
+    m_useStructuredQueueStatus(false),
+    m_isCheckingQueue(false),
+    m_isCheckingStructuredStatus(false),
+    m_maxQueueRequestLength(defaultMaxQueueRequestLength),
+    m_nextSubmissionBatchId(0)
 {
   // Check for jobs to submit every 5 seconds
   m_checkForPendingJobsTimerId = startTimer(5000);
@@ -48,6 +113,7 @@ QueueRemoteSsh::QueueRemoteSsh(const QString &queueName, QueueManager *parentObj
 
 QueueRemoteSsh::~QueueRemoteSsh()
 {
+  closeSharedConnection();
 }
 
 void QueueRemoteSsh::readSettings(QSettings &settings)
@@ -63,6 +129,12 @@ void QueueRemoteSsh::readSettings(QSettings &settings)
   m_userName = settings.value("userName").toString();
   m_identityFile = settings.value("identityFile").toString();
   m_sshPort  = settings.value("sshPort").toInt();
+  m_shareConnections = settings.value("shareConnections", false).toBool();
+  m_directoryTransferMode = static_cast<SshCommand::DirectoryTransferMode>(
+        settings.value("directoryTransferMode",
+                       SshCommand::ScpTransfer).toInt());
+  m_useStructuredQueueStatus =
+      settings.value("useStructuredQueueStatus", false).toBool();
 }
 
 void QueueRemoteSsh::writeSettings(QSettings &settings) const
@@ -78,6 +150,10 @@ void QueueRemoteSsh::writeSettings(QSettings &settings) const
   settings.setValue("userName", m_userName);
   settings.setValue("identityFile", m_identityFile);
   settings.setValue("sshPort",  m_sshPort);
+  settings.setValue("shareConnections", m_shareConnections);
+  settings.setValue("directoryTransferMode",
+                    static_cast<int>(m_directoryTransferMode));
+  settings.setValue("useStructuredQueueStatus", m_useStructuredQueueStatus);
 }
 
 void QueueRemoteSsh::exportConfiguration(QSettings &exporter,
@@ -90,6 +166,10 @@ void QueueRemoteSsh::exportConfiguration(QSettings &exporter,
   exporter.setValue("killCommand", m_killCommand);
   exporter.setValue("hostName", m_hostName);
   exporter.setValue("sshPort",  m_sshPort);
+  exporter.setValue("shareConnections", m_shareConnections);
+  exporter.setValue("directoryTransferMode",
+                    static_cast<int>(m_directoryTransferMode));
+  exporter.setValue("useStructuredQueueStatus", m_useStructuredQueueStatus);
 }
 
 void QueueRemoteSsh::importConfiguration(QSettings &importer,
@@ -102,6 +182,16 @@ void QueueRemoteSsh::importConfiguration(QSettings &importer,
   m_killCommand = importer.value("killCommand").toString();
   m_hostName = importer.value("hostName").toString();
   m_sshPort  = importer.value("sshPort").toInt();
+  if (importer.contains("shareConnections"))
+    m_shareConnections = importer.value("shareConnections").toBool();
+  if (importer.contains("directoryTransferMode")) {
+    m_directoryTransferMode = static_cast<SshCommand::DirectoryTransferMode>(
+          importer.value("directoryTransferMode").toInt());
+  }
+  if (importer.contains("useStructuredQueueStatus")) {
+    m_useStructuredQueueStatus =
+        importer.value("useStructuredQueueStatus").toBool();
+  }
 }
 
 AbstractQueueSettingsWidget* QueueRemoteSsh::settingsWidget()
@@ -110,6 +200,47 @@ AbstractQueueSettingsWidget* QueueRemoteSsh::settingsWidget()
   return widget;
 }
 
+void QueueRemoteSsh::submitPendingJobs()
+{
+  if (m_pendingSubmission.isEmpty() || !checkHostAvailable())
+    return;
+
+  // A single job gains nothing from batching.
+  if (m_pendingSubmission.size() < 2) {
+    QueueRemote::submitPendingJobs();
+    return;
+  }
+
+  JobManager *jobManager = NULL;
+  if (m_server)
+    jobManager = m_server->jobManager();
+
+  if (!jobManager) {
+    Logger::logError(tr("Internal error: %1\n%2").arg(Q_FUNC_INFO)
+                     .arg("Cannot locate server JobManager!"));
+    return;
+  }
+
+  while (!m_pendingSubmission.isEmpty() && canStartSubmission()) {
+    QList<Job> batch;
+    while (batch.size() < maxSubmissionBatchSize &&
+           !m_pendingSubmission.isEmpty()) {
+      Job job = jobManager->lookupJobByMoleQueueId(
+            m_pendingSubmission.takeFirst());
+      if (!writeInputFiles(job)) {
+        Logger::logError(tr("Error while writing input files."),
+                         job.moleQueueId());
+        job.setJobState(Error);
+        continue;
+      }
+      batch.append(job);
+    }
+
+    if (!batch.isEmpty())
+      beginBatchSubmission(batch);
+  }
+}
+
 void QueueRemoteSsh::createRemoteDirectory(Job job)
 {
   // Note that this is just the working directory base -- the job folder is
@@ -127,6 +258,7 @@ void QueueRemoteSsh::createRemoteDirectory(Job job)
                      .arg(conn->portNumber()), job.moleQueueId());
     job.setJobState(MoleQueue::Error);
     conn->deleteLater();
+    submissionFinished();
     return;
   }
 }
@@ -140,12 +272,14 @@ void QueueRemoteSsh::remoteDirectoryCreated()
     return;
   }
   conn->deleteLater();
+  recordConnectionResult(conn);
 
   Job job = conn->data().value<Job>();
 
   if (!job.isValid()) {
     Logger::logError(tr("Internal error: %1\n%2").arg(Q_FUNC_INFO)
                      .arg("Sender does not have an associated job!"));
+    submissionFinished();
     return;
   }
 
@@ -156,9 +290,11 @@ void QueueRemoteSsh::remoteDirectoryCreated()
                      .arg(m_workingDirectoryBase).arg(conn->exitCode())
                      .arg(conn->output()), job.moleQueueId());
     // Retry submission:
-    if (addJobFailure(job.moleQueueId()))
-      m_pendingSubmission.append(job.moleQueueId());
+    if (isConnectionFailure(conn) || addJobFailure(job.moleQueueId()))
+      m_pendingSubmission.enqueue(job.moleQueueId(), job.priority(),
+                                  jobOwner(job));
     job.setJobState(MoleQueue::Error);
+    submissionFinished();
     return;
   }
 
@@ -183,6 +319,7 @@ void QueueRemoteSsh::copyInputFilesToHost(Job job)
                      .arg(conn->portNumber()), job.moleQueueId());
     job.setJobState(MoleQueue::Error);
     conn->deleteLater();
+    submissionFinished();
     return;
   }
 }
@@ -196,12 +333,14 @@ void QueueRemoteSsh::inputFilesCopied()
     return;
   }
   conn->deleteLater();
+  recordConnectionResult(conn);
 
   Job job = conn->data().value<Job>();
 
   if (!job.isValid()) {
     Logger::logError(tr("Internal error: %1\n%2").arg(Q_FUNC_INFO)
                      .arg("Sender does not have an associated job!"));
+    submissionFinished();
     return;
   }
 
@@ -221,9 +360,11 @@ void QueueRemoteSsh::inputFilesCopied()
                        .arg(conn->exitCode()).arg(conn->output()),
                        job.moleQueueId());
     // Retry submission:
-    if (addJobFailure(job.moleQueueId()))
-      m_pendingSubmission.append(job.moleQueueId());
+    if (isConnectionFailure(conn) || addJobFailure(job.moleQueueId()))
+      m_pendingSubmission.enqueue(job.moleQueueId(), job.priority(),
+                                  jobOwner(job));
     job.setJobState(MoleQueue::Error);
+    submissionFinished();
     return;
   }
 
@@ -250,6 +391,7 @@ void QueueRemoteSsh::submitJobToRemoteQueue(Job job)
                      .arg(conn->portNumber()), job.moleQueueId());
     job.setJobState(MoleQueue::Error);
     conn->deleteLater();
+    submissionFinished();
     return;
   }
 }
@@ -263,6 +405,7 @@ void QueueRemoteSsh::jobSubmittedToRemoteQueue()
     return;
   }
   conn->deleteLater();
+  recordConnectionResult(conn);
 
   IdType queueId;
   parseQueueId(conn->output(), &queueId);
@@ -271,6 +414,7 @@ void QueueRemoteSsh::jobSubmittedToRemoteQueue()
   if (!job.isValid()) {
     Logger::logError(tr("Internal error: %1\n%2").arg(Q_FUNC_INFO)
                      .arg("Sender does not have an associated job!"));
+    submissionFinished();
     return;
   }
 
@@ -283,9 +427,11 @@ void QueueRemoteSsh::jobSubmittedToRemoteQueue()
                        .arg(m_launchScriptName).arg(conn->exitCode())
                        .arg(conn->output()), job.moleQueueId());
     // Retry submission:
-    if (addJobFailure(job.moleQueueId()))
-      m_pendingSubmission.append(job.moleQueueId());
+    if (isConnectionFailure(conn) || addJobFailure(job.moleQueueId()))
+      m_pendingSubmission.enqueue(job.moleQueueId(), job.priority(),
+                                  jobOwner(job));
     job.setJobState(MoleQueue::Error);
+    submissionFinished();
     return;
   }
 
@@ -293,6 +439,286 @@ void QueueRemoteSsh::jobSubmittedToRemoteQueue()
   clearJobFailures(job.moleQueueId());
   job.setQueueId(queueId);
   m_jobs.insert(queueId, job.moleQueueId());
+  resetQueueUpdateBackoff();
+  submissionFinished();
+}
+
+void QueueRemoteSsh::beginBatchSubmission(const QList<Job> &jobs)
+{
+  const int batchId = m_nextSubmissionBatchId++;
+  m_submissionBatches.insert(batchId, jobs);
+  submissionStarted();
+  createBatchDirectory(batchId);
+}
+
+void QueueRemoteSsh::createBatchDirectory(int batchId)
+{
+  // The job directories themselves are created by scp.
+  SshConnection *conn = newSshConnection();
+  conn->setData(QVariant(batchId));
+  connect(conn, SIGNAL(requestComplete()), this, SLOT(batchDirectoryCreated()));
+
+  if (!conn->execute(QString("mkdir -p %1").arg(m_workingDirectoryBase))) {
+    failBatch(batchId, tr("Could not initialize ssh resources: user= '%1'\n"
+                          "host = '%2' port = '%3'")
+              .arg(conn->userName()).arg(conn->hostName())
+              .arg(conn->portNumber()));
+    conn->deleteLater();
+    return;
+  }
+}
+
+void QueueRemoteSsh::batchDirectoryCreated()
+{
+  SshConnection *conn = qobject_cast<SshConnection*>(sender());
+  if (!conn) {
+    Logger::logError(tr("Internal error: %1\n%2").arg(Q_FUNC_INFO)
+                     .arg("Sender is not an SshConnection!"));
+    return;
+  }
+  conn->deleteLater();
+  recordConnectionResult(conn);
+
+  const int batchId = conn->data().toInt();
+  if (!m_submissionBatches.contains(batchId)) {
+    Logger::logError(tr("Internal error: %1\n%2").arg(Q_FUNC_INFO)
+                     .arg("Sender does not have an associated batch!"));
+    return;
+  }
+
+  if (conn->exitCode() != 0) {
+    failBatch(batchId, tr("Cannot create remote directory '%1@%2:%3'.\n"
+                          "Exit code (%4) %5")
+              .arg(conn->userName()).arg(conn->hostName())
+              .arg(m_workingDirectoryBase).arg(conn->exitCode())
+              .arg(conn->output()), isConnectionFailure(conn));
+    return;
+  }
+
+  copyBatchInputFilesToHost(batchId);
+}
+
+void QueueRemoteSsh::copyBatchInputFilesToHost(int batchId)
+{
+  QStringList localDirs;
+  foreach (const Job &job, m_submissionBatches.value(batchId)) {
+    if (job.isValid())
+      localDirs << job.localWorkingDirectory();
+  }
+
+  // All jobs were removed while the directory was being created.
+  if (localDirs.isEmpty()) {
+    m_submissionBatches.remove(batchId);
+    submissionFinished();
+    return;
+  }
+
+  SshConnection *conn = newSshConnection();
+  conn->setData(QVariant(batchId));
+  connect(conn, SIGNAL(requestComplete()), this, SLOT(batchInputFilesCopied()));
+
+  if (!conn->copyDirsTo(localDirs, m_workingDirectoryBase)) {
+    failBatch(batchId, tr("Could not initialize ssh resources: user= '%1'\n"
+                          "host = '%2' port = '%3'")
+              .arg(conn->userName()).arg(conn->hostName())
+              .arg(conn->portNumber()));
+    conn->deleteLater();
+    return;
+  }
+}
+
+void QueueRemoteSsh::batchInputFilesCopied()
+{
+  SshConnection *conn = qobject_cast<SshConnection*>(sender());
+  if (!conn) {
+    Logger::logError(tr("Internal error: %1\n%2").arg(Q_FUNC_INFO)
+                     .arg("Sender is not an SshConnection!"));
+    return;
+  }
+  conn->deleteLater();
+  recordConnectionResult(conn);
+
+  const int batchId = conn->data().toInt();
+  if (!m_submissionBatches.contains(batchId)) {
+    Logger::logError(tr("Internal error: %1\n%2").arg(Q_FUNC_INFO)
+                     .arg("Sender does not have an associated batch!"));
+    return;
+  }
+
+  if (conn->exitCode() != 0) {
+    failBatch(batchId, tr("Error while copying input files to remote host "
+                          "'%1/'\nExit code (%2) %3")
+              .arg(m_workingDirectoryBase).arg(conn->exitCode())
+              .arg(conn->output()), isConnectionFailure(conn));
+    return;
+  }
+
+  submitBatchToRemoteQueue(batchId);
+}
+
+void QueueRemoteSsh::submitBatchToRemoteQueue(int batchId)
+{
+  const QString command =
+      generateBatchSubmissionCommand(m_submissionBatches.value(batchId));
+
+  SshConnection *conn = newSshConnection();
+  conn->setData(QVariant(batchId));
+  connect(conn, SIGNAL(requestComplete()),
+          this, SLOT(batchSubmittedToRemoteQueue()));
+
+  if (!conn->execute(command)) {
+    failBatch(batchId, tr("Could not initialize ssh resources: user= '%1'\n"
+                          "host = '%2' port = '%3'")
+              .arg(conn->userName()).arg(conn->hostName())
+              .arg(conn->portNumber()));
+    conn->deleteLater();
+    return;
+  }
+}
+
+void QueueRemoteSsh::batchSubmittedToRemoteQueue()
+{
+  SshConnection *conn = qobject_cast<SshConnection*>(sender());
+  if (!conn) {
+    Logger::logError(tr("Internal error: %1\n%2").arg(Q_FUNC_INFO)
+                     .arg("Sender is not an SshConnection!"));
+    return;
+  }
+  conn->deleteLater();
+  recordConnectionResult(conn);
+
+  const int batchId = conn->data().toInt();
+  if (!m_submissionBatches.contains(batchId)) {
+    Logger::logError(tr("Internal error: %1\n%2").arg(Q_FUNC_INFO)
+                     .arg("Sender does not have an associated batch!"));
+    return;
+  }
+
+  const QList<Job> jobs = m_submissionBatches.take(batchId);
+  const QMap<IdType, BatchSubmissionResult> results =
+      parseBatchSubmissionOutput(conn->output());
+
+  foreach (Job job, jobs) {
+    if (!job.isValid())
+      continue;
+
+    const IdType moleQueueId = job.moleQueueId();
+
+    // Jobs without a result were not reached, e.g. because the connection
+    // dropped. Those are safe to retry.
+    if (!results.contains(moleQueueId) ||
+        results[moleQueueId].exitCode != 0) {
+      const bool reached = results.contains(moleQueueId);
+      Logger::logWarning(tr("Could not submit job to remote queue on %1@%2:%3\n"
+                            "%4 %5/%6/%7\nExit code (%8) %9")
+                         .arg(conn->userName()).arg(conn->hostName())
+                         .arg(conn->portNumber()).arg(m_submissionCommand)
+                         .arg(m_workingDirectoryBase).arg(moleQueueId)
+                         .arg(m_launchScriptName)
+                         .arg(reached ? results[moleQueueId].exitCode
+                                      : conn->exitCode())
+                         .arg(reached ? results[moleQueueId].output
+                                      : conn->output()), moleQueueId);
+      // Retry submission. Jobs that were not reached because the host was
+      // down keep their retries.
+      if ((!reached && isConnectionFailure(conn)) ||
+          addJobFailure(moleQueueId))
+        m_pendingSubmission.enqueue(moleQueueId, job.priority(), jobOwner(job));
+      job.setJobState(MoleQueue::Error);
+      continue;
+    }
+
+    // The job may well be queued, so don't submit it again.
+    IdType queueId;
+    if (!parseQueueId(results[moleQueueId].output, &queueId)) {
+      Logger::logError(tr("Cannot determine the queue id of the job submitted "
+                          "to %1@%2:%3\n%4")
+                       .arg(conn->userName()).arg(conn->hostName())
+                       .arg(conn->portNumber())
+                       .arg(results[moleQueueId].output), moleQueueId);
+      job.setJobState(MoleQueue::Error);
+      continue;
+    }
+
+    job.setJobState(MoleQueue::Submitted);
+    clearJobFailures(moleQueueId);
+    job.setQueueId(queueId);
+    m_jobs.insert(queueId, moleQueueId);
+  }
+
+  resetQueueUpdateBackoff();
+  submissionFinished();
+}
+
+void QueueRemoteSsh::failBatch(int batchId, const QString &message,
+                               bool connectionFailure)
+{
+  if (!m_submissionBatches.contains(batchId))
+    return;
+
+  foreach (Job job, m_submissionBatches.take(batchId)) {
+    if (!job.isValid())
+      continue;
+    Logger::logWarning(message, job.moleQueueId());
+    // Retry submission:
+    if (connectionFailure || addJobFailure(job.moleQueueId()))
+      m_pendingSubmission.enqueue(job.moleQueueId(), job.priority(),
+                                  jobOwner(job));
+    job.setJobState(MoleQueue::Error);
+  }
+
+  submissionFinished();
+}
+
+QString QueueRemoteSsh::generateBatchSubmissionCommand(
+    const QList<Job> &jobs) const
+{
+  QStringList ids;
+  foreach (const Job &job, jobs) {
+    if (job.isValid())
+      ids << QString::number(job.moleQueueId());
+  }
+
+  return QString("cd %1 && for id in %2; do (cd $id && %3 %4) 2>&1; "
+                 "echo \"%5 $id $?\"; done")
+      .arg(m_workingDirectoryBase, ids.join(" "), m_submissionCommand,
+           m_launchScriptName, QLatin1String(batchStatusMarker));
+}
+
+QMap<IdType, QueueRemoteSsh::BatchSubmissionResult>
+QueueRemoteSsh::parseBatchSubmissionOutput(const QString &output)
+{
+  QMap<IdType, BatchSubmissionResult> results;
+  const QString marker = QString(batchStatusMarker) + " ";
+
+  QStringList jobOutput;
+  foreach (const QString &line, output.split("\n")) {
+    // The submission output need not end with a newline.
+    const int markerPos = line.indexOf(marker);
+    if (markerPos < 0) {
+      jobOutput << line;
+      continue;
+    }
+    if (markerPos > 0)
+      jobOutput << line.left(markerPos);
+
+    const QStringList fields =
+        line.mid(markerPos + marker.size()).simplified().split(" ");
+    bool idOk = false;
+    bool exitCodeOk = false;
+    if (fields.size() == 2) {
+      const IdType moleQueueId =
+          static_cast<IdType>(fields.at(0).toUInt(&idOk));
+      BatchSubmissionResult result;
+      result.exitCode = fields.at(1).toInt(&exitCodeOk);
+      result.output = jobOutput.join("\n");
+      if (idOk && exitCodeOk)
+        results.insert(moleQueueId, result);
+    }
+    jobOutput.clear();
+  }
+
+  return results;
 }
 
 void QueueRemoteSsh::requestQueueUpdate()
@@ -303,9 +729,31 @@ void QueueRemoteSsh::requestQueueUpdate()
   if (m_jobs.isEmpty())
     return;
 
+  if (!checkHostAvailable())
+    return;
+
   m_isCheckingQueue = true;
+  queueUpdateStarted();
+  m_isCheckingStructuredStatus = m_useStructuredQueueStatus &&
+      supportsStructuredQueueStatus();
+
+  // Too many ids do not fit on one command line, so the queue may be
+  // requested in several parts. The results are collected until the last
+  // reply has arrived.
+  m_queueUpdateIds = m_jobs.keys();
+  m_pendingQueueRequests = splitQueueRequest(m_queueUpdateIds);
+  m_queueUpdateStates.clear();
+  m_queueUpdateStatuses.clear();
+  sendNextQueueRequest();
+}
 
-  const QString command = generateQueueRequestCommand();
+void QueueRemoteSsh::sendNextQueueRequest()
+{
+  QString command =
+      generateQueueRequestCommand(m_pendingQueueRequests.takeFirst());
+  // Keep the complaints about finished jobs out of the structured output.
+  if (m_isCheckingStructuredStatus)
+    command += " 2>/dev/null";
 
   SshConnection *conn = newSshConnection();
   connect(conn, SIGNAL(requestComplete()),
@@ -317,6 +765,7 @@ void QueueRemoteSsh::requestQueueUpdate()
                      .arg(conn->userName()).arg(conn->hostName())
                      .arg(conn->portNumber()));
     conn->deleteLater();
+    abortQueueUpdate();
     return;
   }
 }
@@ -327,10 +776,11 @@ void QueueRemoteSsh::handleQueueUpdate()
   if (!conn) {
     Logger::logError(tr("Internal error: %1\n%2").arg(Q_FUNC_INFO)
                      .arg("Sender is not an SshConnection!"));
-    m_isCheckingQueue = false;
+    abortQueueUpdate();
     return;
   }
   conn->deleteLater();
+  recordConnectionResult(conn);
 
   if (!m_allowedQueueRequestExitCodes.contains(conn->exitCode())) {
     Logger::logWarning(tr("Error requesting queue data (%1 -u %2) on remote "
@@ -339,46 +789,193 @@ void QueueRemoteSsh::handleQueueUpdate()
                        .arg(m_userName).arg(conn->userName())
                        .arg(conn->hostName()).arg(conn->portNumber())
                        .arg(conn->exitCode()).arg(conn->output()));
-    m_isCheckingQueue = false;
+    abortQueueUpdate();
     return;
   }
 
-  QStringList output = conn->output().split("\n", QString::SkipEmptyParts);
+  QHash<IdType, JobState> &states = m_queueUpdateStates;
+  QHash<IdType, QueueJobStatus> &statuses = m_queueUpdateStatuses;
+  if (m_isCheckingStructuredStatus) {
+    QHash<IdType, QueueJobStatus> replyStatuses;
+    if (!parseStructuredQueueOutput(conn->output(), &replyStatuses)) {
+      Logger::logWarning(tr("Cannot parse the queue status of %1 queue '%2'. "
+                            "Output:\n%3")
+                         .arg(typeName()).arg(name()).arg(conn->output()));
+      abortQueueUpdate();
+      return;
+    }
+    for (QHash<IdType, QueueJobStatus>::const_iterator
+         it = replyStatuses.constBegin(), itEnd = replyStatuses.constEnd();
+         it != itEnd; ++it) {
+      states.insert(it.key(), it.value().state);
+      statuses.insert(it.key(), it.value());
+    }
+  }
+  else {
+    parseQueueOutput(conn->output(), &states);
+  }
 
-  // Get list of submitted queue ids so that we detect when jobs have left
-  // the queue.
-  QList<IdType> queueIds = m_jobs.keys();
+  if (!m_pendingQueueRequests.isEmpty()) {
+    sendNextQueueRequest();
+    return;
+  }
 
-  MoleQueue::JobState state;
-  foreach (QString line, output) {
-    IdType queueId;
-    if (parseQueueLine(line, &queueId, &state)) {
-      IdType moleQueueId = m_jobs.value(queueId, InvalidId);
-      if (moleQueueId != InvalidId) {
-        queueIds.removeOne(queueId);
-        // Get pointer to jobmanager to lookup job
-        if (!m_server) {
-          Logger::logError(tr("Queue '%1' cannot locate Server instance!")
-                           .arg(m_name), moleQueueId);
-          m_isCheckingQueue = false;
-          return;
-        }
-        Job job = m_server->jobManager()->lookupJobByMoleQueueId(moleQueueId);
-        if (!job.isValid()) {
-          Logger::logError(tr("Queue '%1' Cannot update invalid Job reference!")
-                           .arg(m_name), moleQueueId);
-          continue;
-        }
-        job.setJobState(state);
-      }
+  // Jobs that are no longer listed have left the queue. Only the jobs that
+  // were known when the update started are considered; m_jobs may change
+  // while the requests are running and while job states are updated.
+  const QMap<IdType, IdType> jobs = m_jobs;
+  QList<IdType> queueIds;
+  bool changed = false;
+  foreach (IdType queueId, m_queueUpdateIds) {
+    QMap<IdType, IdType>::const_iterator jobIt = jobs.constFind(queueId);
+    if (jobIt == jobs.constEnd())
+      continue;
+
+    QHash<IdType, JobState>::const_iterator state = states.constFind(queueId);
+    if (state == states.constEnd()) {
+      queueIds.append(queueId);
+      continue;
     }
+
+    const IdType moleQueueId = jobIt.value();
+    // Get pointer to jobmanager to lookup job
+    if (!m_server) {
+      Logger::logError(tr("Queue '%1' cannot locate Server instance!")
+                       .arg(m_name), moleQueueId);
+      abortQueueUpdate();
+      return;
+    }
+    Job job = m_server->jobManager()->lookupJobByMoleQueueId(moleQueueId);
+    if (!job.isValid()) {
+      Logger::logError(tr("Queue '%1' Cannot update invalid Job reference!")
+                       .arg(m_name), moleQueueId);
+      continue;
+    }
+    if (job.jobState() != state.value())
+      changed = true;
+    setRemoteJobState(job, state.value(),
+                      statuses.value(queueId).wallTimeUsed);
+    if (state.value() == MoleQueue::RunningRemote)
+      streamJobOutput(job);
+  }
+
+  // Report the last known status of the jobs that have left the queue.
+  foreach (IdType queueId, queueIds) {
+    QHash<IdType, QueueJobStatus>::const_iterator status =
+        m_remoteJobStatus.constFind(queueId);
+    if (status != m_remoteJobStatus.constEnd())
+      logFinalJobStatus(jobs.value(queueId), status.value());
   }
+  m_remoteJobStatus = statuses;
+  m_queueUpdateStates.clear();
+  m_queueUpdateStatuses.clear();
 
   // Now copy back any jobs that have left the queue
   foreach (IdType queueId, queueIds)
     beginFinalizeJob(queueId);
 
   m_isCheckingQueue = false;
+  queueUpdateFinished(true, changed || !queueIds.isEmpty());
+}
+
+void QueueRemoteSsh::abortQueueUpdate()
+{
+  m_pendingQueueRequests.clear();
+  m_queueUpdateStates.clear();
+  m_queueUpdateStatuses.clear();
+  m_isCheckingQueue = false;
+  queueUpdateFinished(false);
+}
+
+void QueueRemoteSsh::parseQueueOutput(const QString &queueListOutput,
+                                      QHash<IdType, JobState> *states)
+{
+  const QStringList lines = queueListOutput.split("\n",
+                                                  QString::SkipEmptyParts);
+  IdType queueId;
+  JobState state;
+  foreach (const QString &line, lines) {
+    if (parseQueueLine(line, &queueId, &state))
+      states->insert(queueId, state);
+  }
+}
+
+void QueueRemoteSsh::streamJobOutput(const Job &job)
+{
+  // Skip jobs whose previous update is still in flight.
+  if (m_streamingJobs.contains(job.moleQueueId()))
+    return;
+
+  const Program *program = lookupProgram(job.program());
+  if (!program || program->streamedOutputFiles().isEmpty())
+    return;
+
+  SshConnection *conn = newSshConnection();
+  conn->setData(QVariant::fromValue(job));
+  // The output is copied into the user's files as is, so keep the messages
+  // of ssh out of it.
+  conn->setSeparateOutput(true);
+  connect(conn, SIGNAL(requestComplete()),
+          this, SLOT(jobOutputStreamed()));
+
+  if (!conn->execute(generateOutputStreamCommand(
+                       job, program->streamedOutputFiles()))) {
+    Logger::logError(tr("Could not initialize ssh resources: user= '%1'\nhost ="
+                        " '%2' port = '%3'")
+                     .arg(conn->userName()).arg(conn->hostName())
+                     .arg(conn->portNumber()), job.moleQueueId());
+    conn->deleteLater();
+    return;
+  }
+
+  m_streamingJobs.insert(job.moleQueueId());
+}
+
+void QueueRemoteSsh::jobOutputStreamed()
+{
+  SshConnection *conn = qobject_cast<SshConnection*>(sender());
+  if (!conn) {
+    Logger::logError(tr("Internal error: %1\n%2").arg(Q_FUNC_INFO)
+                     .arg("Sender is not an SshConnection!"));
+    return;
+  }
+  conn->deleteLater();
+  // Streamed output is job output and says nothing about the connection, so
+  // the circuit breaker is left to the other requests.
+
+  Job job = conn->data().value<Job>();
+
+  if (!job.isValid()) {
+    Logger::logError(tr("Internal error: %1\n%2").arg(Q_FUNC_INFO)
+                     .arg("Sender does not have an associated job!"));
+    return;
+  }
+
+  m_streamingJobs.remove(job.moleQueueId());
+
+  // The job has left the queue while the request was in flight. Its output is
+  // being copied back in full, which must not be overwritten.
+  if (!m_jobs.contains(job.queueId()))
+    return;
+
+  if (conn->exitCode() != 0) {
+    Logger::logWarning(tr("Error while streaming job output from remote "
+                          "server:\n%1@%2:%3/%4\nExit code (%5) %6")
+                       .arg(conn->userName()).arg(conn->hostName())
+                       .arg(m_workingDirectoryBase).arg(job.moleQueueId())
+                       .arg(conn->exitCode()).arg(conn->output()),
+                       job.moleQueueId());
+    return;
+  }
+
+  const Program *program = lookupProgram(job.program());
+  if (!program || !m_server)
+    return;
+
+  const QStringList updated = writeStreamedOutput(
+        job, program->streamedOutputFiles(), conn->standardOutput());
+  if (!updated.isEmpty())
+    m_server->jobManager()->setJobOutputAvailable(job.moleQueueId(), updated);
 }
 
 void QueueRemoteSsh::beginFinalizeJob(IdType queueId)
@@ -414,10 +1011,23 @@ void QueueRemoteSsh::finalizeJobCopyFromServer(Job job)
       QString("%1/%2").arg(m_workingDirectoryBase).arg(job.moleQueueId());
   SshConnection *conn = newSshConnection();
   conn->setData(QVariant::fromValue(job));
-  connect(conn, SIGNAL(requestComplete()),
-          this, SLOT(finalizeJobOutputCopiedFromServer()));
 
-  if (!conn->copyDirFrom(remoteDir, localDir)) {
+  // If the program only needs some of the files, list the remote directory
+  // first and copy back the selected files in finalizeJobOutputListed.
+  bool started = false;
+  const Program *program = lookupProgram(job.program());
+  if (program && program->hasOutputFilter()) {
+    connect(conn, SIGNAL(requestComplete()),
+            this, SLOT(finalizeJobOutputListed()));
+    started = conn->execute(generateOutputListingCommand(job, *program));
+  }
+  else {
+    connect(conn, SIGNAL(requestComplete()),
+            this, SLOT(finalizeJobOutputCopiedFromServer()));
+    started = conn->copyDirFrom(remoteDir, localDir);
+  }
+
+  if (!started) {
     Logger::logError(tr("Could not initialize ssh resources: user= '%1'\nhost ="
                         " '%2' port = '%3'")
                      .arg(conn->userName()).arg(conn->hostName())
@@ -428,6 +1038,61 @@ void QueueRemoteSsh::finalizeJobCopyFromServer(Job job)
   }
 }
 
+void QueueRemoteSsh::finalizeJobOutputListed()
+{
+  SshConnection *conn = qobject_cast<SshConnection*>(sender());
+  if (!conn) {
+    Logger::logError(tr("Internal error: %1\n%2").arg(Q_FUNC_INFO)
+                     .arg("Sender is not an SshConnection!"));
+    return;
+  }
+  conn->deleteLater();
+  recordConnectionResult(conn);
+
+  Job job = conn->data().value<Job>();
+
+  if (!job.isValid()) {
+    Logger::logError(tr("Internal error: %1\n%2").arg(Q_FUNC_INFO)
+                     .arg("Sender does not have an associated job!"));
+    return;
+  }
+
+  if (conn->exitCode() != 0) {
+    Logger::logError(tr("Error while listing job output on remote server:\n"
+                        "%1@%2:%3/%4\nExit code (%5) %6")
+                     .arg(conn->userName()).arg(conn->hostName())
+                     .arg(m_workingDirectoryBase).arg(job.moleQueueId())
+                     .arg(conn->exitCode()).arg(conn->output()),
+                     job.moleQueueId());
+    job.setJobState(MoleQueue::Error);
+    return;
+  }
+
+  const QStringList files = selectOutputFiles(job, conn->output());
+  if (files.isEmpty()) {
+    finalizeJobCopyToCustomDestination(job);
+    return;
+  }
+
+  QString remoteDir =
+      QString("%1/%2").arg(m_workingDirectoryBase).arg(job.moleQueueId());
+  SshConnection *copyConn = newSshConnection();
+  copyConn->setData(QVariant::fromValue(job));
+  connect(copyConn, SIGNAL(requestComplete()),
+          this, SLOT(finalizeJobOutputCopiedFromServer()));
+
+  if (!copyConn->copyFilesFrom(remoteDir, files,
+                               job.localWorkingDirectory())) {
+    Logger::logError(tr("Could not initialize ssh resources: user= '%1'\nhost ="
+                        " '%2' port = '%3'")
+                     .arg(copyConn->userName()).arg(copyConn->hostName())
+                     .arg(copyConn->portNumber()), job.moleQueueId());
+    job.setJobState(MoleQueue::Error);
+    copyConn->deleteLater();
+    return;
+  }
+}
+
 void QueueRemoteSsh::finalizeJobOutputCopiedFromServer()
 {
   SshConnection *conn = qobject_cast<SshConnection*>(sender());
@@ -437,6 +1102,7 @@ void QueueRemoteSsh::finalizeJobOutputCopiedFromServer()
     return;
   }
   conn->deleteLater();
+  recordConnectionResult(conn);
 
   Job job = conn->data().value<Job>();
 
@@ -529,6 +1195,7 @@ void QueueRemoteSsh::remoteDirectoryCleaned()
     return;
   }
   conn->deleteLater();
+  recordConnectionResult(conn);
 
   Job job = conn->data().value<Job>();
 
@@ -581,6 +1248,7 @@ void QueueRemoteSsh::endKillJob()
     return;
   }
   conn->deleteLater();
+  recordConnectionResult(conn);
 
   Job job = conn->data().value<Job>();
   if (!job.isValid()) {
@@ -602,28 +1270,483 @@ void QueueRemoteSsh::endKillJob()
   job.setJobState(MoleQueue::Killed);
 }
 
+void QueueRemoteSsh::connectionProbed()
+{
+  SshConnection *conn = qobject_cast<SshConnection*>(sender());
+  if (!conn) {
+    Logger::logError(tr("Internal error: %1\n%2").arg(Q_FUNC_INFO)
+                     .arg("Sender is not an SshConnection!"));
+    return;
+  }
+  conn->deleteLater();
+  recordConnectionResult(conn);
+
+  if (circuitBreaker().state() != CircuitBreaker::Closed)
+    return;
+
+  // Catch up on the work held back while the host was down.
+  submitPendingJobs();
+  resetQueueUpdateBackoff();
+  requestQueueUpdate();
+}
+
+QVariantHash QueueRemoteSsh::status() const
+{
+  QVariantHash result = QueueRemote::status();
+  result.insert("connection", circuitBreaker().toHash());
+  return result;
+}
+
+CircuitBreaker &QueueRemoteSsh::circuitBreaker()
+{
+  if (m_queueManager)
+    return m_queueManager->hostCircuitBreaker(m_hostName, m_sshPort);
+  return m_circuitBreaker;
+}
+
+const CircuitBreaker &QueueRemoteSsh::circuitBreaker() const
+{
+  // The breaker of a host is created on first use.
+  return const_cast<QueueRemoteSsh*>(this)->circuitBreaker();
+}
+
+bool QueueRemoteSsh::isConnectionFailure(const SshConnection *conn)
+{
+  if (conn->exitCode() == 0)
+    return false;
+
+  const QString output = conn->output();
+  for (size_t i = 0; i < sizeof(connectionFailureMessages) /
+       sizeof(connectionFailureMessages[0]); ++i) {
+    if (output.contains(QLatin1String(connectionFailureMessages[i]),
+                        Qt::CaseInsensitive)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void QueueRemoteSsh::recordConnectionResult(const SshConnection *conn)
+{
+  CircuitBreaker &breaker = circuitBreaker();
+  const CircuitBreaker::State oldState = breaker.state();
+
+  if (!isConnectionFailure(conn)) {
+    breaker.recordSuccess();
+    if (oldState != CircuitBreaker::Closed) {
+      Logger::logNotification(tr("Host %1:%2 is reachable again. Resuming "
+                                 "queue '%3'.")
+                              .arg(m_hostName).arg(m_sshPort).arg(m_name));
+    }
+    return;
+  }
+
+  breaker.recordFailure(QDateTime::currentDateTime());
+  if (breaker.state() == CircuitBreaker::Open &&
+      oldState == CircuitBreaker::Closed) {
+    Logger::logWarning(tr("Cannot reach host %1:%2 after %3 attempts. Pausing "
+                          "queue '%4' until %5.")
+                       .arg(m_hostName).arg(m_sshPort)
+                       .arg(breaker.consecutiveFailures()).arg(m_name)
+                       .arg(breaker.retryTime().toString()));
+  }
+}
+
+bool QueueRemoteSsh::checkHostAvailable()
+{
+  const QDateTime now = QDateTime::currentDateTime();
+  CircuitBreaker &breaker = circuitBreaker();
+  if (breaker.allowsRequests(now))
+    return true;
+
+  if (breaker.allowsProbe(now))
+    sendConnectionProbe();
+  return false;
+}
+
+void QueueRemoteSsh::sendConnectionProbe()
+{
+  circuitBreaker().probeStarted();
+
+  SshConnection *conn = newSshConnection();
+  connect(conn, SIGNAL(requestComplete()), this, SLOT(connectionProbed()));
+
+  if (!conn->execute("true")) {
+    Logger::logError(tr("Could not initialize ssh resources: user= '%1'\nhost ="
+                        " '%2' port = '%3'")
+                     .arg(conn->userName()).arg(conn->hostName())
+                     .arg(conn->portNumber()));
+    conn->deleteLater();
+    circuitBreaker().recordFailure(QDateTime::currentDateTime());
+    return;
+  }
+}
+
 SshConnection *QueueRemoteSsh::newSshConnection()
 {
   SshCommand *command = SshCommandFactory::instance()->newSshCommand();
+  configureSshCommand(command);
+  return command;
+}
+
+void QueueRemoteSsh::configureSshCommand(SshCommand *command)
+{
   command->setSshCommand(m_sshExecutable);
   command->setScpCommand(m_scpExecutable);
   command->setHostName(m_hostName);
   command->setUserName(m_userName);
   command->setIdentityFile(m_identityFile);
   command->setPortNumber(m_sshPort);
+  command->setPersistent(m_shareConnections);
+  // Without a private directory for the socket, don't share the connection.
+  command->setControlPath(m_shareConnections && createControlDirectory()
+                          ? controlPath() : QString());
+  command->setDirectoryTransferMode(m_directoryTransferMode);
+}
 
-  return command;
+QString QueueRemoteSsh::controlDirectory() const
+{
+  const QString base = m_server ? m_server->workingDirectoryBase()
+                                : QDir::homePath() + "/.molequeue";
+  return QDir::cleanPath(base + "/ssh");
 }
 
-QString QueueRemoteSsh::generateQueueRequestCommand()
+bool QueueRemoteSsh::createControlDirectory()
 {
-  QList<IdType> queueIds = m_jobs.keys();
-  QString queueIdString;
+  // The directory follows the server's working directory, so check again if
+  // that has changed.
+  const QString dir = controlDirectory();
+  if (dir == m_checkedControlDirectory)
+    return m_controlDirectoryUsable;
+  m_checkedControlDirectory = dir;
+
+  // The sockets give access to the remote account, so only the user may use
+  // the directory.
+  m_controlDirectoryUsable = QDir().mkpath(dir) &&
+      QFile::setPermissions(dir, QFile::ReadOwner | QFile::WriteOwner |
+                            QFile::ExeOwner);
+  if (!m_controlDirectoryUsable) {
+    Logger::logWarning(tr("Cannot create private directory '%1' for shared "
+                          "ssh connections. Connections of queue '%2' will "
+                          "not be shared.").arg(dir).arg(m_name));
+  }
+  return m_controlDirectoryUsable;
+}
+
+QString QueueRemoteSsh::controlPath() const
+{
+  // Unix socket paths are limited to ~100 characters, so use a short hash of
+  // the connection details rather than the details themselves. The queue name
+  // is part of the key, so closing this queue's master connection does not
+  // affect other queues on the same host.
+  const QByteArray key = QString("%1@%2:%3/%4").arg(m_userName).arg(m_hostName)
+      .arg(m_sshPort).arg(name()).toUtf8();
+  const QByteArray hash =
+      QCryptographicHash::hash(key, QCryptographicHash::Md5).toHex().left(16);
+  return controlDirectory() + "/" + QString(hash);
+}
+
+void QueueRemoteSsh::closeSharedConnection()
+{
+#ifndef WIN32
+  if (!m_shareConnections || m_hostName.isEmpty())
+    return;
+
+  QStringList args;
+  args << "-o" << "ControlPath=" + controlPath() << "-O" << "exit";
+  if (m_sshPort >= 0 && m_sshPort != 22)
+    args << "-p" << QString::number(m_sshPort);
+  args << (m_userName.isEmpty() ? m_hostName
+                                : m_userName + "@" + m_hostName);
+  QProcess::startDetached(m_sshExecutable, args);
+#endif // WIN32
+}
+
+QList<QList<IdType> >
+QueueRemoteSsh::splitQueueRequest(const QList<IdType> &queueIds) const
+{
+  QList<QList<IdType> > requests;
+  QList<IdType> request;
+  int length = 0;
+  foreach (IdType id, queueIds) {
+    // Each id is followed by a space.
+    const int idLength = QString::number(id).size() + 1;
+    if (!request.isEmpty() && length + idLength > m_maxQueueRequestLength) {
+      requests.append(request);
+      request.clear();
+      length = 0;
+    }
+    request.append(id);
+    length += idLength;
+  }
+  if (!request.isEmpty() || requests.isEmpty())
+    requests.append(request);
+  return requests;
+}
+
+QString QueueRemoteSsh::generateQueueRequestCommand(
+    const QList<IdType> &queueIds)
+{
+  const QString program = queueRequestProgram();
+  QString command;
+  command.reserve(program.size() + 1 + queueIds.size() * 11);
+  command += program;
+  command += QLatin1Char(' ');
   foreach (IdType id, queueIds) {
-    queueIdString += QString::number(id) + " ";
+    command += QString::number(id);
+    command += QLatin1Char(' ');
   }
+  return command;
+}
+
+QString QueueRemoteSsh::structuredQueueRequestArguments() const
+{
+  return QString();
+}
+
+QString QueueRemoteSsh::queueRequestProgram() const
+{
+  if (m_useStructuredQueueStatus && supportsStructuredQueueStatus()) {
+    return QString("%1 %2").arg(m_requestQueueCommand)
+        .arg(structuredQueueRequestArguments());
+  }
+  return m_requestQueueCommand;
+}
+
+bool QueueRemoteSsh::parseStructuredQueueOutput(
+    const QString &queueListOutput, QHash<IdType, QueueJobStatus> *statuses)
+{
+  Q_UNUSED(queueListOutput);
+  Q_UNUSED(statuses);
+  return false;
+}
+
+void QueueRemoteSsh::logFinalJobStatus(IdType moleQueueId,
+                                       const QueueJobStatus &status)
+{
+  const QString unknown = tr("unknown");
+  QString wallTime = unknown;
+  if (status.wallTimeUsed >= 0) {
+    const int minutes = status.wallTimeUsed / 60;
+    wallTime = QString("%1:%2:%3").arg(minutes / 60)
+        .arg(minutes % 60, 2, 10, QLatin1Char('0'))
+        .arg(status.wallTimeUsed % 60, 2, 10, QLatin1Char('0'));
+  }
+  const QString message =
+      tr("Job left %1 queue '%2'. Exit status: %3, walltime used: %4, "
+         "nodes: %5")
+      .arg(typeName()).arg(name())
+      .arg(status.hasExitStatus ? QString::number(status.exitStatus)
+                                : unknown)
+      .arg(wallTime)
+      .arg(status.nodes.isEmpty() ? unknown : status.nodes.join(", "));
+
+  if (status.hasExitStatus && status.exitStatus != 0)
+    Logger::logWarning(message, moleQueueId);
+  else
+    Logger::logDebugMessage(message, moleQueueId);
+}
+
+QString QueueRemoteSsh::generateOutputListingCommand(
+    const Job &job, const Program &program) const
+{
+  QString command = QString("cd %1/%2 && echo %3 && "
+                            "find . -type f -exec wc -c {} + && echo %4")
+      .arg(m_workingDirectoryBase).arg(job.moleQueueId())
+      .arg(outputFilesMarker).arg(outputChecksumsMarker);
+
+  if (!program.skipUnchangedOutput())
+    return command;
+
+  // Only files that also exist locally can be unchanged.
+  QDir localDir(job.localWorkingDirectory());
+  QStringList localFiles;
+  int length = 0;
+  QDirIterator it(localDir.absolutePath(), QDir::Files | QDir::Hidden,
+                  QDirIterator::Subdirectories);
+  while (it.hasNext()) {
+    const QString path = localDir.relativeFilePath(it.next());
+    if (program.isOutputFileIncluded(path)) {
+      localFiles << SshConnection::shellQuote(path);
+      length += localFiles.last().size() + 1;
+    }
+  }
+
+  if (localFiles.isEmpty())
+    return command;
+
+  // A long list would exceed the command line limit of the remote shell.
+  // Checksum every remote file instead; selectOutputFiles() ignores the ones
+  // without a local copy.
+  if (length > m_maxQueueRequestLength)
+    return command + " && find . -type f -exec cksum {} +";
+
+  // Files that were deleted on the host are ignored.
+  command += QString(" && (cksum %1 2>/dev/null; exit 0)")
+      .arg(localFiles.join(" "));
+
+  return command;
+}
+
+QStringList QueueRemoteSsh::selectOutputFiles(const Job &job,
+                                              const QString &listing) const
+{
+  // "<size> ./<path>" from wc and "<checksum> <size> <path>" from cksum. The
+  // totals printed by wc do not start with "./".
+  QRegExp sizeParser("^\\s*(\\d+)\\s\\./(.+)$");
+  QRegExp checksumParser("^(\\d+)\\s+(\\d+)\\s(.+)$");
+
+  QMap<QString, qint64> sizes;
+  QMap<QString, quint32> checksums;
+  bool inChecksums = false;
+  foreach (const QString &line, listing.split("\n")) {
+    if (line == outputChecksumsMarker)
+      inChecksums = true;
+    else if (inChecksums && checksumParser.indexIn(line) != -1) {
+      // Paths listed by find start with "./".
+      QString path = checksumParser.cap(3);
+      if (path.startsWith("./"))
+        path.remove(0, 2);
+      checksums.insert(path, checksumParser.cap(1).toUInt());
+    }
+    else if (!inChecksums && sizeParser.indexIn(line) != -1)
+      sizes.insert(sizeParser.cap(2), sizeParser.cap(1).toLongLong());
+  }
+
+  // The program may have been removed since the job was submitted, in which
+  // case everything is copied back.
+  const Program *program = lookupProgram(job.program());
+  const QString localDir = job.localWorkingDirectory();
+
+  QStringList files;
+  for (QMap<QString, qint64>::const_iterator it = sizes.constBegin(),
+       itEnd = sizes.constEnd(); it != itEnd; ++it) {
+    const QString &path = it.key();
+    if (program && !program->isOutputFileIncluded(path))
+      continue;
+
+    if (program && program->skipUnchangedOutput() &&
+        checksums.contains(path)) {
+      const QString localFile = localDir + "/" + path;
+      quint32 localChecksum = 0;
+      if (QFileInfo(localFile).size() == it.value() &&
+          fileChecksum(localFile, &localChecksum) &&
+          localChecksum == checksums.value(path)) {
+        continue;
+      }
+    }
+
+    files << path;
+  }
+
+  return files;
+}
+
+QString QueueRemoteSsh::generateOutputStreamCommand(
+    const Job &job, const QStringList &files) const
+{
+  // Resume each file at the size of the local copy. The remote size is read
+  // first so that a file that grows meanwhile is sent consistently.
+  QStringList commands;
+  foreach (const QString &file, files) {
+    const qint64 offset =
+        QFileInfo(job.localWorkingDirectory() + "/" + file).size();
+    commands << QString("f=%1; o=%2; if [ -f \"$f\" ]; then "
+                        "n=$(($(wc -c < \"$f\"))); "
+                        "if [ $n -lt $o ]; then o=0; fi; "
+                        "if [ $n -gt $o ]; then echo \"%3 $o $n $f\"; "
+                        "tail -c +$((o + 1)) \"$f\" | head -c $((n - o)); "
+                        "fi; fi")
+                .arg(SshConnection::shellQuote(file)).arg(offset)
+                .arg(outputStreamMarker);
+  }
+
+  return QString("cd %1/%2 && { %3; }").arg(m_workingDirectoryBase)
+      .arg(job.moleQueueId()).arg(commands.join("; "));
+}
+
+QStringList QueueRemoteSsh::writeStreamedOutput(const Job &job,
+                                                const QStringList &files,
+                                                const QByteArray &output) const
+{
+  QStringList updated;
+  const QByteArray marker = QByteArray(outputStreamMarker) + " ";
+
+  int pos = 0;
+  while ((pos = output.indexOf(marker, pos)) != -1) {
+    const int endOfHeader = output.indexOf('\n', pos);
+    if (endOfHeader == -1)
+      break;
+
+    // "<offset> <size> <name>"
+    const QString header = QString::fromLatin1(
+          output.constData() + pos + marker.size(),
+          endOfHeader - pos - marker.size());
+    bool offsetOk = false;
+    bool sizeOk = false;
+    const qint64 offset = header.section(' ', 0, 0).toLongLong(&offsetOk);
+    const qint64 size = header.section(' ', 1, 1).toLongLong(&sizeOk);
+    const QString fileName = header.section(' ', 2);
+
+    pos = endOfHeader + 1;
+    if (!offsetOk || !sizeOk || offset < 0 || size <= offset)
+      continue;
+
+    const QByteArray data = output.mid(pos, static_cast<int>(size - offset));
+    pos += data.size();
+
+    // Only write the files that were asked for, never e.g. "../x".
+    if (!files.contains(fileName))
+      continue;
+
+    // The local copy may not be shorter than the offset it was resumed at,
+    // otherwise there would be a gap.
+    QFile file(job.localWorkingDirectory() + "/" + fileName);
+    if (file.exists() && file.size() < offset)
+      continue;
+    QDir().mkpath(QFileInfo(file).absolutePath());
+    if (!file.open(QFile::ReadWrite) || !file.resize(offset) ||
+        !file.seek(offset) || file.write(data) != data.size()) {
+      Logger::logWarning(tr("Cannot write streamed output to '%1': %2")
+                         .arg(file.fileName()).arg(file.errorString()),
+                         job.moleQueueId());
+      continue;
+    }
+
+    if (!updated.contains(fileName))
+      updated << fileName;
+  }
+
+  return updated;
+}
+
+bool QueueRemoteSsh::fileChecksum(const QString &fileName, quint32 *checksum)
+{
+  QFile file(fileName);
+  if (!file.open(QFile::ReadOnly))
+    return false;
+
+  const quint32 *table = cksumTable();
+  quint32 crc = 0;
+  quint64 length = 0;
+  char buffer[65536];
+  qint64 bytesRead;
+  while ((bytesRead = file.read(buffer, sizeof(buffer))) > 0) {
+    for (qint64 i = 0; i < bytesRead; ++i) {
+      crc = (crc << 8) ^
+          table[((crc >> 24) ^ static_cast<uchar>(buffer[i])) & 0xFF];
+    }
+    length += static_cast<quint64>(bytesRead);
+  }
+  if (bytesRead < 0)
+    return false;
+
+  // The length is appended, least significant byte first, without zeros.
+  for (; length != 0; length >>= 8)
+    crc = (crc << 8) ^ table[((crc >> 24) ^ length) & 0xFF];
 
-  return QString ("%1 %2").arg(m_requestQueueCommand).arg(queueIdString);
+  *checksum = ~crc;
+  return true;
 }
 
 } // End namespace
@@ -18,6 +18,11 @@
 #define QUEUEREMOTESSH_H
 
 #include "remote.h"
+#include "circuitbreaker.h"
+#include "queuestatusparser.h"
+#include "../sshcommand.h"
+
+#include <QtCore/QSet>
 
 class QTimer;
 
@@ -155,12 +160,87 @@ public:
     return m_requestQueueCommand;
   }
 
+  /**
+   * If @a share is true, all ssh and scp commands of this queue reuse a single
+   * authenticated connection to the host instead of connecting and
+   * authenticating for each command. With OpenSSH, the connection stays open
+   * for a while after the last command. Default: false
+   */
+  void setShareConnections(bool share)
+  {
+    m_shareConnections = share;
+  }
+
+  bool shareConnections() const
+  {
+    return m_shareConnections;
+  }
+
+  /// @return The path of the socket used to share the connection to the host.
+  /// Each queue has its own socket in controlDirectory().
+  QString controlPath() const;
+
+  /// @return The directory holding the sockets of shared connections. It is
+  /// in the server's working directory and only accessible by the user.
+  QString controlDirectory() const;
+
+  /**
+   * Set how job directories are copied to and from the host. Archive
+   * transfers are much faster for jobs with many files, but need tar on both
+   * hosts. Default: SshCommand::ScpTransfer
+   */
+  void setDirectoryTransferMode(SshCommand::DirectoryTransferMode mode)
+  {
+    m_directoryTransferMode = mode;
+  }
+
+  SshCommand::DirectoryTransferMode directoryTransferMode() const
+  {
+    return m_directoryTransferMode;
+  }
+
+  /**
+   * If @a use is true and the queuing system supports it, the queue status is
+   * requested in a machine-readable format, which also reports the exit
+   * status, walltime used and nodes of each job. Default: false
+   * @sa supportsStructuredQueueStatus()
+   */
+  void setUseStructuredQueueStatus(bool use)
+  {
+    m_useStructuredQueueStatus = use;
+  }
+
+  bool useStructuredQueueStatus() const
+  {
+    return m_useStructuredQueueStatus;
+  }
+
+  /// @return True if this queue can request a machine-readable queue status.
+  bool supportsStructuredQueueStatus() const
+  {
+    return !structuredQueueRequestArguments().isEmpty();
+  }
+
   virtual AbstractQueueSettingsWidget* settingsWidget();
 
+  /// Reimplemented from QueueRemote::status. The state of the connection to
+  /// the host is stored as "connection", see CircuitBreaker::toHash().
+  QVariantHash status() const;
+
+  /**
+   * @return The circuit breaker of the host of this queue, see
+   * QueueManager::hostCircuitBreaker(). A queue without a QueueManager has
+   * its own.
+   */
+  CircuitBreaker &circuitBreaker();
+  const CircuitBreaker &circuitBreaker() const;
+
 public slots:
   void requestQueueUpdate();
 
 protected slots:
+  /// Reimplemented to submit several pending jobs as one batch.
+  void submitPendingJobs();
 
   void createRemoteDirectory(MoleQueue::Job job);
   void remoteDirectoryCreated();
@@ -168,10 +248,22 @@ protected slots:
   void inputFilesCopied();
   void submitJobToRemoteQueue(MoleQueue::Job job);
   void jobSubmittedToRemoteQueue();
+
+  void createBatchDirectory(int batchId);
+  void batchDirectoryCreated();
+  void copyBatchInputFilesToHost(int batchId);
+  void batchInputFilesCopied();
+  void submitBatchToRemoteQueue(int batchId);
+  void batchSubmittedToRemoteQueue();
+
   void handleQueueUpdate();
 
+  void streamJobOutput(const MoleQueue::Job &job);
+  void jobOutputStreamed();
+
   void beginFinalizeJob(MoleQueue::IdType queueId);
   void finalizeJobCopyFromServer(MoleQueue::Job job);
+  void finalizeJobOutputListed();
   void finalizeJobOutputCopiedFromServer();
   void finalizeJobCopyToCustomDestination(MoleQueue::Job job);
   void finalizeJobCleanup(MoleQueue::Job job);
@@ -182,12 +274,135 @@ protected slots:
   void beginKillJob(MoleQueue::Job job);
   void endKillJob();
 
+  void connectionProbed();
+
 protected:
   /**
    * @return a new SshConnection, the caller assumes ownership
    */
   virtual SshConnection *newSshConnection();
 
+  /// Apply this queue's connection settings to @a command.
+  void configureSshCommand(SshCommand *command);
+
+  /// Ask the shared master connection to the current host to exit, if
+  /// connection sharing is enabled.
+  void closeSharedConnection();
+
+  /// Create controlDirectory() if needed and make it private to the user.
+  /// This is done once per directory, and the result is cached.
+  /// @return True if the directory can be used.
+  bool createControlDirectory();
+
+  /// @return True if @a conn could not reach the host, as opposed to a
+  /// remote command that failed. Successful commands never count.
+  static bool isConnectionFailure(const SshConnection *conn);
+
+  /// Record in the circuit breaker whether @a conn reached the host.
+  void recordConnectionResult(const SshConnection *conn);
+
+  /**
+   * @return True if requests may be sent to the host now. If the circuit
+   * breaker is open and its backoff delay has passed, a single probe is sent
+   * and the queue resumes once it succeeds.
+   */
+  bool checkHostAvailable();
+
+  /// Run a cheap command on the host to find out whether it is reachable.
+  void sendConnectionProbe();
+
+  /**
+   * Submit @a jobs, whose input files have already been written, as a single
+   * batch: the remote working directory is created once, all input
+   * directories are copied in one transfer and a single remote command runs
+   * m_submissionCommand for each job.
+   */
+  void beginBatchSubmission(const QList<Job> &jobs);
+
+  /// Log @a message for each job in the batch, requeue the jobs that have not
+  /// exceeded their retry limit and discard the batch. If
+  /// @a connectionFailure is true, the host could not be reached and the
+  /// failure does not count against the retry limit.
+  void failBatch(int batchId, const QString &message,
+                 bool connectionFailure = false);
+
+  /**
+   * @return A shell command that runs m_submissionCommand in the remote
+   * working directory of each of @a jobs. After each submission, a line
+   * containing batchStatusMarker, the MoleQueue id and the exit code of the
+   * submission command is printed.
+   */
+  QString generateBatchSubmissionCommand(const QList<Job> &jobs) const;
+
+  /// Outcome of a single submission in a batch.
+  struct BatchSubmissionResult
+  {
+    BatchSubmissionResult() : exitCode(-1) {}
+    int exitCode;
+    /// Output of m_submissionCommand, suitable for parseQueueId().
+    QString output;
+  };
+
+  /**
+   * Split the output of the command from generateBatchSubmissionCommand() into
+   * the results of the individual submissions.
+   * @return The results, keyed by MoleQueue id. Jobs that do not appear in the
+   * output were not submitted.
+   */
+  static QMap<IdType, BatchSubmissionResult> parseBatchSubmissionOutput(
+      const QString &output);
+
+  /// Prefix of the status lines written by generateBatchSubmissionCommand().
+  static const char batchStatusMarker[];
+
+  /**
+   * @return A shell command that lists the size of each file in the remote
+   * working directory of @a job. If @a program skips unchanged output, the
+   * checksums of the remote copies of the job's local files are listed too,
+   * or of all remote files if the local ones are too many to name.
+   * The two lists follow lines containing outputFilesMarker and
+   * outputChecksumsMarker.
+   */
+  QString generateOutputListingCommand(const Job &job,
+                                       const Program &program) const;
+
+  /**
+   * @return The files listed in @a listing, the output of the command from
+   * generateOutputListingCommand(), that should be copied back to the local
+   * working directory of @a job according to the settings of its program.
+   */
+  QStringList selectOutputFiles(const Job &job, const QString &listing) const;
+
+  /**
+   * @return A shell command that prints the part of each of @a files in the
+   * remote working directory of @a job that has not been copied to the local
+   * working directory yet. Each part follows a line containing
+   * outputStreamMarker, the offset and size of the remote file and its name.
+   * Files that have become shorter are sent again from the start.
+   */
+  QString generateOutputStreamCommand(const Job &job,
+                                      const QStringList &files) const;
+
+  /**
+   * Append the parts of @a files in @a output, the output of the command from
+   * generateOutputStreamCommand(), to the files in the local working directory
+   * of @a job.
+   * @return The files that have been updated.
+   */
+  QStringList writeStreamedOutput(const Job &job, const QStringList &files,
+                                  const QByteArray &output) const;
+
+  /// Marker written by generateOutputStreamCommand().
+  static const char outputStreamMarker[];
+
+  /// Compute the checksum of @a fileName like POSIX cksum does.
+  /// @return True if the file could be read.
+  static bool fileChecksum(const QString &fileName, quint32 *checksum);
+
+  /// Markers written by generateOutputListingCommand().
+  static const char outputFilesMarker[];
+  static const char outputChecksumsMarker[];
+
   /**
    * Extract the job id from the submission output. Reimplement this in derived
    * classes.
@@ -198,11 +413,26 @@ protected:
   virtual bool parseQueueId(const QString &submissionOutput, IdType *queueId) = 0;
 
   /**
-   * Prepare the command to check the remote queue. The default implementation
-   * is m_requestQueueCommand followed by the owned job ids separated by
-   * spaces.
+   * Split @a queueIds, the ids of all jobs in the queue, into the lists passed
+   * to generateQueueRequestCommand(), so that no command line gets longer
+   * than about m_maxQueueRequestLength. Reimplement this to return a single
+   * empty list if the queuing system lists the jobs of a user instead.
    */
-  virtual QString generateQueueRequestCommand();
+  virtual QList<QList<IdType> > splitQueueRequest(
+      const QList<IdType> &queueIds) const;
+
+  /**
+   * Prepare the command to check the jobs with ids @a queueIds in the remote
+   * queue. The default implementation is queueRequestProgram() followed by
+   * @a queueIds separated by spaces.
+   */
+  virtual QString generateQueueRequestCommand(const QList<IdType> &queueIds);
+
+  /// Send the first of m_pendingQueueRequests.
+  void sendNextQueueRequest();
+
+  /// Abandon the current queue update after an error.
+  void abortQueueUpdate();
 
   /**
    * Extract the queueId and JobState from a single line of the the queue list
@@ -215,13 +445,59 @@ protected:
   virtual bool parseQueueLine(const QString &queueListOutput, IdType *queueId,
                               MoleQueue::JobState *state) = 0;
 
+  /**
+   * Extract the queueId and JobState of all jobs listed in the output of
+   * m_requestQueueCommand. The default implementation calls parseQueueLine()
+   * for each line. Reimplement this to parse the whole output in one pass.
+   * @param states Receives the state of each listed job, keyed by queueId.
+   */
+  virtual void parseQueueOutput(const QString &queueListOutput,
+                                QHash<IdType, MoleQueue::JobState> *states);
+
+  /**
+   * @return The arguments that make m_requestQueueCommand print the queue
+   * status in a machine-readable format, or an empty string if the queuing
+   * system has no such format. Reimplement this together with
+   * parseStructuredQueueOutput().
+   */
+  virtual QString structuredQueueRequestArguments() const;
+
+  /// @return m_requestQueueCommand, followed by
+  /// structuredQueueRequestArguments() if the structured status is used.
+  QString queueRequestProgram() const;
+
+  /**
+   * Extract the status of all jobs listed in the machine-readable output of
+   * m_requestQueueCommand. Jobs in unknown states are not added to
+   * @a statuses.
+   * @return False if the output could not be parsed.
+   */
+  virtual bool parseStructuredQueueOutput(
+      const QString &queueListOutput,
+      QHash<IdType, QueueJobStatus> *statuses);
+
+  /// Log the last status reported for the job with MoleQueue id
+  /// @a moleQueueId, which has left the remote queue.
+  void logFinalJobStatus(IdType moleQueueId, const QueueJobStatus &status);
+
   QString m_sshExecutable;
   QString m_scpExecutable;
   QString m_hostName;
   QString m_userName;
   QString m_identityFile;
   int m_sshPort;
+  bool m_shareConnections;
+  /// The control directory last checked by createControlDirectory(), and
+  /// whether it could be used.
+  QString m_checkedControlDirectory;
+  bool m_controlDirectoryUsable;
+  /// Used by circuitBreaker() when there is no QueueManager.
+  CircuitBreaker m_circuitBreaker;
+  SshCommand::DirectoryTransferMode m_directoryTransferMode;
+  bool m_useStructuredQueueStatus;
   bool m_isCheckingQueue;
+  /// True if the pending queue request asked for the structured status.
+  bool m_isCheckingStructuredStatus;
 
   QString m_submissionCommand;
   QString m_killCommand;
@@ -232,6 +508,27 @@ protected:
   /// has completed.
   QList<int> m_allowedQueueRequestExitCodes;
 
+  /// Jobs being submitted in batches, keyed by batch id.
+  QMap<int, QList<Job> > m_submissionBatches;
+  int m_nextSubmissionBatchId;
+
+  /// MoleQueue ids of the jobs whose output is being streamed.
+  QSet<IdType> m_streamingJobs;
+
+  /// Last structured status of the jobs in the remote queue, keyed by queueId.
+  QHash<IdType, QueueJobStatus> m_remoteJobStatus;
+
+  /// Upper limit on the length of the job id list in a queue request, and of
+  /// the file list in an output listing.
+  int m_maxQueueRequestLength;
+  /// Ids of the jobs checked by the current queue update.
+  QList<IdType> m_queueUpdateIds;
+  /// Job id lists of the queue requests that are still to be sent.
+  QList<QList<IdType> > m_pendingQueueRequests;
+  /// States and structured statuses collected by the current queue update.
+  QHash<IdType, JobState> m_queueUpdateStates;
+  QHash<IdType, QueueJobStatus> m_queueUpdateStatuses;
+
 };
 
 } // End namespace
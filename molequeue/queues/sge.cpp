@@ -18,13 +18,46 @@
 
 #include "logger.h"
 
+#include <QtCore/QDateTime>
 #include <QtCore/QDebug>
+#include <QtCore/QRegExp>
+#include <QtCore/QXmlStreamReader>
+
+namespace {
+// Parse an ISO 8601 time stamp written by qstat. An offset or "Z" is honored.
+// SGE normally writes the local time of the qmaster host without an offset,
+// which cannot be told from this host; such times are assumed to be in the
+// local time zone.
+QDateTime parseSgeTime(const QString &text)
+{
+  QRegExp parser("(\\d{4}-\\d{2}-\\d{2}T\\d{2}:\\d{2}:\\d{2})(\\.\\d+)?"
+                 "(Z|[+-]\\d{2}:?\\d{2})?");
+  if (!parser.exactMatch(text))
+    return QDateTime();
+
+  QDateTime time = QDateTime::fromString(parser.cap(1),
+                                         "yyyy-MM-dd'T'HH:mm:ss");
+  const QString zone = parser.cap(3);
+  if (!time.isValid() || zone.isEmpty())
+    return time;
+
+  time.setTimeSpec(Qt::UTC);
+  if (zone != QLatin1String("Z")) {
+    const QString digits = QString(zone.mid(1)).remove(':');
+    const int offset =
+        (digits.left(2).toInt() * 60 + digits.mid(2).toInt()) * 60;
+    time = time.addSecs(zone.startsWith('-') ? offset : -offset);
+  }
+  return time;
+}
+}
 
 namespace MoleQueue
 {
 
 QueueSge::QueueSge(QueueManager *parentManager) :
-  QueueRemoteSsh("Remote (SGE)", parentManager)
+  QueueRemoteSsh("Remote (SGE)", parentManager),
+  m_statusParser(0, 4)
 {
   m_submissionCommand = "qsub";
   m_killCommand = "qdel";
@@ -42,6 +75,17 @@ QueueSge::QueueSge(QueueManager *parentManager) :
       "#$ -l h_rt=$$maxWallTime$$\n"
       "\n"
       "$$programExecution$$\n";
+
+  m_statusParser.addState("r", MoleQueue::RunningRemote);
+  // mark deleted/errored jobs as running for now
+  m_statusParser.addState("d", MoleQueue::RunningRemote);
+  m_statusParser.addState("e", MoleQueue::RunningRemote);
+  m_statusParser.addState("qw", MoleQueue::RemoteQueued);
+  m_statusParser.addState("q", MoleQueue::RemoteQueued);
+  m_statusParser.addState("w", MoleQueue::RemoteQueued);
+  m_statusParser.addState("s", MoleQueue::RemoteQueued);
+  m_statusParser.addState("h", MoleQueue::RemoteQueued);
+  m_statusParser.addState("t", MoleQueue::RemoteQueued);
 }
 
 QueueSge::~QueueSge()
@@ -63,9 +107,23 @@ bool QueueSge::parseQueueId(const QString &submissionOutput, IdType *queueId)
   return false;
 }
 
-QString QueueSge::generateQueueRequestCommand()
+QList<QList<IdType> >
+QueueSge::splitQueueRequest(const QList<IdType> &queueIds) const
 {
-  return QString ("%1 -u %2").arg(m_requestQueueCommand).arg(m_userName);
+  Q_UNUSED(queueIds);
+  // All jobs of the user are listed by a single request.
+  return QList<QList<IdType> >() << QList<IdType>();
+}
+
+QString QueueSge::generateQueueRequestCommand(const QList<IdType> &queueIds)
+{
+  Q_UNUSED(queueIds);
+  return QString ("%1 -u %2").arg(queueRequestProgram()).arg(m_userName);
+}
+
+QString QueueSge::structuredQueueRequestArguments() const
+{
+  return "-xml";
 }
 
 bool QueueSge::parseQueueLine(const QString &queueListOutput,
@@ -87,45 +145,139 @@ bool QueueSge::parseQueueLine(const QString &queueListOutput,
   //  236      5       word         elaine    qw      07/13/96
   //                                                  20:32:07
   //  235      0       andrun       penny     qw      07/13/96 20:31:43
-  QRegExp parser ("^\\s*(\\d+)" // job-ID
-                  "\\s+\\S+"    // prior
-                  "\\s+\\S+"    // name
-                  "\\s+\\S+"    // user
-                  "\\s+(\\w+)"); // state
-
-  QString stateStr;
-  int ind = parser.indexIn(queueListOutput);
-  if (ind >= 0) {
-    bool ok;
-    *queueId = static_cast<IdType>(parser.cap(1).toInt(&ok));
-    if (!ok)
-      return false;
-    stateStr = parser.cap(2).toLower();
-
-    if (stateStr == "r" ||
-        stateStr == "d" || // mark deleted/errored jobs as running for now
-        stateStr == "e") {
-      *state = MoleQueue::RunningRemote;
-      return true;
-    }
-    else if (stateStr == "qw"||
-             stateStr == "q" ||
-             stateStr == "w" ||
-             stateStr == "s" ||
-             stateStr == "h" ||
-             stateStr == "t") {
-      *state = MoleQueue::RemoteQueued;
-      return true;
+  QStringRef stateStr;
+  switch (m_statusParser.parseLine(queueListOutput, queueId, state,
+                                   &stateStr)) {
+  case QueueStatusParser::KnownState:
+    return true;
+  case QueueStatusParser::UnknownState:
+    Logger::logWarning(tr("Unrecognized queue state '%1' in %2 queue '%3'. "
+                          "Queue line:\n%4")
+                       .arg(stateStr.toString().toLower()).arg(typeName())
+                       .arg(name()).arg(queueListOutput));
+    return false;
+  case QueueStatusParser::NoJob:
+    break;
+  }
+  return false;
+}
+
+void QueueSge::parseQueueOutput(const QString &queueListOutput,
+                                QHash<IdType, JobState> *states)
+{
+  QStringList unknownLines;
+  m_statusParser.parse(queueListOutput, states, &unknownLines);
+
+  // Warn about the unrecognized states.
+  IdType queueId;
+  JobState state;
+  foreach (const QString &line, unknownLines)
+    parseQueueLine(line, &queueId, &state);
+}
+
+bool QueueSge::parseStructuredQueueOutput(
+    const QString &queueListOutput, QHash<IdType, QueueJobStatus> *statuses)
+{
+  // Expecting the XML from qstat -xml:
+  // <job_info>
+  //   <queue_info>
+  //     <job_list state="running">
+  //       <JB_job_number>231</JB_job_number>
+  //       ...
+  //       <state>r</state>
+  //       <JAT_start_time>2012-07-13T20:27:15</JAT_start_time>
+  //       <queue_name>all.q@node01</queue_name>
+  //       <slots>1</slots>
+  //     </job_list>
+  //   </queue_info>
+  //   <job_info>
+  //     <job_list state="pending">...</job_list>
+  //   </job_info>
+  // </job_info>
+  // The exit status of finished jobs is only known to qacct.
+  const int start = queueListOutput.indexOf('<');
+  if (start < 0)
+    return queueListOutput.trimmed().isEmpty();
+
+  const QDateTime now = QDateTime::currentDateTimeUtc();
+  QXmlStreamReader xml(queueListOutput.mid(start));
+  IdType queueId = InvalidId;
+  QueueJobStatus status;
+  QString stateCode;
+  QString listState;
+  int depth = 0;
+  while (!xml.atEnd()) {
+    xml.readNext();
+    if (xml.isStartElement()) {
+      ++depth;
+      const QStringRef element = xml.name();
+      if (element == QLatin1String("job_list")) {
+        queueId = InvalidId;
+        status = QueueJobStatus();
+        stateCode.clear();
+        listState = xml.attributes().value("state").toString();
+        continue;
+      }
+
+      // The remaining elements of interest contain only text. Reading it
+      // consumes the end element.
+      if (element == QLatin1String("JB_job_number")) {
+        bool ok;
+        const IdType id = static_cast<IdType>(
+              xml.readElementText().trimmed().toUInt(&ok));
+        if (ok)
+          queueId = id;
+      }
+      else if (element == QLatin1String("state")) {
+        stateCode = xml.readElementText().trimmed();
+      }
+      else if (element == QLatin1String("JAT_start_time")) {
+        // The host clocks are assumed to agree.
+        const QDateTime startTime =
+            parseSgeTime(xml.readElementText().trimmed());
+        if (startTime.isValid())
+          status.wallTimeUsed = qMax(0, startTime.secsTo(now));
+      }
+      else if (element == QLatin1String("queue_name")) {
+        // Queue instances are named queue@host.
+        const QString node = xml.readElementText().section('@', 1).trimmed();
+        if (!node.isEmpty() && !status.nodes.contains(node))
+          status.nodes.append(node);
+      }
+      else {
+        continue;
+      }
+      --depth;
     }
-    else {
-      Logger::logWarning(tr("Unrecognized queue state '%1' in %2 queue '%3'. "
-                            "Queue line:\n%4")
-                         .arg(stateStr).arg(typeName()).arg(name())
-                         .arg(queueListOutput));
-      return false;
+    else if (xml.isEndElement()) {
+      if (xml.name() == QLatin1String("job_list") && queueId != InvalidId) {
+        // Combined states such as "hqw" or "dr" are not in the table, but
+        // the list tells whether the job is running or pending.
+        if (!m_statusParser.lookupState(QStringRef(&stateCode),
+                                        &status.state)) {
+          if (listState == QLatin1String("running"))
+            status.state = MoleQueue::RunningRemote;
+          else if (listState == QLatin1String("pending"))
+            status.state = MoleQueue::RemoteQueued;
+        }
+
+        if (status.state != MoleQueue::Unknown) {
+          statuses->insert(queueId, status);
+        }
+        else {
+          Logger::logWarning(tr("Unrecognized queue state '%1' of job %2 in "
+                                "%3 queue '%4'.")
+                             .arg(stateCode.toLower()).arg(queueId)
+                             .arg(typeName()).arg(name()));
+        }
+      }
+      // Ignore anything after the document, such as error messages.
+      if (--depth == 0)
+        break;
     }
   }
-  return false;
+
+  return !xml.hasError();
 }
 
 } // End namespace
@@ -18,6 +18,7 @@
 #define QUEUESGE_H
 
 #include "remotessh.h"
+#include "queuestatusparser.h"
 
 class QueueSgeTest;
 
@@ -38,9 +39,20 @@ public:
 
 protected:
   virtual bool parseQueueId(const QString &submissionOutput, IdType *queueId);
-  virtual QString generateQueueRequestCommand();
+  virtual QList<QList<IdType> > splitQueueRequest(
+      const QList<IdType> &queueIds) const;
+  virtual QString generateQueueRequestCommand(const QList<IdType> &queueIds);
   virtual bool parseQueueLine(const QString &queueListOutput, IdType *queueId,
                               JobState *state);
+  virtual void parseQueueOutput(const QString &queueListOutput,
+                                QHash<IdType, JobState> *states);
+  virtual QString structuredQueueRequestArguments() const;
+  virtual bool parseStructuredQueueOutput(
+      const QString &queueListOutput,
+      QHash<IdType, QueueJobStatus> *statuses);
+
+  /// Parser for the qstat output, set up in the constructor.
+  QueueStatusParser m_statusParser;
 
 };
 
@@ -54,6 +54,10 @@ RemoteQueueWidget::RemoteQueueWidget(QueueRemoteSsh *queue,
           this, SLOT(setDirty()));
   connect(ui->updateIntervalSpin, SIGNAL(valueChanged(int)),
           this, SLOT(setDirty()));
+  connect(ui->maxSubmissionsSpin, SIGNAL(valueChanged(int)),
+          this, SLOT(setDirty()));
+  connect(ui->structuredStatusCheckBox, SIGNAL(toggled(bool)),
+          this, SLOT(setDirty()));
   connect(ui->edit_launchScriptName, SIGNAL(textChanged(QString)),
           this, SLOT(setDirty()));
   connect(ui->edit_workingDirectoryBase, SIGNAL(textChanged(QString)),
@@ -70,6 +74,10 @@ RemoteQueueWidget::RemoteQueueWidget(QueueRemoteSsh *queue,
           this, SLOT(setDirty()));
   connect(ui->spinSshPort, SIGNAL(valueChanged(int)),
           this, SLOT(setDirty()));
+  connect(ui->shareConnectionCheckBox, SIGNAL(toggled(bool)),
+          this, SLOT(setDirty()));
+  connect(ui->transferModeCombo, SIGNAL(currentIndexChanged(int)),
+          this, SLOT(setDirty()));
   connect(ui->text_launchTemplate, SIGNAL(textChanged()),
           this, SLOT(setDirty()));
   connect(ui->wallTimeHours, SIGNAL(valueChanged(int)),
@@ -105,8 +113,16 @@ void RemoteQueueWidget::save()
   m_queue->setUserName(ui->editUserName->text());
   m_queue->setIdentityFile(ui->editIdentityFile->text());
   m_queue->setSshPort(ui->spinSshPort->value());
+  m_queue->setShareConnections(ui->shareConnectionCheckBox->isChecked());
+  // The combo box items are in the order of the enum.
+  m_queue->setDirectoryTransferMode(
+        static_cast<SshCommand::DirectoryTransferMode>(
+          ui->transferModeCombo->currentIndex()));
 
   m_queue->setQueueUpdateInterval(ui->updateIntervalSpin->value());
+  m_queue->setMaxConcurrentSubmissions(ui->maxSubmissionsSpin->value());
+  m_queue->setUseStructuredQueueStatus(
+        ui->structuredStatusCheckBox->isChecked());
 
   QString text = ui->text_launchTemplate->document()->toPlainText();
   m_queue->setLaunchTemplate(text);
@@ -125,6 +141,11 @@ void RemoteQueueWidget::reset()
   ui->edit_launchScriptName->setText(m_queue->launchScriptName());
   ui->edit_workingDirectoryBase->setText(m_queue->workingDirectoryBase());
   ui->updateIntervalSpin->setValue(m_queue->queueUpdateInterval());
+  ui->maxSubmissionsSpin->setValue(m_queue->maxConcurrentSubmissions());
+  ui->structuredStatusCheckBox->setChecked(
+        m_queue->useStructuredQueueStatus());
+  ui->structuredStatusCheckBox->setEnabled(
+        m_queue->supportsStructuredQueueStatus());
   int walltime = m_queue->defaultMaxWallTime();
   ui->wallTimeHours->setValue(walltime / 60);
   ui->wallTimeMinutes->setValue(walltime % 60);
@@ -134,6 +155,9 @@ void RemoteQueueWidget::reset()
   ui->editUserName->setText(m_queue->userName());
   ui->editIdentityFile->setText(m_queue->identityFile());
   ui->spinSshPort->setValue(m_queue->sshPort());
+  ui->shareConnectionCheckBox->setChecked(m_queue->shareConnections());
+  ui->transferModeCombo->setCurrentIndex(
+        static_cast<int>(m_queue->directoryTransferMode()));
   ui->text_launchTemplate->document()->setPlainText(m_queue->launchTemplate());
   setDirty(false);
 }
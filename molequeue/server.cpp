@@ -17,10 +17,12 @@
 #include "server.h"
 
 #include "job.h"
+#include "jobjournal.h"
 #include "jobmanager.h"
 #include "logger.h"
 #include "queue.h"
 #include "queuemanager.h"
+#include "queues/remote.h"
 #include "pluginmanager.h"
 #include "transport/connectionlistenerfactory.h"
 
@@ -57,6 +59,10 @@ Server::Server(QObject *parentObject, QString serverName)
                                             MoleQueue::JobState,
                                             MoleQueue::JobState)));
 
+  connect(m_jobManager, SIGNAL(jobOutputAvailable(const MoleQueue::Job&,
+                                                  QStringList)),
+          this, SLOT(dispatchJobOutput(const MoleQueue::Job&, QStringList)));
+
   connect(m_jobManager, SIGNAL(jobRemoved(MoleQueue::IdType)),
           this, SLOT(jobRemoved(MoleQueue::IdType)));
 
@@ -67,6 +73,14 @@ Server::Server(QObject *parentObject, QString serverName)
                                               MoleQueue::EndpointId,
                                               MoleQueue::IdType)));
 
+  connect(m_jsonrpc,
+          SIGNAL(queueStatusListRequestReceived(MoleQueue::Connection*,
+                                                MoleQueue::EndpointId,
+                                                MoleQueue::IdType)),
+          this, SLOT(queueStatusListRequestReceived(MoleQueue::Connection*,
+                                                    MoleQueue::EndpointId,
+                                                    MoleQueue::IdType)));
+
   connect(m_jsonrpc, SIGNAL(jobSubmissionRequestReceived(MoleQueue::Connection*,
                                                          MoleQueue::EndpointId,
                                                          MoleQueue::IdType,
@@ -93,6 +107,23 @@ Server::Server(QObject *parentObject, QString serverName)
                                               MoleQueue::EndpointId,
                                               MoleQueue::IdType,
                                               MoleQueue::IdType)));
+  connect(m_jsonrpc, SIGNAL(queueUpdateRequestReceived(MoleQueue::Connection*,
+                                                       MoleQueue::EndpointId,
+                                                       MoleQueue::IdType,
+                                                       QString)),
+          this, SLOT(queueUpdateRequestReceived(MoleQueue::Connection*,
+                                                MoleQueue::EndpointId,
+                                                MoleQueue::IdType,
+                                                QString)));
+  connect(m_jsonrpc,
+          SIGNAL(packetFormatRequestReceived(MoleQueue::Connection*,
+                                             MoleQueue::EndpointId,
+                                             MoleQueue::IdType,
+                                             MoleQueue::PacketFormat)),
+          this, SLOT(packetFormatRequestReceived(MoleQueue::Connection*,
+                                                 MoleQueue::EndpointId,
+                                                 MoleQueue::IdType,
+                                                 MoleQueue::PacketFormat)));
 
   //connect(m_connection, SIGNAL(disconnected()),
   //        this, SIGNAL(disconnected()));
@@ -143,14 +174,27 @@ void Server::readSettings(QSettings &settings)
   m_moleQueueIdCounter =
       settings.value("moleQueueIdCounter", 0).value<IdType>();
 
+  QDir().mkpath(m_workingDirectoryBase);
+  m_jobManager->setLazyLoading(settings.value("lazyJobLoading",
+                                              false).toBool());
+  m_jobManager->openJournal(
+        settings.value("jobJournalFile",
+                       m_workingDirectoryBase + "/jobs.journal").toString());
+
   m_queueManager->readSettings(settings);
   m_jobManager->readSettings(settings);
+
+  // Ids issued after the settings were last written are in the journal:
+  if (const JobJournal *journal = m_jobManager->journal())
+    m_moleQueueIdCounter = qMax(m_moleQueueIdCounter,
+                                journal->maxMoleQueueId());
 }
 
 void Server::writeSettings(QSettings &settings) const
 {
   settings.setValue("workingDirectoryBase", m_workingDirectoryBase);
   settings.setValue("moleQueueIdCounter", m_moleQueueIdCounter);
+  settings.setValue("lazyJobLoading", m_jobManager->lazyLoading());
 
   m_queueManager->writeSettings(settings);
   m_jobManager->writeSettings(settings);
@@ -211,6 +255,29 @@ void Server::dispatchJobStateChange(const Job &job, JobState oldState,
                                  job, oldState, newState);
 }
 
+void Server::dispatchJobOutput(const Job &job, const QStringList &files)
+{
+  Connection *connection = m_connectionLUT.value(job.moleQueueId());
+  EndpointId replyTo = m_endpointLUT.value(job.moleQueueId());
+
+  if (connection == NULL)
+    return;
+
+  sendJobOutputNotification(connection, replyTo, job, files);
+}
+
+QString Server::clientIdentifier(IdType moleQueueId) const
+{
+  Connection *connection = m_connectionLUT.value(moleQueueId, NULL);
+  if (connection == NULL)
+    return QString();
+
+  // A connection may carry several clients, distinguished by their endpoint.
+  return QString("%1/%2")
+      .arg(reinterpret_cast<quintptr>(connection), 0, 16)
+      .arg(QString(m_endpointLUT.value(moleQueueId).toHex()));
+}
+
 void Server::queueListRequestReceived(MoleQueue::Connection *connection,
                                       MoleQueue::EndpointId replyTo,
                                       MoleQueue::IdType packetId)
@@ -218,6 +285,15 @@ void Server::queueListRequestReceived(MoleQueue::Connection *connection,
   sendQueueList(connection, replyTo, packetId, m_queueManager->toQueueList());
 }
 
+void Server::queueStatusListRequestReceived(MoleQueue::Connection *connection,
+                                            MoleQueue::EndpointId replyTo,
+                                            MoleQueue::IdType packetId)
+{
+  sendQueueStatusList(connection, replyTo, packetId,
+                      m_queueManager->toQueueList(),
+                      m_queueManager->toQueueStatus());
+}
+
 void Server::jobCancellationRequestReceived(MoleQueue::Connection *connection,
                                             MoleQueue::EndpointId replyTo,
                                             MoleQueue::IdType packetId,
@@ -256,12 +332,43 @@ void Server::lookupJobRequestReceived(Connection *connection,
     sendFailedLookupJobResponse(connection, replyTo, packetId, moleQueueId);
 }
 
+void Server::queueUpdateRequestReceived(Connection *connection,
+                                        EndpointId replyTo, IdType packetId,
+                                        const QString &queueName)
+{
+  QueueRemote *queue =
+      qobject_cast<QueueRemote*>(m_queueManager->lookupQueue(queueName));
+  if (!queue) {
+    sendQueueUpdateResponse(connection, replyTo, packetId, queueName,
+                            QVariantHash());
+    return;
+  }
+
+  queue->requestImmediateQueueUpdate();
+  sendQueueUpdateResponse(connection, replyTo, packetId, queueName,
+                          queue->queueUpdateStatistics());
+}
+
+void Server::packetFormatRequestReceived(Connection *connection,
+                                         EndpointId replyTo, IdType packetId,
+                                         PacketFormat format)
+{
+  m_jsonrpc->setPacketFormat(connection, format);
+  PacketType packet = m_jsonrpc->generatePacketFormatResponse(
+        format, packetId, m_jsonrpc->packetFormat(connection));
+  sendReply(connection, replyTo, packet);
+}
+
 void Server::jobAboutToBeAdded(Job job)
 {
   IdType nextMoleQueueId = ++m_moleQueueIdCounter;
 
-  QSettings settings;
-  settings.setValue("moleQueueIdCounter", m_moleQueueIdCounter);
+  // The journal records the new id along with the job. Without a journal, save
+  // the counter right away so that ids are not reused after a crash.
+  if (!m_jobManager->journal()) {
+    QSettings settings;
+    settings.setValue("moleQueueIdCounter", m_moleQueueIdCounter);
+  }
 
   job.setMoleQueueId(nextMoleQueueId);
   job.setLocalWorkingDirectory(m_workingDirectoryBase + "/" +
@@ -315,11 +422,22 @@ void Server::sendQueueList(Connection* connection,
                            MoleQueue::IdType packetId,
                            const QueueListType &queueList)
 {
-  PacketType packet = m_jsonrpc->generateQueueList(queueList, packetId);
+  PacketType packet = m_jsonrpc->generateQueueList(
+        queueList, packetId, m_jsonrpc->packetFormat(connection));
 
-  Message msg(to, packet);
+  sendReply(connection, to, packet);
+}
+
+void Server::sendQueueStatusList(Connection *connection,
+                                 EndpointId to,
+                                 MoleQueue::IdType packetId,
+                                 const QueueListType &queueList,
+                                 const QVariantHash &queueStatus)
+{
+  PacketType packet = m_jsonrpc->generateQueueList(
+        queueList, queueStatus, packetId, m_jsonrpc->packetFormat(connection));
 
-  connection->send(msg);
+  sendReply(connection, to, packet);
 }
 
 void Server::sendSuccessfulSubmissionResponse(MoleQueue::Connection *connection,
@@ -336,11 +454,10 @@ void Server::sendSuccessfulSubmissionResponse(MoleQueue::Connection *connection,
 
   const IdType packetId = m_submissionLUT.take(moleQueueId);
   PacketType packet =  m_jsonrpc->generateJobSubmissionConfirmation(
-        moleQueueId, job.localWorkingDirectory(), packetId);
+        moleQueueId, job.localWorkingDirectory(), packetId,
+        m_jsonrpc->packetFormat(connection));
 
-  Message msg(replyTo, packet);
-
-  connection->send(msg);
+  sendReply(connection, replyTo, packet);
 }
 
 void Server::sendFailedSubmissionResponse(MoleQueue::Connection *connection,
@@ -361,10 +478,10 @@ void Server::sendFailedSubmissionResponse(MoleQueue::Connection *connection,
 
   PacketType packet = m_jsonrpc->generateErrorResponse(static_cast<int>(ec),
                                                        errorMessage,
-                                                       packetId);
-  Message msg(replyTo, packet);
-
-  connection->send(msg);
+                                                       packetId,
+                                                       m_jsonrpc->packetFormat(
+                                                         connection));
+  sendReply(connection, replyTo, packet);
 }
 
 void Server::sendSuccessfulCancellationResponse(MoleQueue::Connection *connection,
@@ -380,11 +497,9 @@ void Server::sendSuccessfulCancellationResponse(MoleQueue::Connection *connectio
 
   const IdType packetId = m_cancellationLUT.take(moleQueueId);
   PacketType packet =  m_jsonrpc->generateJobCancellationConfirmation(
-      moleQueueId, packetId);
-
-  Message msg(replyTo, packet);
+      moleQueueId, packetId, m_jsonrpc->packetFormat(connection));
 
-  connection->send(msg);
+  sendReply(connection, replyTo, packet);
 }
 
 void Server::sendSuccessfulLookupJobResponse(Connection *connection,
@@ -393,9 +508,10 @@ void Server::sendSuccessfulLookupJobResponse(Connection *connection,
 {
   PacketType packet = m_jsonrpc->generateLookupJobResponse(req,
                                                            req.moleQueueId(),
-                                                           packetId);
-  Message msg(replyTo, packet);
-  connection->send(msg);
+                                                           packetId,
+                                                           m_jsonrpc->packetFormat(
+                                                             connection));
+  sendReply(connection, replyTo, packet);
 }
 
 void Server::sendFailedLookupJobResponse(Connection *connection,
@@ -404,9 +520,20 @@ void Server::sendFailedLookupJobResponse(Connection *connection,
 {
   PacketType packet = m_jsonrpc->generateLookupJobResponse(Job(),
                                                            moleQueueId,
-                                                           packetId);
-  Message msg(replyTo, packet);
-  connection->send(msg);
+                                                           packetId,
+                                                           m_jsonrpc->packetFormat(
+                                                             connection));
+  sendReply(connection, replyTo, packet);
+}
+
+void Server::sendQueueUpdateResponse(Connection *connection,
+                                     EndpointId replyTo, IdType packetId,
+                                     const QString &queueName,
+                                     const QVariantHash &statistics)
+{
+  PacketType packet = m_jsonrpc->generateQueueUpdateResponse(
+        queueName, statistics, packetId, m_jsonrpc->packetFormat(connection));
+  sendReply(connection, replyTo, packet);
 }
 
 void Server::sendJobStateChangeNotification(MoleQueue::Connection *connection,
@@ -415,11 +542,21 @@ void Server::sendJobStateChangeNotification(MoleQueue::Connection *connection,
                                             JobState newState)
 {
   PacketType packet = m_jsonrpc->generateJobStateChangeNotification(
-        job.moleQueueId(), oldState, newState);
+        job.moleQueueId(), oldState, newState,
+        m_jsonrpc->packetFormat(connection));
 
-  Message msg(to, packet);
+  sendNotification(connection, to, packet);
+}
+
+void Server::sendJobOutputNotification(MoleQueue::Connection *connection,
+                                       MoleQueue::EndpointId to,
+                                       const Job &job,
+                                       const QStringList &files)
+{
+  PacketType packet = m_jsonrpc->generateJobOutputNotification(
+        job.moleQueueId(), files, m_jsonrpc->packetFormat(connection));
 
-  connection->send(msg);
+  sendNotification(connection, to, packet);
 }
 
 void Server::jobSubmissionRequestReceived(MoleQueue::Connection *connection,
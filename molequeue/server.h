@@ -27,6 +27,7 @@
 #include <QtCore/QObject>
 #include <QtCore/QList>
 
+class ConnectionTest;
 class ServerTest;
 class ServerConnectionTest;
 
@@ -98,6 +99,13 @@ public:
   /// The working directory where running job file are kept.
   QString workingDirectoryBase() const {return m_workingDirectoryBase;}
 
+  /**
+   * @return A string identifying the client that submitted the job
+   * @a moleQueueId, or an empty string if the client is not connected (e.g.
+   * the job was loaded from disk).
+   */
+  QString clientIdentifier(IdType moleQueueId) const;
+
   /// Used for internal lookup structures
   typedef QMap<IdType, IdType> PacketLookupTable;
 
@@ -107,6 +115,9 @@ public:
   /// Used for unit testing
   friend class ::ServerTest;
 
+  /// Used for unit testing
+  friend class ::ConnectionTest;
+
 signals:
 
   /**
@@ -173,6 +184,14 @@ public slots:
                               MoleQueue::JobState oldState,
                               MoleQueue::JobState newState);
 
+  /**
+   * Find the client that owns @a job and send a notification to the client that
+   * new output of the running job is available.
+   * @param job Job of interest.
+   * @param files The updated files, relative to the local working directory.
+   */
+  void dispatchJobOutput(const MoleQueue::Job &job, const QStringList &files);
+
   /**
    * Sends the @a list to the connected client.
    *
@@ -184,6 +203,20 @@ public slots:
                      MoleQueue::IdType id,
                      const MoleQueue::QueueListType &queueList);
 
+  /**
+   * Sends the @a queueList and the @a queueStatus of each queue to the
+   * connected client.
+   *
+   * @param id The id for the rpc
+   * @param queueList The queue List
+   * @param queueStatus The status of each queue, keyed by queue name.
+   */
+  void sendQueueStatusList(MoleQueue::Connection *connection,
+                           MoleQueue::EndpointId to,
+                           MoleQueue::IdType id,
+                           const MoleQueue::QueueListType &queueList,
+                           const QVariantHash &queueStatus);
+
   /**
    * Sends a reply to the client informing them that the job submission was
    * successful.
@@ -234,6 +267,19 @@ public slots:
                                    MoleQueue::IdType packetId,
                                    MoleQueue::IdType moleQueueId);
 
+  /**
+   * Sends the queue update statistics of a queue to the client. If
+   * @a statistics is empty, the client is told that the queue is unknown.
+   * @param packetId The id of the request packet
+   * @param queueName The name of the requested queue.
+   * @param statistics The queue update statistics of the queue.
+   */
+  void sendQueueUpdateResponse(MoleQueue::Connection *connection,
+                               MoleQueue::EndpointId replyTo,
+                               MoleQueue::IdType packetId,
+                               const QString &queueName,
+                               const QVariantHash &statistics);
+
   /**
    * Sends a notification to the connected client informing them that a job
    * has changed status.
@@ -247,6 +293,17 @@ public slots:
                                       MoleQueue::JobState oldState,
                                       MoleQueue::JobState newState);
 
+  /**
+   * Sends a notification to the connected client informing them that new
+   * output of a running job is available.
+   * @param req
+   * @param files
+   */
+  void sendJobOutputNotification(MoleQueue::Connection *connection,
+                                 MoleQueue::EndpointId to,
+                                 const MoleQueue::Job &req,
+                                 const QStringList &files);
+
 protected slots:
 
   /**
@@ -273,6 +330,14 @@ protected slots:
                                 MoleQueue::EndpointId replyTo,
                                 MoleQueue::IdType);
 
+  /**
+   * Called when the JsonRpc instance handles a listQueues request that asks
+   * for the queue status.
+   */
+  void queueStatusListRequestReceived(MoleQueue::Connection *,
+                                      MoleQueue::EndpointId replyTo,
+                                      MoleQueue::IdType);
+
   /**
    * Called when the JsonRpc instance handles a submitJob request.
    * @param options Option hash (see Job::hash())
@@ -308,6 +373,27 @@ protected slots:
                                 MoleQueue::IdType packetId,
                                 MoleQueue::IdType moleQueueId);
 
+  /**
+   * Called when the JsonRpc instance handles an updateQueue request. Remote
+   * queues are updated immediately; other queues are unknown to this request.
+   * @param queueName The name of the queue to update.
+   */
+  void queueUpdateRequestReceived(MoleQueue::Connection *connection,
+                                  MoleQueue::EndpointId replyTo,
+                                  MoleQueue::IdType packetId,
+                                  const QString &queueName);
+
+  /**
+   * Called when the JsonRpc instance handles a setPacketFormat request. All
+   * later packets sent over @a connection, including the reply, use
+   * @a format.
+   * @param format The requested format.
+   */
+  void packetFormatRequestReceived(MoleQueue::Connection *connection,
+                                   MoleQueue::EndpointId replyTo,
+                                   MoleQueue::IdType packetId,
+                                   MoleQueue::PacketFormat format);
+
 private slots:
 
   /**
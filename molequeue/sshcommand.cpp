@@ -21,6 +21,7 @@
 
 #include <QtCore/QProcessEnvironment>
 #include <QtCore/QDir>
+#include <QtCore/QFileInfo>
 #include <QtCore/QDebug>
 
 namespace MoleQueue {
@@ -29,14 +30,21 @@ SshCommand::SshCommand(QObject *parentObject, QString ssh,
                        QString scp) : SshConnection(parentObject),
   m_sshCommand(ssh),
   m_scpCommand(scp),
+  m_tarCommand("tar"),
+  m_directoryTransferMode(ScpTransfer),
   m_exitCode(-1),
   m_process(0),
+  m_archiveProcess(0),
+  m_processReadsArchive(false),
+  m_archiveFailedToStart(false),
   m_isComplete(true)
 {
 }
 
 SshCommand::~SshCommand()
 {
+  delete m_archiveProcess;
+  m_archiveProcess = 0;
   delete m_process;
   m_process = 0;
 }
@@ -46,6 +54,11 @@ QString SshCommand::output() const
   return isComplete() ? m_output : QString();
 }
 
+QByteArray SshCommand::standardOutput() const
+{
+  return isComplete() ? m_standardOutput : QByteArray();
+}
+
 int SshCommand::exitCode() const
 {
   return isComplete() ? m_exitCode : -1;
@@ -56,13 +69,28 @@ bool SshCommand::waitForCompletion(int msecs)
   if (!m_process)
     return false;
 
-  if (m_process->state() == QProcess::Starting)
-    m_process->waitForStarted(msecs);
-
-  if (m_isComplete)
-    return true;
-
-  return m_process->waitForFinished(msecs);
+  // Per-file transfers run one process after another.
+  forever {
+    if (m_process->state() == QProcess::Starting)
+      m_process->waitForStarted(msecs);
+
+    if (m_isComplete)
+      return true;
+
+    // Archive transfers finish when both ends of the pipe have exited.
+    if (m_process->state() != QProcess::NotRunning &&
+        !m_process->waitForFinished(msecs)) {
+      return false;
+    }
+    if (m_archiveProcess &&
+        m_archiveProcess->state() != QProcess::NotRunning &&
+        !m_archiveProcess->waitForFinished(msecs)) {
+      return false;
+    }
+
+    if (m_isComplete || m_process->state() == QProcess::NotRunning)
+      return m_isComplete;
+  }
 }
 
 bool SshCommand::isComplete() const
@@ -116,6 +144,20 @@ bool SshCommand::copyDirTo(const QString &localDir, const QString &remoteDir)
   if (!isValid())
     return false;
 
+  if (m_directoryTransferMode != ScpTransfer) {
+    // Unlike scp, this merges into remoteDir if it already exists.
+    QStringList archiveArgs;
+    archiveArgs << "-C" << localDir
+                << QString("-c%1f").arg(archiveCompressionFlag()) << "-" << ".";
+    QStringList args = sshArgs();
+    args << remoteSpec() << QString("mkdir -p %1 && tar -C %1 -x%2f -")
+            .arg(remoteDir).arg(archiveCompressionFlag());
+
+    sendArchiveRequest(archiveArgs, args, true);
+
+    return true;
+  }
+
   QStringList args = scpArgs();
   QString remoteDirSpec = remoteSpec() + ":" + remoteDir;
   args << "-r" << localDir << remoteDirSpec;
@@ -125,6 +167,51 @@ bool SshCommand::copyDirTo(const QString &localDir, const QString &remoteDir)
   return true;
 }
 
+bool SshCommand::copyDirsTo(const QStringList &localDirs,
+                            const QString &remoteDir)
+{
+  if (!isValid() || localDirs.isEmpty())
+    return false;
+
+  if (m_directoryTransferMode != ScpTransfer) {
+    // tar stores paths relative to a single directory, so this only works
+    // if all directories have the same parent. Otherwise fall back to scp.
+    const QString parent =
+        QFileInfo(QDir::cleanPath(localDirs.first())).absolutePath();
+    QStringList names;
+    foreach (const QString &localDir, localDirs) {
+      QFileInfo info(QDir::cleanPath(localDir));
+      if (info.absolutePath() != parent || info.fileName().isEmpty()) {
+        names.clear();
+        break;
+      }
+      names << info.fileName();
+    }
+
+    if (!names.isEmpty()) {
+      QStringList archiveArgs;
+      archiveArgs << "-C" << parent
+                  << QString("-c%1f").arg(archiveCompressionFlag()) << "-"
+                  << names;
+      QStringList args = sshArgs();
+      args << remoteSpec() << QString("mkdir -p %1 && tar -C %1 -x%2f -")
+              .arg(remoteDir).arg(archiveCompressionFlag());
+
+      sendArchiveRequest(archiveArgs, args, true);
+
+      return true;
+    }
+  }
+
+  QStringList args = scpArgs();
+  QString remoteDirSpec = remoteSpec() + ":" + remoteDir;
+  args << "-r" << localDirs << remoteDirSpec;
+
+  sendRequest(m_scpCommand, args);
+
+  return true;
+}
+
 bool SshCommand::copyDirFrom(const QString &remoteDir, const QString &localDir)
 {
   if (!isValid())
@@ -134,6 +221,26 @@ bool SshCommand::copyDirFrom(const QString &remoteDir, const QString &localDir)
   if (!local.exists())
     local.mkpath(localDir); /// @todo Check for failure of mkpath
 
+  if (m_directoryTransferMode != ScpTransfer) {
+    // Archive remoteDir relative to its parent so that, as with scp, it is
+    // extracted as a subdirectory of localDir.
+    const QString remotePath = QDir::cleanPath(remoteDir);
+    const int slash = remotePath.lastIndexOf('/');
+    const QString remoteParent = slash > 0 ? remotePath.left(slash)
+                                           : QString(slash == 0 ? "/" : ".");
+    QStringList archiveArgs;
+    archiveArgs << "-C" << localDir
+                << QString("-x%1f").arg(archiveCompressionFlag()) << "-";
+    QStringList args = sshArgs();
+    args << remoteSpec() << QString("tar -C %1 -c%2f - %3")
+            .arg(remoteParent).arg(archiveCompressionFlag())
+            .arg(remotePath.mid(slash + 1));
+
+    sendArchiveRequest(archiveArgs, args, false);
+
+    return true;
+  }
+
   QStringList args = scpArgs();
   QString remoteDirSpec = remoteSpec() + ":" + remoteDir;
   args << "-r" << remoteDirSpec << localDir;
@@ -143,18 +250,107 @@ bool SshCommand::copyDirFrom(const QString &remoteDir, const QString &localDir)
   return true;
 }
 
+bool SshCommand::copyFilesFrom(const QString &remoteDir,
+                               const QStringList &files,
+                               const QString &localDir)
+{
+  if (!isValid() || files.isEmpty())
+    return false;
+
+  QDir local(localDir);
+  if (!local.exists())
+    local.mkpath(localDir);
+
+  if (m_directoryTransferMode == ScpTransfer) {
+    // Not every scp accepts several remote sources, e.g. PuTTY's pscp, so
+    // copy the files one at a time.
+    QList<QStringList> requests;
+    foreach (const QString &file, files) {
+      const QString localFile = local.absoluteFilePath(file);
+      local.mkpath(QFileInfo(localFile).path());
+      QStringList args = scpArgs();
+      args << remoteSpec() + ":" + remoteDir + "/" + file << localFile;
+      requests << args;
+    }
+
+    const QStringList args = requests.takeFirst();
+    sendRequest(m_scpCommand, args);
+    m_pendingScpRequests = requests;
+
+    return true;
+  }
+
+  QStringList quotedFiles;
+  foreach (const QString &file, files)
+    quotedFiles << shellQuote(file);
+
+  QStringList archiveArgs;
+  archiveArgs << "-C" << localDir
+              << QString("-x%1f").arg(archiveCompressionFlag()) << "-";
+  QStringList args = sshArgs();
+  args << remoteSpec() << QString("tar -C %1 -c%2f - %3")
+          .arg(remoteDir).arg(archiveCompressionFlag())
+          .arg(quotedFiles.join(" "));
+
+  sendArchiveRequest(archiveArgs, args, false);
+
+  return true;
+}
+
 void SshCommand::processStarted()
 {
-  m_process->closeWriteChannel();
+  if (!m_processReadsArchive)
+    m_process->closeWriteChannel();
   emit requestSent();
 }
 
 void SshCommand::processFinished()
 {
-  m_output = m_process->readAll();
+  // Archive transfers are complete when both ends of the pipe have exited.
+  if (m_isComplete || m_process->state() != QProcess::NotRunning ||
+      (m_archiveProcess &&
+       m_archiveProcess->state() != QProcess::NotRunning)) {
+    return;
+  }
+
+  // Only one of the channels is used, depending on the channel mode.
+  const QByteArray standardOutput = m_process->readAllStandardOutput();
+  m_standardOutput = separateOutput() ? standardOutput : QByteArray();
+  m_output = m_pendingOutput + standardOutput;
+  m_output += m_process->readAllStandardError();
   m_exitCode = m_process->exitCode();
+  const bool crashed = m_process->exitStatus() != QProcess::NormalExit;
   m_process->close();
 
+  // Continue a per-file transfer with the next file unless this one failed.
+  if (!m_pendingScpRequests.isEmpty()) {
+    QList<QStringList> requests = m_pendingScpRequests;
+    m_pendingScpRequests.clear();
+    if (m_exitCode == 0 && !crashed) {
+      m_pendingOutput = m_output;
+      const QStringList args = requests.takeFirst();
+      sendRequest(m_scpCommand, args);
+      m_pendingScpRequests = requests;
+      return;
+    }
+  }
+  m_pendingOutput.clear();
+
+  if (m_archiveProcess) {
+    m_output += m_archiveProcess->readAllStandardError();
+    if (m_archiveFailedToStart) {
+      m_output += tr("Cannot run '%1': %2").arg(m_tarCommand)
+          .arg(m_archiveProcess->errorString());
+      m_exitCode = 127;
+    }
+    else if (m_exitCode == 0 &&
+             (m_archiveProcess->exitStatus() != QProcess::NormalExit ||
+              m_archiveProcess->exitCode() != 0)) {
+      m_exitCode = qMax(m_archiveProcess->exitCode(), 1);
+    }
+    m_archiveProcess->close();
+  }
+
   if (debug()) {
     Logger::logDebugMessage(tr("SSH finished (%1) Exit code: %2\n%3")
                             .arg(reinterpret_cast<quint64>(this))
@@ -165,12 +361,30 @@ void SshCommand::processFinished()
   emit requestComplete();
 }
 
+void SshCommand::archiveProcessError(QProcess::ProcessError error)
+{
+  if (error != QProcess::FailedToStart)
+    return;
+
+  m_archiveFailedToStart = true;
+  // Without tar at the other end of the pipe, ssh may never finish.
+  if (m_process->state() != QProcess::NotRunning)
+    m_process->kill();
+  else
+    processFinished();
+}
+
 void SshCommand::sendRequest(const QString &command, const QStringList &args)
 {
+  m_pendingScpRequests.clear();
+  resetArchiveProcesses();
   if (!m_process)
     initializeProcess();
 
   m_isComplete = false;
+  m_process->setProcessChannelMode(separateOutput()
+                                   ? QProcess::SeparateChannels
+                                   : QProcess::MergedChannels);
 
   if (debug()) {
     Logger::logDebugMessage(tr("SSH request (%1): %2 %3")
@@ -181,6 +395,72 @@ void SshCommand::sendRequest(const QString &command, const QStringList &args)
   m_process->start(command, args);
 }
 
+void SshCommand::sendArchiveRequest(const QStringList &archiveArgs,
+                                    const QStringList &args, bool upload)
+{
+  m_pendingScpRequests.clear();
+  m_pendingOutput.clear();
+  resetArchiveProcesses();
+  if (!m_process)
+    initializeProcess();
+
+  m_archiveProcess = new QProcess(this);
+  connect(m_archiveProcess, SIGNAL(finished(int,QProcess::ExitStatus)),
+          this, SLOT(processFinished()));
+  connect(m_archiveProcess, SIGNAL(error(QProcess::ProcessError)),
+          this, SLOT(archiveProcessError(QProcess::ProcessError)));
+
+  m_isComplete = false;
+  m_archiveFailedToStart = false;
+
+  if (debug()) {
+    const QString sshRequest = m_sshCommand + " " + args.join(" ");
+    const QString tarRequest = m_tarCommand + " " + archiveArgs.join(" ");
+    Logger::logDebugMessage(tr("SSH request (%1): %2 | %3")
+                            .arg(reinterpret_cast<quint64>(this))
+                            .arg(upload ? tarRequest : sshRequest)
+                            .arg(upload ? sshRequest : tarRequest));
+  }
+
+  if (upload) {
+    m_processReadsArchive = true;
+    m_archiveProcess->setStandardOutputProcess(m_process);
+    m_process->start(m_sshCommand, args);
+    m_archiveProcess->start(m_tarCommand, archiveArgs);
+  }
+  else {
+    // Keep the messages of ssh out of the archive.
+    m_process->setProcessChannelMode(QProcess::SeparateChannels);
+    m_process->setStandardOutputProcess(m_archiveProcess);
+    m_archiveProcess->start(m_tarCommand, archiveArgs);
+    m_process->start(m_sshCommand, args);
+  }
+}
+
+void SshCommand::resetArchiveProcesses()
+{
+  if (!m_archiveProcess)
+    return;
+
+  // The channels of the processes cannot be disconnected from each other, so
+  // start over with new ones.
+  m_archiveProcess->disconnect(this);
+  m_archiveProcess->deleteLater();
+  m_archiveProcess = 0;
+  if (m_process) {
+    m_process->disconnect(this);
+    m_process->deleteLater();
+    m_process = 0;
+  }
+  m_processReadsArchive = false;
+}
+
+QString SshCommand::archiveCompressionFlag() const
+{
+  return m_directoryTransferMode == CompressedTarTransfer ? QString("z")
+                                                           : QString();
+}
+
 void SshCommand::initializeProcess()
 {
   // Initialize the environment for the process, set merged channels.
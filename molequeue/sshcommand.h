@@ -19,6 +19,7 @@
 
 #include "sshconnection.h"
 
+#include <QtCore/QProcess>
 #include <QtCore/QStringList>
 
 namespace MoleQueue {
@@ -47,15 +48,44 @@ public:
   SshCommand(QObject *parentObject, QString sshCommand, QString scpCommand);
   ~SshCommand();
 
+  /// How copyDirTo(), copyDirsTo() and copyDirFrom() transfer directories.
+  enum DirectoryTransferMode {
+    /// Recursive scp. Needs a round trip for every file.
+    ScpTransfer = 0,
+    /// Stream a tar archive through a single ssh channel. Requires tar on
+    /// both hosts.
+    TarTransfer,
+    /// As TarTransfer, but gzip compressed.
+    CompressedTarTransfer
+  };
+
+  /** \return The tar command used for archive transfers on the local host. */
+  QString tarCommand() const { return m_tarCommand; }
+
+  /** \return How directories are transferred. */
+  DirectoryTransferMode directoryTransferMode() const
+  {
+    return m_directoryTransferMode;
+  }
+
   /** \return The SSH command that will be run. */
   QString sshCommand() { return m_sshCommand; }
 
   /** \return The SCP command that will be run. */
   QString scpCommand() { return m_scpCommand; }
 
+  /**
+   * \return The path of the socket used to share a single connection between
+   * commands when the connection is persistent.
+   */
+  QString controlPath() const { return m_controlPath; }
+
   /** \return The merged stdout and stderr of the remote command */
   QString output() const;
 
+  /** \return The raw stdout of the remote command, see setSeparateOutput() */
+  QByteArray standardOutput() const;
+
   /** \return The exit code returned from the remote command. */
   int exitCode() const;
 
@@ -84,6 +114,30 @@ public slots:
    */
   void setScpCommand(const QString &command) { m_scpCommand = command; }
 
+  /**
+   * Set the path of the socket used to share a single connection between
+   * commands when the connection is persistent. All commands to the same host
+   * that use the same path reuse the connection established by the first one.
+   * Not all ssh clients use this, see setPersistent().
+   */
+  void setControlPath(const QString &path) { m_controlPath = path; }
+
+  /**
+   * Set the tar command used for archive transfers on the local host.
+   * Defaults to 'tar'. The remote host always uses 'tar' from the user's path.
+   */
+  void setTarCommand(const QString &command) { m_tarCommand = command; }
+
+  /**
+   * Set how directories are transferred. Archive transfers stream the whole
+   * directory through one ssh channel, which is much faster than scp for
+   * directories with many small files. Default: ScpTransfer
+   */
+  void setDirectoryTransferMode(DirectoryTransferMode mode)
+  {
+    m_directoryTransferMode = mode;
+  }
+
   /**
    * Execute the supplied command on the remote host.
    *
@@ -139,6 +193,23 @@ public slots:
    */
   virtual bool copyDirTo(const QString &localDir, const QString &remoteDir);
 
+  /**
+   * Copy several local directories recursively into a directory on the remote
+   * system in a single transfer. Each directory becomes a subdirectory of
+   * @a remoteDir with the same name.
+   *
+   * \note The command is executed asynchronously, see requestComplete() or
+   * waitForCompletion() for results.
+   *
+   * \sa requestSent() requestCompleted() waitForCompeletion()
+   *
+   * \param localDirs The paths of the local directories.
+   * \param remoteDir The path of the directory on the remote system.
+   * \return True on success, false on failure.
+   */
+  virtual bool copyDirsTo(const QStringList &localDirs,
+                          const QString &remoteDir);
+
   /**
    * Copy a remote directory recursively to the local system.
    *
@@ -153,23 +224,63 @@ public slots:
    */
   virtual bool copyDirFrom(const QString &remoteDir, const QString &localDir);
 
+  /**
+   * Copy some of the files in a remote directory to the local system. Unless
+   * the directory transfer mode is ScpTransfer, the files are streamed as a
+   * single tar archive, which requires tar on both hosts. Otherwise they are
+   * copied by one scp each, in turn, until one fails.
+   *
+   * \note The command is executed asynchronously, see requestComplete() or
+   * waitForCompletion() for results.
+   *
+   * \sa requestSent() requestCompleted() waitForCompeletion()
+   *
+   * \param remoteDir The path of the directory on the remote system.
+   * \param files The paths of the files, relative to @a remoteDir.
+   * \param localDir The path of the local directory. The files are written to
+   * the same relative paths in this directory.
+   * \return True on success, false on failure.
+   */
+  virtual bool copyFilesFrom(const QString &remoteDir, const QStringList &files,
+                             const QString &localDir);
+
 protected slots:
 
   /// Called when the TerminalProcess enters the Running state.
   void processStarted();
 
-  /// Called when the TerminalProcess exits the Running state.
+  /// Called when the TerminalProcess or the local archive process exits the
+  /// Running state.
   void processFinished();
 
+  /// Called when the local archive process cannot be run.
+  void archiveProcessError(QProcess::ProcessError error);
+
 protected:
 
   /// Send a request. This launches the process and connects the completion
   /// signals
   virtual void sendRequest(const QString &command, const QStringList &args);
 
+  /**
+   * Send a request that streams a tar archive between the local tar command
+   * and ssh. If @a upload is true, the archive created by the local tar is
+   * piped into the ssh command, otherwise the output of the ssh command is
+   * piped into the local tar.
+   */
+  virtual void sendArchiveRequest(const QStringList &archiveArgs,
+                                  const QStringList &args, bool upload);
+
   /// Initialize the TerminalProcess object.
   void initializeProcess();
 
+  /// Discard the processes of a previous archive request, whose channels are
+  /// still connected to each other.
+  void resetArchiveProcesses();
+
+  /// @return "z" for compressed archive transfers, an empty string otherwise.
+  QString archiveCompressionFlag() const;
+
   /// @return the arguments to be passed to the SSH command.
   virtual QStringList sshArgs() = 0;
 
@@ -181,9 +292,23 @@ protected:
 
   QString m_sshCommand;
   QString m_scpCommand;
+  QString m_controlPath;
+  QString m_tarCommand;
+  DirectoryTransferMode m_directoryTransferMode;
   QString m_output;
+  /// Raw stdout of the last request, if separate output was requested.
+  QByteArray m_standardOutput;
+  /// scp arguments of the files still to be copied by a per-file transfer.
+  QList<QStringList> m_pendingScpRequests;
+  /// Output of the finished steps of a per-file transfer.
+  QString m_pendingOutput;
   int m_exitCode;
   TerminalProcess *m_process;
+  /// Local tar of an archive transfer, if any.
+  QProcess *m_archiveProcess;
+  /// True if m_process reads its stdin from m_archiveProcess.
+  bool m_processReadsArchive;
+  bool m_archiveFailedToStart;
   bool m_isComplete;
 };
 
@@ -21,7 +21,7 @@
 namespace MoleQueue {
 
 SshConnection::SshConnection(QObject *parentObject) : QObject(parentObject),
-  m_persistent(false), m_portNumber(-1)
+  m_persistent(false), m_separateOutput(false), m_portNumber(-1)
 {
 }
 
@@ -42,6 +42,11 @@ QString SshConnection::output() const
   return "";
 }
 
+QByteArray SshConnection::standardOutput() const
+{
+  return QByteArray();
+}
+
 int SshConnection::exitCode() const
 {
   return -1;
@@ -78,11 +83,29 @@ bool SshConnection::copyDirTo(const QString &, const QString &)
   return false;
 }
 
+bool SshConnection::copyDirsTo(const QStringList &, const QString &)
+{
+  return false;
+}
+
 bool SshConnection::copyDirFrom(const QString &, const QString &)
 {
   return false;
 }
 
+bool SshConnection::copyFilesFrom(const QString &, const QStringList &,
+                                  const QString &)
+{
+  return false;
+}
+
+QString SshConnection::shellQuote(const QString &argument)
+{
+  QString quoted(argument);
+  quoted.replace("'", "'\\''");
+  return "'" + quoted + "'";
+}
+
 bool SshConnection::debug()
 {
   const char *val = qgetenv("MOLEQUEUE_DEBUG_SSH");
@@ -18,6 +18,7 @@
 #define SSHCONNECTION_H
 
 #include <QtCore/QObject>
+#include <QtCore/QStringList>
 #include <QtCore/QVariant>
 
 namespace MoleQueue {
@@ -62,6 +63,15 @@ public:
   /** \return The merged stdout and stderr of the remote command. */
   virtual QString output() const;
 
+  /**
+   * \return The unmodified stdout of the remote command, if separate output
+   * was requested with setSeparateOutput(), otherwise an empty array.
+   */
+  virtual QByteArray standardOutput() const;
+
+  /** \return True if stdout is kept apart from stderr. */
+  bool separateOutput() const { return m_separateOutput; }
+
   /** \return The exit code returned from a remote command. */
   virtual int exitCode() const;
 
@@ -77,6 +87,12 @@ public:
   /** @return True if the request has completed. False otherwise. */
   virtual bool isComplete() const;
 
+  /**
+   * \return @a argument quoted for a POSIX shell, so that it is passed
+   * literally to commands run with execute().
+   */
+  static QString shellQuote(const QString &argument);
+
   /** @return A reference to arbitrary data stored in the command. */
   QVariant & data() {return m_data;}
 
@@ -96,6 +112,13 @@ public slots:
    */
   void setPersistent(bool persist) { m_persistent = persist; }
 
+  /**
+   * Set whether the stdout of remote commands is kept apart from stderr and
+   * made available as raw bytes through standardOutput(). Use this for
+   * commands that print binary data. Default: false
+   */
+  void setSeparateOutput(bool separate) { m_separateOutput = separate; }
+
   /**
    * Set the user name to use for the connection.
    */
@@ -176,6 +199,23 @@ public slots:
    */
   virtual bool copyDirTo(const QString &localDir, const QString &remoteDir);
 
+  /**
+   * Copy several local directories recursively into a directory on the remote
+   * system in a single transfer. Each directory becomes a subdirectory of
+   * @a remoteDir with the same name.
+   *
+   * \note The command is executed asynchronously, see requestComplete() or
+   * waitForCompletion() for results.
+   *
+   * \sa requestSent() requestCompleted() waitForCompeletion()
+   *
+   * \param localDirs The paths of the local directories.
+   * \param remoteDir The path of the directory on the remote system.
+   * \return True on success, false on failure.
+   */
+  virtual bool copyDirsTo(const QStringList &localDirs,
+                          const QString &remoteDir);
+
   /**
    * Copy a remote directory recursively to the local system.
    *
@@ -190,6 +230,25 @@ public slots:
    */
   virtual bool copyDirFrom(const QString &remoteDir, const QString &localDir);
 
+  /**
+   * Copy some of the files in a remote directory to the local system. The
+   * files are streamed as a single tar archive, which requires tar on both
+   * hosts.
+   *
+   * \note The command is executed asynchronously, see requestComplete() or
+   * waitForCompletion() for results.
+   *
+   * \sa requestSent() requestCompleted() waitForCompeletion()
+   *
+   * \param remoteDir The path of the directory on the remote system.
+   * \param files The paths of the files, relative to @a remoteDir.
+   * \param localDir The path of the local directory. The files are written to
+   * the same relative paths in this directory.
+   * \return True on success, false on failure.
+   */
+  virtual bool copyFilesFrom(const QString &remoteDir, const QStringList &files,
+                             const QString &localDir);
+
 signals:
   /**
    * Emitted when the request has been sent to the server.
@@ -204,6 +263,7 @@ signals:
 protected:
   static bool debug();
   bool m_persistent;
+  bool m_separateOutput;
   QVariant m_data;
   QString m_userName;
   QString m_hostName;
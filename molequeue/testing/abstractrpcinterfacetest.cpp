@@ -21,6 +21,8 @@
 #include "testserver.h"
 #include "transport/localsocket/localsocketconnection.h"
 
+#include <json/json.h>
+
 #include <QtNetwork/QLocalSocket>
 
 class AbstractRpcInterfaceTest : public QObject
@@ -50,6 +52,7 @@ private slots:
   void testInvalidMethod();
   void testInvalidParams();
   void testInternalError();
+  void testBatchReplies();
 };
 
 
@@ -121,8 +124,10 @@ void AbstractRpcInterfaceTest::testInvalidRequest()
 
   QVERIFY2(m_server->waitForPacket(), "Timeout waiting for reply.");
 
+  // The request is a batch, so the reply is a batch response.
   MoleQueue::PacketType refPacket =
-      readReferenceString("abstractrpcinterface-ref/invalid-request.json");
+      "[" + readReferenceString("abstractrpcinterface-ref/invalid-request.json")
+      + "]";
 
   QCOMPARE(QString(m_packet), QString(refPacket));
 }
@@ -151,6 +156,28 @@ void AbstractRpcInterfaceTest::testInternalError()
   qDebug() << "There is currently no way to trigger an internal error response.";
 }
 
+void AbstractRpcInterfaceTest::testBatchReplies()
+{
+  MoleQueue::PacketType packet =
+      "[1, \"two\", "
+      "{ \"jsonrpc\" : \"2.0\", \"id\" : 3, \"method\" : \"notARealMethod\"}]";
+  m_server->sendPacket(packet);
+
+  QVERIFY2(m_server->waitForPacket(), "Timeout waiting for reply.");
+
+  // All three errors are returned in a single batch response.
+  Json::Value root;
+  Json::Reader reader;
+  QVERIFY(reader.parse(m_packet.constData(),
+                       m_packet.constData() + m_packet.size(), root, false));
+  QVERIFY(root.isArray());
+  QCOMPARE(root.size(), 3u);
+  QCOMPARE(root[0u]["error"]["code"].asInt(), -32600);
+  QCOMPARE(root[1u]["error"]["code"].asInt(), -32600);
+  QCOMPARE(root[2u]["error"]["code"].asInt(), -32601);
+  QCOMPARE(root[2u]["id"].asInt(), 3);
+}
+
 QTEST_MAIN(AbstractRpcInterfaceTest)
 
 #include "abstractrpcinterfacetest.moc"
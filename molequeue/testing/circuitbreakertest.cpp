@@ -0,0 +1,164 @@
+/******************************************************************************
+
+  This source file is part of the MoleQueue project.
+
+  Copyright 2012 Kitware, Inc.
+
+  This source code is released under the New BSD License, (the "License").
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+******************************************************************************/
+
+#include <QtTest>
+
+#include "queues/circuitbreaker.h"
+
+#include <QtCore/QSet>
+
+using MoleQueue::CircuitBreaker;
+
+class CircuitBreakerTest : public QObject
+{
+  Q_OBJECT
+
+private slots:
+  void testBackoff();
+  void testJitter();
+  void testOpen();
+  void testProbe();
+  void testToHash();
+};
+
+void CircuitBreakerTest::testBackoff()
+{
+  CircuitBreaker breaker(10, 4, 30);
+  const QDateTime now = QDateTime::currentDateTime();
+  QVERIFY(breaker.allowsRequests(now));
+  QVERIFY(!breaker.retryTime().isValid());
+
+  // The delay doubles with each failure up to the maximum, and is jittered
+  // down by at most half.
+  const int expected[] = {4, 8, 16, 30, 30, 30};
+  for (int i = 0; i < 6; ++i) {
+    breaker.recordFailure(now);
+    QCOMPARE(breaker.state(), CircuitBreaker::Closed);
+    QCOMPARE(breaker.consecutiveFailures(), i + 1);
+    const int delay = now.secsTo(breaker.retryTime());
+    QVERIFY(delay >= expected[i] - expected[i] / 2);
+    QVERIFY(delay <= expected[i]);
+    QVERIFY(!breaker.allowsRequests(now));
+    QVERIFY(breaker.allowsRequests(breaker.retryTime()));
+  }
+
+  // Large failure counts do not overflow.
+  QVERIFY(breaker.backoffDelay(100) >= 15);
+  QVERIFY(breaker.backoffDelay(100) <= 30);
+
+  breaker.recordSuccess();
+  QCOMPARE(breaker.consecutiveFailures(), 0);
+  QVERIFY(!breaker.retryTime().isValid());
+  QVERIFY(breaker.allowsRequests(now));
+}
+
+void CircuitBreakerTest::testJitter()
+{
+  CircuitBreaker breaker(5, 5, 600);
+  QSet<int> delays;
+  for (int i = 0; i < 100; ++i) {
+    const int delay = breaker.backoffDelay(8);
+    QVERIFY(delay >= 300);
+    QVERIFY(delay <= 600);
+    delays.insert(delay);
+  }
+  QVERIFY(delays.size() > 10);
+
+  // Separate breakers do not retry in lockstep.
+  CircuitBreaker other(5, 5, 600);
+  other.m_randomState = breaker.m_randomState + 1;
+  int equal = 0;
+  for (int i = 0; i < 100; ++i) {
+    if (breaker.backoffDelay(8) == other.backoffDelay(8))
+      ++equal;
+  }
+  QVERIFY(equal < 10);
+}
+
+void CircuitBreakerTest::testOpen()
+{
+  CircuitBreaker breaker(3, 5, 600);
+  const QDateTime now = QDateTime::currentDateTime();
+
+  breaker.recordFailure(now);
+  breaker.recordFailure(now);
+  QCOMPARE(breaker.state(), CircuitBreaker::Closed);
+  QVERIFY(!breaker.allowsProbe(breaker.retryTime()));
+
+  // The threshold opens the breaker. Afterwards only probes are allowed.
+  breaker.recordFailure(now);
+  QCOMPARE(breaker.state(), CircuitBreaker::Open);
+  QVERIFY(!breaker.allowsRequests(now));
+  QVERIFY(!breaker.allowsRequests(breaker.retryTime()));
+  QVERIFY(!breaker.allowsProbe(now));
+  QVERIFY(breaker.allowsProbe(breaker.retryTime()));
+}
+
+void CircuitBreakerTest::testProbe()
+{
+  CircuitBreaker breaker(1, 5, 600);
+  const QDateTime now = QDateTime::currentDateTime();
+  breaker.recordFailure(now);
+  QCOMPARE(breaker.state(), CircuitBreaker::Open);
+
+  // Only one probe at a time.
+  QDateTime retryTime = breaker.retryTime();
+  breaker.probeStarted();
+  QCOMPARE(breaker.state(), CircuitBreaker::HalfOpen);
+  QVERIFY(!breaker.allowsProbe(retryTime));
+  QVERIFY(!breaker.allowsRequests(retryTime));
+
+  // A failed probe opens the breaker for longer.
+  breaker.recordFailure(retryTime);
+  QCOMPARE(breaker.state(), CircuitBreaker::Open);
+  QCOMPARE(breaker.consecutiveFailures(), 2);
+  QVERIFY(retryTime.secsTo(breaker.retryTime()) >= 5);
+  QVERIFY(!breaker.allowsProbe(retryTime));
+
+  // A successful probe closes it.
+  retryTime = breaker.retryTime();
+  QVERIFY(breaker.allowsProbe(retryTime));
+  breaker.probeStarted();
+  breaker.recordSuccess();
+  QCOMPARE(breaker.state(), CircuitBreaker::Closed);
+  QCOMPARE(breaker.consecutiveFailures(), 0);
+  QVERIFY(breaker.allowsRequests(now));
+  QVERIFY(!breaker.allowsProbe(retryTime));
+}
+
+void CircuitBreakerTest::testToHash()
+{
+  CircuitBreaker breaker(1, 5, 600);
+  QVariantHash hash = breaker.toHash();
+  QCOMPARE(hash.value("state").toString(), QString("closed"));
+  QCOMPARE(hash.value("consecutiveFailures").toInt(), 0);
+  QCOMPARE(hash.value("retryTime").toString(), QString());
+
+  const QDateTime now = QDateTime::currentDateTime();
+  breaker.recordFailure(now);
+  hash = breaker.toHash();
+  QCOMPARE(hash.value("state").toString(), QString("open"));
+  QCOMPARE(hash.value("consecutiveFailures").toInt(), 1);
+  QCOMPARE(hash.value("retryTime").toString(),
+           breaker.retryTime().toString(Qt::ISODate));
+
+  breaker.probeStarted();
+  QCOMPARE(breaker.toHash().value("state").toString(), QString("half-open"));
+}
+
+QTEST_MAIN(CircuitBreakerTest)
+
+#include "circuitbreakertest.moc"
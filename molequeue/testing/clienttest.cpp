@@ -25,6 +25,8 @@
 
 #include "testserver.h"
 
+#include <json/json.h>
+
 #include <QtGui/QApplication>
 
 #include <QtNetwork/QLocalSocket>
@@ -51,6 +53,7 @@ private slots:
   void cleanup();
 
   void testJobSubmission();
+  void testBatchJobSubmission();
   void testJobCancellation();
   void testLookupJob();
   void testRequestQueueListUpdate();
@@ -131,6 +134,56 @@ void ClientTest::testJobSubmission()
   QCOMPARE(strippedPacket, strippedRefPacket);
 }
 
+void ClientTest::testBatchJobSubmission()
+{
+  QList<MoleQueue::JobRequest> reqs;
+  for (int i = 0; i < 3; ++i) {
+    MoleQueue::JobRequest req = m_client->newJobRequest();
+    req.setQueue("Some queue");
+    req.setProgram("Some program");
+    req.setDescription(QString("Batch job %1").arg(i));
+    reqs << req;
+  }
+
+  m_client->submitJobRequests(reqs);
+
+  QVERIFY2(m_server->waitForPacket(), "Timeout waiting for reply.");
+
+  // All requests arrive in a single packet.
+  Json::Value root;
+  Json::Reader reader;
+  QVERIFY(reader.parse(m_packet.constData(),
+                       m_packet.constData() + m_packet.size(), root, false));
+  QVERIFY(root.isArray());
+  QCOMPARE(root.size(), 3u);
+
+  QSignalSpy spy (m_client, SIGNAL(jobSubmitted(MoleQueue::JobRequest,
+                                                bool,QString)));
+
+  // Answer with a single batch response.
+  const MoleQueue::PacketType responseTemplate =
+      readReferenceString("client-ref/successful-submission.json");
+  MoleQueue::PacketType batch = "[";
+  for (Json::Value::ArrayIndex i = 0; i < root.size(); ++i) {
+    QCOMPARE(QString(root[i]["method"].asCString()), QString("submitJob"));
+    QCOMPARE(QString(root[i]["params"]["description"].asCString()),
+             QString("Batch job %1").arg(i));
+    MoleQueue::PacketType response = responseTemplate;
+    response.replace("%id%", MoleQueue::PacketType::number(
+                       static_cast<qulonglong>(root[i]["id"].asLargestUInt())));
+    if (i > 0)
+      batch += ",";
+    batch += response;
+  }
+  batch += "]";
+  m_server->sendPacket(batch);
+
+  qApp->processEvents(QEventLoop::AllEvents, 1000);
+  QCOMPARE(spy.count(), 3);
+  for (int i = 0; i < spy.size(); ++i)
+    QVERIFY(spy[i][1].toBool());
+}
+
 void ClientTest::testJobCancellation()
 {
   MoleQueue::JobRequest req = m_client->newJobRequest();
@@ -18,6 +18,9 @@
 #include "testing/testserver.h"
 #include "program.h"
 #include "jobmanager.h"
+#include "transport/connection.h"
+
+#include <QtCore/QElapsedTimer>
 
 bool QueueDummy::submitJob(const MoleQueue::Job)
 {
@@ -52,6 +55,69 @@ void ConnectionTest::cleanup()
   delete m_server;
 }
 
+void ConnectionTest::addThroughputRows()
+{
+  QTest::addColumn<int>("messageCount");
+  QTest::addColumn<int>("messageSize");
+
+  QTest::newRow("small messages") << 500 << 256;
+  QTest::newRow("large messages") << 10 << 1024 * 1024;
+
+  if (!qgetenv("MOLEQUEUE_BENCHMARK").isEmpty()) {
+    QTest::newRow("many small messages") << 20000 << 256;
+    QTest::newRow("many large messages") << 200 << 1024 * 1024;
+  }
+}
+
+void ConnectionTest::measureThroughput(MoleQueue::Connection *sender,
+                                       MoleQueue::Connection *receiver,
+                                       int messageCount, int messageSize)
+{
+  m_throughputMessageCount = 0;
+  m_throughputByteCount = 0;
+  m_throughputLastPacket.clear();
+  connect(receiver, SIGNAL(newMessage(const MoleQueue::Message)),
+          this, SLOT(throughputMessageReceived(const MoleQueue::Message)));
+
+  MoleQueue::PacketType payload(messageSize, 'x');
+  QElapsedTimer timer;
+  timer.start();
+  for (int i = 0; i < messageCount; ++i) {
+    // Make the last message distinguishable to verify it arrives intact.
+    if (i == messageCount - 1)
+      payload.fill('y');
+    sender->send(MoleQueue::Message(payload));
+
+    // Let the event loop move data along periodically.
+    if (i % 100 == 0)
+      qApp->processEvents();
+  }
+
+  while (m_throughputMessageCount < messageCount && timer.elapsed() < 60000)
+    qApp->processEvents(QEventLoop::AllEvents, 100);
+  const qint64 elapsed = qMax(timer.elapsed(), Q_INT64_C(1));
+
+  disconnect(receiver, SIGNAL(newMessage(const MoleQueue::Message)),
+             this, SLOT(throughputMessageReceived(const MoleQueue::Message)));
+
+  QCOMPARE(m_throughputMessageCount, messageCount);
+  QCOMPARE(m_throughputByteCount,
+           static_cast<qint64>(messageCount) * messageSize);
+  QCOMPARE(m_throughputLastPacket, MoleQueue::PacketType(messageSize, 'y'));
+
+  qDebug() << "Throughput:"
+           << messageCount * 1000.0 / elapsed << "messages/sec,"
+           << m_throughputByteCount * 1000.0 / elapsed / (1024 * 1024)
+           << "MB/sec";
+}
+
+void ConnectionTest::throughputMessageReceived(const MoleQueue::Message msg)
+{
+  ++m_throughputMessageCount;
+  m_throughputByteCount += msg.data().size();
+  m_throughputLastPacket = msg.data();
+}
+
 void ConnectionTest::testRequestQueueList()
 {
   MoleQueue::QueueListType testQueues;
@@ -286,3 +352,52 @@ void ConnectionTest::testJobStateChangeNotification()
 
     QCOMPARE(state, MoleQueue::Killed);
 }
+
+void ConnectionTest::testPacketFormat()
+{
+  m_client->connectToServer(m_connectionName);
+  qApp->processEvents(QEventLoop::AllEvents, 1000);
+  QCOMPARE(m_server->m_connections.size(), 1);
+  MoleQueue::Connection *serverConnection = m_server->m_connections.first();
+  QCOMPARE(m_server->m_jsonrpc->packetFormat(serverConnection),
+           MoleQueue::StyledPacketFormat);
+
+  QSignalSpy spy (m_client,
+                  SIGNAL(packetFormatAccepted(MoleQueue::PacketFormat)));
+
+  m_client->setPacketFormat(MoleQueue::CompactPacketFormat);
+
+  QTimer timer;
+  timer.setSingleShot(true);
+  timer.start(1000);
+  while (timer.isActive() && spy.isEmpty()) {
+    qApp->processEvents(QEventLoop::AllEvents, 500);
+  }
+
+  QCOMPARE(spy.count(), 1);
+  QCOMPARE(spy.first().first().value<MoleQueue::PacketFormat>(),
+           MoleQueue::CompactPacketFormat);
+  QCOMPARE(m_server->m_jsonrpc->packetFormat(serverConnection),
+           MoleQueue::CompactPacketFormat);
+
+  // The client still understands the server's replies:
+  QSignalSpy listSpy (
+        m_client, SIGNAL(queueListUpdated(const MoleQueue::QueueListType&)));
+  m_client->requestQueueListUpdate();
+  timer.start(1000);
+  while (timer.isActive() && listSpy.isEmpty()) {
+    qApp->processEvents(QEventLoop::AllEvents, 500);
+  }
+  QCOMPARE(listSpy.count(), 1);
+
+  // Switching back restores styled packets:
+  spy.clear();
+  m_client->setPacketFormat(MoleQueue::StyledPacketFormat);
+  timer.start(1000);
+  while (timer.isActive() && spy.isEmpty()) {
+    qApp->processEvents(QEventLoop::AllEvents, 500);
+  }
+  QCOMPARE(spy.count(), 1);
+  QCOMPARE(m_server->m_jsonrpc->packetFormat(serverConnection),
+           MoleQueue::StyledPacketFormat);
+}
@@ -22,6 +22,8 @@
 #include "client.h"
 #include "server.h"
 
+#include "transport/message.h"
+
 #include <QtTest>
 
 
@@ -42,11 +44,31 @@ class ConnectionTest : public QObject
   Q_OBJECT
 protected:
   virtual MoleQueue::Client *createClient() = 0;
+
+  /// Add the messageCount and messageSize columns of a throughput test. The
+  /// heavy rows are only added if MOLEQUEUE_BENCHMARK is set in the
+  /// environment, as done by the "benchmark" target.
+  static void addThroughputRows();
+
+  /// Send @a messageCount messages of @a messageSize bytes from @a sender to
+  /// @a receiver, verify that they all arrive intact and print the
+  /// throughput. Both connections must be started.
+  void measureThroughput(MoleQueue::Connection *sender,
+                         MoleQueue::Connection *receiver,
+                         int messageCount, int messageSize);
+
+protected slots:
+  void throughputMessageReceived(const MoleQueue::Message msg);
+
 private:
   QString m_connectionName;
   MoleQueue::Server *m_server;
   MoleQueue::Client *m_client;
 
+  int m_throughputMessageCount;
+  qint64 m_throughputByteCount;
+  MoleQueue::PacketType m_throughputLastPacket;
+
 private slots:
 
   /// Called before the first test function is executed.
@@ -63,6 +85,7 @@ private slots:
   void testFailedSubmission();
   void testSuccessfulJobCancellation();
   void testJobStateChangeNotification();
+  void testPacketFormat();
 
 };
 
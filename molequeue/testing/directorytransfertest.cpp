@@ -0,0 +1,263 @@
+/******************************************************************************
+
+  This source file is part of the MoleQueue project.
+
+  Copyright 2012 Kitware, Inc.
+
+  This source code is released under the New BSD License, (the "License").
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+******************************************************************************/
+
+#include <QtTest>
+
+#include "opensshcommand.h"
+
+#include <QtCore/QDir>
+#include <QtCore/QDirIterator>
+#include <QtCore/QFile>
+#include <QtCore/QMap>
+#include <QtCore/QProcess>
+#include <QtCore/QScopedPointer>
+
+using MoleQueue::OpenSshCommand;
+using MoleQueue::SshCommand;
+
+Q_DECLARE_METATYPE(MoleQueue::SshCommand::DirectoryTransferMode)
+
+/// Copies directories through the stand-in ssh and scp scripts in
+/// data/fakessh, which run everything on the local host.
+class DirectoryTransferTest : public QObject
+{
+  Q_OBJECT
+
+private:
+  /// @return A command that uses the fake ssh and scp and transfers
+  /// directories with @a mode. The caller owns the command.
+  OpenSshCommand *newCommand(SshCommand::DirectoryTransferMode mode);
+
+  /// Create @a dirs directories with @a files small files each in @a path.
+  static void createTree(const QString &path, int dirs, int files);
+
+  /// @return The relative paths and contents of all files below @a path.
+  static QMap<QString, QByteArray> treeContents(const QString &path);
+
+  /// @return A path in the work directory that does not exist yet.
+  QString newPath();
+
+  void addModeRows();
+
+  QString m_workDir;
+  QString m_sourceDir;
+  int m_pathCount;
+
+private slots:
+  void initTestCase();
+  void cleanupTestCase();
+
+  void testCopyDirTo_data();
+  void testCopyDirTo();
+  void testCopyDirFrom_data();
+  void testCopyDirFrom();
+  void testCopyFilesFrom_data();
+  void testCopyFilesFrom();
+  void testMissingDirectory_data();
+  void testMissingDirectory();
+
+  void benchmarkCopyDirTo_data();
+  void benchmarkCopyDirTo();
+};
+
+OpenSshCommand *
+DirectoryTransferTest::newCommand(SshCommand::DirectoryTransferMode mode)
+{
+  OpenSshCommand *command = new OpenSshCommand;
+  command->setSshCommand(m_workDir + "/ssh");
+  command->setScpCommand(m_workDir + "/scp");
+  command->setHostName("localhost");
+  command->setDirectoryTransferMode(mode);
+  return command;
+}
+
+void DirectoryTransferTest::createTree(const QString &path, int dirs,
+                                       int files)
+{
+  for (int i = 0; i < dirs; ++i) {
+    const QString dirPath = QString("%1/dir%2").arg(path).arg(i);
+    QDir().mkpath(dirPath);
+    for (int j = 0; j < files; ++j) {
+      QFile file(QString("%1/file%2.out").arg(dirPath).arg(j));
+      file.open(QFile::WriteOnly);
+      file.write(QString("Output %1 of step %2\n").arg(j).arg(i).toLatin1());
+    }
+  }
+}
+
+QMap<QString, QByteArray>
+DirectoryTransferTest::treeContents(const QString &path)
+{
+  QMap<QString, QByteArray> contents;
+  QDir root(path);
+  QDirIterator it(path, QDir::Files, QDirIterator::Subdirectories);
+  while (it.hasNext()) {
+    QFile file(it.next());
+    file.open(QFile::ReadOnly);
+    contents.insert(root.relativeFilePath(file.fileName()), file.readAll());
+  }
+  return contents;
+}
+
+QString DirectoryTransferTest::newPath()
+{
+  return QString("%1/copy%2").arg(m_workDir).arg(++m_pathCount);
+}
+
+void DirectoryTransferTest::addModeRows()
+{
+  QTest::addColumn<SshCommand::DirectoryTransferMode>("mode");
+
+  QTest::newRow("scp") << SshCommand::ScpTransfer;
+  QTest::newRow("tar") << SshCommand::TarTransfer;
+  QTest::newRow("tar.gz") << SshCommand::CompressedTarTransfer;
+}
+
+void DirectoryTransferTest::initTestCase()
+{
+#ifndef Q_OS_UNIX
+  QSKIP("The fake ssh and scp are shell scripts.", SkipAll);
+#endif
+
+  m_pathCount = 0;
+  m_workDir = QDir::tempPath() + "/MoleQueue-directoryTransferTest";
+  QProcess::execute("rm", QStringList() << "-rf" << m_workDir);
+  QVERIFY(QDir().mkpath(m_workDir));
+
+  // Copy the scripts so that they can be made executable.
+  foreach (const QString &script, QStringList() << "ssh" << "scp") {
+    const QString target = m_workDir + "/" + script;
+    QVERIFY(QFile::copy(TESTDATADIR "fakessh/" + script, target));
+    QVERIFY(QFile::setPermissions(target, QFile::ReadOwner | QFile::ExeOwner));
+  }
+
+  // A job directory with many small output files
+  m_sourceDir = m_workDir + "/job";
+  createTree(m_sourceDir, 10, 50);
+  QCOMPARE(treeContents(m_sourceDir).size(), 500);
+}
+
+void DirectoryTransferTest::cleanupTestCase()
+{
+  QProcess::execute("rm", QStringList() << "-rf" << m_workDir);
+}
+
+void DirectoryTransferTest::testCopyDirTo_data()
+{
+  addModeRows();
+}
+
+void DirectoryTransferTest::testCopyDirTo()
+{
+  QFETCH(SshCommand::DirectoryTransferMode, mode);
+
+  QScopedPointer<OpenSshCommand> command(newCommand(mode));
+  const QString remoteDir = newPath() + "/4";
+  QVERIFY(QDir().mkpath(remoteDir + "/.."));
+  QVERIFY(command->copyDirTo(m_sourceDir, remoteDir));
+  QVERIFY(command->waitForCompletion());
+  QCOMPARE(command->exitCode(), 0);
+  QVERIFY(treeContents(remoteDir) == treeContents(m_sourceDir));
+}
+
+void DirectoryTransferTest::testCopyDirFrom_data()
+{
+  addModeRows();
+}
+
+void DirectoryTransferTest::testCopyDirFrom()
+{
+  QFETCH(SshCommand::DirectoryTransferMode, mode);
+
+  QScopedPointer<OpenSshCommand> command(newCommand(mode));
+  const QString localDir = newPath();
+  QVERIFY(command->copyDirFrom(m_sourceDir, localDir));
+  QVERIFY(command->waitForCompletion());
+  QCOMPARE(command->exitCode(), 0);
+  QVERIFY(treeContents(localDir + "/job") == treeContents(m_sourceDir));
+}
+
+void DirectoryTransferTest::testCopyFilesFrom_data()
+{
+  addModeRows();
+}
+
+void DirectoryTransferTest::testCopyFilesFrom()
+{
+  QFETCH(SshCommand::DirectoryTransferMode, mode);
+
+  const QStringList files = QStringList() << "dir0/file1.out"
+                                          << "dir3/file7.out"
+                                          << "dir3/file8.out";
+  QScopedPointer<OpenSshCommand> command(newCommand(mode));
+  const QString localDir = newPath();
+  QVERIFY(command->copyFilesFrom(m_sourceDir, files, localDir));
+  QVERIFY(command->waitForCompletion());
+  QCOMPARE(command->exitCode(), 0);
+
+  const QMap<QString, QByteArray> source = treeContents(m_sourceDir);
+  QMap<QString, QByteArray> expected;
+  foreach (const QString &file, files)
+    expected.insert(file, source.value(file));
+  QVERIFY(treeContents(localDir) == expected);
+
+  // A missing file fails the transfer.
+  QVERIFY(command->copyFilesFrom(m_sourceDir, QStringList() << "missing.out"
+                                 << "dir0/file1.out", newPath()));
+  QVERIFY(command->waitForCompletion());
+  QVERIFY(command->exitCode() != 0);
+}
+
+void DirectoryTransferTest::testMissingDirectory_data()
+{
+  addModeRows();
+}
+
+void DirectoryTransferTest::testMissingDirectory()
+{
+  QFETCH(SshCommand::DirectoryTransferMode, mode);
+
+  // Failures at either end of the pipe are reported.
+  QScopedPointer<OpenSshCommand> command(newCommand(mode));
+  QVERIFY(command->copyDirTo(m_workDir + "/missing", newPath()));
+  QVERIFY(command->waitForCompletion());
+  QVERIFY(command->exitCode() != 0);
+
+  QVERIFY(command->copyDirFrom(m_workDir + "/missing", newPath()));
+  QVERIFY(command->waitForCompletion());
+  QVERIFY(command->exitCode() != 0);
+}
+
+void DirectoryTransferTest::benchmarkCopyDirTo_data()
+{
+  addModeRows();
+}
+
+void DirectoryTransferTest::benchmarkCopyDirTo()
+{
+  QFETCH(SshCommand::DirectoryTransferMode, mode);
+
+  QScopedPointer<OpenSshCommand> command(newCommand(mode));
+  QBENCHMARK {
+    QVERIFY(command->copyDirTo(m_sourceDir, newPath()));
+    QVERIFY(command->waitForCompletion());
+    QCOMPARE(command->exitCode(), 0);
+  }
+}
+
+QTEST_MAIN(DirectoryTransferTest)
+
+#include "directorytransfertest.moc"
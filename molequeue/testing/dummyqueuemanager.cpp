@@ -18,6 +18,8 @@
 
 #include "dummyqueueremote.h"
 
+#include "queues/local.h"
+
 using namespace MoleQueue;
 
 DummyQueueManager::DummyQueueManager(Server *parentServer)
@@ -42,6 +44,10 @@ Queue *DummyQueueManager::addQueue(const QString &queueName,
   Queue * newQueue = NULL;
   if (queueType == "Dummy")
     newQueue = new DummyQueueRemote(queueName, this);
+  else if (queueType == "Local") {
+    newQueue = new QueueLocal(this);
+    newQueue->setName(queueName);
+  }
 
   if (!newQueue)
     return NULL;
@@ -36,7 +36,12 @@ DummyQueueRemote::~DummyQueueRemote()
 bool DummyQueueRemote::parseQueueId(const QString &submissionOutput,
                                     IdType *queueId)
 {
-  Q_UNUSED(submissionOutput);
+  // Use the first number in the output, or 12 if there is none.
+  QRegExp parser("(\\d+)");
+  if (parser.indexIn(submissionOutput) >= 0) {
+    *queueId = static_cast<IdType>(parser.cap(1).toUInt());
+    return true;
+  }
   *queueId = 12;
   return true;
 }
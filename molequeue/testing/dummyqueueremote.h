@@ -52,9 +52,7 @@ protected:
     }
 
     m_dummySsh = new DummySshCommand();
-    m_dummySsh->setHostName(m_hostName);
-    m_dummySsh->setUserName(m_userName);
-    m_dummySsh->setPortNumber(m_sshPort);
+    configureSshCommand(m_dummySsh.data());
     m_dummySsh->setParent(this);
 
     return m_dummySsh.data();
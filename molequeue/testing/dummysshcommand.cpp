@@ -19,10 +19,54 @@
 using namespace MoleQueue;
 
 DummySshCommand::DummySshCommand(QObject *parentObject)
-  : MoleQueue::OpenSshCommand(parentObject)
+  : MoleQueue::OpenSshCommand(parentObject),
+    m_dummyArchiveUpload(false)
 {
 }
 
 DummySshCommand::~DummySshCommand()
 {
 }
+
+int DummySshCommand::m_handshakeCount = 0;
+QSet<QString> DummySshCommand::m_masterConnections;
+
+void DummySshCommand::resetHandshakes()
+{
+  m_handshakeCount = 0;
+  m_masterConnections.clear();
+}
+
+void DummySshCommand::sendRequest(const QString &command,
+                                  const QStringList &args)
+{
+  m_dummyCommand = command;
+  m_dummyArgs = args;
+  m_dummyArchiveArgs.clear();
+
+  // Mimic OpenSSH: with ControlMaster=auto, the first request for a control
+  // path authenticates and becomes the master, later ones reuse it.
+  QString controlPath;
+  bool controlMaster = false;
+  foreach (const QString &arg, args) {
+    if (arg == "ControlMaster=auto")
+      controlMaster = true;
+    else if (arg.startsWith("ControlPath="))
+      controlPath = arg.mid(12);
+  }
+
+  if (controlMaster && m_masterConnections.contains(controlPath))
+    return;
+
+  ++m_handshakeCount;
+  if (controlMaster && !controlPath.isEmpty())
+    m_masterConnections.insert(controlPath);
+}
+
+void DummySshCommand::sendArchiveRequest(const QStringList &archiveArgs,
+                                         const QStringList &args, bool upload)
+{
+  sendRequest(m_sshCommand, args);
+  m_dummyArchiveArgs = archiveArgs;
+  m_dummyArchiveUpload = upload;
+}
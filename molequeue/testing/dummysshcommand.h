@@ -19,6 +19,8 @@
 
 #include "opensshcommand.h"
 
+#include <QtCore/QSet>
+
 /// SshCommand implementation that doesn't actually call external processes.
 class DummySshCommand : public MoleQueue::OpenSshCommand
 {
@@ -30,19 +32,38 @@ public:
 
   QString getDummyCommand() const { return m_dummyCommand; }
   QStringList getDummyArgs() const { return m_dummyArgs; }
+  /// @return The arguments of the local tar, if the last request was an
+  /// archive transfer.
+  QStringList getDummyArchiveArgs() const { return m_dummyArchiveArgs; }
+  bool getDummyArchiveUpload() const { return m_dummyArchiveUpload; }
   void setDummyOutput(const QString &out) { m_output = out; }
+  void setDummyStandardOutput(const QByteArray &out)
+  {
+    m_standardOutput = out;
+  }
   void setDummyExitCode(int code) {m_exitCode = code; }
   void emitDummyRequestComplete() { emit requestComplete(); }
 
+  /// @return The number of requests that would have authenticated with the
+  /// host, rather than reusing a shared master connection.
+  static int handshakeCount() { return m_handshakeCount; }
+
+  /// Reset handshakeCount() and forget all master connections.
+  static void resetHandshakes();
+
 protected:
-  void sendRequest(const QString &command, const QStringList &args)
-  {
-    m_dummyCommand = command;
-    m_dummyArgs = args;
-  }
+  void sendRequest(const QString &command, const QStringList &args);
+  void sendArchiveRequest(const QStringList &archiveArgs,
+                          const QStringList &args, bool upload);
 
   QString m_dummyCommand;
   QStringList m_dummyArgs;
+  QStringList m_dummyArchiveArgs;
+  bool m_dummyArchiveUpload;
+
+  static int m_handshakeCount;
+  /// Control paths of the master connections that have been started.
+  static QSet<QString> m_masterConnections;
 };
 
 #endif // DUMMYSSHCOMMAND_H
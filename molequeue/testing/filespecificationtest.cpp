@@ -47,6 +47,7 @@ private slots:
   void ctorFromFileNameAndContents();
   void ctorFromFile();
   void ctorCopy();
+  void fromJson();
   void assignment();
 
   void format();
@@ -144,6 +145,19 @@ void FileSpecificationTest::ctorCopy()
   QCOMPARE(spec1.asJsonString(), spec2.asJsonString());
 }
 
+void FileSpecificationTest::fromJson()
+{
+  Json::Value json(Json::objectValue);
+  json["filename"] = "file.ext";
+  json["contents"] = "I'm input file text!\n";
+
+  FileSpecification spec = FileSpecification::fromJson(json);
+  QVERIFY(json.isNull());
+  QCOMPARE(spec.format(), FileSpecification::ContentsFileSpecification);
+  QString ref = readReferenceString("filespec-ref/contents.json");
+  QCOMPARE(spec.asJsonString(), ref);
+}
+
 void FileSpecificationTest::assignment()
 {
   FileSpecification spec1(QString("/path/to/some/file.ext"));
@@ -0,0 +1,466 @@
+/******************************************************************************
+
+  This source file is part of the MoleQueue project.
+
+  Copyright 2012 Kitware, Inc.
+
+  This source code is released under the New BSD License, (the "License").
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+******************************************************************************/
+
+#include <QtTest>
+
+#include "jobjournal.h"
+
+#include "job.h"
+#include "jobitemmodel.h"
+#include "jobmanager.h"
+#include "molequeueglobal.h"
+
+#include <QtCore/QDir>
+#include <QtCore/QFile>
+#include <QtCore/QFileInfo>
+#include <QtCore/QSettings>
+#include <QtCore/QtEndian>
+
+using MoleQueue::IdType;
+using MoleQueue::Job;
+using MoleQueue::JobItemModel;
+using MoleQueue::JobJournal;
+using MoleQueue::JobManager;
+
+class JobJournalTest : public QObject
+{
+  Q_OBJECT
+
+private:
+  QString m_journalFile;
+  QString m_settingsFile;
+  IdType m_nextId;
+
+  QVariantHash jobState(IdType moleQueueId, const QString &description);
+
+  // Write a journal with @a numJobs jobs, @a numActive of which are running.
+  void writeJournal(int numJobs, int numActive);
+
+private slots:
+  /// Called before the first test function is executed.
+  void initTestCase();
+  /// Called after the last test function is executed.
+  void cleanupTestCase();
+  /// Called before each test function is executed.
+  void init();
+  /// Called after every test function.
+  void cleanup();
+
+  // Assign increasing MoleQueue ids to new jobs
+  void setNewJobIds(MoleQueue::Job);
+
+  void testReplay();
+  void testTruncatedRecord();
+  void testCompact();
+  void testJobManager();
+  void testUpdateSize();
+  void testMigrateSettings();
+  void testUnsupportedVersion();
+  void testLazyLoading();
+
+  void benchmarkReadSettings_data();
+  void benchmarkReadSettings();
+};
+
+QVariantHash JobJournalTest::jobState(IdType moleQueueId,
+                                      const QString &description)
+{
+  QVariantHash state;
+  state.insert("moleQueueId", moleQueueId);
+  state.insert("description", description);
+  return state;
+}
+
+void JobJournalTest::writeJournal(int numJobs, int numActive)
+{
+  JobJournal journal;
+  QVERIFY(journal.open(m_journalFile));
+  for (int i = 1; i <= numJobs; ++i) {
+    IdType moleQueueId = static_cast<IdType>(i);
+    QVariantHash state = jobState(moleQueueId, QString("Job %1").arg(i));
+    state.insert("jobState", i <= numActive ? MoleQueue::RunningLocal
+                                            : MoleQueue::Finished);
+    state.insert("program", "Quantum Tater");
+    state.insert("queue", "Some big ol' cluster");
+    QVERIFY(journal.appendCreate(moleQueueId, state));
+  }
+}
+
+void JobJournalTest::initTestCase()
+{
+  m_journalFile = QDir::tempPath() + QString("/jobjournaltest-%1.journal")
+      .arg(QCoreApplication::applicationPid());
+  m_settingsFile = QDir::tempPath() + QString("/jobjournaltest-%1.ini")
+      .arg(QCoreApplication::applicationPid());
+}
+
+void JobJournalTest::cleanupTestCase()
+{
+}
+
+void JobJournalTest::init()
+{
+  QFile::remove(m_journalFile);
+  QFile::remove(m_settingsFile);
+  m_nextId = 1;
+}
+
+void JobJournalTest::cleanup()
+{
+  QFile::remove(m_journalFile);
+  QFile::remove(m_journalFile + ".tmp");
+  QFile::remove(m_settingsFile);
+}
+
+void JobJournalTest::setNewJobIds(MoleQueue::Job job)
+{
+  job.setMoleQueueId(m_nextId++);
+}
+
+void JobJournalTest::testReplay()
+{
+  {
+    JobJournal journal;
+    QVERIFY(journal.open(m_journalFile));
+    QVERIFY(journal.appendCreate(1, jobState(1, "first")));
+    QVERIFY(journal.appendCreate(2, jobState(2, "second")));
+    QVERIFY(journal.appendCreate(3, jobState(3, "third")));
+    QVariantHash changes;
+    changes.insert("description", "second, updated");
+    QVERIFY(journal.appendUpdate(2, MoleQueue::RunningLocal, changes));
+    QVERIFY(journal.appendRemove(1));
+  }
+
+  JobJournal journal;
+  QVERIFY(journal.open(m_journalFile));
+  QMap<IdType, QVariantHash> states = journal.replay();
+  QCOMPARE(states.size(), 2);
+  // Updates are merged into the state of the job.
+  QCOMPARE(states.value(2).value("description").toString(),
+           QString("second, updated"));
+  QCOMPARE(states.value(2).value("moleQueueId").toUInt(), 2u);
+  QCOMPARE(states.value(3).value("description").toString(), QString("third"));
+  QCOMPARE(journal.recordCount(), 5);
+  QCOMPARE(journal.liveCount(), 2);
+  QCOMPARE(journal.maxMoleQueueId(), static_cast<IdType>(3));
+  QCOMPARE(journal.replayRecords().value(2).jobState, MoleQueue::RunningLocal);
+
+  // Recreating a live job does not add to the live jobs.
+  QVERIFY(journal.appendCreate(3, jobState(3, "third, again")));
+  QCOMPARE(journal.liveCount(), 2);
+  QVERIFY(journal.appendRemove(3));
+  QVERIFY(journal.appendRemove(3));
+  QCOMPARE(journal.liveCount(), 1);
+}
+
+void JobJournalTest::testTruncatedRecord()
+{
+  qint64 goodSize;
+  {
+    JobJournal journal;
+    QVERIFY(journal.open(m_journalFile));
+    QVERIFY(journal.appendCreate(1, jobState(1, "first")));
+    goodSize = QFileInfo(m_journalFile).size();
+    QVERIFY(journal.appendCreate(2, jobState(2, "second")));
+  }
+
+  // Simulate a crash in the middle of writing the second record
+  QFile file(m_journalFile);
+  QVERIFY(file.open(QIODevice::ReadWrite));
+  QVERIFY(file.resize(file.size() - 3));
+  file.close();
+
+  JobJournal journal;
+  QVERIFY(journal.open(m_journalFile));
+  QMap<IdType, QVariantHash> states = journal.replay();
+  QCOMPARE(states.size(), 1);
+  QVERIFY(states.contains(1));
+  QCOMPARE(QFileInfo(m_journalFile).size(), goodSize);
+
+  // New records are appended after the last good record
+  QVERIFY(journal.appendCreate(4, jobState(4, "fourth")));
+  journal.close();
+  QVERIFY(journal.open(m_journalFile));
+  states = journal.replay();
+  QCOMPARE(states.keys(), QList<IdType>() << 1 << 4);
+}
+
+void JobJournalTest::testCompact()
+{
+  JobJournal journal;
+  QVERIFY(journal.open(m_journalFile));
+  for (IdType i = 1; i <= 10; ++i)
+    QVERIFY(journal.appendCreate(i, jobState(i, "job")));
+  QVariantHash changes;
+  changes.insert("description", "updated");
+  for (IdType i = 1; i <= 10; ++i)
+    QVERIFY(journal.appendUpdate(i, MoleQueue::Finished, changes));
+  for (IdType i = 1; i <= 8; ++i)
+    QVERIFY(journal.appendRemove(i));
+  QCOMPARE(journal.recordCount(), 28);
+  QCOMPARE(journal.liveCount(), 2);
+
+  QList<QVariantHash> live;
+  live << jobState(9, "updated") << jobState(10, "updated");
+  const qint64 oldSize = QFileInfo(m_journalFile).size();
+  QVERIFY(journal.compact(live));
+  QVERIFY(QFileInfo(m_journalFile).size() < oldSize);
+  QVERIFY(!QFile::exists(m_journalFile + ".tmp"));
+
+  // The journal stays usable after compaction
+  QVERIFY(journal.appendCreate(11, jobState(11, "new")));
+  journal.close();
+
+  QVERIFY(journal.open(m_journalFile));
+  QMap<IdType, QVariantHash> states = journal.replay();
+  QCOMPARE(states.keys(), QList<IdType>() << 9 << 10 << 11);
+  QCOMPARE(journal.maxMoleQueueId(), static_cast<IdType>(11));
+  journal.close();
+
+  // Removed ids are still accounted for in the counter after compaction
+  QVERIFY(journal.open(m_journalFile));
+  journal.replay();
+  QVERIFY(journal.compact(QList<QVariantHash>() << jobState(9, "updated")));
+  journal.close();
+  QVERIFY(journal.open(m_journalFile));
+  QCOMPARE(journal.replay().size(), 1);
+  QCOMPARE(journal.maxMoleQueueId(), static_cast<IdType>(11));
+}
+
+void JobJournalTest::testJobManager()
+{
+  QSettings settings(m_settingsFile, QSettings::IniFormat);
+  {
+    JobManager jobManager;
+    connect(&jobManager, SIGNAL(jobAboutToBeAdded(MoleQueue::Job)),
+            this, SLOT(setNewJobIds(MoleQueue::Job)), Qt::DirectConnection);
+    QVERIFY(jobManager.openJournal(m_journalFile));
+    jobManager.readSettings(settings);
+    QCOMPARE(jobManager.count(), 0);
+
+    for (int i = 0; i < 5; ++i)
+      jobManager.newJob().setDescription(QString("Job %1").arg(i));
+    jobManager.setJobState(2, MoleQueue::RunningLocal);
+    jobManager.setJobQueueId(3, 1234);
+    jobManager.removeJob(static_cast<IdType>(1));
+    // No writeSettings call -- simulate a crash.
+    QCOMPARE(jobManager.journal()->recordCount(), 8);
+  }
+
+  JobManager jobManager;
+  QVERIFY(jobManager.openJournal(m_journalFile));
+  jobManager.readSettings(settings);
+  QCOMPARE(jobManager.count(), 4);
+  QVERIFY(!jobManager.lookupJobByMoleQueueId(1).isValid());
+  QCOMPARE(jobManager.lookupJobByMoleQueueId(2).jobState(),
+           MoleQueue::RunningLocal);
+  QCOMPARE(jobManager.lookupJobByMoleQueueId(3).queueId(),
+           static_cast<IdType>(1234));
+  QCOMPARE(jobManager.journal()->maxMoleQueueId(), static_cast<IdType>(5));
+
+  // writeSettings compacts the journal and picks up unsignalled changes
+  jobManager.lookupJobByMoleQueueId(4).setDescription("Renamed");
+  jobManager.writeSettings(settings);
+  QCOMPARE(jobManager.journal()->recordCount(), 5);
+  QVERIFY(!settings.contains("Jobs/size"));
+
+  JobManager reloaded;
+  QVERIFY(reloaded.openJournal(m_journalFile));
+  reloaded.readSettings(settings);
+  QCOMPARE(reloaded.count(), 4);
+  QCOMPARE(reloaded.lookupJobByMoleQueueId(4).description(),
+           QString("Renamed"));
+}
+
+void JobJournalTest::testUpdateSize()
+{
+  QSettings settings(m_settingsFile, QSettings::IniFormat);
+  JobManager jobManager;
+  connect(&jobManager, SIGNAL(jobAboutToBeAdded(MoleQueue::Job)),
+          this, SLOT(setNewJobIds(MoleQueue::Job)), Qt::DirectConnection);
+  QVERIFY(jobManager.openJournal(m_journalFile));
+  jobManager.readSettings(settings);
+
+  QVariantHash state;
+  state.insert("description", QString(100000, QLatin1Char('x')));
+  Job job = jobManager.newJob(state);
+  const qint64 createdSize = QFileInfo(m_journalFile).size();
+  QVERIFY(createdSize > 100000);
+
+  // State changes do not rewrite the whole job.
+  jobManager.setJobState(job.moleQueueId(), MoleQueue::Submitted);
+  jobManager.setJobQueueId(job.moleQueueId(), 1234);
+  jobManager.setJobState(job.moleQueueId(), MoleQueue::RunningRemote);
+  QVERIFY(QFileInfo(m_journalFile).size() - createdSize < 1000);
+
+  JobManager reloaded;
+  QVERIFY(reloaded.openJournal(m_journalFile));
+  reloaded.readSettings(settings);
+  Job reloadedJob = reloaded.lookupJobByMoleQueueId(job.moleQueueId());
+  QCOMPARE(reloadedJob.jobState(), MoleQueue::RunningRemote);
+  QCOMPARE(reloadedJob.queueId(), static_cast<IdType>(1234));
+  QCOMPARE(reloadedJob.description().size(), 100000);
+}
+
+void JobJournalTest::testMigrateSettings()
+{
+  QSettings settings(m_settingsFile, QSettings::IniFormat);
+  {
+    // Write jobs to QSettings, as done without a journal
+    JobManager jobManager;
+    connect(&jobManager, SIGNAL(jobAboutToBeAdded(MoleQueue::Job)),
+            this, SLOT(setNewJobIds(MoleQueue::Job)), Qt::DirectConnection);
+    for (int i = 0; i < 3; ++i)
+      jobManager.newJob();
+    jobManager.writeSettings(settings);
+  }
+  QCOMPARE(settings.value("Jobs/size").toInt(), 3);
+
+  {
+    JobManager jobManager;
+    QVERIFY(jobManager.openJournal(m_journalFile));
+    jobManager.readSettings(settings);
+    QCOMPARE(jobManager.count(), 3);
+    QVERIFY(!settings.contains("Jobs/size"));
+  }
+
+  JobManager jobManager;
+  QVERIFY(jobManager.openJournal(m_journalFile));
+  jobManager.readSettings(settings);
+  QCOMPARE(jobManager.count(), 3);
+  QVERIFY(jobManager.lookupJobByMoleQueueId(3).isValid());
+}
+
+void JobJournalTest::testUnsupportedVersion()
+{
+  writeJournal(3, 0);
+
+  JobJournal journal;
+  QVERIFY(journal.open(m_journalFile));
+  journal.close();
+
+  // Journals written in an unknown format are rejected.
+  QFile file(m_journalFile);
+  QVERIFY(file.open(QIODevice::ReadWrite));
+  QByteArray header = file.read(8);
+  qToBigEndian<quint32>(99, reinterpret_cast<uchar*>(header.data()) + 4);
+  QVERIFY(file.seek(0));
+  file.write(header);
+  file.close();
+  QVERIFY(!journal.open(m_journalFile));
+}
+
+void JobJournalTest::testLazyLoading()
+{
+  writeJournal(10, 3);
+
+  QSettings settings(m_settingsFile, QSettings::IniFormat);
+  JobManager jobManager;
+  jobManager.setLazyLoading(true);
+  QVERIFY(jobManager.openJournal(m_journalFile));
+  jobManager.readSettings(settings);
+
+  // Only the running jobs are loaded
+  QCOMPARE(jobManager.count(), 3);
+  QCOMPARE(jobManager.deferredCount(), 7);
+  QCOMPARE(jobManager.jobCount(MoleQueue::RunningLocal), 3);
+  QCOMPARE(jobManager.jobCount(MoleQueue::Finished), 7);
+
+  // State queries and const lookups do not load deferred jobs
+  QVERIFY(jobManager.jobsWithJobState(MoleQueue::Finished).isEmpty());
+  const JobManager &constManager = jobManager;
+  QVERIFY(!constManager.lookupJobByMoleQueueId(8).isValid());
+  QCOMPARE(jobManager.deferredCount(), 7);
+
+  // Lookups page in deferred jobs
+  Job job = jobManager.lookupJobByMoleQueueId(8);
+  QVERIFY(job.isValid());
+  QCOMPARE(job.description(), QString("Job 8"));
+  QCOMPARE(jobManager.count(), 4);
+  QCOMPARE(jobManager.deferredCount(), 6);
+  QCOMPARE(jobManager.jobCount(MoleQueue::Finished), 7);
+
+  // The item model fetches the rest
+  JobItemModel *model = jobManager.itemModel();
+  QCOMPARE(model->rowCount(), 4);
+  QVERIFY(model->canFetchMore(QModelIndex()));
+  model->fetchMore(QModelIndex());
+  QVERIFY(!model->canFetchMore(QModelIndex()));
+  QCOMPARE(model->rowCount(), 10);
+  QCOMPARE(jobManager.deferredCount(), 0);
+
+  // Deferred jobs survive compaction
+  JobManager lazyManager;
+  lazyManager.setLazyLoading(true);
+  QVERIFY(lazyManager.openJournal(m_journalFile));
+  lazyManager.readSettings(settings);
+  QCOMPARE(lazyManager.count(), 3);
+  lazyManager.writeSettings(settings);
+
+  JobManager eagerManager;
+  QVERIFY(eagerManager.openJournal(m_journalFile));
+  eagerManager.readSettings(settings);
+  QCOMPARE(eagerManager.count(), 10);
+  QCOMPARE(eagerManager.jobsWithJobState(MoleQueue::Finished).size(), 7);
+
+  // Deferred jobs are removed without loading them
+  JobManager removeManager;
+  removeManager.setLazyLoading(true);
+  QVERIFY(removeManager.openJournal(m_journalFile));
+  removeManager.readSettings(settings);
+  removeManager.lookupJobByMoleQueueId(8);
+  QSignalSpy removedSpy(&removeManager, SIGNAL(jobRemoved(MoleQueue::IdType)));
+  removeManager.removeJobsWithJobState(MoleQueue::Finished);
+  QCOMPARE(removedSpy.size(), 7);
+  QCOMPARE(removeManager.count(), 3);
+  QCOMPARE(removeManager.deferredCount(), 0);
+  QCOMPARE(removeManager.jobCount(MoleQueue::Finished), 0);
+  QCOMPARE(removeManager.jobCount(MoleQueue::RunningLocal), 3);
+  removeManager.writeSettings(settings);
+
+  JobManager reloadedManager;
+  QVERIFY(reloadedManager.openJournal(m_journalFile));
+  reloadedManager.readSettings(settings);
+  QCOMPARE(reloadedManager.count(), 3);
+}
+
+void JobJournalTest::benchmarkReadSettings_data()
+{
+  QTest::addColumn<bool>("lazy");
+
+  QTest::newRow("eager") << false;
+  QTest::newRow("lazy") << true;
+}
+
+void JobJournalTest::benchmarkReadSettings()
+{
+  QFETCH(bool, lazy);
+
+  // A server with a long history: 20000 jobs, 100 of which are active
+  writeJournal(20000, 100);
+
+  QSettings settings(m_settingsFile, QSettings::IniFormat);
+  QBENCHMARK {
+    JobManager jobManager;
+    jobManager.setLazyLoading(lazy);
+    jobManager.openJournal(m_journalFile);
+    jobManager.readSettings(settings);
+  }
+}
+
+QTEST_MAIN(JobJournalTest)
+
+#include "jobjournaltest.moc"
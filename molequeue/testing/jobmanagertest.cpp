@@ -17,6 +17,8 @@
 #include "jobmanager.h"
 
 #include "job.h"
+#include "jobdata.h"
+#include "jobitemmodel.h"
 #include "molequeueglobal.h"
 
 #include <QtTest>
@@ -45,6 +47,11 @@ private slots:
 
   void testJobAboutToBeAdded();
   void testLookupMoleQueueId();
+  void testRemoveJobs();
+  void testJobsWithJobState();
+  void testStaleReferences();
+  void testSnapshot();
+  void benchmarkJobAccessors();
 
 };
 
@@ -100,6 +107,156 @@ void JobManagerTest::testLookupMoleQueueId()
   QCOMPARE(job2, lookupJob2);
 }
 
+void JobManagerTest::testRemoveJobs()
+{
+  // Add jobs until there are 10 in the manager (ids 1-10)
+  while (m_jobManager.count() < 10)
+    m_jobManager.newJob();
+  QCOMPARE(m_jobManager.count(), 10);
+
+  qRegisterMetaType<QModelIndex>("QModelIndex");
+  QSignalSpy rowSpy(m_jobManager.itemModel(),
+                    SIGNAL(rowsRemoved(QModelIndex,int,int)));
+  QSignalSpy removedSpy(&m_jobManager, SIGNAL(jobRemoved(MoleQueue::IdType)));
+
+  // Remove two contiguous blocks (ids 3-5 and 8-9) plus a duplicate and an
+  // unknown id
+  QList<MoleQueue::IdType> ids;
+  ids << 9 << 3 << 4 << 5 << 8 << 4 << 1234;
+  m_jobManager.removeJobs(ids);
+
+  QCOMPARE(m_jobManager.count(), 5);
+  QCOMPARE(removedSpy.count(), 5);
+  QCOMPARE(rowSpy.count(), 2);
+
+  foreach (MoleQueue::IdType id, ids)
+    QVERIFY(!m_jobManager.lookupJobByMoleQueueId(id).isValid());
+
+  // Remaining jobs keep their relative order and have consistent indices
+  QList<MoleQueue::IdType> remaining;
+  remaining << 1 << 2 << 6 << 7 << 10;
+  for (int i = 0; i < remaining.size(); ++i) {
+    Job job = m_jobManager.jobAt(i);
+    QCOMPARE(job.moleQueueId(), remaining[i]);
+    QCOMPARE(m_jobManager.lookupJobByMoleQueueId(remaining[i]), job);
+    QCOMPARE(m_jobManager.indexOf(job), i);
+  }
+
+  // Removing a single job through a stale reference is a no-op
+  Job job6 = m_jobManager.lookupJobByMoleQueueId(6);
+  m_jobManager.removeJob(job6);
+  QCOMPARE(m_jobManager.count(), 4);
+  QVERIFY(!job6.isValid());
+  m_jobManager.removeJob(job6);
+  QCOMPARE(m_jobManager.count(), 4);
+  QCOMPARE(m_jobManager.indexOf(m_jobManager.lookupJobByMoleQueueId(10)), 3);
+}
+
+void JobManagerTest::testJobsWithJobState()
+{
+  const int numJobs = m_jobManager.count();
+  QCOMPARE(m_jobManager.jobCount(MoleQueue::None), numJobs);
+  QCOMPARE(m_jobManager.jobsWithJobState(MoleQueue::None).size(), numJobs);
+  QCOMPARE(m_jobManager.jobCount(MoleQueue::RunningLocal), 0);
+
+  Job job1 = m_jobManager.jobAt(0);
+  Job job2 = m_jobManager.jobAt(1);
+  job1.setJobState(MoleQueue::RunningLocal);
+  job2.setJobState(MoleQueue::Error);
+
+  QCOMPARE(m_jobManager.jobCount(MoleQueue::None), numJobs - 2);
+  QList<Job> running = m_jobManager.jobsWithJobState(MoleQueue::RunningLocal);
+  QCOMPARE(running.size(), 1);
+  QCOMPARE(running.first(), job1);
+  QCOMPARE(m_jobManager.jobCount(MoleQueue::Error), 1);
+
+  // Changing the state through setFromHash must update the index as well
+  QVariantHash hash = job1.hash();
+  hash.insert("jobState", MoleQueue::Finished);
+  job1.setFromHash(hash);
+  QCOMPARE(m_jobManager.jobCount(MoleQueue::RunningLocal), 0);
+  QCOMPARE(m_jobManager.jobCount(MoleQueue::Finished), 1);
+
+  // Removed jobs are dropped from the index
+  m_jobManager.removeJob(job2);
+  QCOMPARE(m_jobManager.jobCount(MoleQueue::Error), 0);
+  QVERIFY(m_jobManager.jobsWithJobState(MoleQueue::Error).isEmpty());
+}
+
+void JobManagerTest::testStaleReferences()
+{
+  MoleQueue::JobManager jobManager;
+  Job job1 = jobManager.newJob();
+  Job job2 = jobManager.newJob();
+  Job job1Copy = job1;
+  QVERIFY(job1.isValid());
+  QVERIFY(job1Copy.isValid());
+
+  jobManager.removeJob(job1);
+  QVERIFY(!job1.isValid());
+  QVERIFY(!job1Copy.isValid());
+  QVERIFY(job2.isValid());
+
+  // New jobs reuse the removed job's handle slot (and possibly its address),
+  // but must not revive references to the removed job.
+  Job job3 = jobManager.newJob();
+  QVERIFY(job3.isValid());
+  QVERIFY(!job1Copy.isValid());
+  QVERIFY(!(job1Copy == job3));
+  QCOMPARE(jobManager.jobAt(1), job3);
+
+  // References created from a JobData pointer are validated the same way
+  Job job3Alias(jobManager.jobAt(1));
+  QCOMPARE(job3Alias, job3);
+  jobManager.removeJob(job3);
+  QVERIFY(!job3Alias.isValid());
+  QVERIFY(job2.isValid());
+}
+
+void JobManagerTest::testSnapshot()
+{
+  MoleQueue::JobManager jobManager;
+  Job job = jobManager.newJob();
+  job.setQueue("Some queue");
+  job.setProgram("Some program");
+  job.setDescription("Some description");
+  job.setNumberOfCores(4);
+  job.setKeywordReplacement("$$key$$", "value");
+
+  const MoleQueue::JobData snapshot = job.snapshot();
+  QCOMPARE(snapshot.queue(), QString("Some queue"));
+  QCOMPARE(snapshot.program(), QString("Some program"));
+  QCOMPARE(snapshot.description(), QString("Some description"));
+  QCOMPARE(snapshot.numberOfCores(), 4);
+  QCOMPARE(snapshot.keywords(), job.keywords());
+  QCOMPARE(snapshot.hash(), job.hash());
+
+  // The snapshot is detached from the job
+  job.setQueue("Other queue");
+  QCOMPARE(snapshot.queue(), QString("Some queue"));
+  QVERIFY(!Job(const_cast<MoleQueue::JobData*>(&snapshot)).isValid());
+
+  jobManager.removeJob(job);
+  QCOMPARE(job.snapshot().moleQueueId(), MoleQueue::InvalidId);
+  QVERIFY(job.snapshot().queue().isEmpty());
+}
+
+void JobManagerTest::benchmarkJobAccessors()
+{
+  MoleQueue::JobManager jobManager;
+  for (int i = 0; i < 10000; ++i)
+    jobManager.newJob().setMoleQueueId(static_cast<MoleQueue::IdType>(i + 1));
+  const Job job = jobManager.jobAt(5000);
+
+  // Each accessor validates the reference.
+  qint64 total = 0;
+  QBENCHMARK {
+    for (int i = 0; i < 1000; ++i)
+      total += job.numberOfCores() + job.moleQueueId();
+  }
+  QVERIFY(total > 0);
+}
+
 QTEST_MAIN(JobManagerTest)
 
 #include "jobmanagertest.moc"
@@ -76,9 +76,18 @@ private slots:
   void generateJobCancellationConfirmation();
   void generateLookupJobRequest();
   void generateLookupJobResponse();
+  void generateQueueUpdateRequest();
+  void generateQueueUpdateResponse();
   void generateQueueListRequest();
   void generateQueueList();
+  void generateQueueStatusListRequest();
+  void generateQueueStatusList();
   void generateJobStateChangeNotification();
+  void generateJobOutputNotification();
+  void compactPacketFormat();
+  void packetFormatPerConnection();
+  void benchmarkPacketFormat_data();
+  void benchmarkPacketFormat();
 
   void interpretIncomingPacket_unparsable();
   void interpretIncomingPacket_invalidRequest();
@@ -86,13 +95,20 @@ private slots:
   void interpretIncomingPacket_listQueuesRequest();
   void interpretIncomingPacket_listQueuesResult();
   void interpretIncomingPacket_listQueuesError();
+  void interpretIncomingPacket_listQueuesStatusRequest();
+  void interpretIncomingPacket_listQueuesStatusResult();
   void interpretIncomingPacket_submitJobRequest();
+  void interpretIncomingPacket_submitJobRequestLargeInput();
   void interpretIncomingPacket_submitJobResult();
   void interpretIncomingPacket_submitJobError();
   void interpretIncomingPacket_cancelJobRequest();
   void interpretIncomingPacket_cancelJobResult();
   void interpretIncomingPacket_cancelJobError();
+  void interpretIncomingPacket_updateQueueRequest();
+  void interpretIncomingPacket_updateQueueResult();
+  void interpretIncomingPacket_updateQueueError();
   void interpretIncomingPacket_jobStateChange();
+  void interpretIncomingPacket_jobOutput();
 
 };
 
@@ -555,6 +571,68 @@ void JsonRpcTest::generateLookupJobResponse()
   QVERIFY(m_error == false);
 }
 
+void JsonRpcTest::generateQueueUpdateRequest()
+{
+  m_packet = m_rpc.generateQueueUpdateRequest("Some big ol' cluster", 12);
+  if (!m_rpc.validateRequest(m_packet, true)) {
+    qDebug() << "Queue update request packet failed validation!";
+    m_error = true;
+  }
+
+  m_refPacket = readReferenceString("jsonrpc-ref/updateQueue-request.json");
+  if (m_packet != m_refPacket) {
+    qDebug() << "Queue update request generation failed!" << endl
+             << "Expected:" << m_refPacket << endl
+             << "Actual:" << m_packet;
+    m_error = true;
+  }
+
+  QVERIFY(m_error == false);
+}
+
+void JsonRpcTest::generateQueueUpdateResponse()
+{
+  QVariantHash statistics;
+  statistics.insert("updates", 17);
+  statistics.insert("immediateUpdates", 2);
+  statistics.insert("failedUpdates", 1);
+  statistics.insert("updateInterval", 60);
+  statistics.insert("lastUpdate", "2012-08-01T12:30:00");
+  statistics.insert("jobs", 3);
+
+  // Test known queue
+  m_packet = m_rpc.generateQueueUpdateResponse("Some big ol' cluster",
+                                               statistics, 12);
+  if (!m_rpc.validateResponse(m_packet, true)) {
+    qDebug() << "Successful queue update response packet failed validation!";
+    m_error = true;
+  }
+  m_refPacket = readReferenceString("jsonrpc-ref/updateQueue-response.json");
+  if (m_packet != m_refPacket) {
+    qDebug() << "Successful queue update response generation failed!" << endl
+             << "Expected:" << m_refPacket << endl
+             << "Actual:" << m_packet;
+    m_error = true;
+  }
+
+  // Test unknown queue
+  m_packet = m_rpc.generateQueueUpdateResponse("Some big ol' cluster",
+                                               QVariantHash(), 12);
+  if (!m_rpc.validateResponse(m_packet, true)) {
+    qDebug() << "Unsuccessful queue update response packet failed validation!";
+    m_error = true;
+  }
+  m_refPacket = readReferenceString("jsonrpc-ref/updateQueue-error.json");
+  if (m_packet != m_refPacket) {
+    qDebug() << "Unsuccessful queue update response generation failed!" << endl
+             << "Expected:" << m_refPacket << endl
+             << "Actual:" << m_packet;
+    m_error = true;
+  }
+
+  QVERIFY(m_error == false);
+}
+
 void JsonRpcTest::generateQueueListRequest()
 {
   m_packet = m_rpc.generateQueueListRequest(23);
@@ -591,6 +669,53 @@ void JsonRpcTest::generateQueueList()
   QVERIFY(m_error == false);
 }
 
+void JsonRpcTest::generateQueueStatusListRequest()
+{
+  m_packet = m_rpc.generateQueueStatusListRequest(23);
+  if (!m_rpc.validateRequest(m_packet, true)) {
+    qDebug() << "Queue status list request packet failed validation!";
+    m_error = true;
+  }
+  m_refPacket =
+      readReferenceString("jsonrpc-ref/queue-status-list-request.json");
+  if (m_packet != m_refPacket) {
+    qDebug() << "Queue status list request failed!";
+    qDebug() << "Expected:" << m_refPacket;
+    qDebug() << "Actual:" << m_packet;
+    m_error = true;
+  }
+
+  QVERIFY(m_error == false);
+}
+
+void JsonRpcTest::generateQueueStatusList()
+{
+  QVariantHash connection;
+  connection.insert("state", "open");
+  connection.insert("consecutiveFailures", 5);
+  connection.insert("retryTime", "2012-08-01T12:40:00");
+  QVariantHash status;
+  status.insert("connection", connection);
+  QVariantHash queueStatus;
+  queueStatus.insert("Some big ol' cluster", status);
+
+  m_packet = m_rpc.generateQueueList(m_qmanager.toQueueList(), queueStatus,
+                                     23);
+  if (!m_rpc.validateResponse(m_packet, true)) {
+    qDebug() << "Queue status list response packet failed validation!";
+    m_error = true;
+  }
+  m_refPacket = readReferenceString("jsonrpc-ref/queue-status-list.json");
+  if (m_packet != m_refPacket) {
+    qDebug() << "Queue status list generation failed!";
+    qDebug() << "Expected:" << m_refPacket;
+    qDebug() << "Actual:" << m_packet;
+    m_error = true;
+  }
+
+  QVERIFY(m_error == false);
+}
+
 void JsonRpcTest::generateJobStateChangeNotification()
 {
   m_packet = m_rpc.generateJobStateChangeNotification(12, RunningRemote,
@@ -610,6 +735,136 @@ void JsonRpcTest::generateJobStateChangeNotification()
   QVERIFY(m_error == false);
 }
 
+void JsonRpcTest::generateJobOutputNotification()
+{
+  m_packet = m_rpc.generateJobOutputNotification(
+        12, QStringList() << "job.log" << "scf/iterations.out");
+  if (!m_rpc.validateNotification(m_packet, true)) {
+    qDebug() << "Job output notification packet failed validation!";
+    m_error = true;
+  }
+  m_refPacket = readReferenceString("jsonrpc-ref/job-output.json");
+  if (m_packet != m_refPacket) {
+    qDebug() << "Job output notification generation failed!";
+    qDebug() << "Expected:" << m_refPacket;
+    qDebug() << "Actual:" << m_packet;
+    m_error = true;
+  }
+
+  QVERIFY(m_error == false);
+}
+
+void JsonRpcTest::compactPacketFormat()
+{
+  QList<PacketType> styled;
+  QList<PacketType> compact;
+  for (int i = 0; i < 2; ++i) {
+    PacketFormat format = i == 0 ? StyledPacketFormat : CompactPacketFormat;
+    QList<PacketType> &packets = i == 0 ? styled : compact;
+    packets << m_rpc.generateQueueList(m_qmanager.toQueueList(), 23, format)
+            << m_rpc.generateJobStateChangeNotification(12, RunningRemote,
+                                                        Finished, format)
+            << m_rpc.generateJobSubmissionConfirmation(1439932,
+                                                       "/tmp/some/path/",
+                                                       12, format)
+            << m_rpc.generateErrorResponse(-32600, "Invalid request",
+                                           Json::Value("\"q\"\t\\\x01\n"),
+                                           Json::Value(14), format);
+  }
+
+  for (int i = 0; i < styled.size(); ++i) {
+    QVERIFY(!compact[i].contains('\n'));
+    QVERIFY(compact[i].size() < styled[i].size());
+
+    Json::Value styledRoot;
+    Json::Value compactRoot;
+    QVERIFY(m_reader.parse(styled[i].constData(),
+                           styled[i].constData() + styled[i].size(),
+                           styledRoot, false));
+    QVERIFY(m_reader.parse(compact[i].constData(),
+                           compact[i].constData() + compact[i].size(),
+                           compactRoot, false));
+    QVERIFY(styledRoot == compactRoot);
+  }
+
+  QCOMPARE(compact[1], PacketType("{\"jsonrpc\":\"2.0\",\"method\":"
+                                  "\"jobStateChanged\",\"params\":{"
+                                  "\"moleQueueId\":12,\"newState\":"
+                                  "\"Finished\",\"oldState\":"
+                                  "\"RunningRemote\"}}"));
+}
+
+void JsonRpcTest::packetFormatPerConnection()
+{
+  JsonRpc rpc;
+  TestConnection *other = new TestConnection(this);
+  QCOMPARE(rpc.defaultPacketFormat(), StyledPacketFormat);
+  QCOMPARE(rpc.packetFormat(m_connection), StyledPacketFormat);
+
+  rpc.setPacketFormat(m_connection, CompactPacketFormat);
+  QCOMPARE(rpc.packetFormat(m_connection), CompactPacketFormat);
+  QCOMPARE(rpc.packetFormat(other), StyledPacketFormat);
+
+  PacketType packet = rpc.generateQueueListRequest(
+        3, rpc.packetFormat(m_connection));
+  QVERIFY(!packet.contains('\n'));
+  QVERIFY(rpc.validateRequest(packet, true));
+
+  rpc.setDefaultPacketFormat(CompactPacketFormat);
+  QCOMPARE(rpc.packetFormat(other), CompactPacketFormat);
+  QVERIFY(!rpc.generateQueueListRequest(4).contains('\n'));
+
+  rpc.setDefaultPacketFormat(StyledPacketFormat);
+  rpc.setPacketFormat(m_connection, DefaultPacketFormat);
+  QCOMPARE(rpc.packetFormat(m_connection), StyledPacketFormat);
+
+  rpc.setPacketFormat(other, CompactPacketFormat);
+  delete other;
+  QCOMPARE(rpc.packetFormat(m_connection), StyledPacketFormat);
+}
+
+void JsonRpcTest::benchmarkPacketFormat_data()
+{
+  QTest::addColumn<int>("format");
+  QTest::addColumn<bool>("queueList");
+
+  const int styled = static_cast<int>(StyledPacketFormat);
+  const int compact = static_cast<int>(CompactPacketFormat);
+  QTest::newRow("styled jobStateChanged") << styled << false;
+  QTest::newRow("compact jobStateChanged") << compact << false;
+  QTest::newRow("styled queueList") << styled << true;
+  QTest::newRow("compact queueList") << compact << true;
+}
+
+void JsonRpcTest::benchmarkPacketFormat()
+{
+  QFETCH(int, format);
+  QFETCH(bool, queueList);
+
+  QueueListType list;
+  for (int i = 0; i < 20; ++i) {
+    QStringList programs;
+    for (int j = 0; j < 10; ++j)
+      programs << QString("Program %1").arg(j);
+    list.insert(QString("Queue %1").arg(i), programs);
+  }
+
+  PacketType packet;
+  IdType id = 0;
+  QBENCHMARK {
+    if (queueList) {
+      packet = m_rpc.generateQueueList(list, ++id,
+                                       static_cast<PacketFormat>(format));
+    }
+    else {
+      packet = m_rpc.generateJobStateChangeNotification(
+            ++id, RunningRemote, Finished, static_cast<PacketFormat>(format));
+    }
+  }
+
+  qDebug() << "Packet size:" << packet.size() << "bytes";
+}
+
 void JsonRpcTest::interpretIncomingPacket_unparsable()
 {
   QSignalSpy spy (&m_rpc, SIGNAL(
@@ -682,6 +937,56 @@ void JsonRpcTest::interpretIncomingPacket_listQueuesError()
   // Nothing to do, can't happen.
 }
 
+void JsonRpcTest::interpretIncomingPacket_listQueuesStatusRequest()
+{
+  QSignalSpy listSpy (&m_rpc, SIGNAL(
+                        queueListRequestReceived(MoleQueue::Connection*,
+                                                 MoleQueue::EndpointId,
+                                                 MoleQueue::IdType)));
+  QSignalSpy spy (&m_rpc, SIGNAL(
+                    queueStatusListRequestReceived(MoleQueue::Connection*,
+                                                   MoleQueue::EndpointId,
+                                                   MoleQueue::IdType)));
+  m_packet = readReferenceString("jsonrpc-ref/queue-status-list-request.json");
+  m_rpc.interpretIncomingPacket(m_connection, m_packet);
+
+  QCOMPARE(spy.count(), 1);
+  QCOMPARE(listSpy.count(), 0);
+}
+
+void JsonRpcTest::interpretIncomingPacket_listQueuesStatusResult()
+{
+  QSignalSpy listSpy (&m_rpc, SIGNAL(
+                        queueListReceived(MoleQueue::IdType,
+                                          MoleQueue::QueueListType)));
+  QSignalSpy spy (&m_rpc, SIGNAL(
+                    queueStatusReceived(MoleQueue::IdType, QVariantHash)));
+  // Register the packet id with this method for JsonRpc:
+  m_rpc.generateQueueStatusListRequest(23);
+  m_packet = readReferenceString("jsonrpc-ref/queue-status-list.json");
+  m_rpc.interpretIncomingPacket(m_connection, m_packet);
+
+  QCOMPARE(listSpy.count(), 1);
+  const QueueListType list =
+      listSpy.first().at(1).value<MoleQueue::QueueListType>();
+  QCOMPARE(list, m_qmanager.toQueueList());
+
+  QCOMPARE(spy.count(), 1);
+  const QVariantHash status = spy.first().at(1).toHash();
+  QCOMPARE(status.size(), 1);
+  const QVariantHash connection = status.value("Some big ol' cluster")
+      .toHash().value("connection").toHash();
+  QCOMPARE(connection.value("state").toString(), QString("open"));
+  QCOMPARE(connection.value("consecutiveFailures").toInt(), 5);
+
+  // Plain queue lists carry no status.
+  m_rpc.generateQueueListRequest(23);
+  m_packet = readReferenceString("jsonrpc-ref/queue-list.json");
+  m_rpc.interpretIncomingPacket(m_connection, m_packet);
+  QCOMPARE(listSpy.count(), 2);
+  QCOMPARE(spy.count(), 1);
+}
+
 void JsonRpcTest::interpretIncomingPacket_submitJobRequest()
 {
   QSignalSpy spy (&m_rpc, SIGNAL(
@@ -695,6 +1000,48 @@ void JsonRpcTest::interpretIncomingPacket_submitJobRequest()
   QCOMPARE(spy.count(), 1);
 }
 
+void JsonRpcTest::interpretIncomingPacket_submitJobRequestLargeInput()
+{
+  // 4 MB of input file contents
+  const QString contents = QString("0123456789abcdef").repeated(256 * 1024);
+
+  JobManager jobManager;
+  Job req = jobManager.newJob();
+  req.setQueue("Some big ol' cluster");
+  req.setProgram("Quantum Tater");
+  req.setInputFile(FileSpecification(QString("big.inp"), contents));
+  req.setAdditionalInputFiles(QList<FileSpecification>()
+                              << FileSpecification(QString("small.inp"),
+                                                   QString("small"))
+                              << FileSpecification(QString("/tmp/file.ext")));
+
+  QSignalSpy spy (&m_rpc, SIGNAL(
+                  jobSubmissionRequestReceived(MoleQueue::Connection*,
+                                               MoleQueue::EndpointId,
+                                               MoleQueue::IdType,
+                                               QVariantHash)));
+  m_packet = m_rpc.generateJobRequest(req, 15, CompactPacketFormat);
+  m_rpc.interpretIncomingPacket(m_connection, m_packet);
+
+  QCOMPARE(spy.count(), 1);
+  QVariantHash options = spy.first().at(3).toHash();
+
+  // The files are passed as FileSpecifications rather than QVariantHashes.
+  QVariant inputFile = options.value("inputFile");
+  QCOMPARE(inputFile.userType(), qMetaTypeId<FileSpecification>());
+  QCOMPARE(options.value("additionalInputFiles").toList().size(), 2);
+
+  Job job = jobManager.newJob(options);
+  QCOMPARE(job.queue(), QString("Some big ol' cluster"));
+  QCOMPARE(job.program(), QString("Quantum Tater"));
+  QCOMPARE(job.inputFile().filename(), QString("big.inp"));
+  QVERIFY(job.inputFile().contents() == contents);
+  QCOMPARE(job.additionalInputFiles().size(), 2);
+  QCOMPARE(job.additionalInputFiles().at(0).contents(), QString("small"));
+  QCOMPARE(job.additionalInputFiles().at(1).filepath(),
+           QString("/tmp/file.ext"));
+}
+
 void JsonRpcTest::interpretIncomingPacket_submitJobResult()
 {
   QSignalSpy spy (&m_rpc, SIGNAL(
@@ -757,6 +1104,51 @@ void JsonRpcTest::interpretIncomingPacket_cancelJobError()
   // Not implemented
 }
 
+void JsonRpcTest::interpretIncomingPacket_updateQueueRequest()
+{
+  QSignalSpy spy (&m_rpc, SIGNAL(
+                    queueUpdateRequestReceived(MoleQueue::Connection*,
+                                               MoleQueue::EndpointId,
+                                               MoleQueue::IdType,
+                                               QString)));
+  m_packet = readReferenceString("jsonrpc-ref/updateQueue-request.json");
+  m_rpc.interpretIncomingPacket(m_connection, m_packet);
+
+  QCOMPARE(spy.count(), 1);
+  QCOMPARE(spy.first().at(3).toString(), QString("Some big ol' cluster"));
+}
+
+void JsonRpcTest::interpretIncomingPacket_updateQueueResult()
+{
+  QSignalSpy spy (&m_rpc, SIGNAL(
+                    queueUpdateResponseReceived(MoleQueue::IdType,
+                                                QVariantHash)));
+  // Register the packet id with this method for JsonRpc:
+  m_rpc.generateQueueUpdateRequest("Some big ol' cluster", 12);
+  m_packet = readReferenceString("jsonrpc-ref/updateQueue-response.json");
+  m_rpc.interpretIncomingPacket(m_connection, m_packet);
+
+  QCOMPARE(spy.count(), 1);
+  const QVariantHash statistics = spy.first().at(1).toHash();
+  QCOMPARE(statistics.value("queue").toString(),
+           QString("Some big ol' cluster"));
+  QCOMPARE(statistics.value("updates").toInt(), 17);
+  QCOMPARE(statistics.value("updateInterval").toInt(), 60);
+}
+
+void JsonRpcTest::interpretIncomingPacket_updateQueueError()
+{
+  QSignalSpy spy (&m_rpc, SIGNAL(
+                    queueUpdateErrorReceived(MoleQueue::IdType, QString)));
+  // Register the packet id with this method for JsonRpc:
+  m_rpc.generateQueueUpdateRequest("Some big ol' cluster", 12);
+  m_packet = readReferenceString("jsonrpc-ref/updateQueue-error.json");
+  m_rpc.interpretIncomingPacket(m_connection, m_packet);
+
+  QCOMPARE(spy.count(), 1);
+  QCOMPARE(spy.first().at(1).toString(), QString("Some big ol' cluster"));
+}
+
 void JsonRpcTest::interpretIncomingPacket_jobStateChange()
 {
   QSignalSpy spy (&m_rpc, SIGNAL(
@@ -769,6 +1161,20 @@ void JsonRpcTest::interpretIncomingPacket_jobStateChange()
   QCOMPARE(spy.count(), 1);
 }
 
+void JsonRpcTest::interpretIncomingPacket_jobOutput()
+{
+  QSignalSpy spy (&m_rpc, SIGNAL(jobOutputReceived(MoleQueue::IdType,
+                                                   QStringList)));
+  m_packet = readReferenceString("jsonrpc-ref/job-output.json");
+  m_rpc.interpretIncomingPacket(m_connection, m_packet);
+
+  QCOMPARE(spy.count(), 1);
+  QCOMPARE(spy.first().at(0).value<MoleQueue::IdType>(),
+           static_cast<MoleQueue::IdType>(12));
+  QCOMPARE(spy.first().at(1).toStringList(),
+           QStringList() << "job.log" << "scf/iterations.out");
+}
+
 QTEST_MAIN(JsonRpcTest)
 
 #include "jsonrpctest.moc"
@@ -18,7 +18,15 @@
 
 #include "client.h"
 #include "connectiontest.h"
+#include "testserver.h"
 #include "transport/localsocket/localsocketclient.h"
+#include "transport/localsocket/localsocketconnection.h"
+#include "transport/message.h"
+
+#include <QtCore/QElapsedTimer>
+#include <QtCore/QtEndian>
+#include <QtNetwork/QLocalServer>
+#include <QtNetwork/QLocalSocket>
 
 class LocalSocketConnectionTest: public ConnectionTest
 {
@@ -26,6 +34,15 @@ class LocalSocketConnectionTest: public ConnectionTest
 protected:
   MoleQueue::Client *createClient();
 
+private:
+  int m_messageCount;
+
+private slots:
+  void messageReceived(const MoleQueue::Message msg);
+
+  void testThroughput_data();
+  void testThroughput();
+  void testOversizedPacket();
 };
 
 MoleQueue::Client *LocalSocketConnectionTest::createClient()
@@ -33,6 +50,77 @@ MoleQueue::Client *LocalSocketConnectionTest::createClient()
   return new MoleQueue::LocalSocketClient(this);
 }
 
+void LocalSocketConnectionTest::messageReceived(const MoleQueue::Message msg)
+{
+  Q_UNUSED(msg);
+  ++m_messageCount;
+}
+
+void LocalSocketConnectionTest::testThroughput_data()
+{
+  addThroughputRows();
+}
+
+void LocalSocketConnectionTest::testThroughput()
+{
+  QFETCH(int, messageCount);
+  QFETCH(int, messageSize);
+
+  QLocalServer localServer;
+  QVERIFY(localServer.listen(TestServer::getRandomSocketName()));
+
+  MoleQueue::LocalSocketConnection sender(NULL, localServer.serverName());
+  sender.open();
+  QVERIFY(localServer.waitForNewConnection(5000));
+  QLocalSocket *receiverSocket = localServer.nextPendingConnection();
+  MoleQueue::LocalSocketConnection receiver(NULL, receiverSocket);
+  receiver.start();
+  sender.start();
+
+  measureThroughput(&sender, &receiver, messageCount, messageSize);
+}
+
+void LocalSocketConnectionTest::testOversizedPacket()
+{
+  QLocalServer localServer;
+  QVERIFY(localServer.listen(TestServer::getRandomSocketName()));
+
+  QLocalSocket sender;
+  sender.connectToServer(localServer.serverName());
+  QVERIFY(sender.waitForConnected(5000));
+  QVERIFY(localServer.waitForNewConnection(5000));
+  QLocalSocket *receiverSocket = localServer.nextPendingConnection();
+  MoleQueue::LocalSocketConnection receiver(NULL, receiverSocket);
+  connect(&receiver, SIGNAL(newMessage(const MoleQueue::Message)),
+          this, SLOT(messageReceived(const MoleQueue::Message)));
+  receiver.start();
+
+  m_messageCount = 0;
+
+  // Packets over the limit are not sent.
+  const int oversized =
+      static_cast<int>(MoleQueue::LocalSocketConnection::maxPacketSize) + 1;
+  receiver.send(MoleQueue::Message(MoleQueue::PacketType(oversized, 'x')));
+  QCOMPARE(receiverSocket->bytesToWrite(), Q_INT64_C(0));
+
+  // A header announcing a 2 GB packet closes the connection without
+  // allocating or reading the packet.
+  uchar header[3 * sizeof(quint32)];
+  qToBigEndian<quint32>(1, header);
+  qToBigEndian<quint32>(0x7fffffff, header + sizeof(quint32));
+  qToBigEndian<quint32>(0x7fffffff, header + 2 * sizeof(quint32));
+  sender.write(reinterpret_cast<const char*>(header), sizeof(header));
+  sender.write(MoleQueue::PacketType(1024, 'x'));
+  QVERIFY(sender.waitForBytesWritten(5000));
+
+  QElapsedTimer timer;
+  timer.start();
+  while (receiver.isOpen() && timer.elapsed() < 5000)
+    qApp->processEvents(QEventLoop::AllEvents, 100);
+  QVERIFY(!receiver.isOpen());
+  QCOMPARE(m_messageCount, 0);
+}
+
 QTEST_MAIN(LocalSocketConnectionTest)
 
 #include "localsocketconnectiontest.moc"
@@ -18,6 +18,8 @@
 
 #include "queues/pbs.h"
 
+#include <QtCore/QFile>
+
 class QueuePbsTest : public QObject
 {
   Q_OBJECT
@@ -38,6 +40,7 @@ private slots:
   void sanityCheck();
   void testParseJobId();
   void testParseQueueLine();
+  void testParseStructuredQueueOutput();
 };
 
 void QueuePbsTest::initTestCase()
@@ -143,6 +146,62 @@ void QueuePbsTest::testParseQueueLine()
   QCOMPARE(state, MoleQueue::RemoteQueued);
 }
 
+void QueuePbsTest::testParseStructuredQueueOutput()
+{
+  QVERIFY(m_queue.supportsStructuredQueueStatus());
+  m_queue.setUseStructuredQueueStatus(true);
+  QCOMPARE(m_queue.queueRequestProgram(), QString("qstat -x"));
+  m_queue.setUseStructuredQueueStatus(false);
+  QCOMPARE(m_queue.queueRequestProgram(), QString("qstat"));
+
+  QFile file(TESTDATADIR "qstat-ref/pbs-qstat-x.xml");
+  QVERIFY(file.open(QFile::ReadOnly | QFile::Text));
+  const QString output = QString::fromLatin1(file.readAll());
+
+  QHash<MoleQueue::IdType, MoleQueue::QueueJobStatus> statuses;
+  QVERIFY(m_queue.parseStructuredQueueOutput(output, &statuses));
+  // 4811 is in the unknown state "I".
+  QCOMPARE(statuses.size(), 4);
+  QVERIFY(!statuses.contains(4811));
+
+  MoleQueue::QueueJobStatus status = statuses.value(4807);
+  QCOMPARE(status.state, MoleQueue::RunningRemote);
+  QVERIFY(!status.hasExitStatus);
+  // Resources used, not the requested walltime
+  QCOMPARE(status.wallTimeUsed, 12 * 3600 + 56 * 60 + 34);
+  QCOMPARE(status.nodes, QStringList() << "node01" << "node02");
+
+  status = statuses.value(4808);
+  QCOMPARE(status.state, MoleQueue::RemoteQueued);
+  QCOMPARE(status.wallTimeUsed, -1);
+  QVERIFY(status.nodes.isEmpty());
+
+  status = statuses.value(4809);
+  QCOMPARE(status.state, MoleQueue::RunningRemote);
+  QVERIFY(status.hasExitStatus);
+  QCOMPARE(status.exitStatus, 271);
+  QCOMPARE(status.wallTimeUsed, 125);
+  QCOMPARE(status.nodes, QStringList() << "node03");
+
+  QCOMPARE(statuses.value(4810).state, MoleQueue::RemoteQueued);
+
+  // Text around the document is ignored.
+  statuses.clear();
+  QVERIFY(m_queue.parseStructuredQueueOutput(
+            "qstat: Unknown Job Id 4806.headnode\n" + output +
+            "\nqstat: Unknown Job Id 4812.headnode\n", &statuses));
+  QCOMPARE(statuses.size(), 4);
+
+  // No jobs listed
+  statuses.clear();
+  QVERIFY(m_queue.parseStructuredQueueOutput("", &statuses));
+  QVERIFY(statuses.isEmpty());
+
+  // Truncated output is an error.
+  QVERIFY(!m_queue.parseStructuredQueueOutput(output.left(output.size() / 2),
+                                              &statuses));
+}
+
 QTEST_MAIN(QueuePbsTest)
 
 #include "pbstest.moc"
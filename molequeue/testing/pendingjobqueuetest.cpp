@@ -0,0 +1,261 @@
+/******************************************************************************
+
+  This source file is part of the MoleQueue project.
+
+  Copyright 2012 Kitware, Inc.
+
+  This source code is released under the New BSD License, (the "License").
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+******************************************************************************/
+
+#include <QtTest>
+
+#include "pendingjobqueue.h"
+
+#include <QtCore/QSet>
+
+using MoleQueue::IdType;
+using MoleQueue::PendingJobQueue;
+
+class PendingJobQueueTest : public QObject
+{
+  Q_OBJECT
+
+private:
+  /// @return True if @a queue satisfies the heap and index invariants.
+  bool isConsistent(const PendingJobQueue &queue);
+
+private slots:
+  void testFifo();
+  void testPriority();
+  void testRemove();
+  void testFairShare();
+  void testFairShareRemove();
+  void testFairShareTake();
+  void testRandomOperations();
+  void benchmarkEnqueueRemove();
+};
+
+bool PendingJobQueueTest::isConsistent(const PendingJobQueue &queue)
+{
+  if (queue.m_positions.size() != queue.m_heap.size())
+    return false;
+  for (int i = 0; i < queue.m_heap.size(); ++i) {
+    if (queue.m_positions.value(queue.m_heap.at(i).moleQueueId, -1) != i)
+      return false;
+    if (i > 0 && PendingJobQueue::lessThan(queue.m_heap.at(i),
+                                           queue.m_heap.at((i - 1) / 2))) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void PendingJobQueueTest::testFifo()
+{
+  PendingJobQueue queue;
+  QVERIFY(queue.isEmpty());
+  QCOMPARE(queue.first(), MoleQueue::InvalidId);
+  QCOMPARE(queue.takeFirst(), MoleQueue::InvalidId);
+
+  for (IdType id = 1; id <= 5; ++id)
+    queue.enqueue(id);
+  // Duplicates are ignored
+  queue.enqueue(3, 10);
+  QCOMPARE(queue.size(), 5);
+  QCOMPARE(queue.ids(), QList<IdType>() << 1 << 2 << 3 << 4 << 5);
+
+  for (IdType id = 1; id <= 5; ++id)
+    QCOMPARE(queue.takeFirst(), id);
+  QVERIFY(queue.isEmpty());
+}
+
+void PendingJobQueueTest::testPriority()
+{
+  PendingJobQueue queue;
+  queue.enqueue(1, 0);
+  queue.enqueue(2, 0);
+  queue.enqueue(3, 5);
+  queue.enqueue(4, -1);
+  queue.enqueue(5, 5);
+
+  QCOMPARE(queue.priority(3), 5);
+  QCOMPARE(queue.priority(4), -1);
+  QCOMPARE(queue.priority(42), 0);
+  QCOMPARE(queue.ids(), QList<IdType>() << 3 << 5 << 1 << 2 << 4);
+  QCOMPARE(queue.first(), static_cast<IdType>(3));
+
+  QList<IdType> order;
+  while (!queue.isEmpty())
+    order.append(queue.takeFirst());
+  QCOMPARE(order, QList<IdType>() << 3 << 5 << 1 << 2 << 4);
+}
+
+void PendingJobQueueTest::testRemove()
+{
+  PendingJobQueue queue;
+  for (IdType id = 1; id <= 10; ++id)
+    queue.enqueue(id, static_cast<int>(id % 3));
+
+  QVERIFY(queue.remove(5));
+  QVERIFY(!queue.remove(5));
+  QVERIFY(!queue.contains(5));
+  QVERIFY(queue.remove(queue.first()));
+  QVERIFY(isConsistent(queue));
+  QCOMPARE(queue.size(), 8);
+
+  // Priority 2: 8 (2 and 5 removed); 1: 1, 4, 7, 10; 0: 3, 6, 9
+  QCOMPARE(queue.ids(), QList<IdType>() << 8 << 1 << 4 << 7 << 10
+           << 3 << 6 << 9);
+
+  queue.clear();
+  QVERIFY(queue.isEmpty());
+  QVERIFY(!queue.contains(1));
+}
+
+void PendingJobQueueTest::testFairShare()
+{
+  PendingJobQueue queue;
+  queue.setFairShare(true);
+
+  // A batch of jobs from one client, then a few from another.
+  for (IdType id = 1; id <= 6; ++id)
+    queue.enqueue(id, 0, "batch");
+  queue.enqueue(101, 0, "interactive");
+  queue.enqueue(102, 0, "interactive");
+
+  QCOMPARE(queue.ids(), QList<IdType>() << 1 << 101 << 2 << 102 << 3 << 4
+           << 5 << 6);
+
+  // A client that was idle is not credited for the time it did not use: it
+  // joins the current round rather than going ahead of all waiting jobs.
+  QCOMPARE(queue.takeFirst(), static_cast<IdType>(1));
+  QCOMPARE(queue.takeFirst(), static_cast<IdType>(101));
+  QCOMPARE(queue.takeFirst(), static_cast<IdType>(2));
+  QCOMPARE(queue.takeFirst(), static_cast<IdType>(102));
+  queue.enqueue(201, 0, "late");
+  queue.enqueue(202, 0, "late");
+  QCOMPARE(queue.ids(), QList<IdType>() << 201 << 3 << 202 << 4 << 5 << 6);
+
+  // Priority still comes first.
+  queue.enqueue(301, 1, "batch");
+  QCOMPARE(queue.first(), static_cast<IdType>(301));
+}
+
+void PendingJobQueueTest::testFairShareRemove()
+{
+  PendingJobQueue queue;
+  queue.setFairShare(true);
+
+  // Cancelled jobs no longer count against their owner's share.
+  for (IdType id = 1; id <= 4; ++id)
+    queue.enqueue(id, 0, "batch");
+  QVERIFY(queue.remove(3));
+  QVERIFY(queue.remove(4));
+  for (IdType id = 101; id <= 103; ++id)
+    queue.enqueue(id, 0, "interactive");
+  queue.enqueue(5, 0, "batch");
+  QCOMPARE(queue.ids(), QList<IdType>() << 1 << 101 << 2 << 102 << 103 << 5);
+  QVERIFY(isConsistent(queue));
+
+  // Owners without queued jobs are forgotten.
+  QCOMPARE(queue.m_owners.size(), 2);
+  queue.remove(101);
+  queue.remove(102);
+  queue.remove(103);
+  QCOMPARE(queue.m_owners.size(), 1);
+  while (!queue.isEmpty())
+    queue.takeFirst();
+  QVERIFY(queue.m_owners.isEmpty());
+
+  // Jobs enqueued without fair share are not counted.
+  queue.setFairShare(false);
+  queue.enqueue(201, 0, "batch");
+  queue.setFairShare(true);
+  queue.enqueue(202, 0, "batch");
+  queue.takeFirst();
+  QCOMPARE(queue.m_owners.value("batch").queued, 1);
+  queue.takeFirst();
+  QVERIFY(queue.m_owners.isEmpty());
+}
+
+void PendingJobQueueTest::testFairShareTake()
+{
+  PendingJobQueue queue;
+  queue.setFairShare(true);
+  QVERIFY(!queue.take(1));
+
+  // Jobs started out of order, e.g. by backfilling, are charged to their
+  // owner like dequeued ones.
+  for (IdType id = 1; id <= 4; ++id)
+    queue.enqueue(id, 0, "batch");
+  queue.enqueue(101, 0, "interactive");
+  QVERIFY(queue.take(3));
+  QVERIFY(queue.take(4));
+  QVERIFY(!queue.contains(4));
+  QCOMPARE(queue.m_virtualTime, Q_UINT64_C(3));
+  QCOMPARE(queue.m_owners.value("batch").finish, Q_UINT64_C(4));
+  QCOMPARE(queue.m_owners.value("batch").queued, 2);
+
+  queue.enqueue(5, 0, "batch");
+  queue.enqueue(102, 0, "interactive");
+  QCOMPARE(queue.ids(), QList<IdType>() << 1 << 101 << 2 << 102 << 5);
+  QVERIFY(isConsistent(queue));
+}
+
+void PendingJobQueueTest::testRandomOperations()
+{
+  qsrand(42);
+  PendingJobQueue queue;
+  queue.setFairShare(true);
+  QSet<IdType> expected;
+  IdType nextId = 1;
+
+  for (int i = 0; i < 5000; ++i) {
+    const int op = qrand() % 4;
+    if (op < 2 || expected.isEmpty()) {
+      queue.enqueue(nextId, qrand() % 5 - 2,
+                    QString::number(qrand() % 3));
+      expected.insert(nextId++);
+    }
+    else if (op == 2) {
+      const IdType head = queue.first();
+      const QList<IdType> ordered = queue.ids();
+      QCOMPARE(ordered.first(), head);
+      QCOMPARE(queue.takeFirst(), head);
+      expected.remove(head);
+    }
+    else {
+      const IdType victim = static_cast<IdType>(qrand()) % nextId;
+      QCOMPARE(queue.remove(victim), expected.remove(victim));
+    }
+    QCOMPARE(queue.size(), expected.size());
+  }
+  QVERIFY(isConsistent(queue));
+  QCOMPARE(queue.ids().toSet(), expected);
+}
+
+void PendingJobQueueTest::benchmarkEnqueueRemove()
+{
+  const int count = 20000;
+  QBENCHMARK {
+    PendingJobQueue queue;
+    for (int i = 0; i < count; ++i)
+      queue.enqueue(static_cast<IdType>(i + 1), i % 7);
+    // Cancel every other job, then drain the rest.
+    for (int i = 0; i < count; i += 2)
+      queue.remove(static_cast<IdType>(i + 1));
+    while (!queue.isEmpty())
+      queue.takeFirst();
+  }
+}
+
+QTEST_MAIN(PendingJobQueueTest)
+
+#include "pendingjobqueuetest.moc"
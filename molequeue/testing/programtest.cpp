@@ -35,6 +35,7 @@ private slots:
   void cleanup();
 
   void runTest();
+  void testOutputPatterns();
 };
 
 void ProgramTest::initTestCase()
@@ -58,6 +59,33 @@ void ProgramTest::runTest()
   qDebug() << "No tests implemented yet!";
 }
 
+void ProgramTest::testOutputPatterns()
+{
+  MoleQueue::Program program;
+  QVERIFY(!program.hasOutputFilter());
+  QVERIFY(program.isOutputFileIncluded("scratch/fort.7"));
+
+  program.setOutputExcludePatterns(QStringList() << "*.tmp" << "scratch/*");
+  QVERIFY(program.hasOutputFilter());
+  QVERIFY(program.isOutputFileIncluded("job.out"));
+  QVERIFY(!program.isOutputFileIncluded("job.tmp"));
+  // Patterns without a slash match the file name in any directory.
+  QVERIFY(!program.isOutputFileIncluded("sub/job.tmp"));
+  QVERIFY(!program.isOutputFileIncluded("scratch/fort.7"));
+  QVERIFY(program.isOutputFileIncluded("sub/scratch/fort.7"));
+
+  program.setOutputIncludePatterns(QStringList() << "*.out" << "*.log");
+  QVERIFY(program.isOutputFileIncluded("sub/job.out"));
+  QVERIFY(!program.isOutputFileIncluded("job.chk"));
+  QVERIFY(!program.isOutputFileIncluded("scratch/job.log"));
+
+  program.setSkipUnchangedOutput(true);
+  MoleQueue::Program copy(program);
+  QCOMPARE(copy.outputIncludePatterns(), program.outputIncludePatterns());
+  QCOMPARE(copy.outputExcludePatterns(), program.outputExcludePatterns());
+  QVERIFY(copy.skipUnchangedOutput());
+}
+
 QTEST_MAIN(ProgramTest)
 
 #include "programtest.moc"
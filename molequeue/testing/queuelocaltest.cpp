@@ -0,0 +1,511 @@
+/******************************************************************************
+
+  This source file is part of the MoleQueue project.
+
+  Copyright 2012 Kitware, Inc.
+
+  This source code is released under the New BSD License, (the "License").
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+******************************************************************************/
+
+#include <QtTest>
+
+#include "dummyserver.h"
+#include "job.h"
+#include "jobmanager.h"
+#include "program.h"
+#include "queues/local.h"
+
+#include <QtCore/QElapsedTimer>
+
+using namespace MoleQueue;
+
+class QueueLocalTest : public QObject
+{
+  Q_OBJECT
+private:
+  DummyServer *m_server;
+  QueueLocal *m_queue;
+
+  /// Create and submit a job running "sleep @a seconds" on @a cores cores.
+  Job submitSleepJob(const QString &seconds, int cores = 1);
+
+  /// Process events until @a job reaches @a state or @a timeout ms elapse.
+  bool waitForJobState(const Job &job, JobState state, int timeout);
+
+private slots:
+  /// Called before the first test function is executed.
+  void initTestCase();
+  /// Called after the last test function is executed.
+  void cleanupTestCase();
+  /// Called before each test function is executed.
+  void init();
+  /// Called after every test function.
+  void cleanup();
+
+  void testDispatchOnSubmit();
+  void testDispatchOnFinish();
+  void testKillRunningJob();
+  void testSelectJobsToStart();
+  void testSelectJobsWithMemory();
+  void testParseMemInfo();
+  void testParseCpuList();
+  void testAllocateCpus();
+  void testBackfillSimulation();
+};
+
+namespace {
+// A job in the scheduling simulation. Times are in minutes.
+struct SimulatedJob
+{
+  int cores;
+  int runtime;
+  int wallTime;
+};
+
+// A simulated job that has been started, and the time at which it ends.
+struct RunningJob
+{
+  QueueLocal::RunningJobInfo info;
+  qint64 end;
+};
+
+/**
+ * Run @a jobs, submitted at once in order, on @a totalCores cores using
+ * QueueLocal::selectJobsToStart() with @a policy.
+ * @param startTimes Set to the start time of each job.
+ * @return The core utilisation between the first start and the last finish,
+ * or -1 if the jobs could not all be run.
+ */
+double simulate(const QList<SimulatedJob> &jobs, int totalCores,
+                QueueLocal::SchedulingPolicy policy, QList<qint64> &startTimes)
+{
+  QList<int> pendingJobs;
+  for (int i = 0; i < jobs.size(); ++i)
+    pendingJobs.append(i);
+  startTimes = QVector<qint64>(jobs.size(), -1).toList();
+
+  QList<RunningJob> running;
+  qint64 now = 0;
+  qint64 busyCoreTime = 0;
+  forever {
+    QList<QueueLocal::PendingJobInfo> pending;
+    foreach (int index, pendingJobs) {
+      QueueLocal::PendingJobInfo info;
+      info.cores = jobs.at(index).cores;
+      info.wallTime = jobs.at(index).wallTime;
+      pending.append(info);
+    }
+    QList<QueueLocal::RunningJobInfo> runningInfo;
+    foreach (const RunningJob &job, running)
+      runningInfo.append(job.info);
+
+    QList<int> toStart = QueueLocal::selectJobsToStart(pending, runningInfo,
+                                                       totalCores, now,
+                                                       policy);
+    for (int i = toStart.size() - 1; i >= 0; --i) {
+      const int index = pendingJobs.takeAt(toStart.at(i));
+      const SimulatedJob &job = jobs.at(index);
+      RunningJob run;
+      run.info.cores = job.cores;
+      run.info.expectedEnd = job.wallTime > 0 ? now + job.wallTime : -1;
+      run.end = now + job.runtime;
+      running.append(run);
+      startTimes[index] = now;
+      busyCoreTime += job.cores * job.runtime;
+    }
+
+    if (running.isEmpty())
+      break;
+
+    // Advance to the next job completion.
+    qint64 next = running.first().end;
+    foreach (const RunningJob &job, running)
+      next = qMin(next, job.end);
+    now = next;
+    for (int i = running.size() - 1; i >= 0; --i) {
+      if (running.at(i).end <= now)
+        running.removeAt(i);
+    }
+  }
+
+  if (!pendingJobs.isEmpty() || now == 0)
+    return -1.0;
+  return static_cast<double>(busyCoreTime) / (totalCores * now);
+}
+}
+
+Job QueueLocalTest::submitSleepJob(const QString &seconds, int cores)
+{
+  Job job = m_server->jobManager()->newJob();
+  job.setQueue(m_queue->name());
+  job.setProgram("sleep");
+  job.setNumberOfCores(cores);
+  job.setKeywordReplacement("$$seconds$$", seconds);
+  m_queue->submitJob(job);
+  return job;
+}
+
+bool QueueLocalTest::waitForJobState(const Job &job, JobState state,
+                                     int timeout)
+{
+  QElapsedTimer timer;
+  timer.start();
+  while (job.jobState() != state && timer.elapsed() < timeout)
+    qApp->processEvents(QEventLoop::AllEvents, 10);
+  return job.jobState() == state;
+}
+
+void QueueLocalTest::initTestCase()
+{
+}
+
+void QueueLocalTest::cleanupTestCase()
+{
+}
+
+void QueueLocalTest::init()
+{
+  m_server = new DummyServer;
+  m_queue = qobject_cast<QueueLocal*>(
+        m_server->queueManager()->addQueue("Local", "Local", true));
+  QVERIFY(m_queue != NULL);
+
+  Program *program = new Program(m_queue);
+  program->setName("sleep");
+  program->setExecutable("sleep");
+  program->setUseExecutablePath(false);
+  program->setArguments("$$seconds$$");
+  program->setLaunchSyntax(Program::PLAIN);
+  m_queue->addProgram(program);
+}
+
+void QueueLocalTest::cleanup()
+{
+  m_queue->recursiveRemoveDirectory(m_server->workingDirectoryBase());
+  delete m_server;
+  m_server = NULL;
+  m_queue = NULL;
+}
+
+void QueueLocalTest::testDispatchOnSubmit()
+{
+  m_queue->setMaxNumberOfCores(2);
+  QCOMPARE(m_queue->lastQueueLatency(), Q_INT64_C(-1));
+
+  Job job = submitSleepJob("0");
+  QCOMPARE(job.jobState(), LocalQueued);
+
+  // Jobs are started by a check scheduled on submission, once the event loop
+  // runs, rather than by a periodic timer.
+  QVERIFY(m_queue->m_checkJobLimitTimerId != -1);
+  QElapsedTimer timer;
+  timer.start();
+  while (m_queue->coresInUse() == 0 && timer.elapsed() < 5000)
+    qApp->processEvents(QEventLoop::AllEvents, 10);
+  QCOMPARE(m_queue->coresInUse(), 1);
+  QCOMPARE(m_queue->m_checkJobLimitTimerId, -1);
+  QCOMPARE(m_queue->m_dispatchedJobCount, 1);
+  QVERIFY(m_queue->lastQueueLatency() >= 0);
+  qDebug() << "Queue latency:" << m_queue->lastQueueLatency() << "ms";
+
+  QVERIFY(waitForJobState(job, Finished, 5000));
+  QCOMPARE(m_queue->coresInUse(), 0);
+}
+
+void QueueLocalTest::testDispatchOnFinish()
+{
+  m_queue->setMaxNumberOfCores(2);
+
+  // The first job occupies both cores; the second must wait for it.
+  Job first = submitSleepJob("1", 2);
+  Job second = submitSleepJob("0", 1);
+  QVERIFY(waitForJobState(first, RunningLocal, 5000));
+  QCOMPARE(m_queue->coresInUse(), 2);
+  QCOMPARE(second.jobState(), LocalQueued);
+  QCOMPARE(m_queue->m_dispatchedJobCount, 1);
+
+  // The second job is started by the check that the first one schedules when
+  // it finishes.
+  QElapsedTimer timer;
+  timer.start();
+  while (first.jobState() != Finished && second.jobState() == LocalQueued &&
+         timer.elapsed() < 5000) {
+    qApp->processEvents(QEventLoop::AllEvents, 10);
+  }
+  QCOMPARE(first.jobState(), Finished);
+  QCOMPARE(second.jobState(), LocalQueued);
+  QVERIFY(m_queue->m_checkJobLimitTimerId != -1);
+  QVERIFY(waitForJobState(second, Finished, 5000));
+  QCOMPARE(m_queue->coresInUse(), 0);
+  QCOMPARE(m_queue->m_dispatchedJobCount, 2);
+
+  // Waiting jobs count towards the average.
+  QVERIFY(m_queue->averageQueueLatency() > 0.0);
+  qDebug() << "Queue latency:" << m_queue->lastQueueLatency() << "ms,"
+           << "average:" << m_queue->averageQueueLatency() << "ms";
+}
+
+void QueueLocalTest::testKillRunningJob()
+{
+  m_queue->setMaxNumberOfCores(1);
+
+  Job first = submitSleepJob("60");
+  Job second = submitSleepJob("0");
+  QVERIFY(waitForJobState(first, RunningLocal, 5000));
+  QCOMPARE(m_queue->coresInUse(), 1);
+
+  // Killing the running job releases its core for the next one.
+  m_queue->killJob(first);
+  QCOMPARE(first.jobState(), Killed);
+  QCOMPARE(m_queue->coresInUse(), 0);
+  QVERIFY(waitForJobState(second, Finished, 5000));
+  QCOMPARE(m_queue->coresInUse(), 0);
+}
+
+void QueueLocalTest::testSelectJobsToStart()
+{
+  // A 4 core job that runs for 10 ms, an 8 core job that cannot start yet,
+  // and a 1 core job.
+  QList<QueueLocal::PendingJobInfo> pending;
+  QueueLocal::PendingJobInfo info;
+  info.cores = 4;
+  info.wallTime = 10;
+  pending << info;
+  info.cores = 8;
+  info.wallTime = 10;
+  pending << info;
+  info.cores = 1;
+  info.wallTime = 5;
+  pending << info;
+  QList<QueueLocal::RunningJobInfo> running;
+
+  // FIFO stops at the 8 core job.
+  QList<int> expected;
+  expected << 0;
+  QCOMPARE(QueueLocal::selectJobsToStart(pending, running, 8, 0,
+                                         QueueLocal::FifoScheduling),
+           expected);
+
+  // The 1 core job finishes before the 8 core job can start.
+  expected << 2;
+  QCOMPARE(QueueLocal::selectJobsToStart(pending, running, 8, 0,
+                                         QueueLocal::BackfillScheduling),
+           expected);
+
+  // Jobs that may run longer than that are not started, unless they only use
+  // cores that the waiting job doesn't need.
+  pending[2].wallTime = 20;
+  expected.clear();
+  expected << 0;
+  QCOMPARE(QueueLocal::selectJobsToStart(pending, running, 8, 0,
+                                         QueueLocal::BackfillScheduling),
+           expected);
+  pending[2].wallTime = 0;
+  QCOMPARE(QueueLocal::selectJobsToStart(pending, running, 8, 0,
+                                         QueueLocal::BackfillScheduling),
+           expected);
+  expected << 2;
+  QCOMPARE(QueueLocal::selectJobsToStart(pending, running, 9, 0,
+                                         QueueLocal::BackfillScheduling),
+           expected);
+
+  // Nothing is backfilled if the waiting job's start time is unknown.
+  pending[0].wallTime = 0;
+  pending[2].wallTime = 5;
+  expected.clear();
+  expected << 0;
+  QCOMPARE(QueueLocal::selectJobsToStart(pending, running, 8, 0,
+                                         QueueLocal::BackfillScheduling),
+           expected);
+
+  // Running jobs are taken into account.
+  pending.removeFirst();
+  QueueLocal::RunningJobInfo runningJob;
+  runningJob.cores = 4;
+  runningJob.expectedEnd = 100;
+  running << runningJob;
+  expected.clear();
+  expected << 1;
+  QCOMPARE(QueueLocal::selectJobsToStart(pending, running, 8, 50,
+                                         QueueLocal::BackfillScheduling),
+           expected);
+  QVERIFY(QueueLocal::selectJobsToStart(pending, running, 8, 96,
+                                        QueueLocal::BackfillScheduling)
+          .isEmpty());
+}
+
+void QueueLocalTest::testSelectJobsWithMemory()
+{
+  // Three single core jobs on 8 cores and 16000 MB, the second of which must
+  // wait for the first to free its memory.
+  QList<QueueLocal::PendingJobInfo> pending;
+  QueueLocal::PendingJobInfo info;
+  info.wallTime = 10;
+  info.memory = 10000;
+  pending << info;
+  info.memory = 12000;
+  pending << info;
+  info.wallTime = 5;
+  info.memory = 5000;
+  pending << info;
+  QList<QueueLocal::RunningJobInfo> running;
+
+  QList<int> expected;
+  expected << 0;
+  QCOMPARE(QueueLocal::selectJobsToStart(pending, running, 8, 0,
+                                         QueueLocal::FifoScheduling, 16000),
+           expected);
+
+  // Memory is ignored without a limit.
+  expected << 1 << 2;
+  QCOMPARE(QueueLocal::selectJobsToStart(pending, running, 8, 0,
+                                         QueueLocal::FifoScheduling),
+           expected);
+
+  // The last job finishes before the second one can start.
+  expected.clear();
+  expected << 0 << 2;
+  QCOMPARE(QueueLocal::selectJobsToStart(pending, running, 8, 0,
+                                         QueueLocal::BackfillScheduling, 16000),
+           expected);
+
+  // If it runs longer, it may only use memory that the second job does not
+  // need: 4000 MB.
+  pending[2].wallTime = 20;
+  expected.clear();
+  expected << 0;
+  QCOMPARE(QueueLocal::selectJobsToStart(pending, running, 8, 0,
+                                         QueueLocal::BackfillScheduling, 16000),
+           expected);
+  pending[2].memory = 3000;
+  expected << 2;
+  QCOMPARE(QueueLocal::selectJobsToStart(pending, running, 8, 0,
+                                         QueueLocal::BackfillScheduling, 16000),
+           expected);
+
+  // Memory held by running jobs is taken into account.
+  QueueLocal::RunningJobInfo runningJob;
+  runningJob.cores = 1;
+  runningJob.memory = 8000;
+  running << runningJob;
+  bool waitingForMemory = false;
+  QVERIFY(QueueLocal::selectJobsToStart(pending, running, 8, 0,
+                                        QueueLocal::FifoScheduling, 16000,
+                                        &waitingForMemory).isEmpty());
+  QVERIFY(waitingForMemory);
+
+  // Jobs that wait for cores do not wait for memory.
+  QVERIFY(QueueLocal::selectJobsToStart(pending, running, 1, 0,
+                                        QueueLocal::BackfillScheduling, 16000,
+                                        &waitingForMemory).isEmpty());
+  QVERIFY(!waitingForMemory);
+  running.clear();
+  QCOMPARE(QueueLocal::selectJobsToStart(pending, running, 8, 0,
+                                         QueueLocal::FifoScheduling, -1,
+                                         &waitingForMemory).size(), 3);
+  QVERIFY(!waitingForMemory);
+}
+
+void QueueLocalTest::testParseMemInfo()
+{
+  const QByteArray memInfo("MemTotal:       16318412 kB\n"
+                           "MemFree:         1234567 kB\n"
+                           "MemAvailable:    8388608 kB\n"
+                           "HugePages_Total:       0\n");
+  QCOMPARE(QueueLocal::parseMemInfo(memInfo, "MemTotal"), Q_INT64_C(15935));
+  QCOMPARE(QueueLocal::parseMemInfo(memInfo, "MemAvailable"), Q_INT64_C(8192));
+  QCOMPARE(QueueLocal::parseMemInfo(memInfo, "HugePages_Total"), Q_INT64_C(0));
+  QCOMPARE(QueueLocal::parseMemInfo(memInfo, "MemAvail"), Q_INT64_C(-1));
+  QCOMPARE(QueueLocal::parseMemInfo(QByteArray(), "MemTotal"), Q_INT64_C(-1));
+}
+
+void QueueLocalTest::testParseCpuList()
+{
+  QCOMPARE(QueueLocal::parseCpuList("0-3,8,10-11\n"),
+           QList<int>() << 0 << 1 << 2 << 3 << 8 << 10 << 11);
+  QCOMPARE(QueueLocal::parseCpuList("5"), QList<int>() << 5);
+  QVERIFY(QueueLocal::parseCpuList("").isEmpty());
+}
+
+void QueueLocalTest::testAllocateCpus()
+{
+  QList<QList<int> > nodes;
+  nodes << (QList<int>() << 0 << 1 << 2 << 3)
+        << (QList<int>() << 4 << 5 << 6 << 7);
+  QSet<int> inUse;
+  inUse << 0;
+
+  // The smallest node that fits is used, leaving the other one whole.
+  QCOMPARE(QueueLocal::allocateCpus(nodes, inUse, 2), QList<int>() << 1 << 2);
+  QCOMPARE(QueueLocal::allocateCpus(nodes, inUse, 4),
+           QList<int>() << 4 << 5 << 6 << 7);
+
+  // Jobs that do not fit in a node span as few nodes as possible.
+  inUse << 1 << 4;
+  QCOMPARE(QueueLocal::allocateCpus(nodes, inUse, 5),
+           QList<int>() << 5 << 6 << 7 << 2 << 3);
+  QVERIFY(QueueLocal::allocateCpus(nodes, inUse, 6).isEmpty());
+}
+
+void QueueLocalTest::testBackfillSimulation()
+{
+  const int totalCores = 32;
+  QList<SimulatedJob> jobs;
+  // A half-machine job, followed by a full-machine job that must wait for it.
+  SimulatedJob job = { 16, 30, 30 };
+  jobs << job;
+  const int headJob = jobs.size();
+  job.cores = 32;
+  job.runtime = 60;
+  job.wallTime = 60;
+  jobs << job;
+  // Many short single core jobs.
+  for (int i = 0; i < 40; ++i) {
+    job.cores = 1;
+    job.runtime = 8;
+    job.wallTime = 10;
+    jobs << job;
+  }
+  // Medium jobs without a wall time.
+  for (int i = 0; i < 4; ++i) {
+    job.cores = 4;
+    job.runtime = 20;
+    job.wallTime = 0;
+    jobs << job;
+  }
+  // Medium jobs that finish early.
+  for (int i = 0; i < 4; ++i) {
+    job.cores = 8;
+    job.runtime = 25;
+    job.wallTime = 45;
+    jobs << job;
+  }
+
+  QList<qint64> fifoStarts;
+  const double fifoUtilisation = simulate(jobs, totalCores,
+                                          QueueLocal::FifoScheduling,
+                                          fifoStarts);
+  QList<qint64> backfillStarts;
+  const double backfillUtilisation = simulate(jobs, totalCores,
+                                              QueueLocal::BackfillScheduling,
+                                              backfillStarts);
+
+  qDebug() << "Core utilisation: FIFO" << fifoUtilisation
+           << "backfill" << backfillUtilisation;
+
+  QVERIFY(fifoUtilisation > 0.0);
+  QVERIFY(backfillUtilisation > fifoUtilisation);
+  // The waiting job is not delayed by the jobs that skip ahead of it.
+  QVERIFY(backfillStarts.at(headJob) <= fifoStarts.at(headJob));
+}
+
+QTEST_MAIN(QueueLocalTest)
+
+#include "queuelocaltest.moc"
@@ -58,6 +58,7 @@ private slots:
   void testToQueueList();
   void testRemoveQueue();
   void testCleanup();
+  void testHostCircuitBreaker();
 };
 
 void QueueManagerTest::initTestCase()
@@ -138,6 +139,21 @@ void QueueManagerTest::testCleanup()
   QCOMPARE(q.data(), static_cast<MoleQueue::Queue*>(NULL));
 }
 
+void QueueManagerTest::testHostCircuitBreaker()
+{
+  MoleQueue::CircuitBreaker &breaker =
+      m_queueManager.hostCircuitBreaker("host", 22);
+  breaker.recordFailure(QDateTime::currentDateTime());
+  QCOMPARE(&m_queueManager.hostCircuitBreaker("host", 22), &breaker);
+  QCOMPARE(m_queueManager.hostCircuitBreaker("host", 2222)
+           .consecutiveFailures(), 0);
+
+  // Other managers do not see the failures.
+  MoleQueue::QueueManager other;
+  QCOMPARE(other.hostCircuitBreaker("host", 22).consecutiveFailures(), 0);
+  breaker.recordSuccess();
+}
+
 QTEST_MAIN(QueueManagerTest)
 
 #include "queuemanagertest.moc"
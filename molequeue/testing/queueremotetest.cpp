@@ -54,7 +54,16 @@ private slots:
   void testFinalizePipeline();
   void testKillPipeline();
   void testQueueUpdate();
+  void testChunkedQueueUpdate();
+  void testAdaptiveQueueUpdates();
   void testReplaceLaunchScriptKeywords();
+  void testParseBatchSubmissionOutput();
+  void testBatchSubmission();
+  void testConnectionSharing();
+  void testFileChecksum();
+  void testSelectiveOutputRetrieval();
+  void testOutputStreaming();
+  void testConnectionCircuitBreaker();
 };
 
 void QueueRemoteTest::initTestCase()
@@ -486,6 +495,206 @@ void QueueRemoteTest::testQueueUpdate()
 
 }
 
+void QueueRemoteTest::testChunkedQueueUpdate()
+{
+  // The ids of many jobs are split into requests of bounded length.
+  QList<IdType> ids;
+  for (IdType id = 1; id <= 10000; ++id)
+    ids.append(id + 100000);
+  const QList<QList<IdType> > requests = m_queue->splitQueueRequest(ids);
+  QVERIFY(requests.size() > 1);
+  QList<IdType> requestedIds;
+  foreach (const QList<IdType> &request, requests) {
+    QVERIFY(m_queue->generateQueueRequestCommand(request).size() <=
+            QString("reqComm ").size() + m_queue->m_maxQueueRequestLength);
+    requestedIds += request;
+  }
+  QCOMPARE(requestedIds, ids);
+  QCOMPARE(m_queue->splitQueueRequest(QList<IdType>()).size(), 1);
+
+  // Run an update in three requests: 10 11 12, 13 14 15 and 16 17.
+  const QMap<IdType, IdType> savedJobs = m_queue->m_jobs;
+  const int savedMaxLength = m_queue->m_maxQueueRequestLength;
+  m_queue->m_jobs.clear();
+  m_queue->m_maxQueueRequestLength = 10;
+
+  QList<Job> jobs;
+  QStringList commands;
+  QStringList outputs;
+  for (IdType queueId = 10; queueId < 18; ++queueId) {
+    Job job = m_server.jobManager()->newJob();
+    job.setQueue("Dummy");
+    job.setQueueId(queueId);
+    job.setJobState(Submitted);
+    jobs.append(job);
+    m_queue->m_jobs.insert(queueId, job.moleQueueId());
+
+    const int request = static_cast<int>(queueId - 10) / 3;
+    if (request == commands.size()) {
+      commands.append("reqComm ");
+      outputs.append(QString());
+    }
+    commands[request] += QString("%1 ").arg(queueId);
+    outputs[request] += QString("%1 %2\n").arg(queueId)
+        .arg(jobStateToString(RemoteQueued));
+  }
+  QCOMPARE(commands.size(), 3);
+
+  m_queue->requestQueueUpdate();
+  for (int i = 0; i < commands.size(); ++i) {
+    DummySshCommand *ssh = m_queue->getDummySshCommand();
+    QCOMPARE(ssh->getDummyArgs().last(), commands.at(i));
+    // Nothing is updated before the last reply.
+    QCOMPARE(jobs.first().jobState(), Submitted);
+    ssh->setDummyExitCode(0);
+    ssh->setDummyOutput(outputs.at(i));
+    ssh->emitDummyRequestComplete();
+  }
+  foreach (const Job &job, jobs)
+    QCOMPARE(job.jobState(), RemoteQueued);
+  QVERIFY(!m_queue->m_isCheckingQueue);
+
+  // A failed request abandons the update.
+  m_queue->requestQueueUpdate();
+  DummySshCommand *ssh = m_queue->getDummySshCommand();
+  ssh->setDummyExitCode(0);
+  ssh->setDummyOutput(outputs.first().replace(jobStateToString(RemoteQueued),
+                                              jobStateToString(Submitted)));
+  ssh->emitDummyRequestComplete();
+  ssh = m_queue->getDummySshCommand();
+  QCOMPARE(ssh->getDummyArgs().last(), commands.at(1));
+  ssh->setDummyExitCode(1);
+  ssh->setDummyOutput("Argument list too long");
+  ssh->emitDummyRequestComplete();
+  QVERIFY(!m_queue->m_isCheckingQueue);
+  QVERIFY(m_queue->m_pendingQueueRequests.isEmpty());
+  foreach (const Job &job, jobs)
+    QCOMPARE(job.jobState(), RemoteQueued);
+  QCOMPARE(m_queue->m_jobs.size(), jobs.size());
+
+  m_queue->m_jobs = savedJobs;
+  m_queue->m_maxQueueRequestLength = savedMaxLength;
+}
+
+void QueueRemoteTest::testAdaptiveQueueUpdates()
+{
+  const QMap<IdType, IdType> savedJobs = m_queue->m_jobs;
+  const int savedInterval = m_queue->m_queueUpdateInterval;
+  m_queue->m_jobs.clear();
+  m_queue->m_queueUpdateInterval = 3;
+  m_queue->m_stableQueueUpdates = 0;
+
+  // Without jobs there is nothing to look out for.
+  QCOMPARE(m_queue->nextQueueUpdateDelay(), 180);
+
+  Job job = m_server.jobManager()->newJob();
+  job.setQueue("Dummy");
+  job.setQueueId(20);
+  job.setMaxWallTime(60);
+  job.setJobState(Submitted);
+  m_queue->m_jobs.insert(job.queueId(), job.moleQueueId());
+
+  // The delay doubles while nothing changes, up to the update interval.
+  QList<int> delays;
+  for (int i = 0; i < 6; ++i) {
+    delays << m_queue->nextQueueUpdateDelay();
+    m_queue->queueUpdateFinished(true);
+  }
+  QCOMPARE(delays, QList<int>() << 15 << 30 << 60 << 120 << 180 << 180);
+  // Failed updates back off as well.
+  m_queue->queueUpdateFinished(false);
+  QCOMPARE(m_queue->nextQueueUpdateDelay(), 180);
+
+  // Submissions and changes start over.
+  m_queue->resetQueueUpdateBackoff();
+  QCOMPARE(m_queue->nextQueueUpdateDelay(), 15);
+  QCOMPARE(m_queue->m_queueUpdateDelay, 15);
+  m_queue->queueUpdateFinished(true);
+  m_queue->queueUpdateFinished(true, true);
+  QCOMPARE(m_queue->nextQueueUpdateDelay(), 15);
+
+  // Jobs are checked shortly after they reach their walltime limit.
+  m_queue->m_stableQueueUpdates = 10;
+  m_queue->setRemoteJobState(job, RunningRemote, 60 * 60 - 90);
+  QCOMPARE(job.jobState(), RunningRemote);
+  QVERIFY(qAbs(m_queue->nextQueueUpdateDelay() - 120) <= 1);
+  // The deadline is kept until the used walltime is known.
+  m_queue->setRemoteJobState(job, RunningRemote);
+  QVERIFY(qAbs(m_queue->nextQueueUpdateDelay() - 120) <= 1);
+  m_queue->setRemoteJobState(job, RunningRemote, 60 * 60);
+  QVERIFY(qAbs(m_queue->nextQueueUpdateDelay() - 30) <= 1);
+  m_queue->setRemoteJobState(job, RunningRemote, 60 * 60 + 25);
+  QCOMPARE(m_queue->nextQueueUpdateDelay(), 15);
+  // Jobs that overrun their limit are not polled for.
+  m_queue->setRemoteJobState(job, RunningRemote, 60 * 60 + 60);
+  QCOMPARE(m_queue->nextQueueUpdateDelay(), 180);
+
+  // Immediate updates are counted and reset the delay.
+  m_queue->m_wallTimeDeadlines.clear();
+  const QVariantHash before = m_queue->queueUpdateStatistics();
+  QCOMPARE(before.value("jobs").toInt(), 1);
+  m_queue->m_lastQueueUpdateStart = QDateTime();
+  m_queue->requestImmediateQueueUpdate();
+  QVERIFY(m_queue->m_queueUpdateInProgress);
+  QCOMPARE(m_queue->m_checkQueueTimerId, -1);
+  DummySshCommand *ssh = m_queue->getDummySshCommand();
+  QCOMPARE(ssh->getDummyArgs().last(), QString("reqComm 20 "));
+  ssh->setDummyExitCode(0);
+  ssh->setDummyOutput(QString("20 %1\n").arg(jobStateToString(RunningRemote)));
+  ssh->emitDummyRequestComplete();
+  QVERIFY(!m_queue->m_queueUpdateInProgress);
+  QVERIFY(m_queue->m_checkQueueTimerId != -1);
+  // The job did not change, so the update counts as stable.
+  QCOMPARE(m_queue->m_stableQueueUpdates, 1);
+  QVERIFY(m_queue->m_wallTimeDeadlines.contains(20));
+
+  QVariantHash after = m_queue->queueUpdateStatistics();
+  QCOMPARE(after.value("updates").toInt(),
+           before.value("updates").toInt() + 1);
+  QCOMPARE(after.value("immediateUpdates").toInt(),
+           before.value("immediateUpdates").toInt() + 1);
+  QCOMPARE(after.value("failedUpdates").toInt(),
+           before.value("failedUpdates").toInt());
+  QVERIFY(!after.value("lastUpdate").toString().isEmpty());
+  QCOMPARE(after.value("updateInterval").toInt(), 30);
+
+  // Repeated requests are merged into one update after the shortest
+  // interval.
+  m_queue->m_stableQueueUpdates = 5;
+  m_queue->requestImmediateQueueUpdate();
+  m_queue->requestImmediateQueueUpdate();
+  QVERIFY(!m_queue->m_queueUpdateInProgress);
+  QVERIFY(m_queue->m_checkQueueTimerId != -1);
+  QVERIFY(m_queue->m_queueUpdateDelay > 0);
+  QVERIFY(m_queue->m_queueUpdateDelay <= 15);
+  QCOMPARE(m_queue->m_stableQueueUpdates, 0);
+  const QVariantHash merged = m_queue->queueUpdateStatistics();
+  QCOMPARE(merged.value("updates").toInt(), after.value("updates").toInt());
+  QCOMPARE(merged.value("immediateUpdates").toInt(),
+           after.value("immediateUpdates").toInt() + 2);
+
+  // Failed updates are counted.
+  m_queue->requestQueueUpdate();
+  ssh = m_queue->getDummySshCommand();
+  ssh->setDummyExitCode(1);
+  ssh->setDummyOutput("qstat: error");
+  ssh->emitDummyRequestComplete();
+  after = m_queue->queueUpdateStatistics();
+  QCOMPARE(after.value("updates").toInt(),
+           before.value("updates").toInt() + 2);
+  QCOMPARE(after.value("failedUpdates").toInt(),
+           before.value("failedUpdates").toInt() + 1);
+
+  // Deadlines of jobs that have left the queue are forgotten.
+  m_queue->m_jobs.clear();
+  m_queue->queueUpdateFinished(true);
+  QVERIFY(m_queue->m_wallTimeDeadlines.isEmpty());
+
+  m_queue->m_jobs = savedJobs;
+  m_queue->m_queueUpdateInterval = savedInterval;
+  m_queue->resetQueueUpdateBackoff();
+}
+
 void QueueRemoteTest::testReplaceLaunchScriptKeywords()
 {
   // $$maxWallTime$$
@@ -521,6 +730,522 @@ void QueueRemoteTest::testReplaceLaunchScriptKeywords()
                    "Test sixth line\nSafe maxWallTime=24:00:00\n"));
 }
 
+void QueueRemoteTest::testParseBatchSubmissionOutput()
+{
+  const QString marker(DummyQueueRemote::batchStatusMarker);
+  // Job 7 is submitted, job 8 fails, job 9 prints no newline before the marker
+  // and job 10 is never reached.
+  const QString output = QString("Your job 1001\n%1 7 0\n"
+                                 "qsub: error\nsecond line\n%1 8 2\n"
+                                 "Your job 1003%1 9 0\n").arg(marker);
+
+  QMap<IdType, DummyQueueRemote::BatchSubmissionResult> results =
+      DummyQueueRemote::parseBatchSubmissionOutput(output);
+  QCOMPARE(results.keys(), QList<IdType>() << 7 << 8 << 9);
+  QCOMPARE(results[7].exitCode, 0);
+  QCOMPARE(results[7].output, QString("Your job 1001"));
+  QCOMPARE(results[8].exitCode, 2);
+  QCOMPARE(results[8].output, QString("qsub: error\nsecond line"));
+  QCOMPARE(results[9].exitCode, 0);
+  QCOMPARE(results[9].output, QString("Your job 1003"));
+
+  QVERIFY(DummyQueueRemote::parseBatchSubmissionOutput(
+            "ssh: connect to host some.host: Connection refused").isEmpty());
+}
+
+void QueueRemoteTest::testBatchSubmission()
+{
+  QCOMPARE(m_queue->submissionsInProgress(), 0);
+  m_queue->setMaxConcurrentSubmissions(1);
+  const int submittedJobs = m_queue->m_jobs.size();
+
+  QList<Job> jobs;
+  QStringList ids;
+  for (int i = 0; i < 3; ++i) {
+    Job job = m_server.jobManager()->newJob();
+    job.setQueue("Dummy");
+    job.setProgram("DummyProgram");
+    job.setInputFile(FileSpecification("file.ext", "batch"));
+    m_queue->submitJob(job);
+    jobs << job;
+    ids << QString::number(job.moleQueueId());
+  }
+
+  // All pending jobs go into a single batch
+  m_queue->submitPendingJobs();
+  QCOMPARE(m_queue->m_pendingSubmission.size(), 0);
+  QCOMPARE(m_queue->submissionsInProgress(), 1);
+
+  // Further jobs wait for the batch to finish
+  Job waitingJob = m_server.jobManager()->newJob();
+  waitingJob.setQueue("Dummy");
+  waitingJob.setProgram("DummyProgram");
+  m_queue->submitJob(waitingJob);
+  m_queue->submitPendingJobs();
+  QCOMPARE(m_queue->m_pendingSubmission.size(), 1);
+  QCOMPARE(m_queue->submissionsInProgress(), 1);
+
+  // One mkdir for the working directory base
+  DummySshCommand *ssh = m_queue->getDummySshCommand();
+  QCOMPARE(ssh->getDummyCommand(), QString("ssh"));
+  QCOMPARE(ssh->getDummyArgs(), QStringList()
+           << "-q"
+           << "-p" << "6887"
+           << "aUser@some.host.somewhere"
+           << "mkdir -p /some/path"
+           );
+  ssh->setDummyExitCode(0);
+  ssh->emitDummyRequestComplete(); // triggers batchDirectoryCreated
+
+  // One transfer for all input directories
+  ssh = m_queue->getDummySshCommand();
+  QStringList expectedArgs;
+  expectedArgs << "-q" << "-S" << "ssh" << "-P" << "6887" << "-r";
+  foreach (const Job &job, jobs)
+    expectedArgs << job.localWorkingDirectory();
+  expectedArgs << "aUser@some.host.somewhere:/some/path";
+  QCOMPARE(ssh->getDummyCommand(), QString("scp"));
+  QCOMPARE(ssh->getDummyArgs(), expectedArgs);
+  ssh->setDummyExitCode(0);
+  ssh->emitDummyRequestComplete(); // triggers batchInputFilesCopied
+
+  // One command submits all jobs
+  ssh = m_queue->getDummySshCommand();
+  QCOMPARE(ssh->getDummyCommand(), QString("ssh"));
+  QCOMPARE(ssh->getDummyArgs().last(),
+           QString("cd /some/path && for id in %1; do (cd $id && subComm "
+                   "launcher.dummy) 2>&1; echo \"%2 $id $?\"; done")
+           .arg(ids.join(" ")).arg(DummyQueueRemote::batchStatusMarker));
+
+  // The first job is submitted, the second is rejected and the connection
+  // drops before the third.
+  const QString marker(DummyQueueRemote::batchStatusMarker);
+  ssh->setDummyOutput(QString("Your job 1001\n%1 %2 0\nqsub: error\n"
+                              "%1 %3 1\nConnection closed by 10.0.0.1\n")
+                      .arg(marker).arg(ids[0]).arg(ids[1]));
+  ssh->setDummyExitCode(255);
+  ssh->emitDummyRequestComplete(); // triggers batchSubmittedToRemoteQueue
+
+  QCOMPARE(jobs[0].jobState(), Submitted);
+  QCOMPARE(jobs[0].queueId(), static_cast<IdType>(1001));
+  QCOMPARE(m_queue->m_jobs.value(1001), jobs[0].moleQueueId());
+  QCOMPARE(m_queue->m_jobs.size(), submittedJobs + 1);
+  QCOMPARE(jobs[1].jobState(), Error);
+  QCOMPARE(jobs[2].jobState(), Error);
+
+  // The failed jobs are retried along with the waiting one
+  QCOMPARE(m_queue->submissionsInProgress(), 0);
+  QCOMPARE(m_queue->m_pendingSubmission.size(), 3);
+  QVERIFY(m_queue->m_pendingSubmission.contains(jobs[1].moleQueueId()));
+  QVERIFY(m_queue->m_pendingSubmission.contains(jobs[2].moleQueueId()));
+
+  m_queue->m_pendingSubmission.clear();
+  m_queue->m_jobs.remove(1001);
+  m_queue->setMaxConcurrentSubmissions(
+        MoleQueue::DEFAULT_MAX_CONCURRENT_SUBMISSIONS);
+  // The dropped connection holds back requests to the host.
+  QCOMPARE(m_queue->circuitBreaker().consecutiveFailures(), 1);
+  m_queue->circuitBreaker().recordSuccess();
+}
+
+void QueueRemoteTest::testConnectionSharing()
+{
+  const QString hostName = m_queue->hostName();
+
+  // Each step in the life of a job uses a new connection: mkdir, copy input,
+  // submit, queue update, copy output and clean up.
+  for (int share = 0; share <= 1; ++share) {
+    DummySshCommand::resetHandshakes();
+    m_queue->setShareConnections(share != 0);
+
+    m_queue->newSshConnection()->execute("mkdir -p /some/path");
+    m_queue->newSshConnection()->copyDirTo("/tmp/in", "/some/path/1");
+    m_queue->newSshConnection()->execute("cd /some/path/1 && subComm x");
+    m_queue->newSshConnection()->execute("reqComm 1");
+    m_queue->newSshConnection()->copyFrom("/some/path/1/out", "/tmp/out");
+    m_queue->newSshConnection()->execute("rm -rf /some/path/1");
+
+    QCOMPARE(DummySshCommand::handshakeCount(), share ? 1 : 6);
+  }
+
+  // Both ssh and scp use the queue's control socket.
+  DummySshCommand *ssh = m_queue->getDummySshCommand();
+  QVERIFY(ssh->getDummyArgs().contains("ControlPath=" +
+                                       m_queue->controlPath()));
+
+  // The socket is in a directory that only the user can access, and each
+  // queue has its own socket.
+  QVERIFY(m_queue->controlPath().startsWith(
+            QDir::cleanPath(m_server.workingDirectoryBase()) + "/ssh/"));
+  QCOMPARE(QFile::permissions(m_queue->controlDirectory()) &
+           (QFile::ReadGroup | QFile::WriteGroup | QFile::ExeGroup |
+            QFile::ReadOther | QFile::WriteOther | QFile::ExeOther),
+           QFile::Permissions(0));
+  // The directory is only set up once.
+  QCOMPARE(m_queue->m_checkedControlDirectory, m_queue->controlDirectory());
+  QVERIFY(m_queue->m_controlDirectoryUsable);
+  QVERIFY(QDir().rmdir(m_queue->controlDirectory()));
+  m_queue->newSshConnection()->execute("true");
+  QVERIFY(!QDir(m_queue->controlDirectory()).exists());
+  QVERIFY(m_queue->getDummySshCommand()->getDummyArgs().contains(
+            "ControlPath=" + m_queue->controlPath()));
+  m_queue->m_checkedControlDirectory.clear();
+  QVERIFY(m_queue->createControlDirectory());
+  QVERIFY(QDir(m_queue->controlDirectory()).exists());
+
+  const QString queueName = m_queue->name();
+  const QString path = m_queue->controlPath();
+  m_queue->setName("Other queue");
+  QVERIFY(m_queue->controlPath() != path);
+  m_queue->setName(queueName);
+  m_queue->newSshConnection()->copyTo("/tmp/in", "/some/path/in");
+  ssh = m_queue->getDummySshCommand();
+  QCOMPARE(ssh->getDummyCommand(), QString("scp"));
+  QVERIFY(ssh->getDummyArgs().contains("ControlMaster=auto"));
+  QCOMPARE(DummySshCommand::handshakeCount(), 1);
+
+  // Another host needs its own connection.
+  m_queue->setHostName("other.host");
+  m_queue->newSshConnection()->execute("true");
+  QCOMPARE(DummySshCommand::handshakeCount(), 2);
+
+  m_queue->setHostName(hostName);
+  m_queue->setShareConnections(false);
+}
+
+void QueueRemoteTest::testFileChecksum()
+{
+  const QString fileName = m_server.workingDirectoryBase() + "/checksum.txt";
+  QFile file(fileName);
+  QVERIFY(file.open(QFile::WriteOnly));
+  file.close();
+
+  // Reference values from POSIX cksum
+  quint32 checksum = 0;
+  QVERIFY(DummyQueueRemote::fileChecksum(fileName, &checksum));
+  QCOMPARE(checksum, static_cast<quint32>(4294967295u));
+
+  QVERIFY(file.open(QFile::WriteOnly));
+  file.write("line 1\nline 2\n");
+  file.close();
+  QVERIFY(DummyQueueRemote::fileChecksum(fileName, &checksum));
+  QCOMPARE(checksum, static_cast<quint32>(3449080946u));
+
+  QVERIFY(!DummyQueueRemote::fileChecksum(fileName + ".missing", &checksum));
+}
+
+void QueueRemoteTest::testSelectiveOutputRetrieval()
+{
+  Program *program = new Program(m_queue);
+  program->setName("FilteredProgram");
+  program->setOutputIncludePatterns(QStringList() << "*.out" << "*.log"
+                                    << "results/*");
+  program->setOutputExcludePatterns(QStringList() << "*.tmp");
+  program->setSkipUnchangedOutput(true);
+  QVERIFY(m_queue->addProgram(program));
+
+  Job job = m_server.jobManager()->newJob();
+  job.setQueue("Dummy");
+  job.setProgram("FilteredProgram");
+  job.setLocalWorkingDirectory(m_server.workingDirectoryBase() + "/selective");
+  QVERIFY(QDir().mkpath(job.localWorkingDirectory()));
+  foreach (const QString &name, QStringList() << "job.out" << "restart.log"
+           << "input.in") {
+    QFile file(job.localWorkingDirectory() + "/" + name);
+    QVERIFY(file.open(QFile::WriteOnly));
+    file.write("line 1\nline 2\n");
+  }
+
+  // Only the remote copies of included local files are checksummed.
+  const QString remoteDir = QString("%1/%2")
+      .arg(m_queue->workingDirectoryBase()).arg(job.moleQueueId());
+  m_queue->setDirectoryTransferMode(SshCommand::TarTransfer);
+  m_queue->finalizeJobCopyFromServer(job);
+  DummySshCommand *ssh = m_queue->getDummySshCommand();
+  QCOMPARE(ssh->getDummyCommand(), QString("ssh"));
+  const QString command = ssh->getDummyArgs().last();
+  QVERIFY(command.startsWith(QString("cd %1 && ").arg(remoteDir)));
+  QVERIFY(command.contains("'job.out'"));
+  QVERIFY(command.contains("'restart.log'"));
+  QVERIFY(!command.contains("'input.in'"));
+
+  // job.out is unchanged, restart.log has been appended to. Everything else
+  // is filtered by the patterns.
+  const QString listing = QString(
+        "%1\n"
+        "     14 ./job.out\n"
+        "     20 ./restart.log\n"
+        "     14 ./input.in\n"
+        "   5000 ./scratch.tmp\n"
+        "      7 ./results/a.dat\n"
+        "   4000 ./results/b.tmp\n"
+        "     99 ./c.dat\n"
+        "   9154 total\n"
+        "%2\n"
+        "3449080946 14 job.out\n"
+        "1234567890 20 restart.log\n")
+      .arg(DummyQueueRemote::outputFilesMarker)
+      .arg(DummyQueueRemote::outputChecksumsMarker);
+  QCOMPARE(m_queue->selectOutputFiles(job, listing),
+           QStringList() << "restart.log" << "results/a.dat");
+
+  // Copy the selected files into the local working directory.
+  ssh->setDummyOutput(listing);
+  ssh->setDummyExitCode(0);
+  ssh->emitDummyRequestComplete(); // triggers finalizeJobOutputListed
+  ssh = m_queue->getDummySshCommand();
+  QCOMPARE(ssh->getDummyCommand(), QString("ssh"));
+  QCOMPARE(ssh->getDummyArgs().last(),
+           QString("tar -C %1 -cf - 'restart.log' 'results/a.dat'")
+           .arg(remoteDir));
+  QCOMPARE(ssh->getDummyArchiveArgs(), QStringList()
+           << "-C" << job.localWorkingDirectory() << "-xf" << "-");
+  QVERIFY(!ssh->getDummyArchiveUpload());
+
+  ssh->setDummyExitCode(0);
+  ssh->emitDummyRequestComplete(); // triggers finalizeJobOutputCopiedFromServer
+  QCOMPARE(job.jobState(), Finished);
+
+  // Nothing to copy back
+  job.setJobState(RunningRemote);
+  m_queue->finalizeJobCopyFromServer(job);
+  ssh = m_queue->getDummySshCommand();
+  ssh->setDummyOutput(QString("%1\n     14 ./job.out\n%2\n"
+                              "3449080946 14 job.out\n")
+                      .arg(DummyQueueRemote::outputFilesMarker)
+                      .arg(DummyQueueRemote::outputChecksumsMarker));
+  ssh->setDummyExitCode(0);
+  ssh->emitDummyRequestComplete();
+  QCOMPARE(m_queue->getDummySshCommand(), ssh);
+  QCOMPARE(job.jobState(), Finished);
+
+  // Hosts set up for scp get the files one at a time.
+  m_queue->setDirectoryTransferMode(SshCommand::ScpTransfer);
+  job.setJobState(RunningRemote);
+  m_queue->finalizeJobCopyFromServer(job);
+  ssh = m_queue->getDummySshCommand();
+  ssh->setDummyOutput(listing);
+  ssh->setDummyExitCode(0);
+  ssh->emitDummyRequestComplete(); // triggers finalizeJobOutputListed
+  ssh = m_queue->getDummySshCommand();
+  QCOMPARE(ssh->getDummyCommand(), QString("scp"));
+  QVERIFY(ssh->getDummyArgs().at(ssh->getDummyArgs().size() - 2)
+          .endsWith(":" + remoteDir + "/restart.log"));
+  QCOMPARE(ssh->getDummyArgs().last(),
+           QDir(job.localWorkingDirectory()).absoluteFilePath("restart.log"));
+  ssh->setDummyExitCode(0);
+  ssh->emitDummyRequestComplete(); // triggers finalizeJobOutputCopiedFromServer
+  QCOMPARE(job.jobState(), Finished);
+
+  // Too many local files to name are checksummed along with all others.
+  const int savedMaxLength = m_queue->m_maxQueueRequestLength;
+  m_queue->m_maxQueueRequestLength = 10;
+  const QString longCommand =
+      m_queue->generateOutputListingCommand(job, *program);
+  QVERIFY(longCommand.endsWith(" && find . -type f -exec cksum {} +"));
+  QVERIFY(!longCommand.contains("'job.out'"));
+  m_queue->m_maxQueueRequestLength = savedMaxLength;
+  QCOMPARE(m_queue->selectOutputFiles(job, QString(
+             "%1\n     14 ./job.out\n     20 ./restart.log\n%2\n"
+             "3449080946 14 ./job.out\n1234567890 20 ./restart.log\n"
+             "42 7 ./results/a.dat\n")
+           .arg(DummyQueueRemote::outputFilesMarker)
+           .arg(DummyQueueRemote::outputChecksumsMarker)),
+           QStringList() << "restart.log");
+
+  QVERIFY(m_queue->removeProgram("FilteredProgram"));
+}
+
+void QueueRemoteTest::testOutputStreaming()
+{
+  Program *program = new Program(m_queue);
+  program->setName("StreamingProgram");
+  program->setStreamedOutputFiles(QStringList() << "job.log" << "scf.out");
+  QVERIFY(m_queue->addProgram(program));
+
+  Job job = m_server.jobManager()->newJob();
+  job.setQueue("Dummy");
+  job.setProgram("StreamingProgram");
+  job.setQueueId(4321);
+  job.setLocalWorkingDirectory(m_server.workingDirectoryBase() + "/streaming");
+  QVERIFY(QDir().mkpath(job.localWorkingDirectory()));
+  QFile log(job.localWorkingDirectory() + "/job.log");
+  QVERIFY(log.open(QFile::WriteOnly));
+  log.write("step 1\n");
+  log.close();
+  m_queue->m_jobs.insert(job.queueId(), job.moleQueueId());
+
+  // Each file is resumed at the size of its local copy.
+  m_queue->streamJobOutput(job);
+  DummySshCommand *ssh = m_queue->getDummySshCommand();
+  QCOMPARE(ssh->getDummyCommand(), QString("ssh"));
+  const QString command = ssh->getDummyArgs().last();
+  QVERIFY(command.startsWith(QString("cd %1/%2 && { ")
+                             .arg(m_queue->workingDirectoryBase())
+                             .arg(job.moleQueueId())));
+  QVERIFY(command.contains("f='job.log'; o=7;"));
+  QVERIFY(command.contains("f='scf.out'; o=0;"));
+
+  // Only one request per job at a time
+  m_queue->streamJobOutput(job);
+  QCOMPARE(m_queue->getDummySshCommand(), ssh);
+
+  // Only stdout is written to the files, byte for byte. Messages of ssh on
+  // stderr are not.
+  QVERIFY(ssh->separateOutput());
+  const QByteArray marker(DummyQueueRemote::outputStreamMarker);
+  QSignalSpy spy(m_server.jobManager(),
+                 SIGNAL(jobOutputAvailable(MoleQueue::Job,QStringList)));
+  QByteArray streamed = marker + " 7 21 job.log\nstep 2\nstep 3\n" +
+      marker + " 0 3 ../evil\nabc" +
+      marker + " 0 9 scf.out\nE = -1.0\n";
+  // Binary output such as NUL bytes is passed through.
+  streamed.replace("step 3", QByteArray("step\0003", 6));
+  ssh->setDummyStandardOutput(streamed);
+  ssh->setDummyOutput("Warning: Permanently added 'host' to the list of "
+                      "known hosts.\n");
+  ssh->setDummyExitCode(0);
+  CircuitBreaker &breaker = m_queue->circuitBreaker();
+  breaker.recordFailure(QDateTime::currentDateTime());
+  ssh->emitDummyRequestComplete(); // triggers jobOutputStreamed
+  QCOMPARE(spy.count(), 1);
+  // Streaming requests do not touch the circuit breaker.
+  QCOMPARE(breaker.consecutiveFailures(), 1);
+  breaker.recordSuccess();
+  QCOMPARE(spy.first().at(1).toStringList(),
+           QStringList() << "job.log" << "scf.out");
+  QVERIFY(log.open(QFile::ReadOnly));
+  QCOMPARE(log.readAll(),
+           QByteArray("step 1\nstep 2\nstep\0003\n", 21));
+  log.close();
+  QVERIFY(!QFile::exists(m_server.workingDirectoryBase() + "/evil"));
+
+  // A file that was rewritten on the host is replaced.
+  QCOMPARE(m_queue->writeStreamedOutput(
+             job, program->streamedOutputFiles(),
+             marker + " 0 4 job.log\nnew\n"),
+           QStringList() << "job.log");
+  QVERIFY(log.open(QFile::ReadOnly));
+  QCOMPARE(log.readAll(), QByteArray("new\n"));
+  log.close();
+
+  // Late replies for jobs that have left the queue are ignored.
+  m_queue->streamJobOutput(job);
+  ssh = m_queue->getDummySshCommand();
+  m_queue->m_jobs.remove(job.queueId());
+  ssh->setDummyStandardOutput(marker + " 4 8 job.log\nold\n");
+  ssh->setDummyExitCode(0);
+  ssh->emitDummyRequestComplete();
+  QCOMPARE(spy.count(), 1);
+
+  QVERIFY(m_queue->removeProgram("StreamingProgram"));
+}
+
+void QueueRemoteTest::testConnectionCircuitBreaker()
+{
+  const QMap<IdType, IdType> savedJobs = m_queue->m_jobs;
+  m_queue->m_jobs.clear();
+  CircuitBreaker &breaker = m_queue->circuitBreaker();
+  const int savedThreshold = breaker.failureThreshold();
+  breaker.recordSuccess();
+  breaker.setFailureThreshold(2);
+
+  Job job = m_server.jobManager()->newJob();
+  job.setQueue("Dummy");
+  job.setProgram("DummyProgram");
+  job.setInputFile(FileSpecification("file.ext", "unreachable"));
+  m_queue->submitJob(job);
+  m_queue->submitPendingJobs();
+
+  // The host cannot be reached. The job is retried without using up its
+  // retries.
+  DummySshCommand *ssh = m_queue->getDummySshCommand();
+  QCOMPARE(ssh->getDummyCommand(), QString("scp"));
+  ssh->setDummyExitCode(255);
+  ssh->setDummyOutput("ssh: connect to host some.host.somewhere port 6887: "
+                      "Connection refused");
+  ssh->emitDummyRequestComplete(); // triggers inputFilesCopied
+  QCOMPARE(job.jobState(), Error);
+  QCOMPARE(m_queue->jobFailureCount(job.moleQueueId()), 0);
+  QCOMPARE(m_queue->m_pendingSubmission.size(), 1);
+  QCOMPARE(breaker.state(), CircuitBreaker::Closed);
+  QCOMPARE(breaker.consecutiveFailures(), 1);
+
+  // Nothing is sent until the backoff delay has passed.
+  QVERIFY(breaker.retryTime() > QDateTime::currentDateTime());
+  m_queue->submitPendingJobs();
+  QCOMPARE(m_queue->submissionsInProgress(), 0);
+  QCOMPARE(m_queue->getDummySshCommand(), ssh);
+
+  // Another failure opens the breaker. Once its delay has passed, a single
+  // probe is sent instead of the job.
+  breaker.recordFailure(QDateTime::currentDateTime().addSecs(-3600));
+  QCOMPARE(breaker.state(), CircuitBreaker::Open);
+  QCOMPARE(m_queue->status().value("connection").toHash()
+           .value("state").toString(), QString("open"));
+  m_queue->submitPendingJobs();
+  QCOMPARE(breaker.state(), CircuitBreaker::HalfOpen);
+  QCOMPARE(m_queue->submissionsInProgress(), 0);
+  ssh = m_queue->getDummySshCommand();
+  QCOMPARE(ssh->getDummyCommand(), QString("ssh"));
+  QCOMPARE(ssh->getDummyArgs().last(), QString("true"));
+  m_queue->submitPendingJobs();
+  QCOMPARE(m_queue->getDummySshCommand(), ssh);
+
+  // A failed probe keeps the breaker open for longer.
+  ssh->setDummyExitCode(255);
+  ssh->setDummyOutput("ssh: connect to host some.host.somewhere port 6887: "
+                      "Connection timed out");
+  ssh->emitDummyRequestComplete(); // triggers connectionProbed
+  QCOMPARE(breaker.state(), CircuitBreaker::Open);
+  QCOMPARE(breaker.consecutiveFailures(), 3);
+  QVERIFY(breaker.retryTime() > QDateTime::currentDateTime());
+  m_queue->submitPendingJobs();
+  QCOMPARE(m_queue->getDummySshCommand(), ssh);
+
+  // A successful probe closes the breaker and resumes the submission.
+  breaker.recordFailure(QDateTime::currentDateTime().addSecs(-3600));
+  m_queue->submitPendingJobs();
+  ssh = m_queue->getDummySshCommand();
+  QCOMPARE(ssh->getDummyArgs().last(), QString("true"));
+  ssh->setDummyExitCode(0);
+  ssh->setDummyOutput("");
+  ssh->emitDummyRequestComplete(); // triggers connectionProbed
+  QCOMPARE(breaker.state(), CircuitBreaker::Closed);
+  QCOMPARE(breaker.consecutiveFailures(), 0);
+  QVERIFY(!breaker.retryTime().isValid());
+  QCOMPARE(m_queue->m_pendingSubmission.size(), 0);
+  QCOMPARE(m_queue->submissionsInProgress(), 1);
+  ssh = m_queue->getDummySshCommand();
+  QCOMPARE(ssh->getDummyCommand(), QString("scp"));
+  QCOMPARE(m_queue->status().value("connection").toHash()
+           .value("state").toString(), QString("closed"));
+
+  // Successful commands reach the host whatever their output says.
+  ssh->setDummyExitCode(0);
+  ssh->setDummyOutput("Connection refused");
+  QVERIFY(!m_queue->isConnectionFailure(ssh));
+  ssh->setDummyExitCode(1);
+  QVERIFY(m_queue->isConnectionFailure(ssh));
+  ssh->setDummyExitCode(255);
+  QVERIFY(m_queue->isConnectionFailure(ssh));
+  // The remote command may exit with 255 as well.
+  ssh->setDummyOutput("qsub: Permission denied");
+  QVERIFY(!m_queue->isConnectionFailure(ssh));
+
+  // Failures of the remote commands themselves count against the job.
+  ssh->setDummyExitCode(1);
+  ssh->setDummyOutput("scp: /some/path/x: Permission denied");
+  ssh->emitDummyRequestComplete(); // triggers inputFilesCopied
+  QCOMPARE(m_queue->jobFailureCount(job.moleQueueId()), 1);
+  QCOMPARE(breaker.state(), CircuitBreaker::Closed);
+  QCOMPARE(m_queue->submissionsInProgress(), 0);
+
+  m_queue->m_pendingSubmission.clear();
+  m_queue->m_jobs = savedJobs;
+  breaker.setFailureThreshold(savedThreshold);
+}
+
 QTEST_MAIN(QueueRemoteTest)
 
 #include "queueremotetest.moc"
@@ -0,0 +1,317 @@
+/******************************************************************************
+
+  This source file is part of the MoleQueue project.
+
+  Copyright 2012 Kitware, Inc.
+
+  This source code is released under the New BSD License, (the "License").
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+******************************************************************************/
+
+#include <QtTest>
+
+#include "queues/queuestatusparser.h"
+
+#include <QtCore/QRegExp>
+#include <QtCore/QStringList>
+
+using MoleQueue::IdType;
+using MoleQueue::JobState;
+using MoleQueue::QueueStatusParser;
+
+typedef QHash<IdType, JobState> StateHash;
+
+class QueueStatusParserTest : public QObject
+{
+  Q_OBJECT
+
+private:
+  /// @return A parser set up like the one in QueuePbs.
+  static QueueStatusParser pbsParser();
+  /// @return A parser set up like the one in QueueSge.
+  static QueueStatusParser sgeParser();
+
+  /// @return A synthetic qstat listing of @a jobs jobs in the format of
+  /// @a format ("pbs" or "sge").
+  static QString syntheticListing(const QString &format, int jobs);
+
+  /// Parse @a output one line at a time with a regular expression, the way
+  /// the PBS and SGE queues used to.
+  static void parseWithRegExp(const QString &output, const QString &format,
+                              StateHash *states);
+
+private slots:
+  void testParseLine();
+  void testJobIdSuffix();
+  void testParse();
+  void testSyntheticListing_data();
+  void testSyntheticListing();
+
+  void benchmarkParse_data();
+  void benchmarkParse();
+};
+
+QueueStatusParser QueueStatusParserTest::pbsParser()
+{
+  QueueStatusParser parser(0, 4);
+  parser.setAllowJobIdSuffix(true);
+  parser.addState("r", MoleQueue::RunningRemote);
+  parser.addState("e", MoleQueue::RunningRemote);
+  parser.addState("c", MoleQueue::RunningRemote);
+  parser.addState("q", MoleQueue::RemoteQueued);
+  parser.addState("h", MoleQueue::RemoteQueued);
+  parser.addState("t", MoleQueue::RemoteQueued);
+  parser.addState("w", MoleQueue::RemoteQueued);
+  parser.addState("s", MoleQueue::RemoteQueued);
+  return parser;
+}
+
+QueueStatusParser QueueStatusParserTest::sgeParser()
+{
+  QueueStatusParser parser(0, 4);
+  parser.addState("r", MoleQueue::RunningRemote);
+  parser.addState("d", MoleQueue::RunningRemote);
+  parser.addState("e", MoleQueue::RunningRemote);
+  parser.addState("qw", MoleQueue::RemoteQueued);
+  parser.addState("q", MoleQueue::RemoteQueued);
+  parser.addState("w", MoleQueue::RemoteQueued);
+  parser.addState("s", MoleQueue::RemoteQueued);
+  parser.addState("h", MoleQueue::RemoteQueued);
+  parser.addState("t", MoleQueue::RemoteQueued);
+  return parser;
+}
+
+QString QueueStatusParserTest::syntheticListing(const QString &format,
+                                                int jobs)
+{
+  QString output;
+  output.reserve(jobs * 90);
+  if (format == "pbs") {
+    const char *states[] = { "R", "Q", "H", "E", "C" };
+    output += "Job id           Name             User             Time Use S "
+        "Queue\n"
+        "---------------- ---------------- ---------------- -------- - "
+        "-----\n";
+    for (int i = 0; i < jobs; ++i) {
+      output += QString("%1.headnode    job%2         user%3           "
+                        "12:56:34 %4 batch\n").arg(i + 1).arg(i % 1000)
+          .arg(i % 10).arg(states[i % 5]);
+    }
+  }
+  else {
+    const char *states[] = { "r", "qw", "h", "d", "t" };
+    output += "job-ID  prior   name       user         state submit/start at"
+        "     queue                          slots ja-task-ID\n"
+        "----------------------------------------------------------------"
+        "-------------------------------------------------\n";
+    for (int i = 0; i < jobs; ++i) {
+      output += QString("%1 0.50500 job%2     user%3        %4     "
+                        "07/13/2012 20:27:15 all.q@node%5       1\n")
+          .arg(i + 1).arg(i % 1000).arg(i % 10).arg(states[i % 5])
+          .arg(i % 64);
+    }
+  }
+  return output;
+}
+
+void QueueStatusParserTest::parseWithRegExp(const QString &output,
+                                            const QString &format,
+                                            StateHash *states)
+{
+  foreach (const QString &line, output.split("\n", QString::SkipEmptyParts)) {
+    QRegExp parser(format == "pbs" ? "^\\s*(\\d+)\\S*\\s+\\S+\\s+\\S+\\s+\\S+"
+                                     "\\s+(\\w+)"
+                                   : "^\\s*(\\d+)\\s+\\S+\\s+\\S+\\s+\\S+"
+                                     "\\s+(\\w+)");
+    if (parser.indexIn(line) < 0)
+      continue;
+    bool ok;
+    const IdType queueId = static_cast<IdType>(parser.cap(1).toInt(&ok));
+    if (!ok)
+      continue;
+    const QString stateStr = parser.cap(2).toLower();
+    if (stateStr == "r" || stateStr == "e" || stateStr == "c" ||
+        stateStr == "d")
+      states->insert(queueId, MoleQueue::RunningRemote);
+    else
+      states->insert(queueId, MoleQueue::RemoteQueued);
+  }
+}
+
+void QueueStatusParserTest::testParseLine()
+{
+  QueueStatusParser parser = sgeParser();
+  IdType queueId = MoleQueue::InvalidId;
+  JobState state = MoleQueue::Unknown;
+  QStringRef stateCode;
+
+  // Headers, separators and continuation lines
+  QCOMPARE(parser.parseLine("job-ID  prior   name  user  state submit/start at",
+                            &queueId, &state), QueueStatusParser::NoJob);
+  QCOMPARE(parser.parseLine("--------------------------------------",
+                            &queueId, &state), QueueStatusParser::NoJob);
+  QCOMPARE(parser.parseLine("                          20:27:15",
+                            &queueId, &state), QueueStatusParser::NoJob);
+  QCOMPARE(parser.parseLine("", &queueId, &state), QueueStatusParser::NoJob);
+  // Too few columns
+  QCOMPARE(parser.parseLine("231 0 hydra craig", &queueId, &state),
+           QueueStatusParser::NoJob);
+  // Job ids that do not fit an IdType
+  QCOMPARE(parser.parseLine("99999999999999999999999 0 hydra craig r",
+                            &queueId, &state), QueueStatusParser::NoJob);
+  QCOMPARE(queueId, MoleQueue::InvalidId);
+
+  // State codes are case insensitive. The state code refers to the line, so
+  // keep it alive.
+  QString line = "  231  0  hydra  craig  R  07/13/96";
+  QCOMPARE(parser.parseLine(line, &queueId, &state, &stateCode),
+           QueueStatusParser::KnownState);
+  QCOMPARE(queueId, static_cast<IdType>(231));
+  QCOMPARE(state, MoleQueue::RunningRemote);
+  QCOMPARE(stateCode.toString(), QString("R"));
+
+  line = "232\t0\thydra\tcraig\tqw\t07/13/96";
+  QCOMPARE(parser.parseLine(line, &queueId, &state, &stateCode),
+           QueueStatusParser::KnownState);
+  QCOMPARE(queueId, static_cast<IdType>(232));
+  QCOMPARE(state, MoleQueue::RemoteQueued);
+  QCOMPARE(stateCode.toString(), QString("qw"));
+
+  // Unknown states are reported with the id and the code
+  state = MoleQueue::Unknown;
+  line = "233 0 hydra craig inv 07/13/96";
+  QCOMPARE(parser.parseLine(line, &queueId, &state, &stateCode),
+           QueueStatusParser::UnknownState);
+  QCOMPARE(queueId, static_cast<IdType>(233));
+  QCOMPARE(state, MoleQueue::Unknown);
+  QCOMPARE(stateCode.toString(), QString("inv"));
+
+  // Only the part of the line between begin and end is parsed.
+  const QString text = "xx234 0 hydra craig h\n";
+  QCOMPARE(parser.parseLine(text, 2, text.size() - 1, &queueId, &state),
+           QueueStatusParser::KnownState);
+  QCOMPARE(queueId, static_cast<IdType>(234));
+  QCOMPARE(parser.parseLine(text, 2, 18, &queueId, &state),
+           QueueStatusParser::NoJob);
+}
+
+void QueueStatusParserTest::testJobIdSuffix()
+{
+  QueueStatusParser parser(0, 1);
+  parser.addState("R", MoleQueue::RunningRemote);
+  QVERIFY(!parser.allowJobIdSuffix());
+
+  IdType queueId;
+  JobState state;
+  QCOMPARE(parser.parseLine("4807.headnode R", &queueId, &state),
+           QueueStatusParser::NoJob);
+  QCOMPARE(parser.parseLine("4807 R", &queueId, &state),
+           QueueStatusParser::KnownState);
+
+  parser.setAllowJobIdSuffix(true);
+  QVERIFY(parser.allowJobIdSuffix());
+  QCOMPARE(parser.parseLine("4808.headnode R", &queueId, &state),
+           QueueStatusParser::KnownState);
+  QCOMPARE(queueId, static_cast<IdType>(4808));
+  QCOMPARE(parser.parseLine("headnode.4809 R", &queueId, &state),
+           QueueStatusParser::NoJob);
+}
+
+void QueueStatusParserTest::testParse()
+{
+  QueueStatusParser parser = pbsParser();
+  const QString output =
+      "Job id           Name             User             Time Use S Queue\n"
+      "---------------- ---------------- ---------------- -------- - -----\n"
+      "4807.host        scatter          user01           12:56:34 R batch\n"
+      "4808.host        scatter          user01           0        Q batch\n"
+      "4809.host        scatter          user01           0        I batch\r\n"
+      "4808.host        scatter          user01           00:00:01 R batch\r\n"
+      "\n"
+      "4810.host        scatter          user01           0        H batch";
+
+  StateHash states;
+  QStringList unknownLines;
+  parser.parse(output, &states, &unknownLines);
+
+  QCOMPARE(states.size(), 3);
+  QCOMPARE(states.value(4807), MoleQueue::RunningRemote);
+  // The last line wins
+  QCOMPARE(states.value(4808), MoleQueue::RunningRemote);
+  QCOMPARE(states.value(4810), MoleQueue::RemoteQueued);
+  QVERIFY(!states.contains(4809));
+
+  QCOMPARE(unknownLines.size(), 1);
+  QVERIFY(unknownLines.first().startsWith("4809.host"));
+
+  // The unknown lines are optional
+  states.clear();
+  parser.parse(output, &states);
+  QCOMPARE(states.size(), 3);
+}
+
+void QueueStatusParserTest::testSyntheticListing_data()
+{
+  QTest::addColumn<QString>("format");
+
+  QTest::newRow("pbs") << "pbs";
+  QTest::newRow("sge") << "sge";
+}
+
+void QueueStatusParserTest::testSyntheticListing()
+{
+  QFETCH(QString, format);
+
+  // The parser agrees with the regular expressions it replaces.
+  const QString output = syntheticListing(format, 1000);
+  StateHash expected;
+  parseWithRegExp(output, format, &expected);
+  QCOMPARE(expected.size(), 1000);
+
+  StateHash states;
+  QStringList unknownLines;
+  (format == "pbs" ? pbsParser() : sgeParser()).parse(output, &states,
+                                                      &unknownLines);
+  QVERIFY(unknownLines.isEmpty());
+  QVERIFY(states == expected);
+}
+
+void QueueStatusParserTest::benchmarkParse_data()
+{
+  QTest::addColumn<QString>("format");
+  QTest::addColumn<bool>("useRegExp");
+
+  QTest::newRow("pbs, regexp per line") << "pbs" << true;
+  QTest::newRow("pbs, table driven") << "pbs" << false;
+  QTest::newRow("sge, regexp per line") << "sge" << true;
+  QTest::newRow("sge, table driven") << "sge" << false;
+}
+
+void QueueStatusParserTest::benchmarkParse()
+{
+  QFETCH(QString, format);
+  QFETCH(bool, useRegExp);
+
+  const QString output = syntheticListing(format, 50000);
+  const QueueStatusParser parser = format == "pbs" ? pbsParser()
+                                                   : sgeParser();
+  StateHash states;
+  QBENCHMARK {
+    states.clear();
+    if (useRegExp)
+      parseWithRegExp(output, format, &states);
+    else
+      parser.parse(output, &states);
+  }
+  QCOMPARE(states.size(), 50000);
+}
+
+QTEST_MAIN(QueueStatusParserTest)
+
+#include "queuestatusparsertest.moc"
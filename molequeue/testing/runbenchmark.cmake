@@ -0,0 +1,7 @@
+# Run the test functions FUNCTIONS of the test executable BENCHMARK with the
+# heavy benchmark rows enabled.
+set(ENV{MOLEQUEUE_BENCHMARK} 1)
+execute_process(COMMAND ${BENCHMARK} ${FUNCTIONS} RESULT_VARIABLE result)
+if(result)
+  message(FATAL_ERROR "${BENCHMARK} failed.")
+endif()
@@ -18,6 +18,8 @@
 
 #include "queues/sge.h"
 
+#include <QtCore/QFile>
+
 class QueueSgeTest : public QObject
 {
   Q_OBJECT
@@ -38,6 +40,7 @@ private slots:
   void sanityCheck();
   void testParseJobId();
   void testParseQueueLine();
+  void testParseStructuredQueueOutput();
 };
 
 void QueueSgeTest::initTestCase()
@@ -148,6 +151,67 @@ void QueueSgeTest::testParseQueueLine()
 
 }
 
+void QueueSgeTest::testParseStructuredQueueOutput()
+{
+  QVERIFY(m_queue.supportsStructuredQueueStatus());
+  m_queue.setUserName("craig");
+  m_queue.setUseStructuredQueueStatus(true);
+  QCOMPARE(m_queue.generateQueueRequestCommand(QList<MoleQueue::IdType>()),
+           QString("qstat -xml -u craig"));
+  m_queue.setUseStructuredQueueStatus(false);
+  QCOMPARE(m_queue.generateQueueRequestCommand(QList<MoleQueue::IdType>()),
+           QString("qstat -u craig"));
+
+  QFile file(TESTDATADIR "qstat-ref/sge-qstat-xml.xml");
+  QVERIFY(file.open(QFile::ReadOnly | QFile::Text));
+  const QString output = QString::fromLatin1(file.readAll());
+
+  QHash<MoleQueue::IdType, MoleQueue::QueueJobStatus> statuses;
+  QVERIFY(m_queue.parseStructuredQueueOutput(output, &statuses));
+  QCOMPARE(statuses.size(), 4);
+
+  MoleQueue::QueueJobStatus status = statuses.value(231);
+  QCOMPARE(status.state, MoleQueue::RunningRemote);
+  QVERIFY(!status.hasExitStatus);
+  QVERIFY(status.wallTimeUsed > 0);
+  QCOMPARE(status.nodes, QStringList() << "node01.cluster");
+
+  // Combined states fall back to the list the job is in.
+  QCOMPARE(statuses.value(232).state, MoleQueue::RunningRemote);
+  QCOMPARE(statuses.value(232).nodes, QStringList() << "node02.cluster");
+  QCOMPARE(statuses.value(237).state, MoleQueue::RemoteQueued);
+
+  status = statuses.value(236);
+  QCOMPARE(status.state, MoleQueue::RemoteQueued);
+  QCOMPARE(status.wallTimeUsed, -1);
+  QVERIFY(status.nodes.isEmpty());
+
+  // Start times with an offset do not depend on the local time zone.
+  const QDateTime started = QDateTime::currentDateTimeUtc().addSecs(-7200);
+  const QString format("yyyy-MM-dd'T'HH:mm:ss");
+  const QString jobTemplate =
+      "<job_list state=\"running\"><JB_job_number>%1</JB_job_number>"
+      "<state>r</state><JAT_start_time>%2</JAT_start_time></job_list>";
+  const QString offsetOutput = QString("<job_info><queue_info>%1%2%3"
+                                       "</queue_info></job_info>")
+      .arg(jobTemplate.arg(301).arg(started.addSecs(-(9 * 60 + 30) * 60)
+                                    .toString(format) + "-09:30"))
+      .arg(jobTemplate.arg(302).arg(started.addSecs(13 * 3600)
+                                    .toString(format) + "+1300"))
+      .arg(jobTemplate.arg(303).arg(started.toString(format) + ".000Z"));
+  statuses.clear();
+  QVERIFY(m_queue.parseStructuredQueueOutput(offsetOutput, &statuses));
+  QCOMPARE(statuses.size(), 3);
+  for (MoleQueue::IdType id = 301; id <= 303; ++id) {
+    QVERIFY(statuses.value(id).wallTimeUsed >= 7200);
+    QVERIFY(statuses.value(id).wallTimeUsed < 7200 + 60);
+  }
+
+  // Truncated output is an error.
+  QVERIFY(!m_queue.parseStructuredQueueOutput(output.left(output.size() / 2),
+                                              &statuses));
+}
+
 QTEST_MAIN(QueueSgeTest)
 
 #include "sgetest.moc"
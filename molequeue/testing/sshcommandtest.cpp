@@ -18,6 +18,10 @@
 
 #include "dummysshcommand.h"
 
+#include <QtCore/QDir>
+
+using MoleQueue::SshCommand;
+
 class SshCommandTest : public QObject
 {
   Q_OBJECT
@@ -40,7 +44,11 @@ private slots:
   void testCopyTo();
   void testCopyFrom();
   void testCopyDirTo();
+  void testCopyDirsTo();
   void testCopyDirFrom();
+  void testCopyDirToArchive();
+  void testCopyDirsToArchive();
+  void testCopyDirFromArchive();
 };
 
 void SshCommandTest::initTestCase()
@@ -58,6 +66,7 @@ void SshCommandTest::init()
   m_ssh.setHostName("host");
   m_ssh.setUserName("user");
   m_ssh.setPortNumber(22);
+  m_ssh.setDirectoryTransferMode(SshCommand::ScpTransfer);
 }
 
 void SshCommandTest::cleanup()
@@ -118,6 +127,21 @@ void SshCommandTest::testCopyDirTo()
            << QString("user@host:/remote/path"));
 }
 
+void SshCommandTest::testCopyDirsTo()
+{
+  QVERIFY(!m_ssh.copyDirsTo(QStringList(), "/remote/path"));
+  QVERIFY(m_ssh.copyDirsTo(QStringList() << "C:/local/1" << "C:/local/2",
+                           "/remote/path"));
+  QCOMPARE(m_ssh.getDummyCommand(), QString("scp"));
+  QCOMPARE(m_ssh.getDummyArgs(), QStringList ()
+           << QString("-q")
+           << QString("-S") << QString("ssh")
+           << QString("-r")
+           << QString("C:/local/1")
+           << QString("C:/local/2")
+           << QString("user@host:/remote/path"));
+}
+
 void SshCommandTest::testCopyDirFrom()
 {
   m_ssh.copyDirFrom("/remote/path", "C:/local/path");
@@ -130,6 +154,59 @@ void SshCommandTest::testCopyDirFrom()
            << QString("C:/local/path"));
 }
 
+void SshCommandTest::testCopyDirToArchive()
+{
+  m_ssh.setDirectoryTransferMode(SshCommand::CompressedTarTransfer);
+  m_ssh.copyDirTo("/local/path", "/remote/path");
+  QCOMPARE(m_ssh.getDummyCommand(), QString("ssh"));
+  QCOMPARE(m_ssh.getDummyArgs(), QStringList ()
+           << QString("-q")
+           << QString("user@host")
+           << QString("mkdir -p /remote/path && tar -C /remote/path -xzf -"));
+  QVERIFY(m_ssh.getDummyArchiveUpload());
+  QCOMPARE(m_ssh.getDummyArchiveArgs(), QStringList ()
+           << QString("-C") << QString("/local/path")
+           << QString("-czf") << QString("-")
+           << QString("."));
+}
+
+void SshCommandTest::testCopyDirsToArchive()
+{
+  m_ssh.setDirectoryTransferMode(SshCommand::TarTransfer);
+  m_ssh.copyDirsTo(QStringList() << "/local/1" << "/local//2",
+                   "/remote/path");
+  QCOMPARE(m_ssh.getDummyCommand(), QString("ssh"));
+  QCOMPARE(m_ssh.getDummyArgs(), QStringList ()
+           << QString("-q")
+           << QString("user@host")
+           << QString("mkdir -p /remote/path && tar -C /remote/path -xf -"));
+  QCOMPARE(m_ssh.getDummyArchiveArgs(), QStringList ()
+           << QString("-C") << QString("/local")
+           << QString("-cf") << QString("-")
+           << QString("1") << QString("2"));
+
+  // Directories without a common parent fall back to scp
+  m_ssh.copyDirsTo(QStringList() << "/local/1" << "/other/2", "/remote/path");
+  QCOMPARE(m_ssh.getDummyCommand(), QString("scp"));
+  QVERIFY(m_ssh.getDummyArchiveArgs().isEmpty());
+}
+
+void SshCommandTest::testCopyDirFromArchive()
+{
+  const QString localDir = QDir::tempPath();
+  m_ssh.setDirectoryTransferMode(SshCommand::TarTransfer);
+  m_ssh.copyDirFrom("/remote/path/4/", localDir);
+  QCOMPARE(m_ssh.getDummyCommand(), QString("ssh"));
+  QCOMPARE(m_ssh.getDummyArgs(), QStringList ()
+           << QString("-q")
+           << QString("user@host")
+           << QString("tar -C /remote/path -cf - 4"));
+  QVERIFY(!m_ssh.getDummyArchiveUpload());
+  QCOMPARE(m_ssh.getDummyArchiveArgs(), QStringList ()
+           << QString("-C") << localDir
+           << QString("-xf") << QString("-"));
+}
+
 QTEST_MAIN(SshCommandTest)
 
 #include "sshcommandtest.moc"
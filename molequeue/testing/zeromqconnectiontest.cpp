@@ -18,7 +18,13 @@
 
 #include "client.h"
 #include "connectiontest.h"
+#include "testserver.h"
+#include "transport/message.h"
 #include "transport/zeromq/zeromqclient.h"
+#include "transport/zeromq/zeromqconnection.h"
+
+#include <QtCore/QDir>
+#include <QtCore/QElapsedTimer>
 
 class ZeroMqConnectionTest: public ConnectionTest
 {
@@ -26,6 +32,25 @@ class ZeroMqConnectionTest: public ConnectionTest
 protected:
   MoleQueue::Client *createClient();
 
+private:
+  /// Create a connected ROUTER/DEALER pair. The caller owns both.
+  void createConnectionPair(MoleQueue::ZeroMqConnection *&server,
+                            MoleQueue::ZeroMqConnection *&client);
+
+  MoleQueue::ZeroMqConnection *m_echoConnection;
+  int m_messageCount;
+  qint64 m_byteCount;
+  MoleQueue::PacketType m_lastPacket;
+
+private slots:
+  void messageReceived(const MoleQueue::Message msg);
+
+  void testBinaryPayload_data();
+  void testBinaryPayload();
+  void testLatency();
+  void testThroughput_data();
+  void testThroughput();
+  void testUnstartedConnection();
 };
 
 MoleQueue::Client *ZeroMqConnectionTest::createClient()
@@ -33,6 +58,159 @@ MoleQueue::Client *ZeroMqConnectionTest::createClient()
   return new MoleQueue::ZeroMqClient(this);
 }
 
+void ZeroMqConnectionTest::createConnectionPair(
+    MoleQueue::ZeroMqConnection *&server, MoleQueue::ZeroMqConnection *&client)
+{
+  const QString address = "ipc://" + QDir::tempPath() + "/"
+      + MoleQueue::ZeroMqConnection::zeroMqPrefix + "_"
+      + TestServer::getRandomSocketName();
+
+  zmq::context_t *context = new zmq::context_t(1);
+  zmq::socket_t *socket = new zmq::socket_t(*context, ZMQ_ROUTER);
+  socket->bind(address.toLocal8Bit().constData());
+  server = new MoleQueue::ZeroMqConnection(NULL, context, socket);
+
+  client = new MoleQueue::ZeroMqConnection(NULL, address);
+  client->open();
+
+  m_echoConnection = NULL;
+  m_messageCount = 0;
+  m_byteCount = 0;
+  m_lastPacket.clear();
+}
+
+void ZeroMqConnectionTest::messageReceived(const MoleQueue::Message msg)
+{
+  ++m_messageCount;
+  m_byteCount += msg.data().size();
+  m_lastPacket = msg.data();
+
+  if (m_echoConnection && sender() == m_echoConnection)
+    m_echoConnection->send(MoleQueue::Message(msg.replyTo(), msg.data()));
+}
+
+void ZeroMqConnectionTest::testBinaryPayload_data()
+{
+  QTest::addColumn<int>("payloadSize");
+
+  QTest::newRow("empty") << 0;
+  QTest::newRow("256 bytes") << 256;
+  QTest::newRow("16 MB") << 16 * 1024 * 1024;
+}
+
+void ZeroMqConnectionTest::testBinaryPayload()
+{
+  QFETCH(int, payloadSize);
+
+  MoleQueue::ZeroMqConnection *server = NULL;
+  MoleQueue::ZeroMqConnection *client = NULL;
+  createConnectionPair(server, client);
+
+  // Send from the client to the server, which echoes it back.
+  m_echoConnection = server;
+  connect(server, SIGNAL(newMessage(const MoleQueue::Message)),
+          this, SLOT(messageReceived(const MoleQueue::Message)));
+  connect(client, SIGNAL(newMessage(const MoleQueue::Message)),
+          this, SLOT(messageReceived(const MoleQueue::Message)));
+  server->start();
+  client->start();
+
+  // Every byte value, including embedded nulls and sequences that are not
+  // valid in any text encoding.
+  MoleQueue::PacketType payload(payloadSize, '\0');
+  for (int i = 0; i < payloadSize; ++i)
+    payload[i] = static_cast<char>((i * 7 + i / 256) & 0xff);
+
+  client->send(MoleQueue::Message(payload));
+
+  QElapsedTimer timer;
+  timer.start();
+  while (m_messageCount < 2 && timer.elapsed() < 30000)
+    qApp->processEvents(QEventLoop::AllEvents, 100);
+
+  delete client;
+  delete server;
+
+  QCOMPARE(m_messageCount, 2);
+  QCOMPARE(m_byteCount, 2 * static_cast<qint64>(payloadSize));
+  QVERIFY(m_lastPacket == payload);
+}
+
+void ZeroMqConnectionTest::testLatency()
+{
+  MoleQueue::ZeroMqConnection *server = NULL;
+  MoleQueue::ZeroMqConnection *client = NULL;
+  createConnectionPair(server, client);
+
+  // The server echoes each message back to the client.
+  m_echoConnection = server;
+  connect(server, SIGNAL(newMessage(const MoleQueue::Message)),
+          this, SLOT(messageReceived(const MoleQueue::Message)));
+  connect(client, SIGNAL(newMessage(const MoleQueue::Message)),
+          this, SLOT(messageReceived(const MoleQueue::Message)));
+  server->start();
+  client->start();
+
+  const int roundTrips = 200;
+  const MoleQueue::PacketType payload(128, 'x');
+
+  QElapsedTimer timer;
+  timer.start();
+  for (int i = 1; i <= roundTrips; ++i) {
+    client->send(MoleQueue::Message(payload));
+    // Each round trip is counted by both the server and the client.
+    while (m_messageCount < 2 * i && timer.elapsed() < 30000)
+      qApp->processEvents(QEventLoop::AllEvents, 100);
+    QCOMPARE(m_messageCount, 2 * i);
+  }
+  const qint64 elapsed = qMax(timer.elapsed(), Q_INT64_C(1));
+
+  delete client;
+  delete server;
+
+  // Only reported, as wall clock times vary too much between machines.
+  qDebug() << "Round trip latency:"
+           << static_cast<double>(elapsed) / roundTrips << "ms,"
+           << roundTrips * 1000.0 / elapsed << "round trips/sec";
+}
+
+void ZeroMqConnectionTest::testThroughput_data()
+{
+  addThroughputRows();
+}
+
+void ZeroMqConnectionTest::testThroughput()
+{
+  QFETCH(int, messageCount);
+  QFETCH(int, messageSize);
+
+  MoleQueue::ZeroMqConnection *server = NULL;
+  MoleQueue::ZeroMqConnection *client = NULL;
+  createConnectionPair(server, client);
+  server->start();
+  client->start();
+
+  measureThroughput(client, server, messageCount, messageSize);
+
+  delete client;
+  delete server;
+}
+
+void ZeroMqConnectionTest::testUnstartedConnection()
+{
+  // Connections that were never started must still close their sockets, or
+  // terminating the context blocks forever.
+  MoleQueue::ZeroMqConnection *server = NULL;
+  MoleQueue::ZeroMqConnection *client = NULL;
+  createConnectionPair(server, client);
+
+  QElapsedTimer timer;
+  timer.start();
+  delete client;
+  delete server;
+  QVERIFY(timer.elapsed() < 5000);
+}
+
 QTEST_MAIN(ZeroMqConnectionTest)
 
 #include "zeromqconnectiontest.moc"
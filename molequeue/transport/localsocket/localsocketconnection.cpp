@@ -22,21 +22,34 @@
 
 #include <QtCore/QDateTime>
 #include <QtCore/QDebug>
+#include <QtCore/QtEndian>
 #include <QtNetwork/QLocalSocket>
 
+namespace {
+// The wire format of a packet is the header version, the packet size and the
+// packet size again (as QDataStream serializes a byte array), all as
+// big-endian 32-bit unsigned integers, followed by the packet data.
+const quint32 headerSize = 3 * sizeof(quint32);
+// QDataStream's length for a null QByteArray
+const quint32 nullBlockSize = 0xffffffff;
+}
+
 namespace MoleQueue
 {
 
+const quint32 LocalSocketConnection::maxPacketSize;
+
 LocalSocketConnection::LocalSocketConnection(QObject *parentObject,
                                              QLocalSocket *socket)
   : Connection(parentObject),
     m_connectionString(socket->serverName()),
     m_socket(NULL),
     m_headerVersion(1),
-    m_headerSize(sizeof(quint32) + sizeof(quint32)),
-    m_currentPacketSize(0),
+    m_headerSize(headerSize),
+    m_headerRead(false),
+    m_currentPacketPos(0),
     m_currentPacket(),
-    m_dataStream(new QDataStream ()),
+    m_flushPending(false),
     m_holdRequests(true)
 {
   setSocket(socket);
@@ -48,10 +61,11 @@ LocalSocketConnection::LocalSocketConnection(QObject *parentObject,
     m_connectionString(serverName),
     m_socket(NULL),
     m_headerVersion(1),
-    m_headerSize(sizeof(quint32) + sizeof(quint32)),
-    m_currentPacketSize(0),
+    m_headerSize(headerSize),
+    m_headerRead(false),
+    m_currentPacketPos(0),
     m_currentPacket(),
-    m_dataStream(new QDataStream ()),
+    m_flushPending(false),
     m_holdRequests(true)
 {
   setSocket(new QLocalSocket());
@@ -64,10 +78,6 @@ LocalSocketConnection::~LocalSocketConnection()
 
   delete m_socket;
   m_socket = NULL;
-
-  delete m_dataStream;
-  m_dataStream = NULL;
-
 }
 
 void LocalSocketConnection::setSocket(QLocalSocket *socket)
@@ -86,89 +96,131 @@ void LocalSocketConnection::setSocket(QLocalSocket *socket)
     connect(socket, SIGNAL(destroyed()),
             this, SLOT(socketDestroyed()));
   }
-  m_dataStream->setDevice(socket);
   m_socket = socket;
+  m_headerRead = false;
+  m_currentPacketPos = 0;
+  m_currentPacket = PacketType();
 }
 
 void LocalSocketConnection::readSocket()
 {
-  if(!m_socket->isValid())
-    return;
-
-  if (m_holdRequests) {
+  if (m_holdRequests)
     return;
-  }
 
-  // Check if the data is a new packet or if we're in the middle of reading one.
-  if (m_currentPacketSize == 0) {
-
-    // Read header info (e.g. packet size) if enough data is available.
-    // Otherwise, wait for more data.
-    if (canReadPacketHeader())
-      m_currentPacketSize = readPacketHeader();
-    else
+  // Handle every complete packet that is available.
+  forever {
+    if (!m_socket || !m_socket->isValid())
       return;
-  }
 
-  PacketType block;
-  (*m_dataStream) >> block;
+    // Check if the data is a new packet or if we're in the middle of reading
+    // one. Wait for more data if the header is incomplete.
+    if (!m_headerRead && !readPacketHeader())
+      return;
 
-  // Add this block to the packet which is in progress
-  m_currentPacket.append(block);
+    // Read directly into the space allocated for the packet.
+    const int remaining = m_currentPacket.size() - m_currentPacketPos;
+    if (remaining > 0) {
+      const qint64 bytesRead = m_socket->read(
+            m_currentPacket.data() + m_currentPacketPos, remaining);
+      if (bytesRead <= 0)
+        return;
+      m_currentPacketPos += static_cast<int>(bytesRead);
+      if (m_currentPacketPos < m_currentPacket.size())
+        return;
+    }
 
-  // Are we done?
-  if (static_cast<qint64>(m_currentPacket.size()) == m_currentPacketSize) {
+    // The packet is complete. Hand the buffer over to the message and reset
+    // the state before emitting, in case a receiver reenters the event loop.
     Message msg(m_currentPacket);
+    m_currentPacket = PacketType();
+    m_currentPacketPos = 0;
+    m_headerRead = false;
     emit newMessage(msg);
-    m_currentPacket.clear();
-    m_currentPacketSize = 0;
-
-    // if there are more bytes available call again
-    if(m_socket->bytesAvailable())
-      readSocket();
-
   }
 }
 
-void LocalSocketConnection::writePacketHeader(const PacketType &packet)
+void LocalSocketConnection::flushSocket()
 {
-  // First write a version identifier
-  (*m_dataStream) << m_headerVersion;
-
-  // Next is the packet size as 32-bit unsigned integer
-  (*m_dataStream) << static_cast<quint32>(packet.size());
+  m_flushPending = false;
+  if (m_socket)
+    m_socket->flush();
 }
 
-void LocalSocketConnection::send(const Message &msg)
+void LocalSocketConnection::writePacketHeader(const PacketType &packet)
 {
-  writePacketHeader(msg.data());
-  m_dataStream->writeBytes(msg.data().constData(),
-                           static_cast<unsigned int>(msg.data().size()));
-  m_socket->flush();
+  const quint32 packetSize = static_cast<quint32>(packet.size());
+  uchar header[headerSize];
+  qToBigEndian<quint32>(m_headerVersion, header);
+  qToBigEndian<quint32>(packetSize, header + sizeof(quint32));
+  qToBigEndian<quint32>(packetSize, header + 2 * sizeof(quint32));
+  m_socket->write(reinterpret_cast<const char*>(header), headerSize);
 }
 
-bool LocalSocketConnection::canReadPacketHeader()
+void LocalSocketConnection::send(const Message &msg)
 {
-  return (m_socket->bytesAvailable() >= m_headerSize);
-}
+  if (!m_socket)
+    return;
 
-quint32 LocalSocketConnection::readPacketHeader()
-{
-  Q_ASSERT_X(m_socket->bytesAvailable() >= m_headerSize, Q_FUNC_INFO,
-             "Not enough data available to read header! This should not "
-             "happen.");
+  // The header and payload are appended to the socket's write buffer and go
+  // out together. The flush is deferred so that back-to-back sends are
+  // written with as few system calls as possible.
+  const PacketType packet = msg.data();
+  if (static_cast<quint32>(packet.size()) > maxPacketSize) {
+    qWarning() << "Refusing to send a packet of" << packet.size()
+               << "bytes on" << m_connectionString << "- the limit is"
+               << maxPacketSize << "bytes.";
+    return;
+  }
+  writePacketHeader(packet);
+  m_socket->write(packet);
 
-  quint32 headerVersion;
-  quint32 packetSize;
+  if (!m_flushPending) {
+    m_flushPending = true;
+    QMetaObject::invokeMethod(this, "flushSocket", Qt::QueuedConnection);
+  }
+}
 
-  (*m_dataStream) >> headerVersion;
+bool LocalSocketConnection::readPacketHeader()
+{
+  if (m_socket->bytesAvailable() < m_headerSize)
+    return false;
 
-  if (headerVersion != m_headerVersion)
-    return 0;
+  uchar header[headerSize];
+  if (m_socket->read(reinterpret_cast<char*>(header), headerSize) !=
+      static_cast<qint64>(headerSize)) {
+    return false;
+  }
 
-  (*m_dataStream) >> packetSize;
+  const quint32 headerVersion = qFromBigEndian<quint32>(header);
+  const quint32 packetSize = qFromBigEndian<quint32>(header + sizeof(quint32));
+  const quint32 blockSize =
+      qFromBigEndian<quint32>(header + 2 * sizeof(quint32));
+
+  const bool blockSizeValid = blockSize == packetSize ||
+      (blockSize == nullBlockSize && packetSize == 0);
+  if (headerVersion == m_headerVersion && blockSizeValid &&
+      packetSize > maxPacketSize) {
+    // Don't allocate the packet, and don't read it only to discard it either,
+    // as the stream cannot be resynchronized cheaply afterwards.
+    qWarning() << "Packet of" << packetSize << "bytes received on"
+               << m_connectionString << "exceeds the limit of"
+               << maxPacketSize << "bytes - closing the connection.";
+    close();
+    return false;
+  }
+  if (headerVersion != m_headerVersion || !blockSizeValid) {
+    // There is no way to find the start of the next packet, so drop
+    // everything that has been received.
+    qWarning() << "Invalid packet header received on" << m_connectionString
+               << "- discarding" << m_socket->bytesAvailable() << "bytes.";
+    m_socket->readAll();
+    return false;
+  }
 
-  return packetSize;
+  m_currentPacket.resize(static_cast<int>(packetSize));
+  m_currentPacketPos = 0;
+  m_headerRead = true;
+  return true;
 }
 
 void LocalSocketConnection::open()
@@ -187,14 +239,15 @@ void LocalSocketConnection::start()
 {
   if (m_socket) {
     m_holdRequests = false;
-    while (m_socket->bytesAvailable() != 0)
-      readSocket();
+    readSocket();
   }
 }
 
 void LocalSocketConnection::close()
 {
   if(m_socket) {
+    if (m_flushPending)
+      flushSocket();
     if(m_socket->isOpen()) {
       m_socket->disconnectFromServer();
       m_socket->close();
@@ -28,12 +28,18 @@ namespace MoleQueue
  * @class LocalSocketConnection localsocketconnection.h <molequeue/ipc/localsocketconnection.h>
  * @brief Provides a implementation of @Connection using QLocalSockets. Each instance
  * of the class wraps a QLocalSocket.
+ *
+ * Packets are limited to maxPacketSize bytes. Larger packets are refused by
+ * send(), and a connection that announces one is closed.
  */
 class LocalSocketConnection : public Connection
 {
   Q_OBJECT
 public:
 
+  /// The largest packet in bytes that can be sent or received (64 MB).
+  static const quint32 maxPacketSize = 64 * 1024 * 1024;
+
   /**
    * Constructor used by @LocalSocketConnectionListener to create a new connection
    * based on an existing QLocalSocket.
@@ -72,7 +78,7 @@ public:
 
   /**
    * Send a message on the connection, write the bytes to the sockets
-   * data stream.
+   * data stream. Messages larger than maxPacketSize are not sent.
    *
    * @packet The message to send.
    *
@@ -109,6 +115,12 @@ private slots:
    */
   void readSocket();
 
+  /**
+   * Flush data written by send() to the socket. Scheduled once for any number
+   * of back-to-back sends.
+   */
+  void flushSocket();
+
   /**
    * Called when the underlying QLocalSocket is destroyed. This happens when
    * the connection listener associated with it is deleted.
@@ -125,21 +137,17 @@ private:
   void setSocket(QLocalSocket *socket);
 
   /**
-   * Read the data header containing the packet size and protocol version from
-   * the socket.
+   * Read the data header containing the protocol version and packet size from
+   * the socket, and allocate m_currentPacket to hold the packet. The
+   * connection is closed if the packet is larger than maxPacketSize.
    *
-   * @return The size of incoming packet in bytes.
+   * @return True if a complete, valid header has been read.
    */
-  quint32 readPacketHeader();
+  bool readPacketHeader();
 
   /**
-   * @return Whether or not the socket header is complete and ready to read.
-   */
-  bool canReadPacketHeader();
-
-  /**
-   * Write a data header containing the packet size and protocol version to the
-   * socket.
+   * Write the data header containing the protocol version and packet size for
+   * @a packet to the socket.
    *
    * @param packet The packet
    */
@@ -157,14 +165,18 @@ private:
   /// Size of the packet header
   const quint32 m_headerSize;
 
-  /// The size of the currently read packet
-  quint32 m_currentPacketSize;
+  /// True once the header of the packet currently being read has been read.
+  bool m_headerRead;
+
+  /// Number of bytes of m_currentPacket that have been read.
+  int m_currentPacketPos;
 
-  /// The packet currently being read
+  /// The packet currently being read, allocated to its full size from the
+  /// header.
   PacketType m_currentPacket;
 
-  /// The data stream used to interface with the local socket
-  QDataStream *m_dataStream;
+  /// True if a call to flushSocket() has been scheduled.
+  bool m_flushPending;
 
   /// If true, do not read incoming packets from the socket. This is to let
   /// the parent server create connections prior to processing requests.
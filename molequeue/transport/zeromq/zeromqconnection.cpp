@@ -16,7 +16,18 @@
 
 #include "zeromqconnection.h"
 
-#include <QtCore/QTimer>
+#include <QtCore/QSocketNotifier>
+
+namespace {
+
+// zmq_free_fn releasing the QByteArray that owns a zmq::message_t's data.
+void releaseByteArray(void *data, void *hint)
+{
+  Q_UNUSED(data)
+  delete static_cast<QByteArray*>(hint);
+}
+
+}
 
 namespace MoleQueue
 {
@@ -31,11 +42,8 @@ ZeroMqConnection::ZeroMqConnection(QObject *parentObject,
   m_context(context),
   m_socket(socket),
   m_connected(true),
-  m_listener(new QTimer())
+  m_notifier(NULL)
 {
-  connect(m_listener, SIGNAL(timeout()),
-          this, SLOT(listen()));
-
   std::size_t socketTypeSize = sizeof(m_socketType);
   m_socket->getsockopt(ZMQ_TYPE, &m_socketType, &socketTypeSize);
 }
@@ -47,22 +55,20 @@ ZeroMqConnection::ZeroMqConnection(QObject *parentObject, const QString &address
   m_context(new zmq::context_t(1)),
   m_socket(new zmq::socket_t(*m_context, ZMQ_DEALER)),
   m_connected(false),
-  m_listener(new QTimer())
+  m_notifier(NULL)
 {
-  connect(m_listener, SIGNAL(timeout()),
-          this, SLOT(listen()));
   m_socketType = ZMQ_DEALER;
 }
 
 ZeroMqConnection::~ZeroMqConnection()
 {
   close();
-  delete m_listener;
-  m_listener = NULL;
-  delete m_context;
-  m_context = NULL;
+  // The socket must be closed before the context is terminated, or
+  // zmq_term() blocks forever.
   delete m_socket;
   m_socket = NULL;
+  delete m_context;
+  m_context = NULL;
 }
 
 void ZeroMqConnection::open()
@@ -76,17 +82,38 @@ void ZeroMqConnection::open()
 
 void ZeroMqConnection::start()
 {
-  if (!m_listener->isActive()) {
-    m_listener->start(50);
-  }
+  if (m_notifier)
+    return;
+
+#ifdef Q_OS_WIN
+  SOCKET fd;
+#else
+  int fd;
+#endif
+  std::size_t fdSize = sizeof(fd);
+  m_socket->getsockopt(ZMQ_FD, &fd, &fdSize);
+
+  m_notifier = new QSocketNotifier(static_cast<int>(fd),
+                                   QSocketNotifier::Read, this);
+  connect(m_notifier, SIGNAL(activated(int)), this, SLOT(listen()));
+
+  // Pick up anything that arrived before the notifier was created.
+  listen();
 }
 
 void ZeroMqConnection::close()
 {
-  if (m_listener) {
-    m_listener->stop();
-    m_socket->close();
+  if (m_notifier) {
+    m_notifier->setEnabled(false);
+    // close() may be called from a slot connected to newMessage, i.e. while
+    // the notifier is delivering activated().
+    m_notifier->deleteLater();
+    m_notifier = NULL;
   }
+
+  // Also close sockets that were never started.
+  if (m_socket)
+    m_socket->close();
 }
 
 bool ZeroMqConnection::isOpen()
@@ -101,13 +128,19 @@ QString ZeroMqConnection::connectionString() const
 
 void ZeroMqConnection::send(const Message &msg)
 {
-  zmq::message_t message(msg.data().size());
-  memcpy(message.data(), msg.data().constData(), msg.data().size());
+  // The messages share the QByteArray storage rather than copying it. Each
+  // holds a reference to its QByteArray until ZeroMQ has finished sending.
+  QByteArray *data = new QByteArray(msg.data());
+  zmq::message_t message(const_cast<char*>(data->constData()),
+                         static_cast<std::size_t>(data->size()),
+                         releaseByteArray, data);
 
   // If on the server side send the endpoint id first
   if (m_socketType == ZMQ_ROUTER) {
-    zmq::message_t identity(msg.to().size());
-    memcpy(identity.data(), msg.to().data(), msg.to().size());
+    QByteArray *to = new QByteArray(msg.to());
+    zmq::message_t identity(const_cast<char*>(to->constData()),
+                            static_cast<std::size_t>(to->size()),
+                            releaseByteArray, to);
     bool rc  = m_socket->send(identity, ZMQ_SNDMORE | ZMQ_NOBLOCK);
 
     if (!rc) {
@@ -122,40 +155,68 @@ void ZeroMqConnection::send(const Message &msg)
   if (!rc) {
     qWarning() << "zmq_send failed with EAGAIN";
   }
+
+  // Sending updates the socket's events without necessarily signaling the
+  // file descriptor, so check for incoming messages that would otherwise go
+  // unnoticed until the next notification.
+  if (m_notifier && hasPendingMessage())
+    QMetaObject::invokeMethod(this, "listen", Qt::QueuedConnection);
 }
 
 void ZeroMqConnection::listen()
 {
-  if (m_socketType == ZMQ_DEALER) {
-    dealerReceive();
-  }
-  else if (m_socketType == ZMQ_ROUTER) {
-    routerReceive();
-  }
-  else {
-    qWarning() << "Invalid socket type";
+  // The ZeroMQ file descriptor is edge triggered: it only signals when the
+  // socket's state changes, so everything that is ready must be received now.
+  // Stop if a receiver closes the connection.
+  while (m_notifier && hasPendingMessage()) {
+    bool received = false;
+    if (m_socketType == ZMQ_DEALER) {
+      received = dealerReceive();
+    }
+    else if (m_socketType == ZMQ_ROUTER) {
+      received = routerReceive();
+    }
+    else {
+      qWarning() << "Invalid socket type";
+    }
+
+    if (!received)
+      break;
   }
 }
 
-void ZeroMqConnection::dealerReceive()
+bool ZeroMqConnection::hasPendingMessage()
+{
+#if ZMQ_VERSION_MAJOR >= 3
+  int events = 0;
+#else
+  quint32 events = 0;
+#endif
+  std::size_t eventsSize = sizeof(events);
+  m_socket->getsockopt(ZMQ_EVENTS, &events, &eventsSize);
+
+  return (events & ZMQ_POLLIN) != 0;
+}
+
+bool ZeroMqConnection::dealerReceive()
 {
   zmq::message_t message;
 
   if(m_socket->recv(&message, ZMQ_NOBLOCK)) {
 
-    int size = message.size();
-    PacketType messageBuffer;
-
-    messageBuffer.append(QString::fromLocal8Bit(static_cast<char*>(message.data()),
-                                                size));
+    PacketType packet(static_cast<const char*>(message.data()),
+                      static_cast<int>(message.size()));
 
-    Message msg(messageBuffer);
+    Message msg(packet);
 
     emit newMessage(msg);
+    return true;
   }
+
+  return false;
 }
 
-void ZeroMqConnection::routerReceive()
+bool ZeroMqConnection::routerReceive()
 {
   zmq::message_t address;
 
@@ -170,7 +231,7 @@ void ZeroMqConnection::routerReceive()
     zmq::message_t message;
     if(!m_socket->recv(&message, ZMQ_NOBLOCK)) {
       qWarning() << "Error no message body received";
-      return;
+      return false;
     }
 
     size = message.size();
@@ -180,7 +241,10 @@ void ZeroMqConnection::routerReceive()
     Message msg(EndpointId(), replyTo, packet);
 
     emit newMessage(msg);
+    return true;
   }
+
+  return false;
 }
 
 } /* namespace MoleQueue */
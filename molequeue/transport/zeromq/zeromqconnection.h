@@ -21,7 +21,7 @@
 
 #include <zmq.hpp>
 
-class QTimer;
+class QSocketNotifier;
 
 namespace MoleQueue
 {
@@ -76,18 +76,26 @@ public:
   friend class ZeroMqIdentityWrapper;
 
 private slots:
+  /**
+   * Receive all messages that are waiting on the socket. Called when the
+   * ZeroMQ file descriptor becomes readable.
+   */
   void listen();
 
 private:
-  void dealerReceive();
-  void routerReceive();
+  /// @return true if a message can be received without blocking.
+  bool hasPendingMessage();
+  /// Receive a single message. @return true if a message was received.
+  bool dealerReceive();
+  /// Receive a single message. @return true if a message was received.
+  bool routerReceive();
 
   QString m_connectionString;
   zmq::context_t *m_context;
   zmq::socket_t *m_socket;
   int m_socketType;
   bool m_connected;
-  QTimer *m_listener;
+  QSocketNotifier *m_notifier;
 };
 
 } /* namespace MoleQueue */